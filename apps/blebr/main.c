@@ -23,6 +23,11 @@
 #include "shell.h"
 #include "msg.h"
 
+#if IS_USED(MODULE_BLE_SCANNER_NETIF)
+#include "ble_scanner.h"
+#include "ble_scanner_params.h"
+#endif
+
 #define MAIN_QUEUE_SIZE     (8)
 static msg_t _main_msg_queue[MAIN_QUEUE_SIZE];
 
@@ -33,6 +38,12 @@ int main(void)
     msg_init_queue(_main_msg_queue, MAIN_QUEUE_SIZE);
     puts("RIOT border router example application");
 
+#if IS_USED(MODULE_BLE_SCANNER_NETIF)
+    /* connect to the nodes instead of waiting for them */
+    ble_scanner_init(&ble_scan_params[0]);
+    ble_scanner_netif_init();
+#endif
+
     /* start shell */
     puts("All up, running the shell now");
     char line_buf[SHELL_DEFAULT_BUFSIZE];
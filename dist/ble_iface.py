@@ -32,6 +32,7 @@ class PEPPERCharacteristics:
     PEPPER_CONFIG_CHARACTERISTIC = "ce2ae1d5-b067-c348-985a-ba2f2b0ac8d0"
     PEPPER_START_CHARACTERISTIC = "ce2ae1d5-b067-c348-985a-ba2f2b0ac8d1"
     PEPPER_STOP_CHARACTERISTIC = "ce2ae1d5-b067-c348-985a-ba2f2b0ac8d2"
+    PEPPER_UPDATE_CHARACTERISTIC = "ce2ae1d5-b067-c348-985a-ba2f2b0ac8d4"
 
 
 def fmt_addr(addr: int, width=2):
@@ -149,6 +150,18 @@ class PEPPERNode:
             PEPPERCharacteristics.PEPPER_START_CHARACTERISTIC, value
         )
 
+    async def read_pepper_params(self) -> PEPPERStart:
+        value = await self.__read_ble_char(
+            PEPPERCharacteristics.PEPPER_UPDATE_CHARACTERISTIC
+        )
+        return PEPPERStart.from_bytes(value)
+
+    async def write_pepper_update(self, params: PEPPERStart):
+        value = params.to_bytes()
+        await self.__write_ble_char(
+            PEPPERCharacteristics.PEPPER_UPDATE_CHARACTERISTIC, value
+        )
+
     async def write_pepper_stop(self):
         await self.__write_ble_char(
             PEPPERCharacteristics.PEPPER_STOP_CHARACTERISTIC, b"0"
@@ -28,6 +28,9 @@
 #include "nimble/hci_common.h"
 
 #include "ble_pkt_dbg.h"
+#if IS_USED(MODULE_LATENCY)
+#include "latency.h"
+#endif
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_WARNING
@@ -92,6 +95,9 @@ static void _on_scan_evt(uint8_t type, const ble_addr_t *addr,
     assert(addr);
     assert(adv_len <= BLE_ADV_PDU_LEN);
 
+#if IS_USED(MODULE_LATENCY)
+    latency_begin(LATENCY_STAGE_SCAN_DISPATCH);
+#endif
     bluetil_ad_t ad = BLUETIL_AD_INIT((uint8_t *)adv, adv_len, adv_len);
     uint32_t ts = ztimer_now(ZTIMER_MSEC);
 
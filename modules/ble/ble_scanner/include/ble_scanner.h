@@ -40,6 +40,54 @@ extern "C" {
  */
 #define CONFIG_BLE_SCANNER_AUTO_START       1
 
+/**
+ * @brief   Maximum number of connections opened by `ble_scanner_netif`
+ *
+ * Connections in the master role, defaults to all the connections NimBLE
+ * supports. Must not exceed NIMBLE_NETIF_MAX_CONN.
+ */
+#ifndef CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF
+#define CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF   NIMBLE_NETIF_MAX_CONN
+#endif
+
+/**
+ * @brief   Maximum number of connections accepted in the slave role
+ *
+ * Connections above it are closed as soon as they are established, defaults
+ * to all the connections NimBLE supports.
+ */
+#ifndef CONFIG_BLE_SCANNER_NETIF_SLAVE_NUMOF
+#define CONFIG_BLE_SCANNER_NETIF_SLAVE_NUMOF    NIMBLE_NETIF_MAX_CONN
+#endif
+
+/**
+ * @brief   Time a connection needs in every connection interval [in ms]
+ *
+ * The connection interval of all connections is stretched to at least this
+ * times the number of connections so that their connection events fit.
+ */
+#ifndef CONFIG_BLE_SCANNER_NETIF_CONN_EVENT_MS
+#define CONFIG_BLE_SCANNER_NETIF_CONN_EVENT_MS  (10U)
+#endif
+
+/**
+ * @brief   Minimum connection time before a connection is rotated out [in ms]
+ *
+ * When all connections are in use and another node advertises, the oldest
+ * connection is closed once it was open for that long, so that all nodes with
+ * pending data get served. 0 disables rotation.
+ */
+#ifndef CONFIG_BLE_SCANNER_NETIF_CONN_SLICE_MS
+#define CONFIG_BLE_SCANNER_NETIF_CONN_SLICE_MS  (0U)
+#endif
+
+/**
+ * @brief   Time a slot freed by rotation is reserved to the waiting node [in ms]
+ */
+#ifndef CONFIG_BLE_SCANNER_NETIF_RESERVE_MS
+#define CONFIG_BLE_SCANNER_NETIF_RESERVE_MS     (2000U)
+#endif
+
 /**
  * @brief   Set of scan connection parameters
  */
@@ -162,6 +210,20 @@ void ble_scanner_netif_update(const ble_scan_netif_params_t *params);
  */
 void ble_scanner_netif_init(void);
 
+/**
+ * @brief   Returns if there is at least one netif connection
+ *
+ * @return  true if connected, false otherwise
+ */
+bool ble_scanner_netif_connected(void);
+
+/**
+ * @brief   Returns the number of connections opened by the netif module
+ *
+ * @return  the number of connections in the master role
+ */
+unsigned ble_scanner_netif_conn_count(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,21 +30,31 @@
 #include "nimble_riot.h"
 #include "nimble_netif.h"
 #include "nimble_netif_conn.h"
+#include "bitfield.h"
+#include "ztimer.h"
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_WARNING
 #endif
 #include "log.h"
 
-enum {
-    STATE_IDLE,
-    STATE_CONNECTED,
-    STATE_CONNECTING,
-    STATE_CLOSED,
-};
+/* connection slots, only connections we initiated (master role) use them */
+typedef struct {
+    int handle;                     /* -1 when free */
+    uint8_t addr[BLE_ADDR_LEN];     /* network byte order */
+    uint32_t since_ms;              /* connection time */
+} _slot_t;
 
-static volatile uint8_t _state = STATE_IDLE;
+static _slot_t _slots[CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF];
+static volatile bool _connecting = false;
+static volatile uint8_t _masters = 0;
+/* slave connections by handle, from their initiation until closed or aborted */
+static BITFIELD(_slaves, NIMBLE_NETIF_MAX_CONN);
+/* a slot freed for a waiting node is reserved to it for a while */
+static uint8_t _reserved_addr[BLE_ADDR_LEN];
+static uint32_t _reserved_until_ms;
 static nimble_netif_connect_cfg_t _conn_params;
+static struct ble_gap_upd_params _conn_update_params;
 
 static void _evt_dbg(const char *msg, int handle, const uint8_t *addr)
 {
@@ -60,9 +70,53 @@ static void _evt_dbg(const char *msg, int handle, const uint8_t *addr)
     }
 }
 
+static _slot_t *_slot_find(int handle)
+{
+    for (unsigned i = 0; i < CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF; i++) {
+        if (_slots[i].handle == handle) {
+            return &_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static int _conn_update(nimble_netif_conn_t *conn, int handle, void *arg)
+{
+    (void)conn;
+    (void)arg;
+    nimble_netif_update(handle, (const struct ble_gap_upd_params *)arg);
+    return 0;
+}
+
+/* every connection gets a share of the connection interval, so that their
+   connection events do not collide the interval grows with their number */
+static void _conn_itvl_schedule(void)
+{
+    uint32_t itvl_ms = _masters * CONFIG_BLE_SCANNER_NETIF_CONN_EVENT_MS;
+    uint32_t itvl_min_ms = _conn_params.conn_itvl_min_ms;
+    uint32_t itvl_max_ms = _conn_params.conn_itvl_max_ms;
+
+    if (itvl_ms > itvl_min_ms) {
+        itvl_min_ms = itvl_ms;
+        itvl_max_ms = itvl_ms > itvl_max_ms ? itvl_ms : itvl_max_ms;
+    }
+    uint16_t itvl_min = BLE_GAP_CONN_ITVL_MS(itvl_min_ms);
+    uint16_t itvl_max = BLE_GAP_CONN_ITVL_MS(itvl_max_ms);
+
+    if (itvl_min != _conn_update_params.itvl_min ||
+        itvl_max != _conn_update_params.itvl_max) {
+        _conn_update_params.itvl_min = itvl_min;
+        _conn_update_params.itvl_max = itvl_max;
+        nimble_netif_conn_foreach(NIMBLE_NETIF_GAP_MASTER, _conn_update,
+                                  &_conn_update_params);
+    }
+}
+
 static void _on_netif_evt(int handle, nimble_netif_event_t event,
                           const uint8_t *addr)
 {
+    _slot_t *slot;
+
     switch (event) {
     case NIMBLE_NETIF_ACCEPTING:
         _evt_dbg("ACCEPTING", handle, addr);
@@ -72,35 +126,59 @@ static void _on_netif_evt(int handle, nimble_netif_event_t event,
         break;
     case NIMBLE_NETIF_INIT_MASTER:
         _evt_dbg("CONN_INIT master", handle, addr);
-        _state = STATE_CONNECTING;
+        _connecting = true;
         break;
     case NIMBLE_NETIF_INIT_SLAVE:
         _evt_dbg("CONN_INIT slave", handle, addr);
-        _state = STATE_CONNECTING;
+        bf_set(_slaves, handle);
         break;
     case NIMBLE_NETIF_CONNECTED_MASTER:
         _evt_dbg("CONNECTED master", handle, addr);
-        _state = STATE_CONNECTED;
+        _connecting = false;
+        slot = _slot_find(-1);
+        if (slot) {
+            slot->handle = handle;
+            memcpy(slot->addr, addr, BLE_ADDR_LEN);
+            slot->since_ms = ztimer_now(ZTIMER_MSEC);
+            _masters++;
+            _conn_itvl_schedule();
+        }
+        else {
+            /* we only initiate connections when a slot is free */
+            nimble_netif_close(handle);
+        }
         break;
     case NIMBLE_NETIF_CONNECTED_SLAVE:
         _evt_dbg("CONNECTED slave", handle, addr);
-        _state = STATE_CONNECTED;
+        bf_set(_slaves, handle);
+        if (bf_popcnt(_slaves, NIMBLE_NETIF_MAX_CONN) >
+            CONFIG_BLE_SCANNER_NETIF_SLAVE_NUMOF) {
+            LOG_DEBUG("[ble_scanner] netif: too many slave connections\n");
+            nimble_netif_close(handle);
+        }
         break;
     case NIMBLE_NETIF_CLOSED_MASTER:
         _evt_dbg("CLOSED master", handle, addr);
-        _state = STATE_IDLE;
+        slot = _slot_find(handle);
+        if (slot) {
+            slot->handle = -1;
+            _masters--;
+            _conn_itvl_schedule();
+        }
         break;
     case NIMBLE_NETIF_CLOSED_SLAVE:
         _evt_dbg("CLOSED slave", handle, addr);
-        _state = STATE_CLOSED;
+        bf_unset(_slaves, handle);
         break;
     case NIMBLE_NETIF_ABORT_MASTER:
         _evt_dbg("ABORT master", handle, addr);
-        _state = STATE_IDLE;
+        _connecting = false;
         break;
     case NIMBLE_NETIF_ABORT_SLAVE:
         _evt_dbg("ABORT slave", handle, addr);
-        _state = STATE_IDLE;
+        if (handle >= 0) {
+            bf_unset(_slaves, handle);
+        }
         break;
     case NIMBLE_NETIF_CONN_UPDATED:
         _evt_dbg("UPDATED", handle, addr);
@@ -110,20 +188,12 @@ static void _on_netif_evt(int handle, nimble_netif_event_t event,
         assert(0);
     }
 
-    if (ble_scanner_is_enabled() && _state != STATE_CONNECTING) {
+    if (ble_scanner_is_enabled() && !_connecting) {
         LOG_DEBUG("[ble_scanner] netif: restart scanner\n");
         nimble_scanner_start();
     }
 }
 
-static int _conn_update(nimble_netif_conn_t *conn, int handle, void *arg)
-{
-    (void)conn;
-    (void)arg;
-    nimble_netif_update(handle, (const struct ble_gap_upd_params *)arg);
-    return 0;
-}
-
 static int _filter_uuid(const bluetil_ad_t *ad)
 {
     bluetil_ad_data_t incomp;
@@ -140,6 +210,27 @@ static int _filter_uuid(const bluetil_ad_t *ad)
     return 0;
 }
 
+/* picks the connection to close for a waiting node, the one connected for
+   the longest time if it had its slice already */
+static _slot_t *_slot_rotate(uint32_t now)
+{
+    _slot_t *oldest = NULL;
+
+    if (CONFIG_BLE_SCANNER_NETIF_CONN_SLICE_MS == 0) {
+        return NULL;
+    }
+    for (unsigned i = 0; i < CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF; i++) {
+        if (_slots[i].handle >= 0 &&
+            (!oldest || now - _slots[i].since_ms > now - oldest->since_ms)) {
+            oldest = &_slots[i];
+        }
+    }
+    if (oldest && now - oldest->since_ms >= CONFIG_BLE_SCANNER_NETIF_CONN_SLICE_MS) {
+        return oldest;
+    }
+    return NULL;
+}
+
 void _netif_cb(uint8_t adv_type, const ble_addr_t *addr,
                uint32_t ts, const nimble_scanner_info_t *info,
                const bluetil_ad_t *ad, void *arg)
@@ -148,25 +239,49 @@ void _netif_cb(uint8_t adv_type, const ble_addr_t *addr,
     (void)arg;
     (void)ts;
 
-    /* only interested in NONCONN adv */
-    if (adv_type == BLE_HCI_ADV_TYPE_ADV_IND) {
-        /* for connection checking we need the address in network byte order */
-        uint8_t addrn[BLE_ADDR_LEN];
-
-        bluetil_addr_swapped_cp(addr->val, addrn);
-
-        if (_filter_uuid(ad) && !nimble_netif_conn_connected(addrn)) {
-            LOG_DEBUG("[ble_scanner] netif: stop scanner\n");
-            nimble_scanner_stop();
-            LOG_DEBUG("[ble_scanner] netif: found AP, initiating connection\n");
-            int ret = nimble_netif_connect(addr, &_conn_params);
-            if (ret < 0) {
-                LOG_DEBUG("[ble_scanner] netif: unable to connect ret =%d\n", ret);
-                if (ble_scanner_is_enabled()) {
-                    LOG_DEBUG("[ble_scanner] netif: restart scanner\n");
-                    nimble_scanner_start();
-                }
-            }
+    /* only interested in connectable advertisements, nodes advertise while
+       they have data to forward */
+    if (adv_type != BLE_HCI_ADV_TYPE_ADV_IND || _connecting || !_filter_uuid(ad)) {
+        return;
+    }
+
+    /* for connection checking we need the address in network byte order */
+    uint8_t addrn[BLE_ADDR_LEN];
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+
+    bluetil_addr_swapped_cp(addr->val, addrn);
+    if (nimble_netif_conn_connected(addrn)) {
+        return;
+    }
+    if (_masters == CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF) {
+        _slot_t *slot = _slot_rotate(now);
+        if (slot) {
+            LOG_DEBUG("[ble_scanner] netif: rotating out connection %d\n",
+                      slot->handle);
+            memcpy(_reserved_addr, addrn, BLE_ADDR_LEN);
+            _reserved_until_ms = now + CONFIG_BLE_SCANNER_NETIF_RESERVE_MS;
+            nimble_netif_close(slot->handle);
+        }
+        return;
+    }
+    if ((int32_t)(_reserved_until_ms - now) > 0 &&
+        memcmp(_reserved_addr, addrn, BLE_ADDR_LEN) &&
+        _masters == CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF - 1) {
+        /* the last free slot is kept for the node that was waiting */
+        return;
+    }
+
+    LOG_DEBUG("[ble_scanner] netif: stop scanner\n");
+    nimble_scanner_stop();
+    LOG_DEBUG("[ble_scanner] netif: found AP, initiating connection\n");
+    _connecting = true;
+    int ret = nimble_netif_connect(addr, &_conn_params);
+    if (ret < 0) {
+        _connecting = false;
+        LOG_DEBUG("[ble_scanner] netif: unable to connect ret =%d\n", ret);
+        if (ble_scanner_is_enabled()) {
+            LOG_DEBUG("[ble_scanner] netif: restart scanner\n");
+            nimble_scanner_start();
         }
     }
 }
@@ -176,11 +291,19 @@ static ble_scan_listener_t _netif_listener = {
 
 bool ble_scanner_netif_connected(void)
 {
-    return _state == STATE_CONNECTED;
+    return _masters > 0 || bf_popcnt(_slaves, NIMBLE_NETIF_MAX_CONN) > 0;
+}
+
+unsigned ble_scanner_netif_conn_count(void)
+{
+    return _masters;
 }
 
 void ble_scanner_netif_init(void)
 {
+    for (unsigned i = 0; i < CONFIG_BLE_SCANNER_NETIF_MASTER_NUMOF; i++) {
+        _slots[i].handle = -1;
+    }
     /* register our event callback */
     nimble_netif_eventcb(_on_netif_evt);
     ble_scanner_register(&_netif_listener);
@@ -208,18 +331,18 @@ void ble_scanner_netif_update(const ble_scan_netif_params_t *params)
     _conn_params.own_addr_type = nimble_riot_own_addr_type;
 
     /* we use the same values to updated existing connections */
-    struct ble_gap_upd_params conn_update_params;
-
-    conn_update_params.itvl_min = BLE_GAP_CONN_ITVL_MS(params->conn_itvl_min_ms);
-    conn_update_params.itvl_max = BLE_GAP_CONN_ITVL_MS(params->conn_itvl_max_ms);
-    conn_update_params.latency = params->conn_latency_ms;
-    conn_update_params.supervision_timeout =
+    _conn_update_params.itvl_min = BLE_GAP_CONN_ITVL_MS(params->conn_itvl_min_ms);
+    _conn_update_params.itvl_max = BLE_GAP_CONN_ITVL_MS(params->conn_itvl_max_ms);
+    _conn_update_params.latency = params->conn_latency_ms;
+    _conn_update_params.supervision_timeout =
         BLE_GAP_SUPERVISION_TIMEOUT_MS(params->conn_super_to_ms);
-    conn_update_params.min_ce_len = 0;
-    conn_update_params.max_ce_len = 0;
+    _conn_update_params.min_ce_len = 0;
+    _conn_update_params.max_ce_len = 0;
 
     /* we also need to apply the new connection parameters to all BLE
-     * connections where we are in the MASTER role */
+     * connections where we are in the MASTER role, the interval is
+     * stretched if they do not fit in it */
     nimble_netif_conn_foreach(NIMBLE_NETIF_GAP_MASTER, _conn_update,
-                              &conn_update_params);
+                              &_conn_update_params);
+    _conn_itvl_schedule();
 }
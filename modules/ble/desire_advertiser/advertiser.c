@@ -19,10 +19,19 @@
  * @}
  */
 
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "kernel_defines.h"
+#if IS_USED(MODULE_DESIRE_ADVERTISER_SIM)
+#include "sim_bus.h"
+#else
 #include "nimble_riot.h"
 #include "host/ble_gap.h"
 
 #include "net/bluetil/ad.h"
+#endif
 
 #include "desire_ble_adv.h"
 #include "desire/ble_pkt.h"
@@ -32,8 +41,15 @@
 #include "event/callback.h"
 #include "event/timeout.h"
 #include "event/thread.h"
+#include "irq.h"
 #include "random.h"
 #include "ztimer.h"
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_ERROR
@@ -55,12 +71,14 @@ static event_queue_t _threaded_queue;
 /* pointer to the event queue to handle the advertisement events */
 static event_queue_t *_queue;
 
+#if !IS_USED(MODULE_DESIRE_ADVERTISER_SIM)
 /* settings for advertising procedure */
 static struct ble_gap_ext_adv_params _ext_advp;
 /* buffer for _ad */
 static uint8_t buf[BLE_HS_ADV_MAX_SZ];
 /* advertising data struct */
 static bluetil_ad_t _ad;
+#endif
 
 /* advertisement callback */
 static ble_adv_cb_t _adv_cb = NULL;
@@ -91,18 +109,61 @@ typedef struct {
 } adv_event_t;
 static adv_event_t _adv_event;
 
+static void _adv_complete(adv_mgr_t *mgr)
+{
+    LOG_DEBUG("[adv] %" PRIu32 " : complete event\n", ztimer_now(ZTIMER_MSEC));
+#if IS_USED(MODULE_ENERGY)
+    /* only the end of the event is known */
+    energy_add(ENERGY_STATE_BLE_ADV, CONFIG_ENERGY_BLE_ADV_EVENT_US);
+#endif
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_mark(BOOT_PHASE_FIRST_ADV);
+#endif
+    if (_adv_cb) {
+        /* timestamping at this stage does not make sense, there is in any
+           case already an OS delay of at least 100us */
+        _adv_cb(mgr->seed, _adv_cb_arg);
+    }
+}
+
+#if IS_USED(MODULE_DESIRE_ADVERTISER_SIM)
+static void _set_ble_adv_address(void)
+{
+    /* the scanner identifies the sender by its node on the bus */
+}
+
+static void _configure_ext_adv(void)
+{
+    int rc = sim_bus_init();
+
+    assert(rc == 0);
+    (void)rc;
+}
+
+static void _advertise_once(desire_ble_adv_payload_t *adv_payload)
+{
+    sim_bus_frame_t frame = {
+        .type = SIM_BUS_FRAME_BLE_ADV,
+        .len = DESIRE_ADV_PAYLOAD_SIZE,
+    };
+
+    memcpy(frame.payload, adv_payload->bytes, DESIRE_ADV_PAYLOAD_SIZE);
+    sim_bus_send(&frame);
+    /* the frame is out, there is no advertising event to wait for */
+    _adv_complete(&_adv_mgr);
+}
+
+static void _advertise_stop(void)
+{
+}
+#else
 static int _gap_event_cb(struct ble_gap_event *event, void *arg)
 {
     adv_mgr_t *mgr = (adv_mgr_t *)arg;
 
     switch (event->type) {
     case BLE_GAP_EVENT_ADV_COMPLETE:
-        LOG_DEBUG("[adv] %" PRIu32 " : complete event\n", ztimer_now(ZTIMER_MSEC));
-        if (_adv_cb) {
-            /* timestamping at this stage does not make sense, there is in any
-               case already an OS delay of at least 100us */
-            _adv_cb(mgr->seed, _adv_cb_arg);
-        }
+        _adv_complete(mgr);
         break;
     default:
         LOG_WARNING("[adv] warning: unhandled event %" PRIu8 "\n", event->type);
@@ -208,6 +269,16 @@ static void _advertise_once(desire_ble_adv_payload_t *adv_payload)
     assert(rc == 0);
 }
 
+static void _advertise_stop(void)
+{
+    if (ble_gap_ext_adv_active(CONFIG_DESIRE_ADV_INST)) {
+        int rc = ble_gap_ext_adv_stop(CONFIG_DESIRE_ADV_INST);
+        (void)rc;
+        assert(rc == BLE_HS_EALREADY || rc == 0);
+    }
+}
+#endif
+
 static void _ebid_slice_rotate(adv_mgr_t *mgr)
 {
     uint8_t slice[EBID_SLICE_SIZE_LONG];
@@ -312,14 +383,23 @@ void desire_ble_adv_init_threaded(void)
 void desire_ble_adv_stop(void)
 {
     LOG_DEBUG("[adv]: stop adv\n");
-    if (ble_gap_ext_adv_active(CONFIG_DESIRE_ADV_INST)) {
-        int rc = ble_gap_ext_adv_stop(CONFIG_DESIRE_ADV_INST);
-        (void)rc;
-        assert(rc == BLE_HS_EALREADY || rc == 0);
-    }
+    _advertise_stop();
     event_timeout_clear(&_adv_event.timeout);
 }
 
+void desire_ble_adv_update(adv_params_t *params)
+{
+    LOG_DEBUG("[adv]: update adv\n");
+    /* the advertisement handler re-arms with these values */
+    unsigned state = irq_disable();
+
+    _adv_mgr.itvl_ms = params->itvl_ms;
+    _adv_mgr.advs_slice = params->advs_slice;
+    _adv_mgr.advs_max = (uint32_t)params->advs_max == BLE_ADV_TIMEOUT_NEVER ?
+                        BLE_ADV_TIMEOUT_NEVER : _adv_mgr.advs + params->advs_max;
+    irq_restore(state);
+}
+
 void desire_ble_adv_start(ebid_t *ebid, adv_params_t *params)
 {
     LOG_DEBUG("[adv]: start adv\n");
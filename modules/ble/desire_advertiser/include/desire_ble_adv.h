@@ -148,6 +148,18 @@ void desire_ble_adv_start(ebid_t *ebid, adv_params_t *params);
  */
 void desire_ble_adv_stop(void);
 
+/**
+ * @brief   Updates the parameters of the ongoing advertisements
+ *
+ * Unlike @ref desire_ble_adv_start the EBID, cid and advertisement count are
+ * kept. The interval applies from the next advertisement and the slice
+ * rotation from the next rotation.
+ *
+ * @param[in]       params       the advertisement parameters, advs_max counts
+ *                               from the next advertisement on
+ */
+void desire_ble_adv_update(adv_params_t *params);
+
 /**
  * @brief   Callback signature triggered after each advertisement
  *
@@ -26,6 +26,9 @@
 #include "ble_scanner_params.h"
 #include "net/bluetil/ad.h"
 #include "net/bluetil/addr.h"
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
 
 #define ENABLE_DEBUG    0
 #include "debug.h"
@@ -90,12 +93,21 @@ void desire_ble_scan_start(const ble_scan_params_t *params, int32_t scan_duratio
     DEBUG_PUTS("[desire_scanner]: start");
     ble_scanner_register(&_desire_listener);
     ble_scanner_update(params);
+#if IS_USED(MODULE_ENERGY)
+    /* the receiver is only on during the scan window */
+    energy_begin_duty(ENERGY_STATE_BLE_SCAN, params->itvl_ms ?
+                      params->win_ms * ENERGY_DUTY_FULL / params->itvl_ms :
+                      ENERGY_DUTY_FULL);
+#endif
 }
 
 void desire_ble_scan_stop(void)
 {
     ztimer_remove(ZTIMER_MSEC, &_timeout);
     ble_scanner_unregister(&_desire_listener);
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_BLE_SCAN);
+#endif
     DEBUG_PUTS("[desire_scanner]: stop");
 }
 
@@ -26,14 +26,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "kernel_defines.h"
+#if !IS_USED(MODULE_DESIRE_SCANNER_SIM)
 #include "ble_scanner.h"
 #include "host/ble_hs.h"
+#endif
 #include "desire/ble_pkt.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#if IS_USED(MODULE_DESIRE_SCANNER_SIM)
+/**
+ * @brief   BLE address, as NimBLE ble_addr_t, the simulated scanner sets the
+ *          sender node in the first byte
+ */
+typedef struct {
+    uint8_t type;       /**< address type */
+    uint8_t val[6];     /**< address value */
+} ble_addr_t;
+
+/**
+ * @brief   Scan parameters, as ble_scanner ble_scan_params_t
+ */
+typedef struct {
+    uint32_t itvl_ms;   /**< scan interval */
+    uint32_t win_ms;    /**< scan window */
+} ble_scan_params_t;
+#endif
+
 /**
  * @brief   Callback signature triggered by this module for each discovered
  *          advertising Desire packet
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_ble_scanner
+ * @{
+ *
+ * @file
+ * @brief       Simulated desire scanner, advertisements are received from
+ *              the simulated radio bus
+ *
+ * Advertisements are only reported while the scan window is open, windows
+ * open every scan interval starting at @ref desire_ble_scan_start.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "ztimer.h"
+
+#include "desire_ble_scan.h"
+#include "sim_bus.h"
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
+
+#define ENABLE_DEBUG    0
+#include "debug.h"
+
+static detection_cb_t _detection_cb = NULL;
+static ble_scan_params_t _params;
+static uint32_t _start;
+static bool _scanning = false;
+
+static void _desire_ble_stop_cb(void *arg)
+{
+    (void)arg;
+    desire_ble_scan_stop();
+}
+static ztimer_t _timeout = { .callback = _desire_ble_stop_cb };
+
+static void _rx_cb(const sim_bus_frame_t *frame, const sim_bus_link_t *link)
+{
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+    desire_ble_adv_payload_t payload;
+
+    if (!_scanning || frame->len != DESIRE_ADV_PAYLOAD_SIZE) {
+        return;
+    }
+    if (_params.itvl_ms && (now - _start) % _params.itvl_ms >= _params.win_ms) {
+        DEBUG_PUTS("[desire_scanner]: sim, outside of scan window");
+        return;
+    }
+    memcpy(payload.bytes, frame->payload, DESIRE_ADV_PAYLOAD_SIZE);
+    if (payload.data.service_uuid_16 == DESIRE_SERVICE_UUID16 &&
+        _detection_cb != NULL) {
+        /* a random address per sender node */
+        ble_addr_t addr = { .type = 1, .val = { frame->node } };
+        _detection_cb(now, &addr, link->rssi, &payload);
+    }
+}
+
+void desire_ble_scan_init(detection_cb_t cb)
+{
+    int rc = sim_bus_init();
+
+    assert(rc == 0);
+    (void)rc;
+    desire_ble_set_detection_cb(cb);
+    sim_bus_set_rx_cb(SIM_BUS_FRAME_BLE_ADV, _rx_cb);
+}
+
+void desire_ble_scan_start(const ble_scan_params_t *params, int32_t scan_duration_ms)
+{
+    ztimer_set(ZTIMER_MSEC, &_timeout, scan_duration_ms);
+    DEBUG_PUTS("[desire_scanner]: sim start");
+    _params = *params;
+    _start = ztimer_now(ZTIMER_MSEC);
+    _scanning = true;
+#if IS_USED(MODULE_ENERGY)
+    /* the receiver is only on during the scan window */
+    energy_begin_duty(ENERGY_STATE_BLE_SCAN, params->itvl_ms ?
+                      params->win_ms * ENERGY_DUTY_FULL / params->itvl_ms :
+                      ENERGY_DUTY_FULL);
+#endif
+}
+
+void desire_ble_scan_stop(void)
+{
+    ztimer_remove(ZTIMER_MSEC, &_timeout);
+    _scanning = false;
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_BLE_SCAN);
+#endif
+    DEBUG_PUTS("[desire_scanner]: sim stop");
+}
+
+void desire_ble_set_detection_cb(detection_cb_t cb)
+{
+    assert(cb);
+    _detection_cb = cb;
+}
@@ -20,7 +20,21 @@
 #ifndef BLE_PKT_DBG_H
 #define BLE_PKT_DBG_H
 
+#include <stdint.h>
+#include <stdio.h>
+
+#include "kernel_defines.h"
+/**
+ * @brief   NimBLE is left out when the advertiser is simulated, unless the
+ *          NimBLE scanner is used, the simulated scanner does not need it
+ */
+#define BLE_PKT_DBG_NIMBLE  (!IS_USED(MODULE_DESIRE_ADVERTISER_SIM) || \
+                             IS_USED(MODULE_BLE_SCANNER))
+
+/* the address and advertisement type helpers need NimBLE */
+#if BLE_PKT_DBG_NIMBLE
 #include "host/ble_hs.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -71,6 +85,7 @@ static inline void dbg_reverse_dump_buffer(const char *prefix,
     }
 }
 
+#if BLE_PKT_DBG_NIMBLE
 /**
  * @brief   Returns address type as astring
  *
@@ -116,6 +131,7 @@ static inline void dbg_print_ble_addr(const ble_addr_t *addr)
     dbg_reverse_dump_buffer("ble_addr = ", addr->val, 6, ' ');
     printf("%s\n", dbg_parse_ble_addr_type(addr->type));
 }
+#endif
 
 #ifdef __cplusplus
 }
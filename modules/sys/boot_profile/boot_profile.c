@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_boot_profile
+ * @{
+ *
+ * @file
+ * @brief       Boot phases profiling implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include "irq.h"
+#include "timex.h"
+#include "ztimer.h"
+
+#include "boot_profile.h"
+
+static const char *_names[BOOT_PHASE_NUMOF] = {
+    [BOOT_PHASE_PEPPER_INIT] = "pepper_init",
+    [BOOT_PHASE_BLE_ADV_INIT] = "ble_adv_init",
+    [BOOT_PHASE_BLE_SCAN_INIT] = "ble_scan_init",
+    [BOOT_PHASE_TWR_INIT] = "twr_init",
+    [BOOT_PHASE_BPF_INIT] = "bpf_init",
+    [BOOT_PHASE_SRV_INIT] = "srv_init",
+    [BOOT_PHASE_STORAGE_MOUNT] = "storage_mount",
+    [BOOT_PHASE_EDHOC_INIT] = "edhoc_init",
+    [BOOT_PHASE_FIRST_ADV] = "first_adv",
+};
+
+static uint32_t _begin_ms[BOOT_PHASE_NUMOF];
+static uint32_t _begin[BOOT_PHASE_NUMOF];
+static uint32_t _end[BOOT_PHASE_NUMOF];
+/* bitmaps of started and ended phases */
+static uint32_t _started;
+static uint32_t _ended;
+
+static uint32_t _ticks_to_us(uint32_t ticks)
+{
+    return (uint64_t)ticks * US_PER_SEC / CONFIG_ZTIMER_MSEC_BASE_FREQ;
+}
+
+void boot_profile_begin(boot_phase_t phase)
+{
+    unsigned state = irq_disable();
+
+    if (!(_started & (1UL << phase))) {
+        _begin_ms[phase] = ztimer_now(ZTIMER_MSEC);
+        _begin[phase] = ztimer_now(ZTIMER_MSEC_BASE);
+        _started |= 1UL << phase;
+    }
+    irq_restore(state);
+}
+
+void boot_profile_end(boot_phase_t phase)
+{
+    unsigned state = irq_disable();
+
+    if ((_started & (1UL << phase)) && !(_ended & (1UL << phase))) {
+        _end[phase] = ztimer_now(ZTIMER_MSEC_BASE);
+        _ended |= 1UL << phase;
+    }
+    irq_restore(state);
+}
+
+void boot_profile_get(boot_phase_t phase, boot_profile_entry_t *entry)
+{
+    unsigned state = irq_disable();
+
+    entry->done = _ended & (1UL << phase);
+    entry->start_ms = entry->done ? _begin_ms[phase] : 0;
+    entry->us = entry->done ? _ticks_to_us(_end[phase] - _begin[phase]) : 0;
+    irq_restore(state);
+}
+
+const char *boot_profile_phase_name(boot_phase_t phase)
+{
+    return phase < BOOT_PHASE_NUMOF ? _names[phase] : "unknown";
+}
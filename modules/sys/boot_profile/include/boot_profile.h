@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sys_boot_profile Boot Phases Profiling
+ * @ingroup     sys
+ * @brief       Start and duration of the initialization phases after a reset
+ *
+ * Initialization code marks the start and end of each phase with
+ * @ref boot_profile_begin and @ref boot_profile_end, milestones such as the
+ * first advertisement are marked with @ref boot_profile_mark. Only the first
+ * occurrence of a phase is kept, so that phases deferred until first use are
+ * reported when they actually ran.
+ *
+ * Starts are timestamped with ZTIMER_MSEC, so that late milestones do not
+ * wrap around, and durations with ZTIMER_MSEC_BASE. Times are relative to
+ * the ztimer initialization early in auto_init, which is close to the reset.
+ *
+ * @{
+ *
+ * @file
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Boot phases
+ */
+typedef enum {
+    BOOT_PHASE_PEPPER_INIT = 0,     /**< pepper_init as a whole */
+    BOOT_PHASE_BLE_ADV_INIT,        /**< desire advertiser */
+    BOOT_PHASE_BLE_SCAN_INIT,       /**< desire scanner */
+    BOOT_PHASE_TWR_INIT,            /**< twr and the UWB radio */
+    BOOT_PHASE_BPF_INIT,            /**< femto-containers and SUIT regions */
+    BOOT_PHASE_SRV_INIT,            /**< pepper_srv_init as a whole */
+    BOOT_PHASE_STORAGE_MOUNT,       /**< storage mount and directories */
+    BOOT_PHASE_EDHOC_INIT,          /**< security context and EDHOC credentials */
+    BOOT_PHASE_FIRST_ADV,           /**< first advertising event, milestone */
+    BOOT_PHASE_NUMOF,               /**< number of phases */
+} boot_phase_t;
+
+/**
+ * @brief   A boot phase profile
+ */
+typedef struct {
+    uint32_t start_ms;  /**< phase start since boot */
+    uint32_t us;        /**< phase duration */
+    bool done;          /**< the phase ran */
+} boot_profile_entry_t;
+
+/**
+ * @brief   Mark the start of a phase
+ *
+ * Ignored if the phase already ran or started.
+ *
+ * @param[in]   phase   the phase
+ */
+void boot_profile_begin(boot_phase_t phase);
+
+/**
+ * @brief   Mark the end of a phase
+ *
+ * Ignored if the phase already ran or did not start.
+ *
+ * @param[in]   phase   the phase
+ */
+void boot_profile_end(boot_phase_t phase);
+
+/**
+ * @brief   Mark a milestone, a phase without duration
+ *
+ * @param[in]   phase   the phase
+ */
+static inline void boot_profile_mark(boot_phase_t phase)
+{
+    boot_profile_begin(phase);
+    boot_profile_end(phase);
+}
+
+/**
+ * @brief   Get a phase profile
+ *
+ * @param[in]   phase   the phase
+ * @param[out]  entry   the phase profile
+ */
+void boot_profile_get(boot_phase_t phase, boot_profile_entry_t *entry);
+
+/**
+ * @brief   Name of a phase
+ *
+ * @param[in]   phase   the phase
+ *
+ * @return  the phase name
+ */
+const char *boot_profile_phase_name(boot_phase_t phase);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_PROFILE_H */
+/** @} */
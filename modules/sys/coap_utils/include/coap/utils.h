@@ -41,6 +41,41 @@ extern "C" {
 #define CONFIG_COAP_UTILS_BLOCK_SIZE    64
 #endif
 
+/**
+ * @brief   Maximum number of blocks in flight during a block POST
+ *
+ * The first block is sent alone to negotiate the block size, the following
+ * ones are sent as a burst of non-confirmable messages, in the spirit of
+ * RFC 9177 Q-Block1. Each in flight block uses one gcoap request memo so
+ * this is bounded by CONFIG_GCOAP_REQ_WAITING_MAX. coap_utils defaults it to
+ * 8, applications overriding it must leave room for the window next to
+ * their other pending requests.
+ */
+#ifndef CONFIG_COAP_UTILS_BLOCK_WINDOW
+#define CONFIG_COAP_UTILS_BLOCK_WINDOW  4
+#endif
+
+/**
+ * @brief   Maximum number of block retransmissions per block transaction
+ */
+#ifndef CONFIG_COAP_UTILS_BLOCK_RETRIES
+#define CONFIG_COAP_UTILS_BLOCK_RETRIES 8
+#endif
+
+/**
+ * @brief   Number of request contexts in the shared pool
+ */
+#ifndef CONFIG_COAP_UTILS_REQ_POOL_SIZE
+#define CONFIG_COAP_UTILS_REQ_POOL_SIZE     4
+#endif
+
+/**
+ * @brief   Number of block contexts in the shared pool
+ */
+#ifndef CONFIG_COAP_UTILS_BLOCK_POOL_SIZE
+#define CONFIG_COAP_UTILS_BLOCK_POOL_SIZE   1
+#endif
+
 /**
  * @brief CoAP response callback, passes the returned payload and optional arg,
  *        the payload can be NULL.
@@ -54,20 +89,69 @@ typedef struct coap_req_ctx {
     mutex_t resp_wait;          /**< locked when context is in use */
     coap_req_cb_t cb;           /**< req completion callback */
     void *arg;                  /**< optional argument */
+    uint8_t token[GCOAP_TOKENLEN_MAX];  /**< token of the pending request */
+    uint8_t token_len;          /**< token length */
+    bool pooled;                /**< context belongs to the shared pool */
+    bool in_use;                /**< pool context is allocated */
 } coap_req_ctx_t;
 
+/**
+ * @brief   Block transaction statistics
+ */
+typedef struct {
+    uint32_t duration_ms;       /**< time from first block to completion */
+    uint16_t blocks;            /**< number of blocks */
+    uint16_t retransmits;       /**< number of retransmitted blocks */
+} coap_block_stats_t;
+
+/**
+ * @brief   In flight block
+ */
+typedef struct {
+    uint16_t msg_id;            /**< request message id */
+    bool used;                  /**< slot in use */
+    size_t blknum;              /**< block number */
+} coap_block_slot_t;
+
 /**
  * @brief   Context for block transactions
  */
 typedef struct coap_block_ctx {
     coap_req_ctx_t req_ctx;     /**< CoAP request context */
-    size_t last_blknum;         /**< last transmitted blknum */
+    size_t last_blknum;         /**< next never transmitted blknum */
     void *data;                 /**< pointer to data to transmit */
     size_t data_len;            /**< length of data to be transmitted */
     uint8_t format;             /**< media format */
     const char *uri;            /**< uri for block exchange */
+    const sock_udp_ep_t *remote;    /**< remote endpoint */
+    mutex_t lock;               /**< protects the transaction state */
+    size_t blk_size;            /**< preferred block size, 0 for default */
+    uint8_t window;             /**< max blocks in flight, 0 for
+                                     CONFIG_COAP_UTILS_BLOCK_WINDOW */
+    uint8_t szx;                /**< negotiated block size exponent */
+    bool negotiated;            /**< block size was negotiated */
+    uint8_t inflight;           /**< number of blocks in flight */
+    uint8_t retries;            /**< retransmissions left */
+    int status;                 /**< transaction status, 0 while running */
+    size_t base;                /**< lowest unacknowledged blknum */
+    uint32_t acked;             /**< acknowledged blocks bitmap from base */
+    uint32_t start;             /**< transaction start time */
+    coap_block_slot_t slots[CONFIG_COAP_UTILS_BLOCK_WINDOW]; /**< in flight blocks */
+    coap_block_stats_t stats;   /**< last transaction statistics */
 } coap_block_ctx_t;
 
+/**
+ * @brief   Context for an Observe relationship (RFC 7641)
+ */
+typedef struct {
+    coap_req_ctx_t req_ctx;     /**< CoAP request context, the callback is
+                                     called for every notification */
+    const sock_udp_ep_t *remote;    /**< observed remote */
+    uint32_t seq;               /**< last notification sequence number */
+    bool seq_valid;             /**< a notification was received */
+    bool registered;            /**< the relationship is established */
+} coap_obs_ctx_t;
+
 /**
  * @brief   Initialize a coap_get_ctx_t
  *
@@ -81,8 +165,90 @@ static inline void coap_req_ctx_init(coap_req_ctx_t *ctx, coap_req_cb_t cb,
     mutex_init(&ctx->resp_wait);
     ctx->cb = cb;
     ctx->arg = arg;
+    ctx->token_len = 0;
+    ctx->pooled = false;
+    ctx->in_use = false;
+}
+
+/**
+ * @brief   Initialize a coap_block_ctx_t
+ *
+ * @param[inout]    ctx         the context to initialize
+ * @param[in]       cb          optional callback called on completion
+ * @param[in]       arg         optional callback argument
+ * @param[in]       blk_size    preferred block size (16..1024), the server
+ *                              may negotiate it down, 0 for
+ *                              CONFIG_COAP_UTILS_BLOCK_SIZE
+ */
+static inline void coap_block_ctx_init(coap_block_ctx_t *ctx, coap_req_cb_t cb,
+                                       void *arg, size_t blk_size)
+{
+    memset(ctx, '\0', sizeof(*ctx));
+    coap_req_ctx_init(&ctx->req_ctx, cb, arg);
+    mutex_init(&ctx->lock);
+    ctx->blk_size = blk_size;
+}
+
+/**
+ * @brief   Initialize a coap_obs_ctx_t
+ *
+ * @param[inout]    ctx     the context to initialize
+ * @param[in]       cb      callback called with every notification payload,
+ *                          or with a negative value once the relationship
+ *                          is lost
+ * @param[in]       arg     optional callback argument
+ */
+static inline void coap_obs_ctx_init(coap_obs_ctx_t *ctx, coap_req_cb_t cb,
+                                     void *arg)
+{
+    memset(ctx, '\0', sizeof(*ctx));
+    coap_req_ctx_init(&ctx->req_ctx, cb, arg);
+}
+
+/**
+ * @brief   Checks if an Observe relationship is established
+ *
+ * @param[in]       ctx     the observe context
+ *
+ * @return  true if notifications are being received
+ */
+static inline bool coap_obs_is_registered(coap_obs_ctx_t *ctx)
+{
+    return ctx->registered;
 }
 
+/**
+ * @brief   Allocate a request context from the shared pool
+ *
+ * Pool contexts allow several requests to the same remote to be in flight
+ * at once, responses are matched to their context through the request
+ * token. The context is returned to the pool once the request completes,
+ * right after @p cb was called, or if the request could not be sent. It must
+ * therefore not be waited on through its resp_wait mutex.
+ *
+ * @param[in]       cb      optional callback to handle received payload
+ * @param[in]       arg     optional callback argument
+ *
+ * @return  the context, NULL if the pool is exhausted
+ */
+coap_req_ctx_t *coap_req_ctx_alloc(coap_req_cb_t cb, void *arg);
+
+/**
+ * @brief   Allocate a block context from the shared pool
+ *
+ * Same as @ref coap_req_ctx_alloc, the data to send must remain valid until
+ * @p cb is called.
+ *
+ * @param[in]       cb          optional callback called on completion
+ * @param[in]       arg         optional callback argument
+ * @param[in]       blk_size    preferred block size, 0 for
+ *                              CONFIG_COAP_UTILS_BLOCK_SIZE
+ *
+ * @return  the context, NULL if the pool is exhausted
+ */
+coap_block_ctx_t *coap_block_ctx_alloc(coap_req_cb_t cb, void *arg,
+                                       size_t blk_size);
+
 /**
  * @brief   Checks if the CoAP request context is free
  *
@@ -145,21 +311,62 @@ int coap_get(sock_udp_ep_t *remote, coap_req_ctx_t *ctx,
 /**
  * @brief       Perform a CoAP block POST
  *
- * @param[inout]    remote      the remote endpoint
+ * The first block is sent as is, once the server answers (possibly with a
+ * smaller block size) the remaining blocks are pipelined, up to
+ * CONFIG_COAP_UTILS_BLOCK_WINDOW in flight. Blocks that time out or that
+ * the server reports as missing (4.08) are selectively retransmitted. The
+ * context callback is called once all blocks were acknowledged or on error.
+ *
+ * @param[inout]    remote      the remote endpoint, must stay valid until
+ *                              the transaction ends
  * @param[in]       ctx         the coap block ctx, cant be NULL
  * @param[in]       uri         the destination uri
  * @param[in]       data        the data to be sent
  * @param[in]       data_len    the length of the data to be sent out
  * @param[in]       format      the media type format to use
- * @param[in]       type        the message type
  *
- * @retval  0   if successfully started & ended block transaction (single block)
+ * @note    Blocks are always sent as confirmable messages.
+ *
+ * @retval  0   if successfully started transaction (single block)
  * @retval  1   if successfully started transaction (multiple blocks)
  * @retval  <0  on error
  */
 int coap_block_post(sock_udp_ep_t *remote, coap_block_ctx_t *ctx,
                     void *data, size_t data_len,
-                    const char *uri, uint8_t format, uint8_t type);
+                    const char *uri, uint8_t format);
+
+/**
+ * @brief       Register to a resource with CoAP Observe
+ *
+ * Sends a GET with the Observe option, the context callback is then called
+ * with the initial response and every following notification, older
+ * reordered notifications are discarded. If the server answers without the
+ * Observe option, or the request times out, the callback is called and the
+ * context is left unregistered, see @ref coap_obs_is_registered.
+ *
+ * This relies on gcoap keeping the request memo alive for responses that
+ * carry the Observe option (client side Observe support in gcoap).
+ *
+ * @param[inout]    remote      the remote endpoint, must stay valid while
+ *                              registered
+ * @param[in]       ctx         the observe context, cant be NULL
+ * @param[in]       uri         the resource to observe
+ * @param[in]       format      the media type format to use
+ *
+ * @return length of sent packet on success, <0 on error
+ */
+int coap_observe(sock_udp_ep_t *remote, coap_obs_ctx_t *ctx,
+                 const char *uri, uint8_t format);
+
+/**
+ * @brief       Forget an Observe relationship
+ *
+ * Later notifications are answered with a reset by gcoap, which makes the
+ * server drop the relationship.
+ *
+ * @param[in]       ctx         the observe context
+ */
+void coap_observe_cancel(coap_obs_ctx_t *ctx);
 
 #ifdef __cplusplus
 }
@@ -30,19 +30,112 @@
 #include "coap/utils.h"
 #include "od.h"
 #include "fmt.h"
+#include "bitarithm.h"
+#include "ztimer.h"
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_ERROR
 #endif
 #include "log.h"
 
-/* forward declaration */
-static int _do_block_post(coap_pkt_t *pdu, const sock_udp_ep_t *remote,
-                          coap_block_ctx_t *ctx);
+/* track at most as many blocks ahead of the lowest unacknowledged one as
+   fit in the acknowledgment bitmap */
+#define BLOCK_ACK_SPAN      (32U)
+
+/* pdu buffer for blocks sent from the gcoap thread */
+static uint8_t _block_buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+
+static coap_req_ctx_t _req_pool[CONFIG_COAP_UTILS_REQ_POOL_SIZE];
+static coap_block_ctx_t _block_pool[CONFIG_COAP_UTILS_BLOCK_POOL_SIZE];
+static mutex_t _pool_lock = MUTEX_INIT;
+
+static coap_hdr_t *_memo_hdr(const gcoap_request_memo_t *memo)
+{
+    if (memo->send_limit == GCOAP_SEND_LIMIT_NON) {
+        return (coap_hdr_t *)memo->msg.hdr_buf;
+    }
+    return (coap_hdr_t *)memo->msg.data.pdu_buf;
+}
+
+static size_t _hdr_token(coap_hdr_t *hdr, const uint8_t **token)
+{
+    *token = (uint8_t *)hdr + sizeof(coap_hdr_t);
+    return hdr->ver_t_tkl & 0xf;
+}
+
+static void _ctx_set_token(coap_req_ctx_t *ctx, coap_hdr_t *hdr)
+{
+    const uint8_t *token;
+
+    ctx->token_len = _hdr_token(hdr, &token);
+    memcpy(ctx->token, token, ctx->token_len);
+}
+
+static bool _ctx_match_token(coap_req_ctx_t *ctx, coap_hdr_t *hdr)
+{
+    const uint8_t *token;
+    size_t token_len = _hdr_token(hdr, &token);
+
+    return token_len == ctx->token_len &&
+           !memcmp(token, ctx->token, token_len);
+}
+
+static void _ctx_release(coap_req_ctx_t *ctx)
+{
+    if (ctx && ctx->pooled) {
+        mutex_lock(&_pool_lock);
+        ctx->in_use = false;
+        mutex_unlock(&_pool_lock);
+    }
+}
+
+coap_req_ctx_t *coap_req_ctx_alloc(coap_req_cb_t cb, void *arg)
+{
+    coap_req_ctx_t *ctx = NULL;
+
+    mutex_lock(&_pool_lock);
+    for (unsigned i = 0; i < CONFIG_COAP_UTILS_REQ_POOL_SIZE; i++) {
+        if (!_req_pool[i].in_use) {
+            ctx = &_req_pool[i];
+            coap_req_ctx_init(ctx, cb, arg);
+            ctx->pooled = true;
+            ctx->in_use = true;
+            break;
+        }
+    }
+    mutex_unlock(&_pool_lock);
+    if (!ctx) {
+        LOG_WARNING("[coap/utils]: request pool exhausted\n");
+    }
+    return ctx;
+}
+
+coap_block_ctx_t *coap_block_ctx_alloc(coap_req_cb_t cb, void *arg,
+                                       size_t blk_size)
+{
+    coap_block_ctx_t *ctx = NULL;
+
+    mutex_lock(&_pool_lock);
+    for (unsigned i = 0; i < CONFIG_COAP_UTILS_BLOCK_POOL_SIZE; i++) {
+        if (!_block_pool[i].req_ctx.in_use) {
+            ctx = &_block_pool[i];
+            coap_block_ctx_init(ctx, cb, arg, blk_size);
+            ctx->req_ctx.pooled = true;
+            ctx->req_ctx.in_use = true;
+            break;
+        }
+    }
+    mutex_unlock(&_pool_lock);
+    if (!ctx) {
+        LOG_WARNING("[coap/utils]: block pool exhausted\n");
+    }
+    return ctx;
+}
 
 void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t *pdu,
                    const sock_udp_ep_t *remote)
 {
+    (void)remote;
     int res = 0;
     void *data = NULL;
     size_t data_len = 0;
@@ -51,6 +144,11 @@ void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t *pdu,
     /* attemp to recover a request context */
     if (memo->context) {
         context = memo->context;
+        if (!_ctx_match_token(context, _memo_hdr(memo))) {
+            /* the context was recycled, this is a stale request */
+            LOG_DEBUG("[coap/utils]: token mismatch, ignoring response\n");
+            return;
+        }
     }
 
     if (memo->state == GCOAP_MEMO_TIMEOUT) {
@@ -71,16 +169,6 @@ void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t *pdu,
         goto unlock;
     }
 
-    if (coap_get_code_raw(pdu) == COAP_CODE_CONTINUE && context) {
-        coap_block_ctx_t *block_context = (coap_block_ctx_t *)context;
-        res = _do_block_post(pdu, remote, block_context);
-
-        if (res < 0) {
-            goto unlock;
-        }
-        return;
-    }
-
     data = pdu->payload;
     data_len = pdu->payload_len;
 unlock:
@@ -89,6 +177,7 @@ unlock:
             context->cb(res, data, data_len, context->arg);
         }
         mutex_unlock(&context->resp_wait);
+        _ctx_release(context);
     }
     else if (data_len) {
         unsigned content_type = coap_get_content_type(pdu);
@@ -152,6 +241,29 @@ int coap_init_remote(sock_udp_ep_t *remote, char *addr_str, uint16_t port)
     return 0;
 }
 
+static int _req_send(uint8_t *buf, size_t len, sock_udp_ep_t *remote,
+                     coap_req_ctx_t *ctx)
+{
+    if (ctx) {
+        if (!mutex_trylock(&ctx->resp_wait)) {
+            LOG_ERROR("[coap/utils]: ERROR context is locked\n");
+            return -1;
+        }
+        _ctx_set_token(ctx, (coap_hdr_t *)buf);
+    }
+
+    int res = gcoap_req_send(buf, len, remote, _resp_handler, ctx);
+    if (res <= 0) {
+        LOG_ERROR("[coap/utils]: msg send failed: %d\n", res);
+        if (ctx) {
+            mutex_unlock(&ctx->resp_wait);
+            _ctx_release(ctx);
+        }
+        return -1;
+    }
+    return res;
+}
+
 int coap_get(sock_udp_ep_t *remote, coap_req_ctx_t *ctx,
                 const char *uri, uint8_t format, uint8_t type)
 {
@@ -165,13 +277,7 @@ int coap_get(sock_udp_ep_t *remote, coap_req_ctx_t *ctx,
     coap_opt_add_format(&pdu, format);
     msg_len = coap_opt_finish(&pdu, COAP_OPT_FINISH_PAYLOAD);
 
-    if (ctx) {
-        if (!mutex_trylock(&ctx->resp_wait)) {
-            LOG_ERROR("[coap/utils]: ERROR get context is locked\n");
-            return -1;
-        }
-    }
-    return gcoap_req_send(buf, msg_len, remote, _resp_handler, ctx);
+    return _req_send(buf, msg_len, remote, ctx);
 }
 
 int coap_post(sock_udp_ep_t *remote, coap_req_ctx_t *ctx,
@@ -194,58 +300,343 @@ int coap_post(sock_udp_ep_t *remote, coap_req_ctx_t *ctx,
     }
     else {
         LOG_ERROR("[coap/utils]: msg buffer too small\n");
+        _ctx_release(ctx);
         return -1;
     }
-    if (ctx) {
-        if (!mutex_trylock(&ctx->resp_wait)) {
-            LOG_ERROR("[coap/utils]: ERROR post context is locked\n");
-            return -1;
+    return _req_send(buf, msg_len, remote, ctx);
+}
+
+/* RFC 7641 3.4, is sequence number v2 fresher than v1 */
+static bool _obs_is_fresh(uint32_t v1, uint32_t v2)
+{
+    return (v1 < v2 && v2 - v1 < (1UL << 23)) ||
+           (v1 > v2 && v1 - v2 > (1UL << 23));
+}
+
+static void _obs_resp_handler(const gcoap_request_memo_t *memo,
+                              coap_pkt_t *pdu, const sock_udp_ep_t *remote)
+{
+    (void)remote;
+    coap_obs_ctx_t *ctx = memo->context;
+    int res = 0;
+
+    if (!_ctx_match_token(&ctx->req_ctx, _memo_hdr(memo))) {
+        LOG_DEBUG("[coap/utils]: token mismatch, ignoring notification\n");
+        return;
+    }
+
+    if (memo->state == GCOAP_MEMO_TIMEOUT || memo->state == GCOAP_MEMO_ERR) {
+        LOG_WARNING("[coap/utils]: observe request failed\n");
+        res = memo->state == GCOAP_MEMO_TIMEOUT ? -ETIMEDOUT : -EBADMSG;
+    }
+    else if (coap_get_code_class(pdu) != COAP_CLASS_SUCCESS) {
+        LOG_DEBUG("[coap/utils]: unsuccessful response: %1u.%02u\n",
+                  coap_get_code_class(pdu), coap_get_code_detail(pdu));
+        res = -EBADMSG;
+    }
+    else if (!coap_has_observe(pdu)) {
+        /* plain response, the server did not accept the registration */
+        LOG_DEBUG("[coap/utils]: resource is not observable\n");
+        ctx->registered = false;
+        if (ctx->req_ctx.cb) {
+            ctx->req_ctx.cb(0, pdu->payload, pdu->payload_len,
+                            ctx->req_ctx.arg);
+        }
+        return;
+    }
+    else {
+        uint32_t seq = coap_get_observe(pdu);
+        if (ctx->seq_valid && !_obs_is_fresh(ctx->seq, seq)) {
+            LOG_DEBUG("[coap/utils]: stale notification %" PRIu32 "\n", seq);
+            return;
+        }
+        ctx->seq = seq;
+        ctx->seq_valid = true;
+        ctx->registered = true;
+        if (ctx->req_ctx.cb) {
+            ctx->req_ctx.cb(0, pdu->payload, pdu->payload_len,
+                            ctx->req_ctx.arg);
         }
+        return;
+    }
+
+    ctx->registered = false;
+    if (ctx->req_ctx.cb) {
+        ctx->req_ctx.cb(res, NULL, 0, ctx->req_ctx.arg);
     }
-    return gcoap_req_send(buf, msg_len, remote, _resp_handler, ctx);
 }
 
-static int _do_block_post(coap_pkt_t *pdu, const sock_udp_ep_t *remote,
-                          coap_block_ctx_t *ctx)
+int coap_observe(sock_udp_ep_t *remote, coap_obs_ctx_t *ctx,
+                 const char *uri, uint8_t format)
 {
-    coap_block_slicer_t slicer;
+    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+    coap_pkt_t pdu;
+    size_t msg_len;
 
-    LOG_DEBUG("[coap/utils]: blockwise continue, blk=(%d) \n",
-              ctx->last_blknum);
-    coap_block_slicer_init(&slicer, ctx->last_blknum++,
-                           CONFIG_COAP_UTILS_BLOCK_SIZE);
+    assert(ctx);
+    if (ctx->registered) {
+        coap_observe_cancel(ctx);
+    }
 
-    gcoap_req_init(pdu, (uint8_t *)pdu->hdr, CONFIG_GCOAP_PDU_BUF_SIZE,
-                   COAP_METHOD_POST, ctx->uri);
-    /* if CONN messagess are used it would required increasing CONFIG_GCOAP_RESEND_BUFS_MAX
-       since the used memo is cleared only after the resp_handler exists */
-    coap_hdr_set_type(pdu->hdr, COAP_TYPE_NON);
-    coap_opt_add_format(pdu, ctx->format);
-    coap_opt_add_block1(pdu, &slicer, 1);
-    int len = coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
-    len += coap_blockwise_put_bytes(&slicer, pdu->payload, ctx->data, ctx->data_len);
+    /* options must be added in order, Observe comes before Uri-Path */
+    gcoap_req_init(&pdu, &buf[0], CONFIG_GCOAP_PDU_BUF_SIZE, COAP_METHOD_GET,
+                   NULL);
+    coap_hdr_set_type(pdu.hdr, COAP_TYPE_CON);
+    coap_opt_add_uint(&pdu, COAP_OPT_OBSERVE, 0);
+    coap_opt_add_uri_path(&pdu, uri);
+    coap_opt_add_format(&pdu, format);
+    msg_len = coap_opt_finish(&pdu, COAP_OPT_FINISH_NONE);
+
+    _ctx_set_token(&ctx->req_ctx, pdu.hdr);
+    ctx->remote = remote;
+    ctx->seq_valid = false;
 
-    int more = coap_block1_finish(&slicer);
+    int res = gcoap_req_send(buf, msg_len, remote, _obs_resp_handler, ctx);
+    if (res <= 0) {
+        LOG_ERROR("[coap/utils]: msg send failed: %d\n", res);
+        return -1;
+    }
+    return res;
+}
 
-    if (slicer.start == 0) {
-        LOG_DEBUG("[coap/utils]: sending msg ID %u, %u bytes\n",
-                  coap_get_id(pdu), len);
+void coap_observe_cancel(coap_obs_ctx_t *ctx)
+{
+    if (ctx->registered) {
+        gcoap_obs_req_forget(ctx->remote, ctx->req_ctx.token,
+                             ctx->req_ctx.token_len);
     }
+    ctx->registered = false;
+    ctx->req_ctx.token_len = 0;
+}
 
-    ssize_t res = gcoap_req_send((uint8_t *)pdu->hdr, len, remote,
-                                 _resp_handler, ctx);
+static uint16_t _memo_msg_id(const gcoap_request_memo_t *memo)
+{
+    coap_pkt_t req = { .hdr = _memo_hdr(memo) };
+
+    return coap_get_id(&req);
+}
+
+static size_t _block_numof(coap_block_ctx_t *ctx)
+{
+    size_t blk_size = coap_szx2size(ctx->szx);
+
+    return ctx->data_len ? (ctx->data_len + blk_size - 1) / blk_size : 1;
+}
+
+static bool _block_is_acked(coap_block_ctx_t *ctx, size_t blknum)
+{
+    return blknum < ctx->base ||
+           (blknum - ctx->base < BLOCK_ACK_SPAN &&
+            (ctx->acked & (1UL << (blknum - ctx->base))));
+}
+
+static coap_block_slot_t *_block_slot_find(coap_block_ctx_t *ctx, bool used,
+                                           uint16_t msg_id)
+{
+    for (unsigned i = 0; i < CONFIG_COAP_UTILS_BLOCK_WINDOW; i++) {
+        coap_block_slot_t *slot = &ctx->slots[i];
+        if (!used && !slot->used) {
+            return slot;
+        }
+        if (used && slot->used && slot->msg_id == msg_id) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static bool _block_is_inflight(coap_block_ctx_t *ctx, size_t blknum)
+{
+    for (unsigned i = 0; i < CONFIG_COAP_UTILS_BLOCK_WINDOW; i++) {
+        if (ctx->slots[i].used && ctx->slots[i].blknum == blknum) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _block_resp_handler(const gcoap_request_memo_t *memo,
+                                coap_pkt_t *pdu, const sock_udp_ep_t *remote);
+
+static int _block_send(coap_block_ctx_t *ctx, uint8_t *buf, size_t blknum)
+{
+    coap_block_slot_t *slot = _block_slot_find(ctx, false, 0);
+    coap_block_slicer_t slicer;
+    coap_pkt_t pdu;
+
+    if (!slot) {
+        return -ENOBUFS;
+    }
+
+    LOG_DEBUG("[coap/utils]: blockwise send, blk=(%d)\n", (int)blknum);
+    coap_block_slicer_init(&slicer, blknum, coap_szx2size(ctx->szx));
+    gcoap_req_init(&pdu, buf, CONFIG_GCOAP_PDU_BUF_SIZE, COAP_METHOD_POST,
+                   ctx->uri);
+    /* CON messages would require increasing CONFIG_GCOAP_RESEND_BUFS_MAX
+       to the window size, loss is instead handled by selective retransmission */
+    coap_hdr_set_type(pdu.hdr, COAP_TYPE_NON);
+    coap_opt_add_format(&pdu, ctx->format);
+    coap_opt_add_block1(&pdu, &slicer, 1);
+    int len = coap_opt_finish(&pdu, COAP_OPT_FINISH_PAYLOAD);
+    len += coap_blockwise_put_bytes(&slicer, pdu.payload, ctx->data,
+                                    ctx->data_len);
+    coap_block1_finish(&slicer);
+
+    slot->msg_id = coap_get_id(&pdu);
+    slot->blknum = blknum;
+    slot->used = true;
+
+    ssize_t res = gcoap_req_send(buf, len, ctx->remote, _block_resp_handler,
+                                 ctx);
     if (res <= 0) {
         LOG_ERROR("[coap/utils]: msg send failed: %d\n", (int)res);
-        return res;
+        slot->used = false;
+        return -EIO;
     }
-    return more;
+    ctx->inflight++;
+    return 0;
+}
+
+static void _block_retransmit(coap_block_ctx_t *ctx, size_t blknum, int err)
+{
+    if (_block_is_acked(ctx, blknum) || _block_is_inflight(ctx, blknum)) {
+        return;
+    }
+    if (!ctx->retries) {
+        ctx->status = err;
+        return;
+    }
+    ctx->retries--;
+    ctx->stats.retransmits++;
+    if (_block_send(ctx, _block_buf, blknum) < 0 && !ctx->inflight) {
+        ctx->status = -EIO;
+    }
+}
+
+static void _block_fill_window(coap_block_ctx_t *ctx)
+{
+    size_t numof = _block_numof(ctx);
+    unsigned window = CONFIG_COAP_UTILS_BLOCK_WINDOW;
+
+    if (ctx->window && ctx->window < window) {
+        window = ctx->window;
+    }
+    while (!ctx->status && ctx->negotiated && ctx->inflight < window &&
+           ctx->last_blknum < numof &&
+           ctx->last_blknum < ctx->base + BLOCK_ACK_SPAN) {
+        size_t blknum = ctx->last_blknum;
+        if (!_block_is_acked(ctx, blknum) && !_block_is_inflight(ctx, blknum)) {
+            if (_block_send(ctx, _block_buf, blknum) < 0) {
+                if (!ctx->inflight) {
+                    ctx->status = -EIO;
+                }
+                break;
+            }
+        }
+        ctx->last_blknum++;
+    }
+}
+
+static void _block_ack(coap_block_ctx_t *ctx, coap_pkt_t *pdu, size_t blknum)
+{
+    if (!ctx->negotiated) {
+        coap_block1_t block1;
+        ctx->negotiated = true;
+        /* the server may ask for a smaller block size, the already received
+           first block then counts as several of the new size */
+        if (coap_get_block1(pdu, &block1) >= 0 && block1.szx < ctx->szx) {
+            size_t ratio = 1 << (ctx->szx - block1.szx);
+            LOG_DEBUG("[coap/utils]: block size negotiated to %u\n",
+                      coap_szx2size(block1.szx));
+            ctx->szx = block1.szx;
+            ctx->base = ratio;
+            ctx->last_blknum = ratio;
+            ctx->acked = 0;
+            return;
+        }
+    }
+    if (blknum >= ctx->base && blknum - ctx->base < BLOCK_ACK_SPAN) {
+        ctx->acked |= 1UL << (blknum - ctx->base);
+    }
+    while (ctx->acked & 1) {
+        ctx->acked >>= 1;
+        ctx->base++;
+    }
+}
+
+static void _block_resp_handler(const gcoap_request_memo_t *memo,
+                                coap_pkt_t *pdu, const sock_udp_ep_t *remote)
+{
+    (void)remote;
+    coap_block_ctx_t *ctx = memo->context;
+    void *data = NULL;
+    size_t data_len = 0;
+
+    mutex_lock(&ctx->lock);
+    coap_block_slot_t *slot = _block_slot_find(ctx, true, _memo_msg_id(memo));
+    if (!slot) {
+        /* response for an already completed transaction */
+        mutex_unlock(&ctx->lock);
+        return;
+    }
+    size_t blknum = slot->blknum;
+    slot->used = false;
+    ctx->inflight--;
+
+    if (memo->state == GCOAP_MEMO_TIMEOUT || memo->state == GCOAP_MEMO_ERR) {
+        LOG_WARNING("[coap/utils]: no response for blk=(%d)\n", (int)blknum);
+        _block_retransmit(ctx, blknum, memo->state == GCOAP_MEMO_TIMEOUT ?
+                          -ETIMEDOUT : -EBADMSG);
+    }
+    else if (coap_get_code_raw(pdu) == COAP_CODE_REQUEST_ENTITY_INCOMPLETE) {
+        /* the server is missing a previous block, resend the oldest
+           unacknowledged one and send this one again once its turn comes */
+        LOG_DEBUG("[coap/utils]: incomplete, blk=(%d)\n", (int)blknum);
+        if (blknum < ctx->last_blknum) {
+            ctx->last_blknum = blknum;
+        }
+        _block_retransmit(ctx, ctx->base, -EBADMSG);
+    }
+    else if (coap_get_code_class(pdu) != COAP_CLASS_SUCCESS) {
+        LOG_DEBUG("[coap/utils]: unsuccessful response: %1u.%02u\n",
+                  coap_get_code_class(pdu), coap_get_code_detail(pdu));
+        ctx->status = -EBADMSG;
+    }
+    else {
+        _block_ack(ctx, pdu, blknum);
+        data = pdu->payload;
+        data_len = pdu->payload_len;
+    }
+
+    _block_fill_window(ctx);
+
+    bool done = ctx->status ? ctx->inflight == 0 :
+                ctx->base >= _block_numof(ctx);
+    if (done) {
+        ctx->stats.blocks = _block_numof(ctx);
+        ctx->stats.duration_ms = ztimer_now(ZTIMER_MSEC) - ctx->start;
+        LOG_DEBUG("[coap/utils]: block post done in %" PRIu32 "ms, "
+                  "blocks=(%u), retransmits=(%u)\n", ctx->stats.duration_ms,
+                  ctx->stats.blocks, ctx->stats.retransmits);
+        if (ctx->status) {
+            data = NULL;
+            data_len = 0;
+        }
+        if (ctx->req_ctx.cb) {
+            ctx->req_ctx.cb(ctx->status, data, data_len, ctx->req_ctx.arg);
+        }
+        mutex_unlock(&ctx->req_ctx.resp_wait);
+        mutex_unlock(&ctx->lock);
+        _ctx_release(&ctx->req_ctx);
+        return;
+    }
+    mutex_unlock(&ctx->lock);
 }
 
 int coap_block_post(sock_udp_ep_t *remote, coap_block_ctx_t *ctx,
                     void *data, size_t data_len,
-                    const char *uri, uint8_t format, uint8_t type)
+                    const char *uri, uint8_t format)
 {
-    (void) type;
     assert(ctx);
 
     if (!mutex_trylock(&ctx->req_ctx.resp_wait)) {
@@ -253,14 +644,36 @@ int coap_block_post(sock_udp_ep_t *remote, coap_block_ctx_t *ctx,
         return -1;
     }
 
-    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE] = { 0 };
-    coap_pkt_t pdu;
-    pdu.hdr = (coap_hdr_t *)buf;
+    size_t blk_size = ctx->blk_size ? ctx->blk_size : CONFIG_COAP_UTILS_BLOCK_SIZE;
+    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+
+    assert(blk_size >= 16 && blk_size <= 1024);
+    mutex_lock(&ctx->lock);
     ctx->data = data;
     ctx->data_len = data_len;
     ctx->uri = uri;
     ctx->format = format;
-    ctx->last_blknum = 0;
-
-    return _do_block_post(&pdu, remote, ctx);
+    ctx->remote = remote;
+    ctx->szx = bitarithm_msb(blk_size) - 4;
+    ctx->negotiated = false;
+    ctx->inflight = 0;
+    ctx->retries = CONFIG_COAP_UTILS_BLOCK_RETRIES;
+    ctx->status = 0;
+    ctx->base = 0;
+    ctx->acked = 0;
+    ctx->last_blknum = 1;
+    memset(ctx->slots, '\0', sizeof(ctx->slots));
+    memset(&ctx->stats, '\0', sizeof(ctx->stats));
+    ctx->start = ztimer_now(ZTIMER_MSEC);
+
+    /* the first block goes alone, the rest is sent once the block size is
+       agreed on */
+    int res = _block_send(ctx, buf, 0);
+    mutex_unlock(&ctx->lock);
+    if (res < 0) {
+        mutex_unlock(&ctx->req_ctx.resp_wait);
+        _ctx_release(&ctx->req_ctx);
+        return res;
+    }
+    return _block_numof(ctx) > 1;
 }
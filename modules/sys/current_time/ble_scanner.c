@@ -21,6 +21,7 @@
 #include "ble_scanner.h"
 #include "ble_scanner_params.h"
 #include "current_time.h"
+#include "timex.h"
 
 #include "net/bluetil/ad.h"
 #include "net/bluetil/addr.h"
@@ -52,9 +53,16 @@ void _current_time_cb(uint8_t adv_type, const ble_addr_t *addr,
             /* make sure the data matches the expectation */
             if (BLUETIL_AD_OK ==
                 bluetil_ad_find(ad, BLE_GAP_AD_SERVICE_DATA, &field)) {
-                current_time_t *time = (current_time_t *)field.data;
                 uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - ts;
-                current_time_update(time->epoch + elapsed);
+                if (field.len >= sizeof(current_time_ms_t)) {
+                    current_time_ms_t *time = (current_time_ms_t *)field.data;
+                    current_time_update_ms(time->epoch, time->ms + elapsed);
+                }
+                else {
+                    /* the received time lies somewhere within the epoch second */
+                    current_time_t *time = (current_time_t *)field.data;
+                    current_time_update_ms(time->epoch, MS_PER_SEC / 2 + elapsed);
+                }
             }
             else {
                 LOG_DEBUG("[current_time]: malformed current time adv packet\n");
@@ -23,6 +23,7 @@
 
 #include "irq.h"
 #include "clist.h"
+#include "timex.h"
 #include "ztimer.h"
 #include "current_time.h"
 #include "periph/gpio.h"
@@ -35,6 +36,7 @@
 static current_time_hook_t _pre;
 static current_time_hook_t _post;
 static bool _sync = false;
+static uint32_t _steps;
 
 static void _toggle_sync_led(void)
 {
@@ -64,27 +66,61 @@ uint32_t current_time_get(void)
     return ztimer_now(ZTIMER_EPOCH);
 }
 
-void current_time_update(uint32_t epoch)
+uint64_t current_time_get_ms(void)
+{
+    if (IS_USED(MODULE_CURRENT_TIME_DISCIPLINE)) {
+        return current_time_discipline_now();
+    }
+    return (uint64_t)ztimer_now(ZTIMER_EPOCH) * MS_PER_SEC;
+}
+
+/* adjusts ZTIMER_EPOCH by diff seconds */
+static void _adjust(int32_t diff, uint32_t sys_epoch)
 {
+    _toggle_sync_led();
+    _sync = false;
+    clist_foreach(&_pre.list_node, _hook_cb, &diff);
+    uint32_t elapsed = ztimer_now(ZTIMER_EPOCH) - sys_epoch;
+    ztimer_adjust_time(ZTIMER_EPOCH, diff + elapsed);
+    LOG_DEBUG("\tnew-current: %" PRIu32 "\n", ztimer_now(ZTIMER_EPOCH));
+    clist_foreach(&_post.list_node, _hook_cb, &diff);
+    _sync = true;
+    _toggle_sync_led();
+}
+
+void current_time_update_ms(uint32_t epoch, uint32_t ms)
+{
+    epoch += ms / MS_PER_SEC;
+    ms %= MS_PER_SEC;
+
     uint32_t sys_epoch = ztimer_now(ZTIMER_EPOCH);
 
     LOG_DEBUG("[current_time]: epoch\n");
     LOG_DEBUG("\tcurrent:     %" PRIu32 "\n", sys_epoch);
-    LOG_DEBUG("\treceived:    %" PRIu32 "\n", epoch);
+    LOG_DEBUG("\treceived:    %" PRIu32 ".%03" PRIu32 "\n", epoch, ms);
     int32_t diff = epoch - sys_epoch;
 
-    /* adjust time only if out of CONFIG_CURRENT_TIME_RANGE_S */
+    /* step time only if out of CONFIG_CURRENT_TIME_RANGE_S */
     if (!_time_is_in_range(diff, CONFIG_CURRENT_TIME_RANGE_S)) {
-        _toggle_sync_led();
-        _sync = false;
-        clist_foreach(&_pre.list_node, _hook_cb, &diff);
-        uint32_t elapsed = ztimer_now(ZTIMER_EPOCH) - sys_epoch;
-        ztimer_adjust_time(ZTIMER_EPOCH, diff + elapsed);
-        LOG_DEBUG("\tnew-current: %" PRIu32 "\n", ztimer_now(ZTIMER_EPOCH));
-        clist_foreach(&_post.list_node, _hook_cb, &diff);
-        _sync = true;
-        _toggle_sync_led();
+        _adjust(diff, sys_epoch);
+        _steps++;
+        if (IS_USED(MODULE_CURRENT_TIME_DISCIPLINE)) {
+            current_time_discipline_reset((uint64_t)epoch * MS_PER_SEC + ms);
+        }
     }
+    else if (IS_USED(MODULE_CURRENT_TIME_DISCIPLINE)) {
+        /* slew the disciplined clock, ZTIMER_EPOCH follows by whole seconds */
+        diff = current_time_discipline_update((uint64_t)epoch * MS_PER_SEC + ms);
+        if (diff) {
+            _adjust(diff, ztimer_now(ZTIMER_EPOCH));
+        }
+    }
+}
+
+void current_time_update(uint32_t epoch)
+{
+    /* the received time lies somewhere within the epoch second */
+    current_time_update_ms(epoch, MS_PER_SEC / 2);
 }
 
 void current_time_add_pre_cb(current_time_hook_t *hook)
@@ -130,7 +166,13 @@ void current_time_init(void)
     memset(&_pre, '\0', sizeof(current_time_hook_t));
     memset(&_post, '\0', sizeof(current_time_hook_t));
     _sync = false;
+    _steps = 0;
 
+    if (IS_USED(MODULE_CURRENT_TIME_DISCIPLINE)) {
+        /* the ZTIMER_EPOCH phase is unknown, assume the middle of the second */
+        current_time_discipline_init((uint64_t)ztimer_now(ZTIMER_EPOCH) *
+                                     MS_PER_SEC + MS_PER_SEC / 2);
+    }
     if (IS_USED(MODULE_CURRENT_TIME_BLE_SCANNER)) {
         current_time_init_ble_scanner();
     }
@@ -140,3 +182,12 @@ bool current_time_valid(void)
 {
     return _sync;
 }
+
+void current_time_get_stats(current_time_stats_t *stats)
+{
+    memset(stats, '\0', sizeof(*stats));
+    stats->steps = _steps;
+    if (IS_USED(MODULE_CURRENT_TIME_DISCIPLINE)) {
+        current_time_discipline_stats(stats);
+    }
+}
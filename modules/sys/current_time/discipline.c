@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_current_time
+ * @{
+ *
+ * @file
+ * @brief       Current Time clock discipline implementation
+ *
+ * A proportional-integral loop over successive time samples: the integral
+ * term estimates the frequency offset (skew) of the local clock, the
+ * proportional term schedules a phase correction that is slewed out instead
+ * of stepped.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "irq.h"
+#include "timex.h"
+#include "ztimer.h"
+#include "current_time.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+/* signed constants, keep the arithmetic signed with a 64 bit long */
+#define MS_PER_S        ((int64_t)MS_PER_SEC)
+#define PPM_PER_1       ((int64_t)US_PER_SEC)
+#define PPB_PER_1       ((int64_t)NS_PER_SEC)
+#define SKEW_MAX_PPB    ((int64_t)CONFIG_CURRENT_TIME_DISCIPLINE_SKEW_MAX_PPM * 1000)
+
+typedef struct {
+    uint64_t ref_ms;        /**< disciplined time at ref_local */
+    uint32_t ref_local;     /**< ZTIMER_MSEC time of the last rebase */
+    uint32_t sample_local;  /**< ZTIMER_MSEC time of the last sample */
+    int32_t skew_ppb;       /**< estimated skew */
+    int32_t skew_rem;       /**< skew correction remainder, in ms * 1e-9 */
+    int32_t slew_ms;        /**< phase correction left to slew at ref_local */
+    int32_t offset_ms;      /**< last measured phase error */
+    uint32_t samples;       /**< disciplined samples */
+    uint32_t ignored;       /**< samples received too early */
+} _discipline_t;
+
+static _discipline_t _disc;
+
+static int32_t _slewed(uint32_t dt)
+{
+    int64_t max = (int64_t)dt * CONFIG_CURRENT_TIME_DISCIPLINE_SLEW_MAX_PPM /
+                  PPM_PER_1;
+
+    if (_disc.slew_ms > 0) {
+        return _disc.slew_ms < max ? _disc.slew_ms : max;
+    }
+    return -_disc.slew_ms < max ? _disc.slew_ms : -max;
+}
+
+/* time elapsed on the disciplined clock since ref_local */
+static int64_t _elapsed(uint32_t dt, int32_t slewed)
+{
+    return dt + ((int64_t)dt * _disc.skew_ppb + _disc.skew_rem) / PPB_PER_1 +
+           slewed;
+}
+
+/* move the reference to local, the sub-millisecond part of the skew
+   correction is carried over */
+static void _rebase(uint32_t local)
+{
+    uint32_t dt = local - _disc.ref_local;
+    int32_t slewed = _slewed(dt);
+
+    _disc.ref_ms += _elapsed(dt, slewed);
+    _disc.skew_rem = ((int64_t)dt * _disc.skew_ppb + _disc.skew_rem) % PPB_PER_1;
+    _disc.slew_ms -= slewed;
+    _disc.ref_local = local;
+}
+
+/* whole seconds ZTIMER_EPOCH lags behind the disciplined clock, the
+   ZTIMER_EPOCH phase is unknown so compare against the middle of its
+   current second */
+static int32_t _epoch_lag(void)
+{
+    int64_t lag = (int64_t)_disc.ref_ms -
+                  ((int64_t)ztimer_now(ZTIMER_EPOCH) * MS_PER_S + MS_PER_S / 2);
+
+    return (int32_t)(lag / MS_PER_S);
+}
+
+void current_time_discipline_init(uint64_t epoch_ms)
+{
+    unsigned state = irq_disable();
+
+    memset(&_disc, '\0', sizeof(_disc));
+    current_time_discipline_reset(epoch_ms);
+    irq_restore(state);
+}
+
+void current_time_discipline_reset(uint64_t epoch_ms)
+{
+    unsigned state = irq_disable();
+
+    _disc.ref_ms = epoch_ms;
+    _disc.ref_local = ztimer_now(ZTIMER_MSEC);
+    _disc.sample_local = _disc.ref_local;
+    _disc.slew_ms = 0;
+    _disc.skew_rem = 0;
+    _disc.offset_ms = 0;
+    irq_restore(state);
+}
+
+int32_t current_time_discipline_update(uint64_t epoch_ms)
+{
+    unsigned state = irq_disable();
+    uint32_t local = ztimer_now(ZTIMER_MSEC);
+    uint32_t itvl = local - _disc.sample_local;
+
+    if (itvl < CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS) {
+        _disc.ignored++;
+        irq_restore(state);
+        return 0;
+    }
+    _rebase(local);
+    _disc.sample_local = local;
+
+    int64_t err = (int64_t)(epoch_ms - _disc.ref_ms);
+    /* the error is within CONFIG_CURRENT_TIME_RANGE_S, no overflow */
+    _disc.offset_ms = (int32_t)err;
+    _disc.slew_ms = (int32_t)(err * CONFIG_CURRENT_TIME_DISCIPLINE_KP / 100);
+    int64_t skew = _disc.skew_ppb +
+                   err * PPB_PER_1 / itvl * CONFIG_CURRENT_TIME_DISCIPLINE_KI / 100;
+    if (skew > SKEW_MAX_PPB) {
+        skew = SKEW_MAX_PPB;
+    }
+    else if (skew < -SKEW_MAX_PPB) {
+        skew = -SKEW_MAX_PPB;
+    }
+    _disc.skew_ppb = (int32_t)skew;
+    _disc.samples++;
+    int32_t lag = _epoch_lag();
+    irq_restore(state);
+
+    LOG_DEBUG("[current_time]: offset=%" PRId32 "ms skew=%" PRId32 "ppb\n",
+              _disc.offset_ms, _disc.skew_ppb);
+    return lag;
+}
+
+uint64_t current_time_discipline_now(void)
+{
+    unsigned state = irq_disable();
+    uint32_t dt = ztimer_now(ZTIMER_MSEC) - _disc.ref_local;
+
+    /* rebasing truncates the slewed part, only do it before ZTIMER_MSEC
+       wraps around */
+    if (dt > UINT32_MAX / 2) {
+        _rebase(_disc.ref_local + dt);
+        dt = 0;
+    }
+    uint64_t now = _disc.ref_ms + _elapsed(dt, _slewed(dt));
+    irq_restore(state);
+    return now;
+}
+
+void current_time_discipline_stats(current_time_stats_t *stats)
+{
+    unsigned state = irq_disable();
+
+    stats->offset_ms = _disc.offset_ms;
+    stats->skew_ppb = _disc.skew_ppb;
+    stats->slew_ms = _disc.slew_ms;
+    stats->samples = _disc.samples;
+    stats->ignored = _disc.ignored;
+    irq_restore(state);
+}
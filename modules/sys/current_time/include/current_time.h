@@ -59,6 +59,48 @@ extern "C" {
 #endif
 #endif
 
+/**
+ * @brief   Proportional gain of the clock discipline, in percent
+ *
+ * Fraction of a measured phase error that is slewed out before the next
+ * sample.
+ */
+#ifndef CONFIG_CURRENT_TIME_DISCIPLINE_KP
+#define CONFIG_CURRENT_TIME_DISCIPLINE_KP           (50)
+#endif
+
+/**
+ * @brief   Integral gain of the clock discipline, in percent
+ *
+ * Fraction of the frequency error seen over the last sample interval that
+ * is added to the skew estimate.
+ */
+#ifndef CONFIG_CURRENT_TIME_DISCIPLINE_KI
+#define CONFIG_CURRENT_TIME_DISCIPLINE_KI           (10)
+#endif
+
+/**
+ * @brief   Maximum rate at which phase errors are slewed out, in ppm
+ */
+#ifndef CONFIG_CURRENT_TIME_DISCIPLINE_SLEW_MAX_PPM
+#define CONFIG_CURRENT_TIME_DISCIPLINE_SLEW_MAX_PPM (500)
+#endif
+
+/**
+ * @brief   Maximum skew estimate, in ppm
+ */
+#ifndef CONFIG_CURRENT_TIME_DISCIPLINE_SKEW_MAX_PPM
+#define CONFIG_CURRENT_TIME_DISCIPLINE_SKEW_MAX_PPM (500)
+#endif
+
+/**
+ * @brief   Minimum interval between two disciplined samples in ms, in range
+ *          updates received earlier are ignored
+ */
+#ifndef CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS
+#define CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS  (10 * 1000LU)
+#endif
+
 /* TODO: this could probably be an event */
 
 /**
@@ -77,6 +119,27 @@ typedef union __attribute__((packed)) current_time {
     uint8_t bytes[4];   /**< epoch bytes */
 } current_time_t;
 
+/**
+ * @brief   Optional extended current time service data, carrying the
+ *          milliseconds elapsed since @p epoch
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t epoch;     /**< epoch */
+    uint16_t ms;        /**< milliseconds since epoch */
+} current_time_ms_t;
+
+/**
+ * @brief   Clock discipline statistics
+ */
+typedef struct {
+    int32_t offset_ms;  /**< last measured phase error */
+    int32_t skew_ppb;   /**< estimated frequency offset of the local clock */
+    int32_t slew_ms;    /**< phase correction still to be slewed out */
+    uint32_t samples;   /**< disciplined samples */
+    uint32_t ignored;   /**< in range updates received too early */
+    uint32_t steps;     /**< times the time was stepped, not slewed */
+} current_time_stats_t;
+
 /**
  * @brief    Time service adjusted time hooks
  */
@@ -153,6 +216,18 @@ static inline void current_time_hook_init(current_time_hook_t *hook,
  */
 void current_time_update(uint32_t time);
 
+/**
+ * @brief   Update current time with a sub-second resolution time
+ *
+ * Without the current_time_discipline module this is the same as
+ * current_time_update(). Otherwise in range updates are fed to the clock
+ * discipline which slews the clock instead of stepping it.
+ *
+ * @param[in]       epoch   epoch in seconds since RIOT_EPOCH
+ * @param[in]       ms      milliseconds elapsed since @p epoch
+ */
+void current_time_update_ms(uint32_t epoch, uint32_t ms);
+
 /**
  * @brief   Update current time
  *
@@ -160,11 +235,78 @@ void current_time_update(uint32_t time);
  */
 uint32_t current_time_get(void);
 
+/**
+ * @brief   Get current time in milliseconds
+ *
+ * Without the current_time_discipline module this has the resolution of
+ * ZTIMER_EPOCH.
+ *
+ * @return  epoch in milliseconds since RIOT_EPOCH
+ */
+uint64_t current_time_get_ms(void);
+
 /**
  * @brief   Returns if current time has been set
  */
 bool current_time_valid(void);
 
+/**
+ * @brief   Get the clock discipline statistics
+ *
+ * @param[out]      stats   the statistics
+ */
+void current_time_get_stats(current_time_stats_t *stats);
+
+/**
+ * @name    Clock discipline, only used by the current_time core
+ *
+ * The disciplined clock runs on ZTIMER_MSEC corrected by an estimated skew,
+ * phase errors are slewed out at most at
+ * @ref CONFIG_CURRENT_TIME_DISCIPLINE_SLEW_MAX_PPM. The seconds resolution
+ * ZTIMER_EPOCH follows the disciplined clock by whole second adjustments.
+ * @{
+ */
+/**
+ * @brief   Init the clock discipline
+ *
+ * @param[in]       epoch_ms   current time in milliseconds
+ */
+void current_time_discipline_init(uint64_t epoch_ms);
+
+/**
+ * @brief   Reset the disciplined clock, the skew estimate is kept
+ *
+ * The disciplined clock and ZTIMER_EPOCH run in phase afterwards.
+ *
+ * @param[in]       epoch_ms   current time in milliseconds
+ */
+void current_time_discipline_reset(uint64_t epoch_ms);
+
+/**
+ * @brief   Feed a time sample to the discipline
+ *
+ * @param[in]       epoch_ms   received time in milliseconds
+ *
+ * @return  the seconds ZTIMER_EPOCH must be adjusted by to follow the
+ *          disciplined clock
+ */
+int32_t current_time_discipline_update(uint64_t epoch_ms);
+
+/**
+ * @brief   Get the disciplined time
+ *
+ * @return  epoch in milliseconds since RIOT_EPOCH
+ */
+uint64_t current_time_discipline_now(void);
+
+/**
+ * @brief   Get the discipline statistics
+ *
+ * @param[inout]    stats   the statistics to complete
+ */
+void current_time_discipline_stats(current_time_stats_t *stats);
+/** @} */
+
 /**
  * @brief   Initializes the current time ble scanner service
  */
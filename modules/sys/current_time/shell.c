@@ -71,6 +71,14 @@ static int _cmd_time(int argc, char **argv)
            time.tm_min,
            time.tm_sec);
     printf("\tEpoch: %" PRIu32 "\n", epoch);
+    if (IS_USED(MODULE_CURRENT_TIME_DISCIPLINE)) {
+        current_time_stats_t stats;
+        current_time_get_stats(&stats);
+        printf("\tOffset: %" PRId32 " ms, skew: %" PRId32 " ppb, slew: %" PRId32
+               " ms\n", stats.offset_ms, stats.skew_ppb, stats.slew_ms);
+        printf("\tSamples: %" PRIu32 ", ignored: %" PRIu32 ", steps: %" PRIu32
+               "\n", stats.samples, stats.ignored, stats.steps);
+    }
     return 0;
 }
 
@@ -3,10 +3,5 @@
 
 int contact_filter(ed_uwb_bpf_ctx_t *ctx)
 {
-    if (ctx->distance <= MAX_DISTANCE_CM && \
-        ctx->time >= MIN_EXPOSURE_TIME_S &&
-        ctx->req_count >= MIN_REQUEST_COUNT) {
-        return 1;
-    }
-    return 0;
+    return ed_uwb_bpf_contact_filter(ctx);
 }
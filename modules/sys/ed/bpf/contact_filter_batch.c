@@ -0,0 +1,16 @@
+#include <stdint.h>
+#include "bpf/ed.h"
+
+int contact_filter_batch(ed_uwb_bpf_batch_ctx_t *batch)
+{
+    int valid = 0;
+    uint32_t numof = batch->numof < ED_UWB_BPF_BATCH_SIZE ?
+                     batch->numof : ED_UWB_BPF_BATCH_SIZE;
+
+    for (uint32_t i = 0; i < numof; i++) {
+        batch->entries[i].valid =
+            ed_uwb_bpf_contact_filter(&batch->entries[i].ctx);
+        valid += batch->entries[i].valid;
+    }
+    return valid;
+}
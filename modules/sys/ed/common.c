@@ -24,6 +24,9 @@
 #include "irq.h"
 #include "ed.h"
 #include "ed_shared.h"
+#if IS_USED(MODULE_ED_UWB_BPF)
+#include "bpf/ed.h"
+#endif
 
 #include "fmt.h"
 #include "timex.h"
@@ -178,12 +181,15 @@ ed_t *ed_list_process_slice(ed_list_t *list, const uint32_t cid, uint16_t time,
     return ed;
 }
 
-bool ed_finish(ed_t *ed, uint32_t min_exposure_s)
+/* uwb_filtered is set when the UWB data was already run through the contact
+   filter container by ed_list_finish */
+static bool _finish(ed_t *ed, uint32_t min_exposure_s, bool uwb_filtered)
 {
     bool valid = false;
 
     (void)ed;
     (void)min_exposure_s;
+    (void)uwb_filtered;
 #if IS_USED(MODULE_ED_BLE_COMMON)
     bool valid_ble = false;
 #endif
@@ -196,7 +202,12 @@ bool ed_finish(ed_t *ed, uint32_t min_exposure_s)
     valid |= valid_ble;
 #endif
 #if IS_USED(MODULE_ED_UWB)
+#if IS_USED(MODULE_ED_UWB_BPF)
+    bool valid_uwb = uwb_filtered ? ed->uwb.valid : ed_uwb_bpf_finish(ed);
+    ed_uwb_average(ed);
+#else
     bool valid_uwb = ed_uwb_finish(ed, min_exposure_s);
+#endif
     valid |= valid_uwb;
 #if IS_USED(MODULE_ED_BLE_COMMON) && IS_USED(MODULE_ED_LEDS)
     if (valid_uwb != valid_ble) {
@@ -209,6 +220,11 @@ bool ed_finish(ed_t *ed, uint32_t min_exposure_s)
     return valid;
 }
 
+bool ed_finish(ed_t *ed, uint32_t min_exposure_s)
+{
+    return _finish(ed, min_exposure_s, false);
+}
+
 /* since we will always know the before node this will update the clist more
    efficiently */
 static void _clist_remove_with_before(clist_node_t *list, clist_node_t *node,
@@ -228,8 +244,38 @@ static void _clist_remove_with_before(clist_node_t *list, clist_node_t *node,
     irq_restore(state);
 }
 
+#if IS_USED(MODULE_ED_UWB_BPF)
+/* validate the UWB data of all encounters with as few container invocations
+   as possible */
+static void _list_uwb_bpf_finish(ed_list_t *list)
+{
+    ed_t *eds[ED_UWB_BPF_BATCH_SIZE];
+    unsigned numof = 0;
+    clist_node_t *node = list->list.next;
+
+    if (!node) {
+        return;
+    }
+    do {
+        /* the list points to its last node, start from the first one */
+        node = node->next;
+        eds[numof++] = (ed_t *)node;
+        if (numof == ED_UWB_BPF_BATCH_SIZE) {
+            ed_uwb_bpf_finish_batch(eds, numof);
+            numof = 0;
+        }
+    } while (node != list->list.next);
+    if (numof) {
+        ed_uwb_bpf_finish_batch(eds, numof);
+    }
+}
+#endif
+
 void ed_list_finish(ed_list_t *list)
 {
+#if IS_USED(MODULE_ED_UWB_BPF)
+    _list_uwb_bpf_finish(list);
+#endif
     clist_node_t *node = list->list.next;
 
     if (node) {
@@ -239,7 +285,8 @@ void ed_list_finish(ed_list_t *list)
             /* check if we are handling the last node (start of list)*/
             bool last_node = node == list->list.next;
             /* check if node should be kept */
-            if (!ed_finish((ed_t *)node, list->min_exposure_s)) {
+            if (!_finish((ed_t *)node, list->min_exposure_s,
+                         IS_USED(MODULE_ED_UWB_BPF))) {
                 LOG_DEBUG("[ed]: discarding node\n");
                 /* remove the current node from list, and pass previous
                     node to easily update list */
@@ -270,16 +317,27 @@ void ed_memory_manager_init(ed_memory_manager_t *manager)
 {
     memset(manager, '\0', sizeof(ed_memory_manager_t));
     memarray_init(&manager->mem, manager->buf, sizeof(ed_t), CONFIG_ED_BUF_SIZE);
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_init(&manager->watermark, CONFIG_ED_BUF_SIZE);
+#endif
 }
 
 void ed_memory_manager_free(ed_memory_manager_t *manager, ed_t *ed)
 {
     memarray_free(&manager->mem, ed);
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_free(&manager->watermark);
+#endif
 }
 
 ed_t *ed_memory_manager_calloc(ed_memory_manager_t *manager)
 {
-    return memarray_calloc(&manager->mem);
+    ed_t *ed = memarray_calloc(&manager->mem);
+
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_alloc(&manager->watermark, ed != NULL);
+#endif
+    return ed;
 }
 
 size_t ed_serialize_uwb_ble_csv(ed_uwb_data_t *uwb, ed_ble_data_t *ble, const char *bn, char *buf)
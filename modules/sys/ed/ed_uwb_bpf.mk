@@ -3,9 +3,10 @@ ifneq (,$(filter ed_uwb_bpf,$(USEMODULE)))
 UWB_ED_BPF_DIR := $(LAST_MAKEFILEDIR)/bpf
 F12R_DIRS  += $(UWB_ED_BPF_DIR)
 F12R_BLOBS  += $(UWB_ED_BPF_DIR)/contact_filter.bin
+F12R_BLOBS  += $(UWB_ED_BPF_DIR)/contact_filter_batch.bin
 
 # Define RAM Regions
-CFLAGS += -DCONFIG_SUIT_STORAGE_RAM_REGIONS=1
+CFLAGS += -DCONFIG_SUIT_STORAGE_RAM_REGIONS=2
 CFLAGS += -DCONFIG_SUIT_STORAGE_RAM_SIZE=512
 
 # Required variables defined in riotboot.inc.mk or Makefile.include
@@ -20,13 +21,22 @@ SUIT_UWB_ED_PAYLOAD_BIN ?= $(BINDIR_APP)/contact_filter.$(APP_VER).bin
 BUILD_FILES += $(SUIT_UWB_ED_PAYLOAD)
 SUIT_UWB_ED_STORAGE ?= ram:0
 
+SUIT_UWB_ED_BATCH_PAYLOAD ?= $(UWB_ED_BPF_DIR)/contact_filter_batch.bin
+SUIT_UWB_ED_BATCH_PAYLOAD_BIN ?= $(BINDIR_APP)/contact_filter_batch.$(APP_VER).bin
+BUILD_FILES += $(SUIT_UWB_ED_BATCH_PAYLOAD)
+SUIT_UWB_ED_BATCH_STORAGE ?= ram:1
+
 $(SUIT_UWB_ED_PAYLOAD_BIN): $(SUIT_UWB_ED_PAYLOAD)
 	$(Q)cp $(SUIT_UWB_ED_PAYLOAD) $@
 
+$(SUIT_UWB_ED_BATCH_PAYLOAD_BIN): $(SUIT_UWB_ED_BATCH_PAYLOAD)
+	$(Q)cp $(SUIT_UWB_ED_BATCH_PAYLOAD) $@
+
 ifneq (, $(filter suit/%_bpf, $(MAKECMDGOALS)))
   SUIT_MANIFEST_BASENAME ?= bpf_suit
-  SUIT_MANIFEST_PAYLOADS ?= $(SUIT_UWB_ED_PAYLOAD_BIN)
-  SUIT_MANIFEST_SLOTFILES ?= $(SUIT_UWB_ED_PAYLOAD_BIN):0:$(SUIT_UWB_ED_STORAGE)
+  SUIT_MANIFEST_PAYLOADS ?= $(SUIT_UWB_ED_PAYLOAD_BIN) $(SUIT_UWB_ED_BATCH_PAYLOAD_BIN)
+  SUIT_MANIFEST_SLOTFILES ?= $(SUIT_UWB_ED_PAYLOAD_BIN):0:$(SUIT_UWB_ED_STORAGE) \
+                             $(SUIT_UWB_ED_BATCH_PAYLOAD_BIN):0:$(SUIT_UWB_ED_BATCH_STORAGE)
 endif
 endif
 
@@ -16,6 +16,16 @@
 extern "C" {
 #endif
 
+/**
+ * @brief   Encounters evaluated per batch VM invocation
+ *
+ * Bounds the batch context size and the number of branches taken by the
+ * batch filter, larger lists are evaluated in several invocations. The
+ * container is built apart from the application, so this is not a build
+ * time option: both only share this header.
+ */
+#define ED_UWB_BPF_BATCH_SIZE           (16U)
+
 /**
  * @brief   ed context for femto-container/bpf
  */
@@ -25,6 +35,39 @@ typedef struct {
     uint16_t req_count; /**< successful TWR request count */
 } ed_uwb_bpf_ctx_t;
 
+/**
+ * @brief   batch entry for femto-container/bpf
+ */
+typedef struct {
+    ed_uwb_bpf_ctx_t ctx;   /**< the encounter context */
+    uint16_t valid;         /**< set by the filter, 1 if valid */
+} ed_uwb_bpf_batch_entry_t;
+
+/**
+ * @brief   batch context for femto-container/bpf
+ */
+typedef struct {
+    uint32_t numof;         /**< number of entries to evaluate */
+    ed_uwb_bpf_batch_entry_t entries[ED_UWB_BPF_BATCH_SIZE]; /**< entries */
+} ed_uwb_bpf_batch_ctx_t;
+
+/**
+ * @brief   The contact filter shared by the single and batch containers
+ *
+ * @param[in]   ctx     the encounter context
+ *
+ * @return  1 if the encounter is valid, 0 otherwise
+ */
+static inline int ed_uwb_bpf_contact_filter(const ed_uwb_bpf_ctx_t *ctx)
+{
+    if (ctx->distance <= MAX_DISTANCE_CM &&
+        ctx->time >= MIN_EXPOSURE_TIME_S &&
+        ctx->req_count >= MIN_REQUEST_COUNT) {
+        return 1;
+    }
+    return 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
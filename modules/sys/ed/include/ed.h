@@ -41,6 +41,9 @@
 #if IS_USED(MODULE_ED_BLE_WIN)
 #include "rdl_window.h"
 #endif
+#if IS_USED(MODULE_WATERMARK)
+#include "watermark.h"
+#endif
 #include "ed_shared.h"
 
 #ifdef __cplusplus
@@ -83,6 +86,17 @@ extern "C" {
 #define CONFIG_ED_BLE_RX_COMPENSATION_GAIN      (0U)
 #endif
 
+/**
+ * @brief   Defer the contact filters setup, and SUIT storage bootstrap, from
+ *          @ref ed_uwb_bpf_init to their first use
+ *
+ * Shortens the boot, but SUIT updates are only accepted after the first
+ * filtering.
+ */
+#ifndef CONFIG_ED_UWB_BPF_LAZY_INIT
+#define CONFIG_ED_UWB_BPF_LAZY_INIT             0
+#endif
+
 #if IS_USED(MODULE_ED_UWB_STATS)
 /**
  * @brief   UWB encounter statistics
@@ -206,6 +220,9 @@ typedef struct ed {
 typedef struct ed_memory_manager {
     uint8_t buf[CONFIG_ED_BUF_SIZE * sizeof(ed_t)]; /**< Task buffer */
     memarray_t mem;                                 /**< Memarray management */
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_t watermark;                     /**< usage watermarks */
+#endif
 } ed_memory_manager_t;
 
 /**
@@ -574,6 +591,16 @@ bool ed_finish(ed_t *ed, uint32_t min_exposure_s);
  * @return         true if valid encounter, false otherwise (can be discarded)
  */
 bool ed_uwb_finish(ed_t *ed, uint32_t min_exposure_s);
+
+/**
+ * @brief   Average the UWB data of an encounter, without validating it
+ *
+ * Called by @ref ed_uwb_finish, and on its own when the encounters are
+ * validated by the contact filter container (`ed_uwb_bpf`).
+ *
+ * @param[in]      ed     the encounter data
+ */
+void ed_uwb_average(ed_t *ed);
 #endif
 
 #if IS_USED(MODULE_ED_BLE_WIN)
@@ -641,10 +668,26 @@ ed_t *ed_memory_manager_calloc(ed_memory_manager_t *manager);
  */
 bool ed_uwb_bpf_finish(ed_t *ed);
 
+/**
+ * @brief   Process several encounter data, data validation is done in a VM
+ *
+ * Same as @ref ed_uwb_bpf_finish but encounters are evaluated in batches of
+ * up to ED_UWB_BPF_BATCH_SIZE per VM invocation, to amortize the
+ * container entry cost when a whole epoch is processed at once. With
+ * `ed_uwb_bpf` @ref ed_list_finish validates the UWB data this way.
+ *
+ * @param[in]      eds      the encounter data
+ * @param[in]      numof    the number of encounter data
+ *
+ * @return  the number of valid encounters
+ */
+unsigned ed_uwb_bpf_finish_batch(ed_t **eds, unsigned numof);
+
 /**
  * @brief   Initiates UWB encounter data bpf handling
  *
- * This will setup storage used for bpf and a thread for suit updates
+ * This will setup storage used for bpf and a thread for suit updates, unless
+ * deferred with @ref CONFIG_ED_UWB_BPF_LAZY_INIT
  */
 void ed_uwb_bpf_init(void);
 
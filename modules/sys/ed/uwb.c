@@ -63,10 +63,8 @@ ed_t *ed_list_process_rng_data(ed_list_t *list, const uint16_t addr, uint16_t ti
     return ed;
 }
 
-bool ed_uwb_finish(ed_t *ed, uint32_t min_exposure_s)
+void ed_uwb_average(ed_t *ed)
 {
-    uint16_t exposure = ed->uwb.seen_last_s - ed->uwb.seen_first_s;
-
     if (ed->uwb.req_count > 0) {
         LOG_DEBUG("[ed] uwb: sum %" PRIu32 "cm, count %" PRIu16 "\n",
                   ed->uwb.cumulative_d_cm, ed->uwb.req_count);
@@ -79,6 +77,15 @@ bool ed_uwb_finish(ed_t *ed, uint32_t min_exposure_s)
         /* set the cummulative_rssi to the rssi average */
         ed->uwb.cumulative_rssi = 10 * log10f(n_avg);
 #endif
+    }
+}
+
+bool ed_uwb_finish(ed_t *ed, uint32_t min_exposure_s)
+{
+    uint16_t exposure = ed->uwb.seen_last_s - ed->uwb.seen_first_s;
+
+    if (ed->uwb.req_count > 0) {
+        ed_uwb_average(ed);
         if (ed->uwb.cumulative_d_cm <= MAX_DISTANCE_CM) {
             if (exposure >= min_exposure_s) {
                 if (ed->uwb.req_count >= MIN_REQUEST_COUNT) {
@@ -20,12 +20,13 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 
 #include "mutex.h"
 #include "femtocontainer/femtocontainer.h"
 #include "shared.h"
-#if IS_USED(MODULE_UWB_BPF_SUIT)
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
 #include "suit/transport/coap.h"
 #include "suit/storage.h"
 #include "suit/storage/ram.h"
@@ -34,22 +35,99 @@
 
 #include "ed.h"
 #include "bpf/ed.h"
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
 
 #include "blob/bpf/contact_filter.bin.h"
+#include "blob/bpf/contact_filter_batch.bin.h"
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_DEBUG
 #endif
 #include "log.h"
 
+/**
+ * @brief   A contact filter container, set up and verified once per update
+ */
+typedef struct {
+    f12r_t femtoc;                  /**< the container */
+    const uint8_t *blob;            /**< the bootstrap application */
+    size_t blob_len;                /**< the bootstrap application length */
+    bool ready;                     /**< set up and verified */
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
+    const char *region_id;          /**< the SUIT storage region id */
+    suit_storage_region_t *region;  /**< the SUIT storage region */
+    suit_storage_hooks_t pre;       /**< locks the containers on update */
+    suit_storage_hooks_t post;      /**< invalidates and unlocks on update */
+#endif
+} _filter_t;
+
+/* executions are serialized by _lock, a single stack is enough */
 static uint8_t _stack[512] = { 0 };
 static mutex_t _lock = MUTEX_INIT;
 
-#if IS_USED(MODULE_UWB_BPF_SUIT)
-suit_storage_region_t *region = NULL;
-static suit_storage_hooks_t pre;
-static suit_storage_hooks_t post;
+static _filter_t _single = {
+    .blob = contact_filter_bin,
+    .blob_len = sizeof(contact_filter_bin),
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
+    .region_id = ".ram.0",
+#endif
+};
+static _filter_t _batch = {
+    .blob = contact_filter_batch_bin,
+    .blob_len = sizeof(contact_filter_batch_bin),
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
+    .region_id = ".ram.1",
+#endif
+};
+static ed_uwb_bpf_batch_ctx_t _batch_ctx;
+static bool _bootstrapped;
+
+/* must be called with _lock held */
+static bool _filter_setup(_filter_t *filter)
+{
+    if (filter->ready) {
+        return true;
+    }
+    memset(&filter->femtoc, '\0', sizeof(filter->femtoc));
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
+    if (!filter->region) {
+        return false;
+    }
+    filter->femtoc.application = suit_storage_region_location(filter->region);
+    filter->femtoc.application_len = suit_storage_region_size_used(filter->region);
+#else
+    filter->femtoc.application = filter->blob;
+    filter->femtoc.application_len = filter->blob_len;
+#endif
+    filter->femtoc.stack = _stack;
+    filter->femtoc.stack_size = sizeof(_stack);
+    f12r_setup(&filter->femtoc);
+    int res = f12r_verify_preflight(&filter->femtoc);
+    if (res < 0) {
+        LOG_ERROR("[ed_bpf]: ERROR, application rejected (%d)\n", res);
+        return false;
+    }
+    filter->ready = true;
+    return true;
+}
+
+static void _bootstrap(void);
+
+/* must be called with _lock held */
+static int64_t _filter_run(_filter_t *filter, void *ctx, size_t ctx_len)
+{
+    int64_t result = 0;
+
+    _bootstrap();
+    if (_filter_setup(filter)) {
+        f12r_execute_ctx(&filter->femtoc, ctx, ctx_len, &result);
+    }
+    return result;
+}
 
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
 /* CoAP resources (alphabetical order) */
 static const coap_resource_t _resources[] = {
     /* this line adds the whole "/suit"-subtree */
@@ -62,89 +140,133 @@ static gcoap_listener_t _suit_listener = {
     NULL,
     NULL
 };
+/* SUIT storage regions were initialized */
+static bool _suit_storage_init;
 
 static void _lock_region(void *arg)
 {
+    (void)arg;
     LOG_INFO("[femto-container]: updating, lock region\n");
-    mutex_t *lock = (mutex_t *)arg;
-
-    mutex_lock(lock);
+    mutex_lock(&_lock);
 }
 
 static void _unlock_region(void *arg)
 {
-    LOG_INFO("[femto-container]: update finished, unlock region\n");
-    mutex_t *lock = (mutex_t *)arg;
+    _filter_t *filter = arg;
 
-    mutex_unlock(lock);
+    LOG_INFO("[femto-container]: update finished, unlock region\n");
+    /* set up and verify the new application on next use */
+    filter->ready = false;
+    mutex_unlock(&_lock);
 }
-#endif
 
-void ed_uwb_bpf_init(void)
+static int _filter_bootstrap(_filter_t *filter)
 {
-#if IS_USED(MODULE_UWB_BPF_SUIT)
-    suit_storage_init_all();
-    region = suit_storage_get_region_by_id(".ram.0");
-    if (!region) {
-        LOG_ERROR("[ed_bpf]: ERROR, did not find storage region");
-        return;
+    if (filter->region) {
+        /* bootstrapped by a previous, partly failed, attempt */
+        return 0;
+    }
+    filter->region = suit_storage_get_region_by_id(filter->region_id);
+    if (!filter->region) {
+        LOG_ERROR("[ed_bpf]: ERROR, did not find storage region %s\n",
+                  filter->region_id);
+        return -ENOENT;
     }
     /* initial bootstrapping maybe there should be an api for this.. */
-    region->used = sizeof(contact_filter_bin);
-    memcpy(suit_storage_region_location(region), contact_filter_bin, region->used);
+    filter->region->used = filter->blob_len;
+    memcpy(suit_storage_region_location(filter->region), filter->blob,
+           filter->region->used);
 
     /* install hooks */
-    pre.arg = &_lock;
-    pre.cb = _lock_region;
-    post.arg = &_lock;
-    post.cb = _unlock_region;
-    suit_storage_add_pre_hook(".ram.0", &pre);
-    suit_storage_add_post_hook(".ram.0", &post);
+    filter->pre.arg = filter;
+    filter->pre.cb = _lock_region;
+    filter->post.arg = filter;
+    filter->post.cb = _unlock_region;
+    suit_storage_add_pre_hook(filter->region_id, &filter->pre);
+    suit_storage_add_post_hook(filter->region_id, &filter->post);
+    return 0;
+}
+
+static int _suit_bootstrap(void)
+{
+    /* regions are reset on init, only do it once */
+    if (!_suit_storage_init) {
+        suit_storage_init_all();
+        _suit_storage_init = true;
+    }
+    if (_filter_bootstrap(&_single) || _filter_bootstrap(&_batch)) {
+        return -ENOENT;
+    }
 
     /* start suit coap updater thread */
     suit_coap_run();
 
     /* start gcoap listener */
     gcoap_register_listener(&_suit_listener);
+    return 0;
+}
+#endif
+
+/* must be called with _lock held, the hooks are only installed here, a
+   failed bootstrap is retried on next use */
+static void _bootstrap(void)
+{
+    if (_bootstrapped) {
+        return;
+    }
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_BPF_INIT);
+#endif
+#if IS_USED(MODULE_ED_UWB_BPF_SUIT)
+    _bootstrapped = _suit_bootstrap() == 0;
+#else
+    _bootstrapped = true;
+#endif
+    if (_bootstrapped) {
+        _filter_setup(&_single);
+        _filter_setup(&_batch);
+    }
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_BPF_INIT);
 #endif
 }
 
-bool ed_uwb_bpf_finish(ed_t *ed)
+void ed_uwb_bpf_init(void)
 {
-    if (ed->uwb.req_count > 0) {
-        ed->uwb.cumulative_d_cm = ed->uwb.cumulative_d_cm / ed->uwb.req_count;
+    if (IS_ACTIVE(CONFIG_ED_UWB_BPF_LAZY_INIT)) {
+        LOG_DEBUG("[ed_bpf]: setup deferred to first use\n");
+        return;
     }
+    mutex_lock(&_lock);
+    _bootstrap();
+    mutex_unlock(&_lock);
+}
 
-    uint16_t time = ed->uwb.seen_last_s - ed->uwb.seen_first_s;
-    ed_uwb_bpf_ctx_t ctx = {
-        .time = time,
-        .distance = ed->uwb.cumulative_d_cm,
-        .req_count = ed->uwb.req_count
-    };
+/* the encounter is left as is, it is averaged by ed_uwb_average() */
+static void _ctx_init(const ed_t *ed, ed_uwb_bpf_ctx_t *ctx)
+{
+    uint32_t distance = ed->uwb.cumulative_d_cm;
 
+    if (ed->uwb.req_count > 0) {
+        distance /= ed->uwb.req_count;
+    }
+    ctx->time = ed->uwb.seen_last_s - ed->uwb.seen_first_s;
+    ctx->distance = distance;
+    ctx->req_count = ed->uwb.req_count;
     LOG_DEBUG("[ed_bpf]: time=(%" PRIu16 "), d=(%" PRIu32 "), req=(%" PRIu16 ")\n",
-              time, ed->uwb.cumulative_d_cm, ed->uwb.req_count);
-
-    f12r_t femtoc = {
-#if IS_USED(MODULE_UWB_BPF_SUIT)
-        .application = suit_storage_region_location(region),
-        .application_len = suit_storage_region_size_used(region),
-#else
-        .application = contact_filter_bin,
-        .application_len = sizeof(contact_filter_bin),
-#endif
-        .stack = _stack,
-        .stack_size = sizeof(_stack),
-    };
+              ctx->time, distance, ed->uwb.req_count);
+}
 
-    int64_t result = 0;
+bool ed_uwb_bpf_finish(ed_t *ed)
+{
+    ed_uwb_bpf_ctx_t ctx;
 
+    _ctx_init(ed, &ctx);
     LOG_INFO("[encounter_record]: log... ");
-    f12r_setup(&femtoc);
     mutex_lock(&_lock);
-    f12r_execute_ctx(&femtoc, &ctx, sizeof(ctx), &result);
+    int64_t res = _filter_run(&_single, &ctx, sizeof(ctx));
     mutex_unlock(&_lock);
-    if (result == 1) {
+    if (res == 1) {
         LOG_INFO("YES\n");
         ed->uwb.valid = true;
         return true;
@@ -152,3 +274,41 @@ bool ed_uwb_bpf_finish(ed_t *ed)
     LOG_INFO("NO\n");
     return false;
 }
+
+/* must be called with _lock held, it also protects _batch_ctx */
+static unsigned _batch_flush(ed_t **eds, unsigned numof)
+{
+    _batch_ctx.numof = numof;
+    if (_filter_run(&_batch, &_batch_ctx, sizeof(_batch_ctx)) <= 0) {
+        return 0;
+    }
+    unsigned valid = 0;
+    for (unsigned i = 0; i < numof; i++) {
+        if (_batch_ctx.entries[i].valid == 1) {
+            eds[i]->uwb.valid = true;
+            valid++;
+        }
+    }
+    return valid;
+}
+
+unsigned ed_uwb_bpf_finish_batch(ed_t **eds, unsigned numof)
+{
+    unsigned valid = 0;
+    unsigned pending = 0;
+
+    mutex_lock(&_lock);
+    for (unsigned i = 0; i < numof; i++) {
+        _ctx_init(eds[i], &_batch_ctx.entries[pending].ctx);
+        _batch_ctx.entries[pending].valid = 0;
+        if (++pending == ED_UWB_BPF_BATCH_SIZE) {
+            valid += _batch_flush(&eds[i + 1 - pending], pending);
+            pending = 0;
+        }
+    }
+    if (pending) {
+        valid += _batch_flush(&eds[numof - pending], pending);
+    }
+    mutex_unlock(&_lock);
+    return valid;
+}
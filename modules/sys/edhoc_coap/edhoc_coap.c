@@ -18,11 +18,19 @@
  * @}
  */
 
-#include "net/nanocoap_sock.h"
+#include <errno.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "net/gcoap.h"
 #include "edhoc/edhoc.h"
 #include "edhoc/coap.h"
 #include "edhoc/keys.h"
-#include "random.h"
+
+#if CONFIG_GCOAP_PDU_BUF_SIZE < CONFIG_COAP_EDHOC_BUF_SIZE + EDHOC_COAP_PDU_OVERHEAD
+#error "edhoc_coap: CONFIG_GCOAP_PDU_BUF_SIZE too small for EDHOC messages, \
+set it to at least CONFIG_COAP_EDHOC_BUF_SIZE + EDHOC_COAP_PDU_OVERHEAD"
+#endif
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_INFO
@@ -42,28 +50,116 @@ static void print_bstr(const uint8_t *bstr, size_t bstr_len)
     LOG_DEBUG("\n");
 }
 
-static ssize_t _build_coap_pkt(coap_pkt_t *pkt,
-                               uint8_t *buf, ssize_t buf_len,
-                               uint8_t *payload, ssize_t payload_len)
+static ssize_t _req_init(coap_pkt_t *pdu, uint8_t *buf, size_t buf_len)
+{
+    /* confirmable message always post, gcoap handles retransmissions */
+    gcoap_req_init(pdu, buf, buf_len, COAP_METHOD_POST, CONFIG_COAP_EDHOC_RESOURCE);
+    coap_hdr_set_type(pdu->hdr, COAP_TYPE_CON);
+    coap_opt_add_format(pdu, COAP_FORMAT_OCTET);
+    return coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
+}
+
+static void _finish(edhoc_coap_ctx_t *ctx, int res)
+{
+    if (res == 0) {
+        LOG_INFO("[enrollment]: key exchange successfully completed\n");
+        ctx->state = EDHOC_COAP_DONE;
+    }
+    else {
+        LOG_INFO("[enrollment]: key exchange failed (%d)\n", res);
+        ctx->state = EDHOC_COAP_FAILED;
+    }
+    if (ctx->cb) {
+        ctx->cb(ctx, res, ctx->arg);
+    }
+}
+
+static void _resp_handler(const gcoap_request_memo_t *memo, coap_pkt_t *pdu,
+                          const sock_udp_ep_t *remote)
 {
-    ssize_t len = 0;
-    uint8_t token[4];
-    uint32_t rand = random_uint32();
-    memcpy(&token, &rand, 4);
-    /* set pkt buffer */
-    pkt->hdr = (coap_hdr_t *)buf;
-    /* build header, confirmed message always post */
-    ssize_t hdrlen = coap_build_hdr(pkt->hdr, COAP_TYPE_CON, token,
-                                    sizeof(token), COAP_METHOD_POST, 1);
-    coap_pkt_init(pkt, buf, buf_len, hdrlen);
-    coap_opt_add_string(pkt, COAP_OPT_URI_PATH, CONFIG_COAP_EDHOC_RESOURCE, '/');
-    coap_opt_add_uint(pkt, COAP_OPT_CONTENT_FORMAT, COAP_FORMAT_OCTET);
-    len = coap_opt_finish(pkt, COAP_OPT_FINISH_PAYLOAD);
-    /* copy msg payload */
-    pkt->payload_len = payload_len;
-    memcpy(pkt->payload, payload, payload_len);
-    len += pkt->payload_len;
-    return len;
+    (void)remote;
+    edhoc_coap_ctx_t *ctx = memo->context;
+    coap_hdr_t *hdr = (coap_hdr_t *)memo->msg.data.pdu_buf;
+
+    if (hdr->id != ctx->msg_id || (ctx->state != EDHOC_COAP_MSG1_SENT &&
+                                   ctx->state != EDHOC_COAP_MSG3_SENT)) {
+        LOG_DEBUG("[edhoc_coap]: ignoring stale response\n");
+        return;
+    }
+
+    if (memo->state == GCOAP_MEMO_TIMEOUT) {
+        ctx->res = -ETIMEDOUT;
+    }
+    else if (memo->state == GCOAP_MEMO_ERR ||
+             coap_get_code_class(pdu) != COAP_CLASS_SUCCESS) {
+        ctx->res = -EBADMSG;
+    }
+    else if (ctx->state == EDHOC_COAP_MSG1_SENT) {
+        /* keep msg2, msg3 is built on the handshake queue */
+        if (pdu->payload_len > sizeof(ctx->msg)) {
+            ctx->res = -ENOBUFS;
+        }
+        else {
+            memcpy(ctx->msg, pdu->payload, pdu->payload_len);
+            ctx->msg_len = pdu->payload_len;
+            ctx->state = EDHOC_COAP_MSG2_RECEIVED;
+        }
+    }
+    event_post(ctx->queue, &ctx->event);
+}
+
+static int _req_send(edhoc_coap_ctx_t *ctx, coap_pkt_t *pdu, size_t len,
+                     edhoc_coap_state_t state)
+{
+    /* the response may be handled before gcoap_req_send returns */
+    ctx->msg_id = pdu->hdr->id;
+    ctx->state = state;
+    if (gcoap_req_send((uint8_t *)pdu->hdr, len, &ctx->remote, _resp_handler,
+                       ctx) == 0) {
+        ctx->state = EDHOC_COAP_FAILED;
+        return -1;
+    }
+    return 0;
+}
+
+static void _handshake_step(event_t *event)
+{
+    edhoc_coap_ctx_t *ctx = container_of(event, edhoc_coap_ctx_t, event);
+    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+    coap_pkt_t pdu;
+    ssize_t msg_len;
+
+    if (ctx->res) {
+        _finish(ctx, ctx->res);
+        return;
+    }
+
+    if (ctx->state == EDHOC_COAP_MSG2_RECEIVED) {
+        LOG_INFO("[enrollment]: received EDHOC msg2 (%d bytes):\n", (int)ctx->msg_len);
+        print_bstr(ctx->msg, ctx->msg_len);
+        /* msg3 is written straight in the request payload */
+        ssize_t len = _req_init(&pdu, buf, sizeof(buf));
+        if ((msg_len = edhoc_create_msg3(&ctx->ctx, ctx->msg, ctx->msg_len,
+                                         pdu.payload, pdu.payload_len)) <= 0) {
+            LOG_ERROR("[enrollment]: failed to create msg3\n");
+            _finish(ctx, -1);
+            return;
+        }
+        LOG_INFO("[enrollment]: sending EDHOC msg3 (%d bytes):\n", (int)msg_len);
+        print_bstr(pdu.payload, msg_len);
+        if (_req_send(ctx, &pdu, len + msg_len, EDHOC_COAP_MSG3_SENT)) {
+            LOG_INFO("[enrollment]: failed to send msg3\n");
+            _finish(ctx, -1);
+        }
+    }
+    else if (ctx->state == EDHOC_COAP_MSG3_SENT) {
+        if (edhoc_init_finalize(&ctx->ctx)) {
+            _finish(ctx, -1);
+            return;
+        }
+        ctx->ctx.state = EDHOC_FINALIZED;
+        _finish(ctx, 0);
+    }
 }
 
 int edhoc_coap_init(edhoc_coap_ctx_t *ctx, edhoc_role_t role, uint8_t* id, size_t id_len)
@@ -106,61 +202,48 @@ int edhoc_coap_init(edhoc_coap_ctx_t *ctx, edhoc_role_t role, uint8_t* id, size_
         return -1;
     }
     edhoc_ctx_setup(&ctx->ctx, &ctx->conf, &ctx->sha);
+    ctx->state = EDHOC_COAP_IDLE;
 
     return 0;
 }
 
-int edhoc_coap_handshake(edhoc_ctx_t *ctx, sock_udp_ep_t *remote, uint8_t method, uint8_t suite)
+int edhoc_coap_handshake_start(edhoc_coap_ctx_t *ctx, const sock_udp_ep_t *remote,
+                               event_queue_t *queue, uint8_t method, uint8_t suite,
+                               edhoc_coap_cb_t cb, void *arg)
 {
-    /* TODO: reduce this to a single buffer */
-    uint8_t buf[CONFIG_COAP_EDHOC_BUF_SIZE] = { 0 };
-    coap_pkt_t pkt;
-    ssize_t len = 0;
-    uint8_t msg[CONFIG_COAP_EDHOC_BUF_SIZE];
-    ssize_t msg_len = 0;
-
-    /* correlation value is transport specific */
-    corr_t corr = CORR_1_2;
-
-    /* reset state */
-    ctx->state = EDHOC_WAITING;
+    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+    coap_pkt_t pdu;
+    ssize_t msg_len;
 
-    if ((msg_len = edhoc_create_msg1(ctx, corr, method, suite, msg, sizeof(msg))) > 0) {
-        LOG_INFO("[enrollment]: sending EDHOC msg1 (%d bytes):\n", (int)msg_len);
-        print_bstr(msg, msg_len);
-        _build_coap_pkt(&pkt, buf, sizeof(buf), msg, msg_len);
-        len = nanocoap_request(&pkt, NULL, remote, CONFIG_COAP_EDHOC_BUF_SIZE);
+    if (edhoc_coap_handshake_busy(ctx)) {
+        return -EBUSY;
     }
-    else {
+
+    ctx->remote = *remote;
+    ctx->queue = queue;
+    ctx->cb = cb;
+    ctx->arg = arg;
+    ctx->res = 0;
+    ctx->msg_len = 0;
+    ctx->event.handler = _handshake_step;
+
+    /* reset state, correlation value is transport specific */
+    ctx->ctx.state = EDHOC_WAITING;
+
+    /* msg1 is written straight in the request payload */
+    ssize_t len = _req_init(&pdu, buf, sizeof(buf));
+    if ((msg_len = edhoc_create_msg1(&ctx->ctx, CORR_1_2, method, suite,
+                                     pdu.payload, pdu.payload_len)) <= 0) {
         LOG_INFO("[enrollment]: failed to create msg1\n");
+        ctx->state = EDHOC_COAP_FAILED;
         return -1;
     }
-    if (len < 0) {
+    LOG_INFO("[enrollment]: sending EDHOC msg1 (%d bytes):\n", (int)msg_len);
+    print_bstr(pdu.payload, msg_len);
+    if (_req_send(ctx, &pdu, len + msg_len, EDHOC_COAP_MSG1_SENT)) {
         LOG_INFO("[enrollment]: failed to send msg1\n");
         return -1;
     }
 
-    LOG_INFO("[enrollment]: received EDHOC msg2 (%d bytes):\n", pkt.payload_len);
-    print_bstr(pkt.payload, pkt.payload_len);
-
-    if ((msg_len = edhoc_create_msg3(ctx, pkt.payload, pkt.payload_len, msg, sizeof(msg))) > 0) {
-        LOG_INFO("[enrollment]: sending EDHOC msg3 (%d bytes):\n", (int)msg_len);
-        print_bstr(msg, msg_len);
-        _build_coap_pkt(&pkt, buf, sizeof(buf), msg, msg_len);
-        nanocoap_request(&pkt, NULL, remote, CONFIG_COAP_EDHOC_BUF_SIZE);
-    }
-    else {
-        LOG_ERROR("[enrollment]: failed to create msg3");
-        return -1;
-    }
-
-    if (edhoc_init_finalize(ctx)) {
-        LOG_ERROR("[enrollment]: key exchange failed");
-        return -1;
-    }
-
-    LOG_INFO("[enrollment]: key exchange successfully completed\n");
-    ctx->state = EDHOC_FINALIZED;
-
     return 0;
 }
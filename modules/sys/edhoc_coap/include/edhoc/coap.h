@@ -14,6 +14,11 @@
  * Utilities to initiate an EDHOC CoAP context and perform simple a key exchange
  * (initiator side)
  *
+ * The key exchange is driven as a state machine over gcoap: messages are sent
+ * as confirmable requests, so gcoap takes care of retransmissions, and the
+ * responses are handed back to an event queue where the next message is
+ * built. The caller is never blocked waiting for the responder.
+ *
  * @{
  *
  * @file
@@ -25,12 +30,14 @@
 #define EDHOC_COAP_H
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #include "coap.h"
 #include "edhoc/edhoc.h"
+#include "event.h"
 #include "tinycrypt/sha256.h"
 
-#include "net/nanocoap_sock.h"
+#include "net/gcoap.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +50,14 @@ extern "C" {
 #define CONFIG_COAP_EDHOC_BUF_SIZE          256
 #endif
 
+/**
+ * @brief       Room for the CoAP header, token and options ahead of an EDHOC
+ *              message, messages are sent in a single gcoap PDU so
+ *              CONFIG_GCOAP_PDU_BUF_SIZE must be at least
+ *              CONFIG_COAP_EDHOC_BUF_SIZE + EDHOC_COAP_PDU_OVERHEAD
+ */
+#define EDHOC_COAP_PDU_OVERHEAD             (64U)
+
 /**
  * @brief       The default EDHOC resource
  */
@@ -50,6 +65,30 @@ extern "C" {
 #define CONFIG_COAP_EDHOC_RESOURCE          "/.well-known/edhoc"
 #endif
 
+/**
+ * @brief       Key exchange states
+ */
+typedef enum {
+    EDHOC_COAP_IDLE,                    /**< no key exchange started */
+    EDHOC_COAP_MSG1_SENT,               /**< waiting for msg2 */
+    EDHOC_COAP_MSG2_RECEIVED,           /**< msg3 is being built */
+    EDHOC_COAP_MSG3_SENT,               /**< waiting for msg3 acknowledgment */
+    EDHOC_COAP_DONE,                    /**< key exchange completed */
+    EDHOC_COAP_FAILED,                  /**< key exchange failed */
+} edhoc_coap_state_t;
+
+struct edhoc_coap_ctx;
+
+/**
+ * @brief       Key exchange completion callback, called on the event queue
+ *              the key exchange was started with
+ *
+ * @param[in]       ctx     The EDHOC CoAP context
+ * @param[in]       res     0 if the key exchange succeeded, <0 otherwise
+ * @param[in]       arg     The callback argument
+ */
+typedef void (*edhoc_coap_cb_t)(struct edhoc_coap_ctx *ctx, int res, void *arg);
+
 /**
  * @brief       Utility wrapper to hold all required EDHOC-C strucutres
  */
@@ -60,6 +99,16 @@ typedef struct edhoc_coap_ctx {
     cred_id_t id;                       /**< the credential id */
     edhoc_cose_key_t key;               /**< authkey structure */
     struct tc_sha256_state_struct sha;  /**< the hash context*/
+    event_t event;                      /**< next handshake step */
+    event_queue_t *queue;               /**< queue running the handshake steps */
+    sock_udp_ep_t remote;               /**< the responder endpoint */
+    edhoc_coap_cb_t cb;                 /**< completion callback */
+    void *arg;                          /**< completion callback argument */
+    volatile edhoc_coap_state_t state;  /**< key exchange state */
+    int res;                            /**< last exchange result */
+    uint16_t msg_id;                    /**< outstanding request message id */
+    size_t msg_len;                     /**< received message length */
+    uint8_t msg[CONFIG_COAP_EDHOC_BUF_SIZE];    /**< received message */
 } edhoc_coap_ctx_t;
 
 
@@ -75,20 +124,41 @@ int edhoc_coap_init(edhoc_coap_ctx_t *ctx, edhoc_role_t role, uint8_t *id,
                     size_t id_len);
 
 /**
- * @brief       Perform a EDHOC key exchange agains the remote endpoint
+ * @brief       Start an EDHOC key exchange against the remote endpoint
  *
+ * msg1 is built and sent from the calling context, every following step
+ * runs on @p queue, @p cb is called there once the key exchange ends.
  *
- * @param[in]       ctx     The edhoc context
+ * @param[in]       ctx     The EDHOC CoAP context
  * @param[in]       remote  The remote endpoint
+ * @param[in]       queue   The event queue running the handshake steps
  * @param[in]       method  The authentication method, only EDHOC_AUTH_SIGN_SIGN
  *                          currently supported
  * @param[in]       suite   The cipher suit to use, only EDHOC_CIPHER_SUITE_0 is
  *                          supported
+ * @param[in]       cb      The completion callback
+ * @param[in]       arg     The completion callback argument
  *
- * @returns     0 id succeeded, <0 otherwise
+ * @returns     0 if msg1 was sent, -EBUSY if a key exchange is ongoing,
+ *              <0 otherwise
  */
-int edhoc_coap_handshake(edhoc_ctx_t *ctx, sock_udp_ep_t *remote,
-                         uint8_t method, uint8_t suite);
+int edhoc_coap_handshake_start(edhoc_coap_ctx_t *ctx, const sock_udp_ep_t *remote,
+                               event_queue_t *queue, uint8_t method, uint8_t suite,
+                               edhoc_coap_cb_t cb, void *arg);
+
+/**
+ * @brief       Check if a key exchange is ongoing
+ *
+ * @param[in]       ctx     The EDHOC CoAP context
+ *
+ * @returns     true if a key exchange is ongoing
+ */
+static inline bool edhoc_coap_handshake_busy(const edhoc_coap_ctx_t *ctx)
+{
+    return ctx->state == EDHOC_COAP_MSG1_SENT ||
+           ctx->state == EDHOC_COAP_MSG2_RECEIVED ||
+           ctx->state == EDHOC_COAP_MSG3_SENT;
+}
 
 #ifdef __cplusplus
 }
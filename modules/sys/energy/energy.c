@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_energy
+ * @{
+ *
+ * @file
+ * @brief       Radio state energy accounting implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <string.h>
+
+#include "irq.h"
+#include "timex.h"
+
+#include "energy.h"
+
+static const char *_names[ENERGY_STATE_NUMOF] = {
+    [ENERGY_STATE_BLE_SCAN] = "ble_scan",
+    [ENERGY_STATE_BLE_ADV] = "ble_adv",
+    [ENERGY_STATE_UWB_LISTEN] = "uwb_listen",
+    [ENERGY_STATE_UWB_REQUEST] = "uwb_request",
+    [ENERGY_STATE_UWB_SLEEP] = "uwb_sleep",
+};
+
+static const uint32_t _current_ua[ENERGY_STATE_NUMOF] = {
+    [ENERGY_STATE_BLE_SCAN] = CONFIG_ENERGY_BLE_SCAN_UA,
+    [ENERGY_STATE_BLE_ADV] = CONFIG_ENERGY_BLE_ADV_UA,
+    [ENERGY_STATE_UWB_LISTEN] = CONFIG_ENERGY_UWB_LISTEN_UA,
+    [ENERGY_STATE_UWB_REQUEST] = CONFIG_ENERGY_UWB_REQUEST_UA,
+    [ENERGY_STATE_UWB_SLEEP] = CONFIG_ENERGY_UWB_SLEEP_UA,
+};
+
+static uint64_t _time_us[ENERGY_STATE_NUMOF];
+static uint32_t _count[ENERGY_STATE_NUMOF];
+static uint32_t _begin[ENERGY_STATE_NUMOF];
+static uint16_t _duty[ENERGY_STATE_NUMOF];
+/* bitmap of entered states */
+static uint32_t _started;
+
+static uint64_t _elapsed_us(energy_state_t state, uint32_t now)
+{
+    uint64_t us = (uint64_t)(now - _begin[state]) * US_PER_SEC /
+                  CONFIG_ZTIMER_MSEC_BASE_FREQ;
+
+    return us * _duty[state] / ENERGY_DUTY_FULL;
+}
+
+void energy_begin_duty(energy_state_t state, uint16_t duty)
+{
+    unsigned irq = irq_disable();
+    uint32_t now = energy_now();
+
+    if (_started & (1UL << state)) {
+        _time_us[state] += _elapsed_us(state, now);
+    }
+    else {
+        _started |= 1UL << state;
+        _count[state]++;
+    }
+    _begin[state] = now;
+    _duty[state] = duty > ENERGY_DUTY_FULL ? ENERGY_DUTY_FULL : duty;
+    irq_restore(irq);
+}
+
+void energy_end(energy_state_t state)
+{
+    unsigned irq = irq_disable();
+    uint32_t now = energy_now();
+
+    if (_started & (1UL << state)) {
+        _started &= ~(1UL << state);
+        _time_us[state] += _elapsed_us(state, now);
+    }
+    irq_restore(irq);
+}
+
+void energy_add(energy_state_t state, uint32_t us)
+{
+    unsigned irq = irq_disable();
+
+    _time_us[state] += us;
+    _count[state]++;
+    irq_restore(irq);
+}
+
+uint32_t energy_estimate_uj(energy_state_t state, uint64_t us)
+{
+    /* uA * mV * us is in fJ */
+    return us * _current_ua[state] * CONFIG_ENERGY_SUPPLY_MV / 1000000000ULL;
+}
+
+uint32_t energy_summary_all(energy_summary_t *summaries)
+{
+    uint32_t total = 0;
+
+    for (unsigned i = 0; i < ENERGY_STATE_NUMOF; i++) {
+        unsigned irq = irq_disable();
+        uint32_t now = energy_now();
+        uint64_t us = _time_us[i];
+
+        if (_started & (1UL << i)) {
+            us += _elapsed_us(i, now);
+        }
+        summaries[i].count = _count[i];
+        irq_restore(irq);
+        summaries[i].time_ms = us / US_PER_MS;
+        summaries[i].uj = energy_estimate_uj(i, us);
+        total += summaries[i].uj;
+    }
+    return total;
+}
+
+void energy_reset(void)
+{
+    unsigned irq = irq_disable();
+    uint32_t now = energy_now();
+
+    memset(_time_us, '\0', sizeof(_time_us));
+    memset(_count, '\0', sizeof(_count));
+    for (unsigned i = 0; i < ENERGY_STATE_NUMOF; i++) {
+        if (_started & (1UL << i)) {
+            /* still in the state, it counts as entered again */
+            _begin[i] = now;
+            _count[i] = 1;
+        }
+    }
+    irq_restore(irq);
+}
+
+const char *energy_state_name(energy_state_t state)
+{
+    return state < ENERGY_STATE_NUMOF ? _names[state] : "unknown";
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sys_energy Radio State Energy Accounting
+ * @ingroup     sys
+ * @brief       Time spent by the BLE and UWB radios in each state and the
+ *              matching energy estimate
+ *
+ * The BLE scanner, BLE advertiser and TWR modules mark when their radio
+ * enters and leaves a state with @ref energy_begin and @ref energy_end, or
+ * add a known duration with @ref energy_add. Probes are timestamped with
+ * ZTIMER_MSEC_BASE.
+ *
+ * Not every state can be observed directly:
+ * - the BLE controller does not report when the scan window is open, the
+ *   scanning time is scaled by the window over interval duty cycle
+ * - only the end of an advertising event is reported, each event is
+ *   accounted for @ref CONFIG_ENERGY_BLE_ADV_EVENT_US
+ *
+ * The energy is estimated from a constant current per state and a supply
+ * voltage. Defaults are datasheet figures of the nRF52832 and DW1000 found on
+ * the DWM1001, boards can override them in their board.h.
+ *
+ * @{
+ *
+ * @file
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+
+#include "board.h"
+#include "ztimer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Supply voltage in mV
+ */
+#ifndef CONFIG_ENERGY_SUPPLY_MV
+#define CONFIG_ENERGY_SUPPLY_MV             (3000U)
+#endif
+
+/**
+ * @brief   BLE receive current in uA, nRF52832 with DC/DC
+ */
+#ifndef CONFIG_ENERGY_BLE_SCAN_UA
+#define CONFIG_ENERGY_BLE_SCAN_UA           (5400U)
+#endif
+
+/**
+ * @brief   Average current during an advertising event in uA, nRF52832 at
+ *          0dBm with DC/DC, transmit on three channels and radio ramp up
+ */
+#ifndef CONFIG_ENERGY_BLE_ADV_UA
+#define CONFIG_ENERGY_BLE_ADV_UA            (5000U)
+#endif
+
+/**
+ * @brief   Duration of a legacy non connectable advertising event in us
+ */
+#ifndef CONFIG_ENERGY_BLE_ADV_EVENT_US
+#define CONFIG_ENERGY_BLE_ADV_EVENT_US      (1500U)
+#endif
+
+/**
+ * @brief   UWB receive current in uA, DW1000 at 6.8Mbps
+ */
+#ifndef CONFIG_ENERGY_UWB_LISTEN_UA
+#define CONFIG_ENERGY_UWB_LISTEN_UA         (118000U)
+#endif
+
+/**
+ * @brief   UWB ranging initiator current in uA, DW1000 at 6.8Mbps, a poll
+ *          transmission followed by the response reception
+ */
+#ifndef CONFIG_ENERGY_UWB_REQUEST_UA
+#define CONFIG_ENERGY_UWB_REQUEST_UA        (100000U)
+#endif
+
+/**
+ * @brief   UWB sleep current in uA, DW1000 in SLEEP
+ */
+#ifndef CONFIG_ENERGY_UWB_SLEEP_UA
+#define CONFIG_ENERGY_UWB_SLEEP_UA          (1U)
+#endif
+
+/**
+ * @brief   Full duty cycle, in permille
+ */
+#define ENERGY_DUTY_FULL                    (1000U)
+
+/**
+ * @brief   Radio states
+ */
+typedef enum {
+    ENERGY_STATE_BLE_SCAN = 0,      /**< BLE scan window open */
+    ENERGY_STATE_BLE_ADV,           /**< BLE advertising events */
+    ENERGY_STATE_UWB_LISTEN,        /**< UWB ranging responder listen */
+    ENERGY_STATE_UWB_REQUEST,       /**< UWB ranging initiator request */
+    ENERGY_STATE_UWB_SLEEP,         /**< UWB radio asleep */
+    ENERGY_STATE_NUMOF,             /**< number of states */
+} energy_state_t;
+
+/**
+ * @brief   Time in state summary
+ */
+typedef struct {
+    uint32_t count;     /**< times the state was entered */
+    uint32_t time_ms;   /**< time in state */
+    uint32_t uj;        /**< estimated energy */
+} energy_summary_t;
+
+/**
+ * @brief   Mark that a radio entered a state
+ *
+ * If the state was already entered the time spent so far is accounted, so
+ * that parameters can change while in a state.
+ *
+ * @param[in]   state   the state
+ * @param[in]   duty    the fraction of time actually spent in the state, in
+ *                      permille, @ref ENERGY_DUTY_FULL if always on
+ */
+void energy_begin_duty(energy_state_t state, uint16_t duty);
+
+/**
+ * @brief   Mark that a radio entered a state, for the whole time
+ *
+ * @param[in]   state   the state
+ */
+static inline void energy_begin(energy_state_t state)
+{
+    energy_begin_duty(state, ENERGY_DUTY_FULL);
+}
+
+/**
+ * @brief   Mark that a radio left a state and account the time spent in it
+ *
+ * Nothing is accounted if the state was not entered.
+ *
+ * @param[in]   state   the state
+ */
+void energy_end(energy_state_t state);
+
+/**
+ * @brief   Account a state entered for a known duration
+ *
+ * @param[in]   state   the state
+ * @param[in]   us      the duration in us
+ */
+void energy_add(energy_state_t state, uint32_t us);
+
+/**
+ * @brief   Current probe timestamp
+ *
+ * @return  ZTIMER_MSEC_BASE ticks
+ */
+static inline uint32_t energy_now(void)
+{
+    return ztimer_now(ZTIMER_MSEC_BASE);
+}
+
+/**
+ * @brief   Estimate the energy spent in a state
+ *
+ * @param[in]   state   the state
+ * @param[in]   us      the time in state in us
+ *
+ * @return  the energy in uJ
+ */
+uint32_t energy_estimate_uj(energy_state_t state, uint64_t us);
+
+/**
+ * @brief   Summarize all states, states still entered are accounted up to
+ *          now
+ *
+ * @param[out]  summaries   ENERGY_STATE_NUMOF summaries
+ *
+ * @return  the total estimated energy in uJ
+ */
+uint32_t energy_summary_all(energy_summary_t *summaries);
+
+/**
+ * @brief   Clear all counters, states still entered are accounted from now
+ *          on, e.g. at the start of an epoch
+ */
+void energy_reset(void);
+
+/**
+ * @brief   Name of a state
+ *
+ * @param[in]   state   the state
+ *
+ * @return  the state name
+ */
+const char *energy_state_name(energy_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ENERGY_H */
+/** @} */
@@ -24,6 +24,15 @@
 #include "crypto_manager.h"
 #include "ed.h"
 #include "memarray.h"
+#if IS_USED(MODULE_LATENCY)
+#include "latency.h"
+#endif
+#if IS_USED(MODULE_WATERMARK)
+#include "watermark.h"
+#endif
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -124,6 +133,17 @@ typedef struct epoch_data {
     uint32_t timestamp;                                     /**< epoch timestamp seconds*/
     contact_data_t contacts[CONFIG_EPOCH_MAX_ENCOUNTERS];   /**< possible contacts */
     crypto_manager_keys_t *keys;                            /**< keys */
+#if IS_USED(MODULE_LATENCY)
+    latency_summary_t latency[LATENCY_STAGE_NUMOF];         /**< pipeline latencies */
+#endif
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_t pools[WATERMARK_POOL_NUMOF];           /**< memory pool usage */
+    watermark_stack_t stacks[CONFIG_WATERMARK_STACKS_NUMOF]; /**< thread stack usage */
+#endif
+#if IS_USED(MODULE_ENERGY)
+    energy_summary_t energy[ENERGY_STATE_NUMOF];            /**< radio time in state */
+    uint32_t energy_uj;                                     /**< radio energy estimate */
+#endif
 } epoch_data_t;
 
 /**
@@ -44,6 +44,174 @@ static void turo_hexarray(turo_t *ctx, uint8_t *vals, size_t size)
     print_str("\"");
 }
 
+#if IS_USED(MODULE_LATENCY)
+static void _json_latency(json_encoder_t *ctx, const latency_summary_t *latency)
+{
+    json_dict_key(ctx, "latency");
+    json_dict_open(ctx);
+    for (unsigned i = 0; i < LATENCY_STAGE_NUMOF; i++) {
+        json_dict_key(ctx, latency_stage_name(i));
+        json_dict_open(ctx);
+        json_dict_key(ctx, "n");
+        json_u32(ctx, latency[i].count);
+        json_dict_key(ctx, "min");
+        json_u32(ctx, latency[i].min_us);
+        json_dict_key(ctx, "avg");
+        json_u32(ctx, latency[i].avg_us);
+        json_dict_key(ctx, "p99");
+        json_u32(ctx, latency[i].p99_us);
+        json_dict_key(ctx, "max");
+        json_u32(ctx, latency[i].max_us);
+        json_dict_close(ctx);
+    }
+    json_dict_close(ctx);
+}
+
+static void _turo_latency(turo_t *ctx, const latency_summary_t *latency)
+{
+    turo_dict_key(ctx, "latency");
+    turo_dict_open(ctx);
+    for (unsigned i = 0; i < LATENCY_STAGE_NUMOF; i++) {
+        turo_dict_key(ctx, latency_stage_name(i));
+        turo_dict_open(ctx);
+        turo_dict_key(ctx, "n");
+        turo_u32(ctx, latency[i].count);
+        turo_dict_key(ctx, "min");
+        turo_u32(ctx, latency[i].min_us);
+        turo_dict_key(ctx, "avg");
+        turo_u32(ctx, latency[i].avg_us);
+        turo_dict_key(ctx, "p99");
+        turo_u32(ctx, latency[i].p99_us);
+        turo_dict_key(ctx, "max");
+        turo_u32(ctx, latency[i].max_us);
+        turo_dict_close(ctx);
+    }
+    turo_dict_close(ctx);
+}
+#endif
+
+#if IS_USED(MODULE_WATERMARK)
+static void _json_watermark(json_encoder_t *ctx, const epoch_data_t *epoch)
+{
+    json_dict_key(ctx, "pools");
+    json_dict_open(ctx);
+    for (unsigned i = 0; i < WATERMARK_POOL_NUMOF; i++) {
+        /* pool not in use */
+        if (epoch->pools[i].size == 0) {
+            continue;
+        }
+        json_dict_key(ctx, watermark_pool_name(i));
+        json_dict_open(ctx);
+        json_dict_key(ctx, "size");
+        json_u32(ctx, epoch->pools[i].size);
+        json_dict_key(ctx, "used");
+        json_u32(ctx, epoch->pools[i].used);
+        json_dict_key(ctx, "high");
+        json_u32(ctx, epoch->pools[i].high);
+        json_dict_key(ctx, "fails");
+        json_u32(ctx, epoch->pools[i].fails);
+        json_dict_close(ctx);
+    }
+    json_dict_close(ctx);
+    json_dict_key(ctx, "stacks");
+    json_dict_open(ctx);
+    for (unsigned i = 0; i < CONFIG_WATERMARK_STACKS_NUMOF; i++) {
+        if (epoch->stacks[i].name == NULL) {
+            break;
+        }
+        json_dict_key(ctx, epoch->stacks[i].name);
+        json_dict_open(ctx);
+        json_dict_key(ctx, "size");
+        json_u32(ctx, epoch->stacks[i].size);
+        json_dict_key(ctx, "used");
+        json_u32(ctx, epoch->stacks[i].used);
+        json_dict_close(ctx);
+    }
+    json_dict_close(ctx);
+}
+
+static void _turo_watermark(turo_t *ctx, const epoch_data_t *epoch)
+{
+    turo_dict_key(ctx, "pools");
+    turo_dict_open(ctx);
+    for (unsigned i = 0; i < WATERMARK_POOL_NUMOF; i++) {
+        /* pool not in use */
+        if (epoch->pools[i].size == 0) {
+            continue;
+        }
+        turo_dict_key(ctx, watermark_pool_name(i));
+        turo_dict_open(ctx);
+        turo_dict_key(ctx, "size");
+        turo_u32(ctx, epoch->pools[i].size);
+        turo_dict_key(ctx, "used");
+        turo_u32(ctx, epoch->pools[i].used);
+        turo_dict_key(ctx, "high");
+        turo_u32(ctx, epoch->pools[i].high);
+        turo_dict_key(ctx, "fails");
+        turo_u32(ctx, epoch->pools[i].fails);
+        turo_dict_close(ctx);
+    }
+    turo_dict_close(ctx);
+    turo_dict_key(ctx, "stacks");
+    turo_dict_open(ctx);
+    for (unsigned i = 0; i < CONFIG_WATERMARK_STACKS_NUMOF; i++) {
+        if (epoch->stacks[i].name == NULL) {
+            break;
+        }
+        turo_dict_key(ctx, epoch->stacks[i].name);
+        turo_dict_open(ctx);
+        turo_dict_key(ctx, "size");
+        turo_u32(ctx, epoch->stacks[i].size);
+        turo_dict_key(ctx, "used");
+        turo_u32(ctx, epoch->stacks[i].used);
+        turo_dict_close(ctx);
+    }
+    turo_dict_close(ctx);
+}
+#endif
+
+#if IS_USED(MODULE_ENERGY)
+static void _json_energy(json_encoder_t *ctx, const epoch_data_t *epoch)
+{
+    json_dict_key(ctx, "energy");
+    json_dict_open(ctx);
+    json_dict_key(ctx, "uj");
+    json_u32(ctx, epoch->energy_uj);
+    for (unsigned i = 0; i < ENERGY_STATE_NUMOF; i++) {
+        json_dict_key(ctx, energy_state_name(i));
+        json_dict_open(ctx);
+        json_dict_key(ctx, "n");
+        json_u32(ctx, epoch->energy[i].count);
+        json_dict_key(ctx, "ms");
+        json_u32(ctx, epoch->energy[i].time_ms);
+        json_dict_key(ctx, "uj");
+        json_u32(ctx, epoch->energy[i].uj);
+        json_dict_close(ctx);
+    }
+    json_dict_close(ctx);
+}
+
+static void _turo_energy(turo_t *ctx, const epoch_data_t *epoch)
+{
+    turo_dict_key(ctx, "energy");
+    turo_dict_open(ctx);
+    turo_dict_key(ctx, "uj");
+    turo_u32(ctx, epoch->energy_uj);
+    for (unsigned i = 0; i < ENERGY_STATE_NUMOF; i++) {
+        turo_dict_key(ctx, energy_state_name(i));
+        turo_dict_open(ctx);
+        turo_dict_key(ctx, "n");
+        turo_u32(ctx, epoch->energy[i].count);
+        turo_dict_key(ctx, "ms");
+        turo_u32(ctx, epoch->energy[i].time_ms);
+        turo_dict_key(ctx, "uj");
+        turo_u32(ctx, epoch->energy[i].uj);
+        turo_dict_close(ctx);
+    }
+    turo_dict_close(ctx);
+}
+#endif
+
 size_t contact_data_serialize_all_json(epoch_data_t *epoch, uint8_t *buf,
                                        size_t len, const char *prefix)
 {
@@ -138,6 +306,15 @@ size_t contact_data_serialize_all_json(epoch_data_t *epoch, uint8_t *buf,
         }
     }
     json_array_close(&ctx);
+#if IS_USED(MODULE_LATENCY)
+    _json_latency(&ctx, epoch->latency);
+#endif
+#if IS_USED(MODULE_WATERMARK)
+    _json_watermark(&ctx, epoch);
+#endif
+#if IS_USED(MODULE_ENERGY)
+    _json_energy(&ctx, epoch);
+#endif
     json_dict_close(&ctx);
     return json_encoder_end(&ctx);
 }
@@ -236,6 +413,15 @@ void contact_data_serialize_all_printf(epoch_data_t *epoch, const char *prefix)
         turo_dict_close(&ctx);
     }
     turo_array_close(&ctx);
+#if IS_USED(MODULE_LATENCY)
+    _turo_latency(&ctx, epoch->latency);
+#endif
+#if IS_USED(MODULE_WATERMARK)
+    _turo_watermark(&ctx, epoch);
+#endif
+#if IS_USED(MODULE_ENERGY)
+    _turo_energy(&ctx, epoch);
+#endif
     turo_dict_close(&ctx);
     print_str("\n");
     irq_restore(state);
@@ -0,0 +1,436 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_flashlog
+ * @{
+ *
+ * @file
+ * @brief       Flash Circular Log implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "checksum/fletcher16.h"
+#include "ztimer.h"
+
+#include "flashlog.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+#define FLASHLOG_ERASED_BYTE        (0xFF)
+
+static uint32_t _now_us(void)
+{
+    if (IS_USED(MODULE_FLASHLOG_STATS)) {
+        return ztimer_now(ZTIMER_USEC);
+    }
+    return 0;
+}
+
+static inline size_t _align(size_t len)
+{
+    return FLASHLOG_ALIGN(len);
+}
+
+static bool _is_erased(const void *buf, size_t len)
+{
+    const uint8_t *data = buf;
+
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != FLASHLOG_ERASED_BYTE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int _read(const flashlog_t *log, uint32_t idx, uint32_t offset,
+                 void *buf, size_t len)
+{
+    uint32_t addr = (log->first_sector + idx) * log->sector_size + offset;
+    int res = mtd_read_page(log->mtd, buf, addr / log->mtd->page_size,
+                            addr % log->mtd->page_size, len);
+
+    return res < 0 ? res : 0;
+}
+
+static int _write(const flashlog_t *log, uint32_t idx, uint32_t offset,
+                  const void *buf, size_t len)
+{
+    uint32_t addr = (log->first_sector + idx) * log->sector_size + offset;
+    int res = mtd_write_page_raw(log->mtd, buf, addr / log->mtd->page_size,
+                                 addr % log->mtd->page_size, len);
+
+    return res < 0 ? res : 0;
+}
+
+static int _write_hdr(const flashlog_t *log, uint32_t idx, uint32_t offset,
+                      const void *hdr, size_t len)
+{
+    /* pad headers so that whatever follows them stays write aligned */
+    uint32_t buf[FLASHLOG_SECTOR_HDR_SIZE > FLASHLOG_RECORD_HDR_SIZE ?
+                 FLASHLOG_SECTOR_HDR_SIZE / sizeof(uint32_t) :
+                 FLASHLOG_RECORD_HDR_SIZE / sizeof(uint32_t)];
+
+    memset(buf, FLASHLOG_ERASED_BYTE, sizeof(buf));
+    memcpy(buf, hdr, len);
+    return _write(log, idx, offset, buf, _align(len));
+}
+
+static bool _read_sector_hdr(const flashlog_t *log, uint32_t idx,
+                             flashlog_sector_hdr_t *hdr)
+{
+    if (_read(log, idx, 0, hdr, sizeof(*hdr))) {
+        return false;
+    }
+    return hdr->magic == FLASHLOG_SECTOR_MAGIC;
+}
+
+static bool _read_record_hdr(const flashlog_t *log, uint32_t idx,
+                             uint32_t offset, flashlog_record_hdr_t *hdr)
+{
+    if (offset + FLASHLOG_RECORD_HDR_SIZE > log->sector_size) {
+        return false;
+    }
+    if (_read(log, idx, offset, hdr, sizeof(*hdr))) {
+        return false;
+    }
+    return hdr->magic == FLASHLOG_RECORD_MAGIC &&
+           hdr->len <= flashlog_max_len(log);
+}
+
+static int _start_sector(flashlog_t *log, uint32_t idx, uint32_t seq)
+{
+    flashlog_sector_hdr_t hdr;
+    flashlog_record_hdr_t rec;
+    uint32_t erase_count = 0;
+
+    if (_read_sector_hdr(log, idx, &hdr)) {
+        erase_count = hdr.erase_count;
+        if (_read_record_hdr(log, idx, FLASHLOG_SECTOR_HDR_SIZE, &rec)) {
+            log->stats.recycled++;
+        }
+    }
+
+    uint32_t start = _now_us();
+    int res = mtd_erase_sector(log->mtd, log->first_sector + idx, 1);
+    log->stats.erase_us += _now_us() - start;
+    if (res < 0) {
+        LOG_ERROR("[flashlog]: failed to erase sector %" PRIu32 "\n", idx);
+        return res;
+    }
+    log->stats.erases++;
+
+    hdr.magic = FLASHLOG_SECTOR_MAGIC;
+    hdr.seq = seq;
+    hdr.erase_count = erase_count + 1;
+    hdr.rec_seq = log->rec_seq;
+    res = _write_hdr(log, idx, 0, &hdr, sizeof(hdr));
+    if (res < 0) {
+        LOG_ERROR("[flashlog]: failed to write sector %" PRIu32 " header\n", idx);
+        return res;
+    }
+
+    log->head = idx;
+    log->head_seq = seq;
+    log->offset = FLASHLOG_SECTOR_HDR_SIZE;
+    return 0;
+}
+
+static int _recover_head(flashlog_t *log, const flashlog_sector_hdr_t *shdr)
+{
+    flashlog_record_hdr_t hdr;
+
+    log->offset = FLASHLOG_SECTOR_HDR_SIZE;
+    log->rec_seq = shdr->rec_seq;
+    while (log->offset + FLASHLOG_RECORD_HDR_SIZE <= log->sector_size) {
+        int res = _read(log, log->head, log->offset, &hdr, sizeof(hdr));
+        if (res < 0) {
+            /* where the sector ends is unknown, do not write over it */
+            LOG_ERROR("[flashlog]: failed to read record header\n");
+            return res;
+        }
+        if (hdr.magic == FLASHLOG_RECORD_MAGIC &&
+            hdr.len <= flashlog_max_len(log)) {
+            log->offset += FLASHLOG_RECORD_HDR_SIZE + _align(hdr.len);
+            log->rec_seq = hdr.seq + 1;
+        }
+        else {
+            if (!_is_erased(&hdr, sizeof(hdr))) {
+                /* interrupted write, consider the sector as full */
+                LOG_WARNING("[flashlog]: corrupted header, skip sector\n");
+                log->offset = log->sector_size;
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+size_t flashlog_max_len(const flashlog_t *log)
+{
+    size_t max = log->sector_size - FLASHLOG_SECTOR_HDR_SIZE -
+                 FLASHLOG_RECORD_HDR_SIZE;
+
+    if (max > UINT16_MAX) {
+        max = UINT16_MAX;
+    }
+    return max & ~(CONFIG_FLASHLOG_WRITE_ALIGN - 1);
+}
+
+int flashlog_init(flashlog_t *log, mtd_dev_t *mtd, uint32_t first_sector,
+                  uint32_t sector_numof)
+{
+    assert(log && mtd);
+    assert(sector_numof >= 2);
+
+    memset(log, '\0', sizeof(flashlog_t));
+    mutex_init(&log->lock);
+    log->mtd = mtd;
+    log->first_sector = first_sector;
+    log->sector_numof = sector_numof;
+    log->sector_size = mtd->page_size * mtd->pages_per_sector;
+
+    if (first_sector + sector_numof > mtd->sector_count ||
+        log->sector_size <= FLASHLOG_SECTOR_HDR_SIZE + FLASHLOG_RECORD_HDR_SIZE) {
+        LOG_ERROR("[flashlog]: invalid sector range\n");
+        return -EINVAL;
+    }
+
+    flashlog_sector_hdr_t hdr;
+    flashlog_sector_hdr_t head_hdr;
+    bool found = false;
+
+    for (uint32_t i = 0; i < sector_numof; i++) {
+        if (_read_sector_hdr(log, i, &hdr)) {
+            if (!found || hdr.seq > head_hdr.seq) {
+                head_hdr = hdr;
+                log->head = i;
+                found = true;
+            }
+        }
+    }
+
+    if (!found) {
+        LOG_INFO("[flashlog]: no log found, formatting\n");
+        return _start_sector(log, 0, 1);
+    }
+
+    log->head_seq = head_hdr.seq;
+    int res = _recover_head(log, &head_hdr);
+    if (res < 0) {
+        return res;
+    }
+    LOG_INFO("[flashlog]: head=%" PRIu32 ", offset=%" PRIu32 ", seq=%" PRIu32 "\n",
+             log->head, log->offset, log->rec_seq);
+    return 0;
+}
+
+int flashlog_clear(flashlog_t *log)
+{
+    int res = 0;
+
+    mutex_lock(&log->lock);
+    /* erase in ring order so the last started sector is the new head */
+    for (uint32_t i = 1; i <= log->sector_numof; i++) {
+        uint32_t idx = (log->head + i) % log->sector_numof;
+        res = _start_sector(log, idx, log->head_seq + 1);
+        if (res < 0) {
+            break;
+        }
+    }
+    mutex_unlock(&log->lock);
+    return res;
+}
+
+int32_t flashlog_append(flashlog_t *log, uint16_t tag, const void *data,
+                        size_t len)
+{
+    if (len == 0 || len > flashlog_max_len(log)) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&log->lock);
+
+    int res = 0;
+    size_t aligned = _align(len);
+    uint32_t start = _now_us();
+
+    if (log->offset + FLASHLOG_RECORD_HDR_SIZE + aligned >
+        log->sector_size) {
+        res = _start_sector(log, (log->head + 1) % log->sector_numof,
+                            log->head_seq + 1);
+        if (res < 0) {
+            goto out;
+        }
+    }
+
+    flashlog_record_hdr_t hdr = {
+        .magic = FLASHLOG_RECORD_MAGIC,
+        .len = len,
+        .tag = tag,
+        .chk = fletcher16(data, len),
+        .seq = log->rec_seq,
+    };
+    res = _write_hdr(log, log->head, log->offset, &hdr, sizeof(hdr));
+    if (res < 0) {
+        goto fail;
+    }
+
+    /* flash writes require aligned source buffers, stage the payload */
+    uint32_t chunk[CONFIG_FLASHLOG_CHUNK_SIZE / sizeof(uint32_t)];
+    const uint8_t *src = data;
+    uint32_t offset = log->offset + FLASHLOG_RECORD_HDR_SIZE;
+    for (size_t pos = 0; pos < aligned; pos += sizeof(chunk)) {
+        size_t size = aligned - pos < sizeof(chunk) ? aligned - pos : sizeof(chunk);
+        size_t copy = len - pos < size ? len - pos : size;
+        memset(chunk, FLASHLOG_ERASED_BYTE, size);
+        memcpy(chunk, &src[pos], copy);
+        res = _write(log, log->head, offset + pos, chunk, size);
+        if (res < 0) {
+            goto fail;
+        }
+    }
+
+    log->offset += FLASHLOG_RECORD_HDR_SIZE + aligned;
+    log->stats.records++;
+    log->stats.bytes += len;
+    log->stats.write_us += _now_us() - start;
+    res = log->rec_seq++;
+    goto out;
+
+fail:
+    /* partially written record, don't append to this sector anymore */
+    log->offset = log->sector_size;
+out:
+    if (res < 0) {
+        log->stats.errors++;
+    }
+    mutex_unlock(&log->lock);
+    return res;
+}
+
+void flashlog_iter_init(flashlog_t *log, flashlog_iter_t *iter)
+{
+    mutex_lock(&log->lock);
+    /* the sector following the head is the oldest one */
+    iter->idx = (log->head + 1) % log->sector_numof;
+    iter->seq = 0;
+    iter->offset = FLASHLOG_SECTOR_HDR_SIZE;
+    mutex_unlock(&log->lock);
+}
+
+static int _iter_step(flashlog_t *log, flashlog_iter_t *iter,
+                      flashlog_record_hdr_t *hdr, void *buf, size_t len)
+{
+    flashlog_sector_hdr_t shdr;
+    bool valid = _read_sector_hdr(log, iter->idx, &shdr);
+
+    if (valid && iter->seq && shdr.seq != iter->seq) {
+        /* recycled since the last call, resume at the oldest sector */
+        iter->idx = (log->head + 1) % log->sector_numof;
+        iter->seq = 0;
+        iter->offset = FLASHLOG_SECTOR_HDR_SIZE;
+        return -EAGAIN;
+    }
+    uint32_t end = iter->idx == log->head ? log->offset : log->sector_size;
+    if (valid && iter->offset < end &&
+        _read_record_hdr(log, iter->idx, iter->offset, hdr)) {
+        uint32_t offset = iter->offset + FLASHLOG_RECORD_HDR_SIZE;
+        iter->seq = shdr.seq;
+        iter->offset = offset + _align(hdr->len);
+        size_t copy = hdr->len < len ? hdr->len : len;
+        if (buf && copy) {
+            if (_read(log, iter->idx, offset, buf, copy)) {
+                return -EIO;
+            }
+            if (copy == hdr->len && fletcher16(buf, copy) != hdr->chk) {
+                LOG_DEBUG("[flashlog]: bad checksum, seq=%" PRIu32 "\n",
+                          hdr->seq);
+                return -EAGAIN;
+            }
+        }
+        return hdr->len;
+    }
+    if (iter->idx == log->head) {
+        /* keep the position, records appended later are read next */
+        return 0;
+    }
+    iter->idx = (iter->idx + 1) % log->sector_numof;
+    iter->seq = 0;
+    iter->offset = FLASHLOG_SECTOR_HDR_SIZE;
+    return -EAGAIN;
+}
+
+int flashlog_iter_next(flashlog_t *log, flashlog_iter_t *iter,
+                       flashlog_record_hdr_t *hdr, void *buf, size_t len)
+{
+    int res;
+
+    do {
+        /* one record or sector at a time, appends can go on in between */
+        mutex_lock(&log->lock);
+        res = _iter_step(log, iter, hdr, buf, len);
+        mutex_unlock(&log->lock);
+    } while (res == -EAGAIN);
+    return res;
+}
+
+void flashlog_get_stats(flashlog_t *log, flashlog_stats_t *stats)
+{
+    flashlog_sector_hdr_t hdr;
+
+    mutex_lock(&log->lock);
+    memcpy(stats, &log->stats, sizeof(flashlog_stats_t));
+    stats->erase_min = UINT32_MAX;
+    stats->erase_max = 0;
+    stats->erase_total = 0;
+    for (uint32_t i = 0; i < log->sector_numof; i++) {
+        uint32_t count = _read_sector_hdr(log, i, &hdr) ? hdr.erase_count : 0;
+        stats->erase_min = count < stats->erase_min ? count : stats->erase_min;
+        stats->erase_max = count > stats->erase_max ? count : stats->erase_max;
+        stats->erase_total += count;
+    }
+    mutex_unlock(&log->lock);
+}
+
+void flashlog_print_stats(flashlog_t *log)
+{
+    flashlog_stats_t stats;
+
+    flashlog_get_stats(log, &stats);
+    printf("[flashlog]: sectors=%" PRIu32 ", sector_size=%" PRIu32 "\n",
+           log->sector_numof, log->sector_size);
+    printf("\thead=%" PRIu32 ", offset=%" PRIu32 ", next_seq=%" PRIu32 "\n",
+           log->head, log->offset, log->rec_seq);
+    printf("\trecords=%" PRIu32 ", bytes=%" PRIu32 ", errors=%" PRIu32 "\n",
+           stats.records, stats.bytes, stats.errors);
+    printf("\terases=%" PRIu32 ", recycled=%" PRIu32 "\n",
+           stats.erases, stats.recycled);
+    printf("\terase count: min=%" PRIu32 ", max=%" PRIu32 ", total=%" PRIu32 "\n",
+           stats.erase_min, stats.erase_max, stats.erase_total);
+    if (IS_USED(MODULE_FLASHLOG_STATS) && stats.write_us) {
+        printf("\tappend: %" PRIu32 " us, %" PRIu32 " B/s, erase: %" PRIu32 " us\n",
+               stats.write_us,
+               (uint32_t)(((uint64_t)stats.bytes * US_PER_SEC) / stats.write_us),
+               stats.erase_us);
+    }
+}
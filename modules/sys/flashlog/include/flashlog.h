@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sys_flashlog Flash Circular Log
+ * @ingroup     sys
+ * @brief       Wear-leveled circular record log on a raw MTD device
+ *
+ * The log uses a contiguous range of MTD sectors as a ring. Each sector
+ * starts with a @ref flashlog_sector_hdr_t holding its sequence number and
+ * erase count, followed by records made of a @ref flashlog_record_hdr_t and
+ * the (write-aligned) payload. When the head sector is full the next sector
+ * in the ring is erased and the oldest records are dropped. Since sectors are
+ * always recycled in ring order erase counts never differ by more than one.
+ *
+ * No filesystem is involved, the write position is recovered on init by
+ * scanning sector and record headers.
+ *
+ * @{
+ *
+ * @file
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "mtd.h"
+#include "mutex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Write alignment in bytes, records are padded to this size
+ */
+#ifndef CONFIG_FLASHLOG_WRITE_ALIGN
+#ifdef FLASHPAGE_WRITE_BLOCK_ALIGNMENT
+#define CONFIG_FLASHLOG_WRITE_ALIGN         FLASHPAGE_WRITE_BLOCK_ALIGNMENT
+#else
+#define CONFIG_FLASHLOG_WRITE_ALIGN         (4U)
+#endif
+#endif
+
+/**
+ * @brief   Size of the aligned staging buffer used to program payloads
+ */
+#ifndef CONFIG_FLASHLOG_CHUNK_SIZE
+#define CONFIG_FLASHLOG_CHUNK_SIZE          (128U)
+#endif
+
+/**
+ * @brief   Sector header magic ("FLOG")
+ */
+#define FLASHLOG_SECTOR_MAGIC               (0x464C4F47UL)
+
+/**
+ * @brief   Record header magic
+ */
+#define FLASHLOG_RECORD_MAGIC               (0x4C52U)
+
+/**
+ * @brief   Sector header, at the start of every used sector
+ */
+typedef struct {
+    uint32_t magic;         /**< FLASHLOG_SECTOR_MAGIC */
+    uint32_t seq;           /**< sector sequence number, increases on every erase */
+    uint32_t erase_count;   /**< number of times this sector was erased */
+    uint32_t rec_seq;       /**< sequence number of the first record in sector */
+} flashlog_sector_hdr_t;
+
+/**
+ * @brief   Record header, precedes every record payload
+ */
+typedef struct {
+    uint16_t magic;         /**< FLASHLOG_RECORD_MAGIC */
+    uint16_t len;           /**< payload length in bytes (unpadded) */
+    uint16_t tag;           /**< user tag, e.g.: stream identifier */
+    uint16_t chk;           /**< fletcher16 checksum of the payload */
+    uint32_t seq;           /**< record sequence number */
+} flashlog_record_hdr_t;
+
+/**
+ * @brief   Round @p len up to @ref CONFIG_FLASHLOG_WRITE_ALIGN
+ */
+#define FLASHLOG_ALIGN(len)                 (((len) + CONFIG_FLASHLOG_WRITE_ALIGN - 1) & \
+                                             ~(CONFIG_FLASHLOG_WRITE_ALIGN - 1))
+
+/**
+ * @brief   Flash space used by a sector header, so that records start aligned
+ */
+#define FLASHLOG_SECTOR_HDR_SIZE            FLASHLOG_ALIGN(sizeof(flashlog_sector_hdr_t))
+
+/**
+ * @brief   Flash space used by a record header, so that payloads start aligned
+ */
+#define FLASHLOG_RECORD_HDR_SIZE            FLASHLOG_ALIGN(sizeof(flashlog_record_hdr_t))
+
+/**
+ * @brief   Flash log statistics
+ */
+typedef struct {
+    uint32_t records;       /**< records appended since init */
+    uint32_t bytes;         /**< payload bytes appended since init */
+    uint32_t write_us;      /**< time spent appending (flashlog_stats) */
+    uint32_t erase_us;      /**< time spent erasing (flashlog_stats) */
+    uint32_t erases;        /**< sectors erased since init */
+    uint32_t recycled;      /**< erased sectors that still held records */
+    uint32_t errors;        /**< failed appends */
+    uint32_t erase_min;     /**< lowest sector erase count */
+    uint32_t erase_max;     /**< highest sector erase count */
+    uint32_t erase_total;   /**< sum of all sector erase counts */
+} flashlog_stats_t;
+
+/**
+ * @brief   Flash log descriptor
+ */
+typedef struct {
+    mtd_dev_t *mtd;         /**< backing MTD device */
+    uint32_t first_sector;  /**< first MTD sector of the ring */
+    uint32_t sector_numof;  /**< number of sectors in the ring */
+    uint32_t sector_size;   /**< sector size in bytes */
+    uint32_t head;          /**< ring index of the sector being written */
+    uint32_t head_seq;      /**< sequence number of the head sector */
+    uint32_t offset;        /**< write offset in the head sector */
+    uint32_t rec_seq;       /**< sequence number of the next record */
+    flashlog_stats_t stats; /**< statistics */
+    mutex_t lock;           /**< lock */
+} flashlog_t;
+
+/**
+ * @brief   Flash log read iterator
+ */
+typedef struct {
+    uint32_t idx;           /**< ring index of the sector being read */
+    uint32_t seq;           /**< sequence number of that sector, 0 if unknown */
+    uint32_t offset;        /**< read offset in the current sector */
+} flashlog_iter_t;
+
+/**
+ * @brief   Init the flash log, recovers the write position from flash
+ *
+ * The MTD device must already be initialized.
+ *
+ * @param[out]  log             the log descriptor
+ * @param[in]   mtd             the MTD device
+ * @param[in]   first_sector    first sector of the ring
+ * @param[in]   sector_numof    number of sectors, must be >= 2
+ *
+ * @return  0 on success, <0 otherwise
+ */
+int flashlog_init(flashlog_t *log, mtd_dev_t *mtd, uint32_t first_sector,
+                  uint32_t sector_numof);
+
+/**
+ * @brief   Erase all sectors of the log, erase counts are preserved
+ *
+ * @param[in]   log         the log descriptor
+ *
+ * @return  0 on success, <0 otherwise
+ */
+int flashlog_clear(flashlog_t *log);
+
+/**
+ * @brief   Append a record to the log
+ *
+ * @param[in]   log         the log descriptor
+ * @param[in]   tag         record tag
+ * @param[in]   data        the payload
+ * @param[in]   len         the payload length
+ *
+ * @return  the record sequence number on success, <0 otherwise
+ */
+int32_t flashlog_append(flashlog_t *log, uint16_t tag, const void *data,
+                        size_t len);
+
+/**
+ * @brief   Maximum payload length of a single record
+ *
+ * @param[in]   log         the log descriptor
+ */
+size_t flashlog_max_len(const flashlog_t *log);
+
+/**
+ * @brief   Init an iterator at the oldest record in the log
+ *
+ * @param[in]   log         the log descriptor
+ * @param[out]  iter        the iterator
+ */
+void flashlog_iter_init(flashlog_t *log, flashlog_iter_t *iter);
+
+/**
+ * @brief   Read the next record, records with a bad checksum are skipped
+ *
+ * The log lock is held while reading each record, so iterating is safe while
+ * other threads append to the log. If the sector being read was recycled since
+ * the previous call, reading resumes at the oldest record left.
+ *
+ * @param[in]       log     the log descriptor
+ * @param[inout]    iter    the iterator
+ * @param[out]      hdr     the record header
+ * @param[out]      buf     buffer for the payload, may be NULL
+ * @param[in]       len     @p buf size, payload is truncated to it
+ *
+ * @return  the record payload length, 0 when no records are left, <0 on error
+ */
+int flashlog_iter_next(flashlog_t *log, flashlog_iter_t *iter,
+                       flashlog_record_hdr_t *hdr, void *buf, size_t len);
+
+/**
+ * @brief   Get log statistics, erase counts are read from flash
+ *
+ * @param[in]   log         the log descriptor
+ * @param[out]  stats       the statistics
+ */
+void flashlog_get_stats(flashlog_t *log, flashlog_stats_t *stats);
+
+/**
+ * @brief   Print log statistics
+ *
+ * @param[in]   log         the log descriptor
+ */
+void flashlog_print_stats(flashlog_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASHLOG_H */
+/** @} */
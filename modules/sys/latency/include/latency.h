@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sys_latency Pipeline Latency Histograms
+ * @ingroup     sys
+ * @brief       Per stage latency histograms of the scan to range pipeline
+ *
+ * Each stage of the pipeline, from a scan report to the accounting of a TWR
+ * exchange, is timed with @ref latency_begin and @ref latency_end probes,
+ * or with @ref latency_record when the start of the stage is known. Probes
+ * are timestamped with ZTIMER_USEC when it is used, with ZTIMER_MSEC_BASE
+ * otherwise.
+ *
+ * Durations are accumulated in fixed histograms with power of two
+ * microseconds buckets, so that recording is constant time and allocation
+ * free. The first bucket spans the probe clock resolution, narrower buckets
+ * would only hold rounding. Percentiles are estimated as the upper bound of
+ * the bucket they fall in.
+ *
+ * @{
+ *
+ * @file
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#include "kernel_defines.h"
+#include "timex.h"
+#include "ztimer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Number of histogram buckets
+ *
+ * With s the most significant bit of @ref LATENCY_RESOLUTION_US, bucket i
+ * holds durations in [2^(s+i), 2^(s+i+1)) us, bucket 0 also holds everything
+ * below and the last bucket everything above.
+ */
+#ifndef CONFIG_LATENCY_HIST_BUCKETS
+#define CONFIG_LATENCY_HIST_BUCKETS     (20U)
+#endif
+
+/**
+ * @name    Probe clock
+ * @{
+ */
+#if IS_USED(MODULE_ZTIMER_USEC) || defined(DOXYGEN)
+#define LATENCY_ZTIMER          ZTIMER_USEC             /**< probe clock */
+#define LATENCY_ZTIMER_FREQ     (US_PER_SEC)            /**< probe clock frequency */
+#else
+#define LATENCY_ZTIMER          ZTIMER_MSEC_BASE
+#define LATENCY_ZTIMER_FREQ     (CONFIG_ZTIMER_MSEC_BASE_FREQ)
+#endif
+/**
+ * @brief   Probe clock resolution in us, rounded up
+ */
+#define LATENCY_RESOLUTION_US   ((US_PER_SEC + LATENCY_ZTIMER_FREQ - 1) / \
+                                 LATENCY_ZTIMER_FREQ)
+/** @} */
+
+/**
+ * @brief   Pipeline stages
+ */
+typedef enum {
+    LATENCY_STAGE_SCAN_DISPATCH = 0,    /**< scan report to detection callback */
+    LATENCY_STAGE_SCAN_PROCESS,         /**< slice and EBID processing */
+    LATENCY_STAGE_TWR_SCHEDULE,         /**< TWR listen scheduling */
+    LATENCY_STAGE_TWR_LISTEN_DELAY,     /**< TWR listen start past its deadline */
+    LATENCY_STAGE_TWR_EXCHANGE,         /**< TWR listen start to completion */
+    LATENCY_STAGE_TWR_ACCOUNT,          /**< TWR completion accounting */
+    LATENCY_STAGE_NUMOF,                /**< number of stages */
+} latency_stage_t;
+
+/**
+ * @brief   Latency histogram
+ */
+typedef struct {
+    uint32_t buckets[CONFIG_LATENCY_HIST_BUCKETS];  /**< sample count per bucket */
+    uint32_t count;                                 /**< sample count */
+    uint32_t min;                                   /**< smallest sample in us */
+    uint32_t max;                                   /**< largest sample in us */
+    uint64_t sum;                                   /**< samples sum in us */
+} latency_hist_t;
+
+/**
+ * @brief   Latency histogram summary
+ */
+typedef struct {
+    uint32_t count;     /**< sample count */
+    uint32_t min_us;    /**< smallest sample */
+    uint32_t avg_us;    /**< average */
+    uint32_t p99_us;    /**< 99th percentile upper bound */
+    uint32_t max_us;    /**< largest sample */
+} latency_summary_t;
+
+/**
+ * @brief   Empty a histogram
+ *
+ * @param[out]  hist    the histogram
+ */
+void latency_hist_reset(latency_hist_t *hist);
+
+/**
+ * @brief   Add a sample to a histogram
+ *
+ * @param[inout]    hist    the histogram
+ * @param[in]       us      the sample in us
+ */
+void latency_hist_add(latency_hist_t *hist, uint32_t us);
+
+/**
+ * @brief   Estimate a percentile of a histogram
+ *
+ * @param[in]   hist        the histogram
+ * @param[in]   permille    the percentile in permille, e.g. 990 for p99
+ *
+ * @return  upper bound of the bucket holding the percentile, clamped to the
+ *          histogram extrema, 0 if empty
+ */
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint16_t permille);
+
+/**
+ * @brief   Summarize a histogram
+ *
+ * @param[in]   hist        the histogram
+ * @param[out]  summary     the summary
+ */
+void latency_hist_summary(const latency_hist_t *hist, latency_summary_t *summary);
+
+/**
+ * @brief   Timestamp the start of a stage
+ *
+ * Only the last start is kept, a stage that is not ended is dropped.
+ *
+ * @param[in]   stage   the stage
+ */
+void latency_begin(latency_stage_t stage);
+
+/**
+ * @brief   Timestamp the end of a stage and record its duration
+ *
+ * Nothing is recorded if the stage was not started.
+ *
+ * @param[in]   stage   the stage
+ */
+void latency_end(latency_stage_t stage);
+
+/**
+ * @brief   Record a stage duration given its start
+ *
+ * Nothing is recorded if @p start lies in the future.
+ *
+ * @param[in]   stage   the stage
+ * @param[in]   start   the stage start, as returned by @ref latency_now
+ */
+void latency_record(latency_stage_t stage, uint32_t start);
+
+/**
+ * @brief   Current probe timestamp
+ *
+ * @return  @ref LATENCY_ZTIMER ticks
+ */
+static inline uint32_t latency_now(void)
+{
+    return ztimer_now(LATENCY_ZTIMER);
+}
+
+/**
+ * @brief   Probe timestamp of a deadline
+ *
+ * @param[in]   ticks   the deadline, in ZTIMER_MSEC_BASE ticks from now
+ *
+ * @return  the deadline in @ref LATENCY_ZTIMER ticks, to be passed to
+ *          @ref latency_record
+ */
+static inline uint32_t latency_deadline(uint32_t ticks)
+{
+    return latency_now() + (uint64_t)ticks * LATENCY_ZTIMER_FREQ /
+           CONFIG_ZTIMER_MSEC_BASE_FREQ;
+}
+
+/**
+ * @brief   Get a copy of a stage histogram
+ *
+ * @param[in]   stage   the stage
+ * @param[out]  hist    the histogram copy
+ */
+void latency_get(latency_stage_t stage, latency_hist_t *hist);
+
+/**
+ * @brief   Summarize all stages
+ *
+ * @param[out]  summaries   LATENCY_STAGE_NUMOF summaries
+ */
+void latency_summary_all(latency_summary_t *summaries);
+
+/**
+ * @brief   Empty all stage histograms
+ */
+void latency_reset(void);
+
+/**
+ * @brief   Name of a stage
+ *
+ * @param[in]   stage   the stage
+ *
+ * @return  the stage name
+ */
+const char *latency_stage_name(latency_stage_t stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_H */
+/** @} */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_latency
+ * @{
+ *
+ * @file
+ * @brief       Pipeline latency histograms implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <string.h>
+
+#include "bitarithm.h"
+#include "irq.h"
+#include "timex.h"
+
+#include "latency.h"
+
+static const char *_names[LATENCY_STAGE_NUMOF] = {
+    [LATENCY_STAGE_SCAN_DISPATCH] = "scan_dispatch",
+    [LATENCY_STAGE_SCAN_PROCESS] = "scan_process",
+    [LATENCY_STAGE_TWR_SCHEDULE] = "twr_schedule",
+    [LATENCY_STAGE_TWR_LISTEN_DELAY] = "twr_listen_delay",
+    [LATENCY_STAGE_TWR_EXCHANGE] = "twr_exchange",
+    [LATENCY_STAGE_TWR_ACCOUNT] = "twr_account",
+};
+
+static latency_hist_t _hists[LATENCY_STAGE_NUMOF];
+static uint32_t _begin[LATENCY_STAGE_NUMOF];
+/* bitmap of started stages */
+static uint32_t _started;
+
+/* lowest bucket bit, the first bucket spans the clock resolution */
+static unsigned _shift(void)
+{
+    return bitarithm_msb(LATENCY_RESOLUTION_US);
+}
+
+static unsigned _bucket(uint32_t us)
+{
+    if ((us >> _shift()) == 0) {
+        return 0;
+    }
+    unsigned bucket = bitarithm_msb(us) - _shift();
+
+    return bucket < CONFIG_LATENCY_HIST_BUCKETS ?
+           bucket : CONFIG_LATENCY_HIST_BUCKETS - 1;
+}
+
+static uint32_t _ticks_to_us(uint32_t ticks)
+{
+    return (uint64_t)ticks * US_PER_SEC / LATENCY_ZTIMER_FREQ;
+}
+
+void latency_hist_reset(latency_hist_t *hist)
+{
+    memset(hist, '\0', sizeof(*hist));
+}
+
+void latency_hist_add(latency_hist_t *hist, uint32_t us)
+{
+    if (hist->count == 0 || us < hist->min) {
+        hist->min = us;
+    }
+    if (us > hist->max) {
+        hist->max = us;
+    }
+    hist->buckets[_bucket(us)]++;
+    hist->sum += us;
+    hist->count++;
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint16_t permille)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+    /* rank of the percentile sample, rounded up */
+    uint32_t rank = ((uint64_t)hist->count * permille + 999) / 1000;
+    uint32_t seen = 0;
+    unsigned i = 0;
+
+    for (; i < CONFIG_LATENCY_HIST_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    if (i == CONFIG_LATENCY_HIST_BUCKETS - 1) {
+        return hist->max;
+    }
+    uint32_t bound = (2UL << (i + _shift())) - 1;
+
+    if (bound > hist->max) {
+        return hist->max;
+    }
+    return bound < hist->min ? hist->min : bound;
+}
+
+void latency_hist_summary(const latency_hist_t *hist, latency_summary_t *summary)
+{
+    summary->count = hist->count;
+    summary->min_us = hist->min;
+    summary->max_us = hist->max;
+    summary->avg_us = hist->count ? hist->sum / hist->count : 0;
+    summary->p99_us = latency_hist_percentile(hist, 990);
+}
+
+void latency_begin(latency_stage_t stage)
+{
+    uint32_t now = latency_now();
+    unsigned state = irq_disable();
+
+    _begin[stage] = now;
+    _started |= 1UL << stage;
+    irq_restore(state);
+}
+
+void latency_end(latency_stage_t stage)
+{
+    uint32_t now = latency_now();
+    unsigned state = irq_disable();
+
+    if (_started & (1UL << stage)) {
+        _started &= ~(1UL << stage);
+        latency_hist_add(&_hists[stage], _ticks_to_us(now - _begin[stage]));
+    }
+    irq_restore(state);
+}
+
+void latency_record(latency_stage_t stage, uint32_t start)
+{
+    int32_t elapsed = latency_now() - start;
+
+    if (elapsed < 0) {
+        return;
+    }
+    unsigned state = irq_disable();
+
+    latency_hist_add(&_hists[stage], _ticks_to_us(elapsed));
+    irq_restore(state);
+}
+
+void latency_get(latency_stage_t stage, latency_hist_t *hist)
+{
+    unsigned state = irq_disable();
+
+    *hist = _hists[stage];
+    irq_restore(state);
+}
+
+void latency_summary_all(latency_summary_t *summaries)
+{
+    latency_hist_t hist;
+
+    for (unsigned i = 0; i < LATENCY_STAGE_NUMOF; i++) {
+        latency_get(i, &hist);
+        latency_hist_summary(&hist, &summaries[i]);
+    }
+}
+
+void latency_reset(void)
+{
+    unsigned state = irq_disable();
+
+    memset(_hists, '\0', sizeof(_hists));
+    _started = 0;
+    irq_restore(state);
+}
+
+const char *latency_stage_name(latency_stage_t stage)
+{
+    return stage < LATENCY_STAGE_NUMOF ? _names[stage] : "unknown";
+}
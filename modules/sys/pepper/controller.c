@@ -19,15 +19,20 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pepper.h"
+#include "pepper/pipeline.h"
 
 #include "event.h"
 #include "event/thread.h"
 #include "event/periodic.h"
 #include "event/callback.h"
 
+#include "irq.h"
+#include "thread.h"
 #include "ztimer.h"
 #include "timex.h"
 #include "fmt.h"
@@ -38,6 +43,18 @@
 #include "twr.h"
 #endif
 #include "ebid.h"
+#if IS_USED(MODULE_LATENCY)
+#include "latency.h"
+#endif
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
+#if IS_USED(MODULE_CURRENT_TIME)
+#include "current_time.h"
+#endif
 #include "desire_ble_adv.h"
 #include "desire_ble_scan.h"
 #ifndef LOG_LEVEL
@@ -64,44 +81,17 @@ static uint32_t pepper_sec_since_start(void)
 
     return ztimer_now(ZTIMER_SEC) - _controller.start_time;
 }
-#if IS_USED(MODULE_TWR)
-static bool _twr_should_listen(uint32_t timestamp, ed_t *ed)
-{
-    /* check if no successfull TWR exchange in last CONFIG_PEPPER_TWR_BACK_OFF_S */
-    if ((ed->uwb.seen_last_rx_s + _controller.twr_params.backoff <= timestamp) ||
-        ed->uwb.seen_last_rx_s == 0) {
-        return true;
-    }
-    LOG_INFO("[pepper]: lst skip 0x%04" PRIx16 ", %" PRIu32 "s < %" PRIu16 "s\n",
-             ed_get_short_addr(
-                 ed), timestamp - ed->uwb.seen_last_rx_s, _controller.twr_params.backoff);
-    return false;
-}
 
-static bool _twr_should_request(uint32_t timestamp, ed_t *ed)
+/* absolute time in ms, disciplined when current_time_discipline is used */
+static uint64_t _epoch_now_ms(void)
 {
-    if (ed->ebid.status.status == EBID_HAS_ALL) {
-        /* 1. check if advertisement where received from neighbor in last CONFIG_MIA_TIME_S */
-        if (ed->seen_last_s + CONFIG_MIA_TIME_S > timestamp) {
-            /* 1.1 check if no successfull TWR exchange in last CONFIG_PEPPER_TWR_BACK_OFF_S */
-            if ((ed->uwb.seen_last_s + _controller.twr_params.backoff <= timestamp + 1) ||
-                ed->uwb.seen_last_s == 0) {
-                return true;
-            }
-            else {
-                LOG_INFO(
-                    "[pepper]: req skip 0x%04" PRIx16 ": %" PRIu32 "s < %" PRIu16 "s\n",
-                    ed_get_short_addr(
-                        ed), timestamp + 1 - ed->uwb.seen_last_s, _controller.twr_params.backoff);
-            }
-        }
-        else {
-            LOG_WARNING("[pepper]: req skip encounter, missing over BLE\n");
-        }
-    }
-    return false;
+#if IS_USED(MODULE_CURRENT_TIME)
+    return current_time_get_ms();
+#else
+    return (uint64_t)ztimer_now(ZTIMER_EPOCH) * MS_PER_SEC;
+#endif
 }
-
+#if IS_USED(MODULE_TWR)
 static uint16_t _get_twr_offset(ebid_t *ebid, uint16_t seed)
 {
     /* last two bytes of the EBID */
@@ -109,8 +99,8 @@ static uint16_t _get_twr_offset(ebid_t *ebid, uint16_t seed)
 
     /* add a minimum offset and a random EBID based one */
     offset_ms = (offset_ms % CONFIG_BLE_ADV_ITVL_MS) + CONFIG_TWR_MIN_OFFSET_MS;
-    /* TODO: add some RIOT functions for this */
-    return os_cputime_usecs_to_ticks(offset_ms * US_PER_MS);
+    /* in ZTIMER_MSEC_BASE ticks, as the TWR events are scheduled on it */
+    return (uint64_t)offset_ms * CONFIG_ZTIMER_MSEC_BASE_FREQ / MS_PER_SEC;
 }
 
 static uint16_t _get_twr_rx_offset(ebid_t *ebid, uint16_t seed)
@@ -138,7 +128,8 @@ static void _twr_cb(twr_event_data_t *data, twr_status_t status)
 
     (void)ed;
 
-    if (LOG_LEVEL == LOG_DEBUG || IS_ACTIVE(CONFIG_PEPPER_LOG_UWB)) {
+    if (LOG_LEVEL == LOG_DEBUG || IS_ACTIVE(CONFIG_PEPPER_LOG_UWB) ||
+        IS_USED(MODULE_PEPPER_TELEMETRY)) {
         ed_uwb_data_t uwb_data = {
 #if IS_USED(MODULE_ED_UWB_RSSI)
             .rssi = data->rssi,
@@ -151,6 +142,12 @@ static void _twr_cb(twr_event_data_t *data, twr_status_t status)
             .cid = ed->cid,
         };
 
+        if (IS_USED(MODULE_PEPPER_TELEMETRY)) {
+            pepper_telemetry_uwb(&uwb_data);
+        }
+        if (LOG_LEVEL != LOG_DEBUG && !IS_ACTIVE(CONFIG_PEPPER_LOG_UWB)) {
+            return;
+        }
 #if IS_USED(MODULE_PEPPER_SRV_STORAGE)
         pepper_srv_uwb_data_submit(&uwb_data);
 #else
@@ -225,8 +222,10 @@ static void _scan_cb(uint32_t ticks, const ble_addr_t *addr, int8_t rssi,
     (void)ticks;
     (void)rssi;
 
-    uint32_t cid;
-    uint8_t part;
+#if IS_USED(MODULE_LATENCY)
+    latency_end(LATENCY_STAGE_SCAN_DISPATCH);
+    latency_begin(LATENCY_STAGE_SCAN_PROCESS);
+#endif
     /* timestamp relative to beginning of epoch */
     uint32_t timestamp = pepper_sec_since_start();
     /* seed for offset */
@@ -234,51 +233,67 @@ static void _scan_cb(uint32_t ticks, const ble_addr_t *addr, int8_t rssi,
     uint16_t seed = adv_payload->data.reserved.seed;
 #endif
 
-    /* 1. process the incoming slice */
-    decode_sid_cid(adv_payload->data.sid_cid, &part, &cid);
-    ed_t *ed = ed_list_process_slice(&_controller.ed_list, cid, timestamp,
-                                     adv_payload->data.ebid_slice, part);
+    /* 1. process the incoming slice and rssi */
+    ed_t *ed = pepper_pipeline_scan(&_controller.ed_list, timestamp, rssi,
+                                    adv_payload);
 
     if (ed == NULL) {
         LOG_ERROR("return NULL\n");
         return;
     }
-    /* 2. update last time this encounter was seen, relative to epoch start */
-    ed->seen_last_s = timestamp;
+#if IS_USED(MODULE_LATENCY)
+    latency_end(LATENCY_STAGE_SCAN_PROCESS);
+#endif
 
-    /* 3. if the EBID was reconstructed then either log BLE information (rssi)
-          and/or scheduler a TWR exchange */
+    /* 2. if the EBID was reconstructed then schedule a TWR exchange */
     if (ed->ebid.status.status == EBID_HAS_ALL) {
-#if IS_USED(MODULE_ED_BLE) || IS_USED(MODULE_ED_BLE_WIN)
-        /* 3.1 log rssi data */
-        ed_list_process_scan_data(&_controller.ed_list, cid, timestamp, rssi);
-#endif
 #if IS_USED(MODULE_TWR)
-        /* 3.2 check if should listen */
-        if (_twr_should_listen(timestamp, ed)) {
+        /* 2.1 check if should listen */
+        if (pepper_pipeline_twr_should_listen(ed, timestamp,
+                                              _controller.twr_params.backoff)) {
 #if IS_USED(MODULE_ED_UWB_STATS)
             ed->uwb.stats.lst.scheduled++;
 #endif
             /* compensate for delay in scheduling listen */
-            /* 3.3 schedule a twr listen event at an EBID based offset */
+            /* 2.2 schedule a twr listen event at an EBID based offset */
             uint16_t offset = _get_twr_rx_offset(&_controller.ebid, seed);
+#if IS_USED(MODULE_LATENCY)
+            latency_begin(LATENCY_STAGE_TWR_SCHEDULE);
+#endif
             if (twr_schedule_listen_managed(ed_get_short_addr(ed), offset)) {
 #if IS_USED(MODULE_ED_UWB_STATS)
                 ed->uwb.stats.lst.aborted++;
 #endif
             }
+#if IS_USED(MODULE_LATENCY)
+            latency_end(LATENCY_STAGE_TWR_SCHEDULE);
+#endif
             LOG_DEBUG("[pepper]: 0x04%" PRIx16 " rx offset %" PRIu16 "\n", ed_get_short_addr(
                           ed), offset);
+#if IS_USED(MODULE_TWR_PEER)
+            LOG_DEBUG("[pepper]: 0x04%" PRIx16 " predicted request at %" PRId32 "us\n",
+                      ed_get_short_addr(ed),
+                      twr_peer_predict_us(ed_get_short_addr(ed),
+                                          (uint64_t)offset * US_PER_SEC /
+                                          CONFIG_ZTIMER_MSEC_BASE_FREQ));
+#endif
         }
 #endif
     }
 #if IS_USED(MODULE_ED_BLE_COMMON)
-    if (LOG_LEVEL == LOG_DEBUG || IS_ACTIVE(CONFIG_PEPPER_LOG_BLE)) {
+    if (LOG_LEVEL == LOG_DEBUG || IS_ACTIVE(CONFIG_PEPPER_LOG_BLE) ||
+        IS_USED(MODULE_PEPPER_TELEMETRY)) {
         ed_ble_data_t ble_data = {
             .rssi = rssi,
             .time = ztimer_now(ZTIMER_MSEC),
-            .cid = cid,
+            .cid = ed->cid,
         };
+        if (IS_USED(MODULE_PEPPER_TELEMETRY)) {
+            pepper_telemetry_ble(&ble_data);
+        }
+        if (LOG_LEVEL != LOG_DEBUG && !IS_ACTIVE(CONFIG_PEPPER_LOG_BLE)) {
+            return;
+        }
 #if IS_USED(MODULE_PEPPER_SRV_STORAGE)
         pepper_srv_ble_data_submit(&ble_data);
 #else
@@ -322,7 +337,8 @@ static void _adv_cb(uint32_t advs, void *arg)
     do {
         next = (ed_t *)next->list_node.next;
         /* 1. check if it should send a request */
-        if (_twr_should_request(timestamp, next)) {
+        if (pepper_pipeline_twr_should_request(next, timestamp,
+                                               _controller.twr_params.backoff)) {
             /* compensate for delay in scheduling requests */
             uint16_t delay = ztimer_now(ZTIMER_MSEC_BASE) - now_ticks;
             /* 2. schedule the request at the EBID based offset */
@@ -357,6 +373,10 @@ void pepper_core_enable(ebid_t *ebid, ble_scan_params_t *scan_params,
     LOG_DEBUG("[pepper]: enable TWR with addr 0x%" PRIx16 "ms\n", short_addr);
     twr_enable();
     twr_set_short_addr(short_addr);
+#if IS_USED(MODULE_TWR_PEER)
+    /* neighbours change their short addr every epoch as well */
+    twr_peer_reset();
+#endif
 #endif
     LOG_DEBUG("[pepper]: start scanning for %" PRIu32 "ms\n", duration_ms);
     /* start scanning */
@@ -379,10 +399,13 @@ static void _epoch_start(event_t *event)
     (void)event;
     /* timestamp the start of the epoch in relative units*/
     _controller.start_time = ztimer_now(ZTIMER_SEC);
-    /* only use the ZTIMER_EPOCH timestamps for absolute and not for relative
+    /* only use the absolute time for timestamps and not for relative
        differences */
-    LOG_INFO("[pepper]: new uwb_epoch t=%" PRIu32 "\n", ztimer_now(ZTIMER_EPOCH));
-    epoch_init(&_controller.data, ztimer_now(ZTIMER_EPOCH), &_controller.keys);
+    uint32_t now = _epoch_now_ms() / MS_PER_SEC;
+    LOG_INFO("[pepper]: new uwb_epoch t=%" PRIu32 "\n", now);
+    epoch_init(&_controller.data, now, &_controller.keys);
+    /* the epoch duration might have been updated during the last epoch */
+    ed_list_set_min_exposure(&_controller.ed_list, _controller.epoch.duration_s / 3);
     /* update local ebid */
     ebid_init(&_controller.ebid);
     LOG_INFO("[pepper]: new ebid generation\n");
@@ -402,7 +425,12 @@ static void _epoch_start(event_t *event)
 }
 
 static event_periodic_t _end_epoch;
+/* the epoch duration was updated, re-arm the end of epoch events at the
+   next epoch boundary */
+static bool _end_epoch_rearm;
 static event_t _start_epoch = { .handler = _epoch_start };
+static void _align_end_of_epoch(uint32_t epoch_duration_s, uint32_t count,
+                                bool boundary);
 static void _epoch_end(void *arg)
 {
     (void)arg;
@@ -411,15 +439,46 @@ static void _epoch_end(void *arg)
     /* update controller status */
     mutex_lock(&_controller.lock);
     LOG_INFO("[pepper]: end of uwb_epoch\n");
-    if (!ztimer_is_set(ZTIMER_EPOCH, &_end_epoch.timer.timer) && \
-        _controller.status != PEPPER_PAUSED) {
-        pepper_controller_set_status(PEPPER_STOPPED);
+    if (!ztimer_is_set(ZTIMER_MSEC, &_end_epoch.timer.timer)) {
+        if (_controller.status != PEPPER_PAUSED) {
+            pepper_controller_set_status(PEPPER_STOPPED);
+        }
     }
+    else if (_controller.align) {
+        /* ZTIMER_MSEC drifts from the disciplined time, re-align every epoch */
+        _align_end_of_epoch(_controller.epoch.duration_s, _end_epoch.count, true);
+    }
+    else if (_end_epoch_rearm) {
+        /* the updated epoch duration applies from this boundary on */
+        event_periodic_stop(&_end_epoch);
+        event_periodic_set_count(&_end_epoch, _end_epoch.count);
+        event_periodic_start(&_end_epoch, _controller.epoch.duration_s * MS_PER_SEC);
+    }
+    _end_epoch_rearm = false;
     mutex_unlock(&_controller.lock);
     /* process uwb_epoch data */
     LOG_INFO("[pepper]: process all uwb_epoch data\n");
     ed_list_finish(&_controller.ed_list);
     epoch_finish(&_controller.data, &_controller.ed_list);
+#if IS_USED(MODULE_LATENCY)
+    /* ship this epoch pipeline latencies and start over */
+    latency_summary_all(_controller.data.latency);
+    latency_reset();
+#endif
+#if IS_USED(MODULE_WATERMARK)
+    /* ship this epoch pool and stack usage, restart the pool watermarks */
+    pepper_watermark_pools(_controller.data.pools);
+    pepper_watermark_stacks(_controller.data.stacks, CONFIG_WATERMARK_STACKS_NUMOF);
+    pepper_watermark_reset();
+#endif
+#if IS_USED(MODULE_ENERGY)
+    /* ship this epoch radio time in state and start over */
+    _controller.data.energy_uj = energy_summary_all(_controller.data.energy);
+    energy_reset();
+#endif
+    if (IS_USED(MODULE_PEPPER_TELEMETRY)) {
+        pepper_telemetry_epoch(&_controller.data);
+    }
     /* post serializing/offloading event */
 #if IS_USED(MODULE_PEPPER_SRV)
     pepper_srv_data_submit(&_controller.data);
@@ -434,23 +493,34 @@ static void _epoch_end(void *arg)
 }
 static event_callback_t _end_of_epoch = EVENT_CALLBACK_INIT(_epoch_end, NULL);
 
-static void _align_end_of_epoch(uint32_t epoch_duration_s)
+static void _align_end_of_epoch(uint32_t epoch_duration_s, uint32_t count,
+                                bool boundary)
 {
-    /* ZTIMER_EPOCH is only used for absolute timestamps and aligning the end
+    /* the absolute time is only used for timestamps and aligning the end
        of epoch events */
-    uint32_t timeout = epoch_duration_s - (ztimer_now(ZTIMER_EPOCH) % epoch_duration_s);
+    uint32_t duration_ms = epoch_duration_s * MS_PER_SEC;
+    uint32_t timeout = duration_ms - (_epoch_now_ms() % duration_ms);
 
-    /* schedule end of epoch event */
-    event_periodic_set_count(&_end_epoch, _controller.epoch.iterations);
+    /* at an epoch boundary the local clock may run slightly ahead, do not
+       end the epoch that was just started right away */
+    if (boundary && timeout < duration_ms / 2) {
+        timeout += duration_ms;
+    }
+    /* schedule end of epoch event, every end of epoch re-aligns the next
+       one so the periodic interval is never used as is */
+    event_periodic_stop(&_end_epoch);
+    event_periodic_set_count(&_end_epoch, count);
     event_periodic_start(&_end_epoch, timeout);
-    /* fix subsequent timeouts */
-    _end_epoch.timer.interval = epoch_duration_s;
+    _controller.align = true;
     /* setup end of uwb_epoch timeout event */
-    LOG_INFO("[pepper]: align first epoch end in %" PRIu32 "s\n", timeout);
+    LOG_INFO("[pepper]: align epoch end in %" PRIu32 "ms\n", timeout);
 }
 
 void pepper_init(void)
 {
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_PEPPER_INIT);
+#endif
     /* set initial status to STOPPED */
     pepper_controller_set_status(PEPPER_STOPPED);
     if (IS_USED(MODULE_PEPPER_UTIL)) {
@@ -467,12 +537,25 @@ void pepper_init(void)
         pepper_current_time_init();
     }
     /* init ble advertiser */
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_BLE_ADV_INIT);
+#endif
     desire_ble_adv_init(CONFIG_UWB_BLE_EVENT_PRIO);
     desire_ble_adv_set_cb(_adv_cb);
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_BLE_ADV_INIT);
+    boot_profile_begin(BOOT_PHASE_BLE_SCAN_INIT);
+#endif
     /* init ble scanner and current_time */
     desire_ble_scan_init(_scan_cb);
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_BLE_SCAN_INIT);
+#endif
     /* init twr */
 #if IS_USED(MODULE_TWR)
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_TWR_INIT);
+#endif
     twr_event_mem_manager_init(&_controller.twr_mem);
     twr_managed_set_manager(&_controller.twr_mem);
     twr_init(CONFIG_UWB_BLE_EVENT_PRIO);
@@ -481,12 +564,20 @@ void pepper_init(void)
     twr_set_busy_cb(_twr_busy_cb);
     twr_set_rx_timeout_cb(_twr_timeout_cb);
     twr_set_rx_cb(_twr_rx_cb);
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_TWR_INIT);
+#endif
 #endif
     /* init ed management */
     ed_memory_manager_init(&_controller.ed_mem);
     ed_list_init(&_controller.ed_list, &_controller.ed_mem, &_controller.ebid);
+#if IS_USED(MODULE_ED_UWB_BPF)
+    /* bootstrap the contact filters, deferred to the first epoch end with
+       CONFIG_ED_UWB_BPF_LAZY_INIT */
+    ed_uwb_bpf_init();
+#endif
     /* setup end of uwb_epoch timeout event */
-    event_periodic_init(&_end_epoch, ZTIMER_EPOCH, CONFIG_PEPPER_EVENT_PRIO,
+    event_periodic_init(&_end_epoch, ZTIMER_MSEC, CONFIG_PEPPER_EVENT_PRIO,
                         &_end_of_epoch.super);
     /* set static cid if requested */
     if (IS_ACTIVE(CONFIG_BLE_ADV_STATIC_CID)) {
@@ -502,6 +593,9 @@ void pepper_init(void)
         }
         desire_ble_adv_set_cid(cid);
     }
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_PEPPER_INIT);
+#endif
 }
 
 void pepper_start(pepper_start_params_t *params)
@@ -527,12 +621,14 @@ void pepper_start(pepper_start_params_t *params)
     /* */
     /* align epoch start */
     if (params->align) {
-        _align_end_of_epoch(_controller.epoch.duration_s);
+        _align_end_of_epoch(_controller.epoch.duration_s, _controller.epoch.iterations,
+                            false);
     }
     else {
         /* schedule end of epoch event */
+        _controller.align = false;
         event_periodic_set_count(&_end_epoch, _controller.epoch.iterations);
-        event_periodic_start(&_end_epoch, _controller.epoch.duration_s);
+        event_periodic_start(&_end_epoch, _controller.epoch.duration_s * MS_PER_SEC);
     }
     mutex_unlock(&_controller.lock);
     /* bootstrap first epoch */
@@ -543,14 +639,17 @@ void pepper_resume(bool align)
 {
     mutex_lock(&_controller.lock);
     if (pepper_is_active()) {
+        /* end of epochs only re-align if resumed aligned */
+        _controller.align = align;
         /* align epoch start */
         if (align) {
-            _align_end_of_epoch(_controller.epoch.duration_s);
+            _align_end_of_epoch(_controller.epoch.duration_s, _controller.epoch.iterations,
+                                false);
         }
         else {
             /* schedule end of epoch event with remaining counts */
             event_periodic_set_count(&_end_epoch, _end_epoch.count);
-            event_periodic_start(&_end_epoch, _controller.epoch.duration_s);
+            event_periodic_start(&_end_epoch, _controller.epoch.duration_s * MS_PER_SEC);
             /* re-enable BLE and UWB */
             pepper_core_enable(&_controller.ebid, &_controller.scan, &_controller.adv,
                                _controller.epoch.duration_s * MS_PER_SEC);
@@ -583,6 +682,74 @@ void pepper_pause(void)
     mutex_unlock(&_controller.lock);
 }
 
+static bool _params_valid(const pepper_start_params_t *params)
+{
+    /* encounter times are kept in s since the epoch start on 16 bits */
+    return params->epoch_duration_s != 0 && params->epoch_duration_s <= UINT16_MAX &&
+           params->adv_itvl_ms != 0 &&
+           params->adv_itvl_ms <= params->epoch_duration_s * MS_PER_SEC &&
+           params->advs_per_slice != 0 && params->advs_per_slice <= INT32_MAX &&
+           params->scan_win_ms != 0 && params->scan_win_ms <= params->scan_itvl_ms;
+}
+
+int pepper_update_params(const pepper_start_params_t *params)
+{
+    if (!_params_valid(params)) {
+        return -EINVAL;
+    }
+    mutex_lock(&_controller.lock);
+    if (!pepper_is_active()) {
+        mutex_unlock(&_controller.lock);
+        return -EPERM;
+    }
+    /* what is left of the current epoch, it keeps its duration */
+    uint32_t duration_ms = _controller.epoch.duration_s * MS_PER_SEC;
+    uint32_t elapsed_ms = pepper_sec_since_start() * MS_PER_SEC;
+    uint32_t remaining_ms = elapsed_ms < duration_ms ? duration_ms - elapsed_ms : 0;
+    bool scan_changed = _controller.scan.itvl_ms != params->scan_itvl_ms ||
+                        _controller.scan.win_ms != params->scan_win_ms;
+
+    /* set advertisement and scan parameters for the next epochs */
+    _controller.adv.itvl_ms = params->adv_itvl_ms;
+    _controller.adv.advs_slice = params->advs_per_slice;
+    _controller.adv.advs_max = (params->epoch_duration_s * MS_PER_SEC) / params->adv_itvl_ms;
+    _controller.scan.itvl_ms = params->scan_itvl_ms;
+    _controller.scan.win_ms = params->scan_win_ms;
+    if (_controller.status == PEPPER_RUNNING) {
+        /* the EBID, cid and encounters are kept, only the timing changes */
+        adv_params_t adv = {
+            .itvl_ms = params->adv_itvl_ms,
+            .advs_max = remaining_ms / params->adv_itvl_ms,
+            .advs_slice = params->advs_per_slice,
+        };
+        desire_ble_adv_update(&adv);
+        if (scan_changed) {
+            desire_ble_scan_stop();
+            desire_ble_scan_start(&_controller.scan, remaining_ms);
+        }
+    }
+    /* the end of epoch timer is already set, it is re-armed with the new
+       duration at the end of the current epoch */
+    _end_epoch_rearm = _controller.epoch.duration_s != params->epoch_duration_s;
+    _controller.epoch.duration_s = params->epoch_duration_s;
+    LOG_INFO("[pepper]: params updated, %" PRIu32 "ms left in epoch\n", remaining_ms);
+    mutex_unlock(&_controller.lock);
+    return 0;
+}
+
+void pepper_get_params(pepper_start_params_t *params)
+{
+    mutex_lock(&_controller.lock);
+    memset(params, '\0', sizeof(*params));
+    params->epoch_duration_s = _controller.epoch.duration_s;
+    params->epoch_iterations = _controller.epoch.iterations;
+    params->advs_per_slice = _controller.adv.advs_slice;
+    params->adv_itvl_ms = _controller.adv.itvl_ms;
+    params->scan_itvl_ms = _controller.scan.itvl_ms;
+    params->scan_win_ms = _controller.scan.win_ms;
+    mutex_unlock(&_controller.lock);
+}
+
 static void _set_status_led(uint8_t state)
 {
     if (IS_USED(MODULE_PEPPER_STATUS_LED)) {
@@ -668,6 +835,51 @@ void pepper_twr_set_backoff(uint16_t backoff)
 #endif
 }
 
+#if IS_USED(MODULE_WATERMARK)
+void pepper_watermark_pools(watermark_pool_t *pools)
+{
+    memset(pools, '\0', WATERMARK_POOL_NUMOF * sizeof(watermark_pool_t));
+    /* pools are used from the BLE, UWB and event threads */
+    unsigned state = irq_disable();
+
+    pools[WATERMARK_POOL_ED] = _controller.ed_mem.watermark;
+#if IS_USED(MODULE_TWR)
+    pools[WATERMARK_POOL_TWR] = _controller.twr_mem.watermark;
+#endif
+    irq_restore(state);
+}
+
+static kernel_pid_t _queue_pid(event_queue_t *queue)
+{
+    /* the waiter is set once the event thread claimed the queue */
+    return queue->waiter ? thread_getpid_of(queue->waiter) : KERNEL_PID_UNDEF;
+}
+
+unsigned pepper_watermark_stacks(watermark_stack_t *stacks, unsigned numof)
+{
+    /* the event threads run the whole pipeline, always report them */
+    const kernel_pid_t pids[] = {
+        _queue_pid(CONFIG_PEPPER_HIGH_EVENT_PRIO),
+        _queue_pid(CONFIG_PEPPER_EVENT_PRIO),
+        _queue_pid(CONFIG_UWB_BLE_EVENT_PRIO),
+        _queue_pid(CONFIG_PEPPER_LOW_EVENT_PRIO),
+    };
+
+    return watermark_stacks(stacks, numof, pids, ARRAY_SIZE(pids));
+}
+
+void pepper_watermark_reset(void)
+{
+    unsigned state = irq_disable();
+
+    watermark_pool_reset(&_controller.ed_mem.watermark);
+#if IS_USED(MODULE_TWR)
+    watermark_pool_reset(&_controller.twr_mem.watermark);
+#endif
+    irq_restore(state);
+}
+#endif
+
 controller_t *pepper_get_controller(void)
 {
     return &_controller;
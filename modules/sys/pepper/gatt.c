@@ -66,6 +66,11 @@ static const ble_uuid128_t gatt_svr_chr_pepper_restart_uuid
     = BLE_UUID128_INIT(0xd3, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
                        0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
 
+/* UUID = ce2ae1d5-b067-c348-985a-ba2f2b0ac8d4 */
+static const ble_uuid128_t gatt_svr_chr_pepper_update_uuid
+    = BLE_UUID128_INIT(0xd4, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
+                       0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
+
 /* service handlers */
 static int _pepper_cfg_handler(uint16_t conn_handle, uint16_t attr_handle,
                                struct ble_gatt_access_ctxt *ctxt, void *arg);
@@ -77,6 +82,8 @@ static int _pepper_stop_handler(uint16_t conn_handle, uint16_t attr_handle,
                                 struct ble_gatt_access_ctxt *ctxt, void *arg);
 static int _pepper_restart_handler(uint16_t conn_handle, uint16_t attr_handle,
                                    struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int _pepper_update_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                  struct ble_gatt_access_ctxt *ctxt, void *arg);
 #if IS_USED(MODULE_PEPPER_CURRENT_TIME)
 static int _pepper_current_time_handler(uint16_t conn_handle, uint16_t attr_handle,
                                         struct ble_gatt_access_ctxt *ctxt, void *arg);
@@ -112,6 +119,12 @@ XFA_CONST(gatt_svr_svcs, 0) struct ble_gatt_svc_def _gatt_svr_pepper = {
             .access_cb = _pepper_restart_handler,
             .flags =  BLE_GATT_CHR_F_WRITE,
         },
+        {
+            /* Characteristic: Read/Update PEPPER parameters */
+            .uuid = (ble_uuid_t *)&gatt_svr_chr_pepper_update_uuid.u,
+            .access_cb = _pepper_update_handler,
+            .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+        },
         {
             0,         /* No more characteristics in this service */
         },
@@ -370,6 +383,57 @@ static int _pepper_restart_handler(uint16_t conn_handle, uint16_t attr_handle,
     return rc;
 }
 
+static int _pepper_update_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                  struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+    int rc = 0;
+    pepper_start_params_t params;
+
+    switch (ctxt->op) {
+
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        LOG_INFO("[pepper] gatt: update read params\n");
+        pepper_get_params(&params);
+        rc = os_mbuf_append(ctxt->om, &params, sizeof(params));
+        break;
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+        LOG_INFO("[pepper] gatt: update ...\n");
+        uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
+        if (om_len != sizeof(pepper_start_params_t)) {
+            LOG_INFO("\terror, invalid parameters\n");
+            rc = 1;
+        }
+        else {
+            rc = ble_hs_mbuf_to_flat(ctxt->om, &params, sizeof(params), &om_len);
+            LOG_INFO("\tepoch_duration: %" PRIu32 " [s]\n", params.epoch_duration_s);
+            LOG_INFO("\tadv_per_slice: %" PRIu32 "\n", params.advs_per_slice);
+            LOG_INFO("\tadv_itvl: %" PRIu32 " [ms]\n", params.adv_itvl_ms);
+            LOG_INFO("\tscan_itvl: %" PRIu32 " [ms]\n", params.scan_itvl_ms);
+            LOG_INFO("\tscan_win: %" PRIu32 " [ms]\n", params.scan_win_ms);
+            if (rc == 0 && pepper_update_params(&params)) {
+                /* stopped or invalid, nothing was applied */
+                LOG_INFO("\terror, not updated\n");
+                rc = 1;
+            }
+        }
+        break;
+    case BLE_GATT_ACCESS_OP_READ_DSC:
+        LOG_DEBUG("[pepper] gatt: update read from descriptor\n");
+        break;
+    case BLE_GATT_ACCESS_OP_WRITE_DSC:
+        LOG_DEBUG("[pepper] gatt: update write to descriptor\n");
+        break;
+    default:
+        LOG_WARNING("[pepper] gatt: update unhandled operation!\n");
+        rc = 1;
+        break;
+    }
+    return rc;
+}
+
 #if IS_USED(MODULE_PEPPER_CURRENT_TIME)
 static int _pepper_current_time_handler(uint16_t conn_handle, uint16_t attr_handle,
                                         struct ble_gatt_access_ctxt *ctxt, void *arg)
@@ -434,6 +498,13 @@ void pepper_gatt_init(void)
     /* reload the GATT server to link our added services */
     ble_gatts_start();
 
+    if (IS_USED(MODULE_PEPPER_GATT_LOG)) {
+        pepper_gatt_log_init();
+    }
+    if (IS_USED(MODULE_PEPPER_TELEMETRY)) {
+        pepper_telemetry_init();
+    }
+
     /* start to advertise this node with its name */
     nimble_autoadv_add_field(BLE_GAP_AD_NAME, uid, strlen(uid));
     nimble_autoadv_start(NULL);
@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     pepper
+ * @{
+ *
+ * @file
+ * @brief       Bulk readout of the SD card log files over GATT
+ *
+ * The log service has two characteristics:
+ *
+ * - control (read/write): reading lists the files of @ref CONFIG_PEPPER_LOGS_DIR
+ *   in index order, each as its size (uint32_t, little endian) followed by
+ *   its NUL terminated name. Writing a uint16_t file index, optionally
+ *   followed by a uint32_t byte offset (both little endian), (re)starts
+ *   streaming from that point of that file and on through the following
+ *   files, an empty write stops streaming.
+ * - data (notify): a byte stream of frames, each a @ref pepper_gatt_log_frame_t
+ *   followed by a chunk of a file. Frames are split over notifications as
+ *   large as the negotiated ATT MTU allows. The end of the logs is marked by
+ *   an empty frame holding the index and size of the last file.
+ *
+ * A readout is resumed by writing the file index and the offset following
+ * the last complete chunk received, resuming from the end frame only streams
+ * the data logged since.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "byteorder.h"
+#include "event.h"
+#include "irq.h"
+#include "vfs.h"
+#include "xfa.h"
+
+#include "host/ble_gap.h"
+#include "host/ble_gatt.h"
+#include "host/ble_hs.h"
+
+#include "pepper.h"
+#include "storage.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_INFO
+#endif
+#include "log.h"
+
+/* ATT notification header: opcode + attribute handle */
+#define ATT_NOTIFY_HDR_LEN      (3U)
+/* path of a log file */
+#define LOG_PATH_MAX            (sizeof(CONFIG_PEPPER_LOGS_DIR) + VFS_NAME_MAX)
+
+#if IS_USED(MODULE_STORAGE_FLASHLOG)
+#error "pepper_gatt_log streams the SD card log files, storage_flashlog is not supported"
+#endif
+
+/* UUID = ce2ae1d5-b067-c348-985a-ba2f2b0ac8e0 */
+static const ble_uuid128_t gatt_svr_svc_pepper_log_uuid
+    = BLE_UUID128_INIT(0xe0, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
+                       0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
+
+/* UUID = ce2ae1d5-b067-c348-985a-ba2f2b0ac8e1 */
+static const ble_uuid128_t gatt_svr_chr_pepper_log_ctrl_uuid
+    = BLE_UUID128_INIT(0xe1, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
+                       0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
+
+/* UUID = ce2ae1d5-b067-c348-985a-ba2f2b0ac8e2 */
+static const ble_uuid128_t gatt_svr_chr_pepper_log_data_uuid
+    = BLE_UUID128_INIT(0xe2, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
+                       0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
+
+/* start/stop requests come from the NimBLE host thread, they are applied
+   by the readout event so that only the event thread touches the stream */
+typedef struct {
+    event_t event;
+    volatile bool start_req;
+    volatile bool stop_req;
+    volatile uint16_t req_conn_handle;
+    volatile uint16_t req_file;
+    volatile uint32_t req_offset;
+    volatile unsigned in_flight;    /* notifications not yet acknowledged */
+    uint16_t conn_handle;
+    bool streaming;
+    bool done;                      /* end of logs frame queued */
+    bool loaded;                    /* path holds the streamed file */
+    uint16_t file;                  /* index of the streamed file */
+    uint32_t offset;                /* offset of its next chunk */
+    char path[LOG_PATH_MAX];
+    /* current frame, header and chunk, and bytes of it already sent */
+    size_t frame_len;
+    size_t frame_sent;
+    uint8_t frame[sizeof(pepper_gatt_log_frame_t) + CONFIG_PEPPER_GATT_LOG_CHUNK_SIZE];
+} _readout_t;
+
+static int _pepper_log_ctrl_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                    struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int _pepper_log_data_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                    struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static uint16_t _data_val_handle;
+static struct ble_gap_event_listener _gap_listener;
+static _readout_t _readout;
+
+XFA_USE_CONST(struct ble_gatt_svc_def, gatt_svr_svcs);
+XFA_CONST(gatt_svr_svcs, 0) struct ble_gatt_svc_def _gatt_svr_pepper_log = {
+    /* PEPPER Log Readout Service */
+    .type = BLE_GATT_SVC_TYPE_PRIMARY,
+    .uuid = (ble_uuid_t *)&gatt_svr_svc_pepper_log_uuid.u,
+    .characteristics = (struct ble_gatt_chr_def[]) {
+        {
+            /* Characteristic: log files, start/stop readout */
+            .uuid = (ble_uuid_t *)&gatt_svr_chr_pepper_log_ctrl_uuid.u,
+            .access_cb = _pepper_log_ctrl_handler,
+            .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+        },
+        {
+            /* Characteristic: log files stream */
+            .uuid = (ble_uuid_t *)&gatt_svr_chr_pepper_log_data_uuid.u,
+            .access_cb = _pepper_log_data_handler,
+            .val_handle = &_data_val_handle,
+            .flags = BLE_GATT_CHR_F_NOTIFY,
+        },
+        {
+            0,         /* No more characteristics in this service */
+        },
+    }
+};
+
+static void _frame_set(uint16_t file, uint32_t offset, size_t len)
+{
+    pepper_gatt_log_frame_t *frame = (pepper_gatt_log_frame_t *)_readout.frame;
+
+    frame->offset = htolel(offset);
+    frame->file = htoles(file);
+    frame->len = htoles(len);
+    _readout.frame_len = sizeof(*frame) + len;
+    _readout.frame_sent = 0;
+}
+
+/* looks up the path of a file by its index */
+static bool _file_load(uint16_t file)
+{
+    char name[VFS_NAME_MAX + 1];
+
+    if (storage_dir_entry(CONFIG_PEPPER_LOGS_DIR, file, name, sizeof(name), NULL)) {
+        return false;
+    }
+    snprintf(_readout.path, sizeof(_readout.path), "%s%s", CONFIG_PEPPER_LOGS_DIR, name);
+    return true;
+}
+
+/* loads the next chunk to stream, or the end of logs frame */
+static void _frame_next(void)
+{
+    uint8_t *chunk = &_readout.frame[sizeof(pepper_gatt_log_frame_t)];
+
+    while (_readout.loaded) {
+        ssize_t len = storage_read(_readout.path, _readout.offset, chunk,
+                                   CONFIG_PEPPER_GATT_LOG_CHUNK_SIZE);
+        if (len > 0) {
+            _frame_set(_readout.file, _readout.offset, len);
+            _readout.offset += len;
+            return;
+        }
+        if (len < 0) {
+            LOG_WARNING("[pepper] gatt_log: failed to read %s (%d)\n",
+                        _readout.path, (int)len);
+            break;
+        }
+        /* end of file, stay on it if it is the last one */
+        if (!_file_load(_readout.file + 1)) {
+            break;
+        }
+        _readout.file++;
+        _readout.offset = 0;
+    }
+    /* empty frame at the end of the last file, resuming from it later
+       only streams newer data */
+    _frame_set(_readout.file, _readout.offset, 0);
+    _readout.done = true;
+}
+
+static void _stop(void)
+{
+    _readout.streaming = false;
+    _readout.done = false;
+    _readout.frame_len = 0;
+    _readout.frame_sent = 0;
+}
+
+static void _start(uint16_t conn_handle, uint16_t file, uint32_t offset);
+
+static void _pump(event_t *event)
+{
+    (void)event;
+
+    unsigned state = irq_disable();
+    bool stop = _readout.stop_req;
+    bool start = _readout.start_req;
+    uint16_t conn_handle = _readout.req_conn_handle;
+    uint16_t file = _readout.req_file;
+    uint32_t offset = _readout.req_offset;
+    _readout.stop_req = false;
+    _readout.start_req = false;
+    irq_restore(state);
+
+    if (stop) {
+        _stop();
+    }
+    if (start) {
+        _start(conn_handle, file, offset);
+    }
+    if (!_readout.streaming) {
+        return;
+    }
+
+    uint16_t mtu = ble_att_mtu(_readout.conn_handle);
+    if (mtu <= ATT_NOTIFY_HDR_LEN) {
+        return;
+    }
+    size_t chunk = mtu - ATT_NOTIFY_HDR_LEN;
+
+    /* keep a window of notifications queued so that the link layer can fill
+       every connection event, acknowledgments re-trigger the pump */
+    while (_readout.in_flight < CONFIG_PEPPER_GATT_LOG_TX_WINDOW &&
+           !_readout.stop_req && !_readout.start_req) {
+        struct os_mbuf *om = ble_hs_mbuf_att_pkt();
+        if (!om) {
+            break;
+        }
+        /* pack frames back to back up to the notification size */
+        while (OS_MBUF_PKTLEN(om) < chunk) {
+            if (_readout.frame_sent == _readout.frame_len) {
+                if (_readout.done) {
+                    break;
+                }
+                _frame_next();
+            }
+            size_t len = _readout.frame_len - _readout.frame_sent;
+            if (len > chunk - OS_MBUF_PKTLEN(om)) {
+                len = chunk - OS_MBUF_PKTLEN(om);
+            }
+            if (os_mbuf_append(om, &_readout.frame[_readout.frame_sent], len)) {
+                break;
+            }
+            _readout.frame_sent += len;
+        }
+        if (OS_MBUF_PKTLEN(om) == 0) {
+            os_mbuf_free_chain(om);
+            break;
+        }
+
+        state = irq_disable();
+        _readout.in_flight++;
+        irq_restore(state);
+        /* the mbuf is consumed, even on failure */
+        if (ble_gatts_notify_custom(_readout.conn_handle, _data_val_handle, om)) {
+            state = irq_disable();
+            _readout.in_flight--;
+            irq_restore(state);
+            LOG_WARNING("[pepper] gatt_log: notify failed, stopping\n");
+            _stop();
+            return;
+        }
+        if (_readout.done && _readout.frame_sent == _readout.frame_len) {
+            LOG_INFO("[pepper] gatt_log: readout complete\n");
+            _stop();
+            return;
+        }
+    }
+}
+
+static void _request(bool start, uint16_t conn_handle, uint16_t file, uint32_t offset)
+{
+    unsigned state = irq_disable();
+
+    if (start) {
+        _readout.start_req = true;
+        _readout.req_conn_handle = conn_handle;
+        _readout.req_file = file;
+        _readout.req_offset = offset;
+    }
+    else {
+        _readout.start_req = false;
+        _readout.stop_req = true;
+    }
+    irq_restore(state);
+    event_post(CONFIG_PEPPER_GATT_LOG_EVENT_PRIO, &_readout.event);
+}
+
+static void _start(uint16_t conn_handle, uint16_t file, uint32_t offset)
+{
+    LOG_INFO("[pepper] gatt_log: readout from file=%u offset=%" PRIu32 "\n",
+             file, offset);
+    _stop();
+    _readout.conn_handle = conn_handle;
+    _readout.file = file;
+    _readout.offset = offset;
+    /* a missing file only gets the end of logs frame */
+    _readout.loaded = _file_load(file);
+    _readout.streaming = true;
+
+    /* ask for the shortest connection interval and the longest link layer
+       packets, the central has the final word */
+    struct ble_gap_upd_params params = {
+        .itvl_min = BLE_GAP_CONN_ITVL_MS(CONFIG_PEPPER_GATT_LOG_CONN_ITVL_MIN_MS),
+        .itvl_max = BLE_GAP_CONN_ITVL_MS(CONFIG_PEPPER_GATT_LOG_CONN_ITVL_MAX_MS),
+        .latency = 0,
+        .supervision_timeout = BLE_GAP_SUPERVISION_TIMEOUT_MS(CONFIG_PEPPER_GATT_LOG_SUPERVISION_TO_MS),
+        .min_ce_len = 0,
+        .max_ce_len = 0,
+    };
+    ble_gap_update_params(conn_handle, &params);
+    ble_gap_set_data_len(conn_handle, BLE_HCI_SET_DATALEN_TX_OCTETS_MAX,
+                         BLE_HCI_SET_DATALEN_TX_TIME_MAX);
+}
+
+/* appends the size and name of each log file */
+static int _log_list(struct os_mbuf *om)
+{
+    char name[VFS_NAME_MAX + 1];
+    size_t size;
+    int res;
+
+    for (unsigned i = 0;
+         (res = storage_dir_entry(CONFIG_PEPPER_LOGS_DIR, i, name, sizeof(name),
+                                  &size)) == 0; i++) {
+        uint32_t le_size = htolel(size);
+        if (os_mbuf_append(om, &le_size, sizeof(le_size)) ||
+            os_mbuf_append(om, name, strlen(name) + 1)) {
+            return BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+    }
+    return res == -ENOENT ? 0 : BLE_ATT_ERR_UNLIKELY;
+}
+
+static int _pepper_log_ctrl_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                    struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)attr_handle;
+    (void)arg;
+    int rc = 0;
+
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        rc = _log_list(ctxt->om);
+        break;
+    case BLE_GATT_ACCESS_OP_WRITE_CHR: {
+        uint8_t buf[sizeof(uint16_t) + sizeof(uint32_t)] = { 0 };
+        uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
+        if (om_len == 0) {
+            LOG_INFO("[pepper] gatt_log: readout stopped\n");
+            _request(false, conn_handle, 0, 0);
+            break;
+        }
+        if (om_len != sizeof(uint16_t) && om_len != sizeof(buf)) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &om_len);
+        _request(true, conn_handle, byteorder_lebuftohs(buf),
+                 byteorder_lebuftohl(&buf[sizeof(uint16_t)]));
+        break;
+    }
+    default:
+        LOG_WARNING("[pepper] gatt_log: ctrl unhandled operation!\n");
+        rc = 1;
+        break;
+    }
+    return rc;
+}
+
+static int _pepper_log_data_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                    struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)ctxt;
+    (void)arg;
+    /* notify only */
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+static int _gap_event_cb(struct ble_gap_event *event, void *arg)
+{
+    (void)arg;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_NOTIFY_TX:
+        if (event->notify_tx.attr_handle == _data_val_handle &&
+            event->notify_tx.conn_handle == _readout.conn_handle) {
+            unsigned state = irq_disable();
+            if (_readout.in_flight) {
+                _readout.in_flight--;
+            }
+            irq_restore(state);
+            event_post(CONFIG_PEPPER_GATT_LOG_EVENT_PRIO, &_readout.event);
+        }
+        break;
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        if (event->subscribe.attr_handle == _data_val_handle &&
+            event->subscribe.conn_handle == _readout.conn_handle &&
+            !event->subscribe.cur_notify) {
+            _request(false, event->subscribe.conn_handle, 0, 0);
+        }
+        break;
+    case BLE_GAP_EVENT_DISCONNECT:
+        if (event->disconnect.conn.conn_handle == _readout.conn_handle) {
+            /* pending notifications are dropped with the connection */
+            _readout.in_flight = 0;
+            _request(false, event->disconnect.conn.conn_handle, 0, 0);
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void pepper_gatt_log_init(void)
+{
+    _readout.event.handler = _pump;
+    _readout.conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    ble_gap_event_listener_register(&_gap_listener, _gap_event_cb, NULL);
+}
@@ -21,12 +21,19 @@
  *
  * - `pepper_shell`: includes shell commands to start/stop and configure pepper
  * - `pepper_gatt`: adds a gatt service interface to start/stop and configure pepper
+ * - `pepper_gatt_log`: adds a gatt service streaming the SD card log files,
+ *    resumable by file and byte offset
  * - `pepper_stdio_nimble`: add stdio over BLE to provide a shell interface to start
  *    stop and configure PEPPER.
+ * - `pepper_telemetry`: adds a gatt service batching samples and epochs in
+ *    sequenced binary frames, a lighter alternative to printf logging for live
+ *    monitoring over BLE
  * - `pepper_current_time`: adds service to listen to BLE current time advertisements
  *    and synchronize to them
  * - `pepper_util`: collection of utilities, currently UID generation and basename
  *    serialization tags.
+ * - `pepper_sim`: replaces the BLE and UWB radios by the simulated radio bus
+ *    (`sim_bus`), to run several `native` instances against each other
  *
  * ### Used ZTIMER clocks
  *
@@ -204,6 +211,110 @@ extern "C" {
 #define CONFIG_PEPPER_LOG_CSV           0
 #endif
 
+/**
+ * @name    GATT log readout (`pepper_gatt_log`) configuration
+ * @{
+ */
+/**
+ * @brief   Largest chunk of a log file read at once and streamed in a frame
+ */
+#ifndef CONFIG_PEPPER_GATT_LOG_CHUNK_SIZE
+#define CONFIG_PEPPER_GATT_LOG_CHUNK_SIZE           (512U)
+#endif
+/**
+ * @brief   Notifications queued before waiting for their completion
+ */
+#ifndef CONFIG_PEPPER_GATT_LOG_TX_WINDOW
+#define CONFIG_PEPPER_GATT_LOG_TX_WINDOW            (4U)
+#endif
+/**
+ * @brief   Connection interval requested while streaming
+ */
+#ifndef CONFIG_PEPPER_GATT_LOG_CONN_ITVL_MIN_MS
+#define CONFIG_PEPPER_GATT_LOG_CONN_ITVL_MIN_MS     (8U)
+#endif
+#ifndef CONFIG_PEPPER_GATT_LOG_CONN_ITVL_MAX_MS
+#define CONFIG_PEPPER_GATT_LOG_CONN_ITVL_MAX_MS     (15U)
+#endif
+/**
+ * @brief   Supervision timeout requested while streaming
+ */
+#ifndef CONFIG_PEPPER_GATT_LOG_SUPERVISION_TO_MS
+#define CONFIG_PEPPER_GATT_LOG_SUPERVISION_TO_MS    (2000U)
+#endif
+/**
+ * @brief   Event priority of the readout, SD card reads happen there
+ */
+#ifndef CONFIG_PEPPER_GATT_LOG_EVENT_PRIO
+#define CONFIG_PEPPER_GATT_LOG_EVENT_PRIO           CONFIG_PEPPER_LOW_EVENT_PRIO
+#endif
+/** @} */
+
+/**
+ * @brief   GATT log readout frame header, followed by a chunk of a log file
+ *
+ * All fields are little endian.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t offset;            /**< offset of the chunk in its file */
+    uint16_t file;              /**< index of the file in the logs directory */
+    uint16_t len;               /**< chunk length, 0 marks the end of the logs */
+} pepper_gatt_log_frame_t;
+
+/**
+ * @name    Binary telemetry (`pepper_telemetry`) configuration
+ * @{
+ */
+/**
+ * @brief   Largest ATT MTU used for telemetry frames
+ */
+#ifndef CONFIG_PEPPER_TELEMETRY_MTU_MAX
+#define CONFIG_PEPPER_TELEMETRY_MTU_MAX             (247U)
+#endif
+/**
+ * @brief   Maximum time a record waits in a partially filled frame
+ */
+#ifndef CONFIG_PEPPER_TELEMETRY_FLUSH_MS
+#define CONFIG_PEPPER_TELEMETRY_FLUSH_MS            (500U)
+#endif
+/** @} */
+
+/**
+ * @brief   Telemetry frame header, followed by the records
+ *
+ * Every record is a type (@ref pepper_telemetry_type_t), a length and the
+ * record payload. All multi-byte fields are little endian.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t seq;               /**< frame sequence number */
+    uint8_t records;            /**< number of records in the frame */
+    uint8_t flags;              /**< reserved */
+} pepper_telemetry_frame_t;
+
+/**
+ * @brief   Telemetry record types
+ */
+typedef enum {
+    /** time u32 ms, cid u32, d_cm u16, los u16 (0xffff n/a), rssi i16 cdBm (-32768 n/a) */
+    PEPPER_TELEMETRY_UWB = 0x01,
+    /** time u32 ms, cid u32, rssi i16 cdBm */
+    PEPPER_TELEMETRY_BLE = 0x02,
+    /** timestamp u32, contacts u8, followed by as many contact records */
+    PEPPER_TELEMETRY_EPOCH = 0x03,
+    /** index u8, et[32], rt[32], exposure_s u16, req_count u16, avg_d_cm u16 */
+    PEPPER_TELEMETRY_CONTACT = 0x04,
+} pepper_telemetry_type_t;
+
+/**
+ * @brief   Telemetry statistics
+ */
+typedef struct {
+    uint32_t frames;            /**< frames sent */
+    uint32_t records;           /**< records batched */
+    uint32_t dropped;           /**< frames that could not be sent */
+    uint32_t oversized;         /**< records larger than the MTU */
+} pepper_telemetry_stats_t;
+
 /**
  * @brief   Token ID length in bytes
  */
@@ -286,6 +397,8 @@ typedef struct controller {
     mutex_t lock;                       /**< lock to prevent multiple calls to
                                             pepper_start */
     epoch_params_t epoch;               /**< current epoch parameters */
+    bool align;                         /**< end of epochs are aligned on the
+                                            current time */
 #if IS_USED(MODULE_DESIRE_ADVERTISER)
     adv_params_t adv;                   /**< configured advertisement parameters */
 #endif
@@ -327,6 +440,33 @@ void pepper_pause(void);
  */
 void pepper_resume(bool align);
 
+/**
+ * @brief   Updates the parameters of an active PEPPER without clearing the
+ *          encounter list or the current epoch data
+ *
+ * The advertisement interval applies from the next advertisement and the
+ * advertisements per slice from the next slice rotation, the scan parameters
+ * from the next scan window. The current epoch keeps its duration, the new
+ * one applies from the next epoch. @p params epoch_iterations and align are
+ * ignored, they only apply on @ref pepper_start.
+ *
+ * If paused the parameters are applied on @ref pepper_resume.
+ *
+ * @param[in]   params  PEPPER parameters
+ *
+ * @return  0 on success
+ * @return  -EINVAL if the parameters are not valid
+ * @return  -EPERM if PEPPER is stopped, use @ref pepper_start
+ */
+int pepper_update_params(const pepper_start_params_t *params);
+
+/**
+ * @brief   Returns the current PEPPER parameters
+ *
+ * @param[out]  params  PEPPER parameters, align is always false
+ */
+void pepper_get_params(pepper_start_params_t *params);
+
 /**
  * @brief   Query pepper status
  *
@@ -401,6 +541,32 @@ uint16_t pepper_twr_get_backoff(void);
  */
 void pepper_twr_set_backoff(uint16_t backoff);
 
+#if IS_USED(MODULE_WATERMARK)
+/**
+ * @brief   Get the controller memory pools usage
+ *
+ * @param[out]  pools   WATERMARK_POOL_NUMOF pool usages, unused pools have
+ *                      a zero size
+ */
+void pepper_watermark_pools(watermark_pool_t *pools);
+
+/**
+ * @brief   Measure the thread stacks usage, the PEPPER event threads first
+ *
+ * @param[out]  stacks  the stack usages
+ * @param[in]   numof   the number of @p stacks
+ *
+ * @return  the number of threads measured, 0 without DEVELHELP
+ */
+unsigned pepper_watermark_stacks(watermark_stack_t *stacks, unsigned numof);
+
+/**
+ * @brief   Restart the controller memory pools high watermarks and clear
+ *          their failed allocations
+ */
+void pepper_watermark_reset(void);
+#endif
+
 /**
  * @brief   Configure the basename string to be added when serializing and logging
  *
@@ -457,6 +623,56 @@ void pepper_uid_init(void);
  */
 void pepper_gatt_init(void);
 
+/**
+ * @brief   PEPPER gatt log readout initialization
+ *
+ * Called by @ref pepper_gatt_init when `pepper_gatt_log` is used, the
+ * SD card must be mounted through @ref storage_init.
+ */
+void pepper_gatt_log_init(void);
+
+/**
+ * @brief   PEPPER binary telemetry initialization
+ *
+ * Called by @ref pepper_gatt_init when `pepper_telemetry` is used, the
+ * service itself is registered with the other PEPPER GATT services. Records
+ * are only batched while a central is subscribed to it.
+ */
+void pepper_telemetry_init(void);
+
+/**
+ * @brief   Queue a UWB sample for telemetry
+ *
+ * @param[in]   data    the sample
+ */
+void pepper_telemetry_uwb(const ed_uwb_data_t *data);
+
+/**
+ * @brief   Queue a BLE sample for telemetry
+ *
+ * @param[in]   data    the sample
+ */
+void pepper_telemetry_ble(const ed_ble_data_t *data);
+
+/**
+ * @brief   Queue an epoch and its contacts for telemetry, then flush
+ *
+ * @param[in]   epoch   the epoch data
+ */
+void pepper_telemetry_epoch(epoch_data_t *epoch);
+
+/**
+ * @brief   Send the partially filled telemetry frame, if any
+ */
+void pepper_telemetry_flush(void);
+
+/**
+ * @brief   Get telemetry statistics
+ *
+ * @param[out]  stats   the statistics
+ */
+void pepper_telemetry_get_stats(pepper_telemetry_stats_t *stats);
+
 /**
  * @brief   PEPPER stdio nimble initialization
  *
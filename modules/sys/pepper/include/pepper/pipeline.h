@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_pepper
+ * @{
+ *
+ * @file
+ * @brief       PEPPER encounter pipeline, radio independent processing
+ *
+ * Provided by the `pepper_pipeline` pseudomodule, used by the controller and
+ * by native drivers of the pipeline such as tests/pepper_load.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef PEPPER_PIPELINE_H
+#define PEPPER_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ed.h"
+#include "desire/ble_pkt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Process a scanned DESIRE advertisement into an encounter list
+ *
+ * This is the radio independent part of the scan callback: the EBID slice
+ * is added to the matching encounter, allocated if new, and once the EBID is
+ * reconstructed the rssi is recorded.
+ *
+ * @param[inout]    list            the encounter list
+ * @param[in]       timestamp       the time in s relative to the epoch start
+ * @param[in]       rssi            the advertisement rssi
+ * @param[in]       adv_payload     the advertisement payload
+ *
+ * @return  the encounter, NULL if the encounter memory is exhausted
+ */
+ed_t *pepper_pipeline_scan(ed_list_t *list, uint32_t timestamp, int8_t rssi,
+                           const desire_ble_adv_payload_t *adv_payload);
+
+/**
+ * @brief   Whether to listen for a TWR request from an encounter
+ *
+ * Listening is skipped if a request from the encounter was received less than
+ * @p backoff_s ago.
+ *
+ * @param[in]       ed              the encounter that advertised
+ * @param[in]       timestamp       the time in s relative to the epoch start
+ * @param[in]       backoff_s       the TWR backoff, in s
+ *
+ * @return  true if a listen should be scheduled
+ */
+bool pepper_pipeline_twr_should_listen(ed_t *ed, uint32_t timestamp,
+                                       uint16_t backoff_s);
+
+/**
+ * @brief   Whether to send a TWR request to an encounter
+ *
+ * The encounter EBID must be reconstructed, the encounter must have been seen
+ * in the last @ref CONFIG_MIA_TIME_S and no exchange must have completed less
+ * than @p backoff_s ago, the request is sent in the next advertisement
+ * interval.
+ *
+ * @param[in]       ed              the encounter to range with
+ * @param[in]       timestamp       the time in s relative to the epoch start
+ * @param[in]       backoff_s       the TWR backoff, in s
+ *
+ * @return  true if a request should be scheduled
+ */
+bool pepper_pipeline_twr_should_request(ed_t *ed, uint32_t timestamp,
+                                        uint16_t backoff_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEPPER_PIPELINE_H */
+/** @} */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_pepper
+ * @{
+ *
+ * @file
+ * @brief       PEPPER encounter pipeline, radio independent processing
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <inttypes.h>
+
+#include "pepper.h"
+#include "pepper/pipeline.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_INFO
+#endif
+#include "log.h"
+
+ed_t *pepper_pipeline_scan(ed_list_t *list, uint32_t timestamp, int8_t rssi,
+                           const desire_ble_adv_payload_t *adv_payload)
+{
+    uint32_t cid;
+    uint8_t part;
+
+    (void)rssi;
+
+    /* 1. process the incoming slice */
+    decode_sid_cid(adv_payload->data.sid_cid, &part, &cid);
+    ed_t *ed = ed_list_process_slice(list, cid, timestamp,
+                                     adv_payload->data.ebid_slice, part);
+
+    if (ed == NULL) {
+        return NULL;
+    }
+    /* 2. update last time this encounter was seen, relative to epoch start */
+    ed->seen_last_s = timestamp;
+#if IS_USED(MODULE_ED_BLE) || IS_USED(MODULE_ED_BLE_WIN)
+    /* 3. once the EBID was reconstructed log rssi data */
+    if (ed->ebid.status.status == EBID_HAS_ALL) {
+        ed_list_process_scan_data(list, cid, timestamp, rssi);
+    }
+#endif
+    return ed;
+}
+
+bool pepper_pipeline_twr_should_listen(ed_t *ed, uint32_t timestamp,
+                                       uint16_t backoff_s)
+{
+    /* check if no successfull TWR exchange in last backoff_s */
+    if ((ed->uwb.seen_last_rx_s + backoff_s <= timestamp) ||
+        ed->uwb.seen_last_rx_s == 0) {
+        return true;
+    }
+    LOG_INFO("[pepper]: lst skip 0x%04" PRIx16 ", %" PRIu32 "s < %" PRIu16 "s\n",
+             ed_get_short_addr(ed), timestamp - ed->uwb.seen_last_rx_s,
+             backoff_s);
+    return false;
+}
+
+bool pepper_pipeline_twr_should_request(ed_t *ed, uint32_t timestamp,
+                                        uint16_t backoff_s)
+{
+    if (ed->ebid.status.status == EBID_HAS_ALL) {
+        /* 1. check if advertisement where received from neighbor in last CONFIG_MIA_TIME_S */
+        if (ed->seen_last_s + CONFIG_MIA_TIME_S > timestamp) {
+            /* 1.1 check if no successfull TWR exchange in last backoff_s */
+            if ((ed->uwb.seen_last_s + backoff_s <= timestamp + 1) ||
+                ed->uwb.seen_last_s == 0) {
+                return true;
+            }
+            else {
+                LOG_INFO(
+                    "[pepper]: req skip 0x%04" PRIx16 ": %" PRIu32 "s < %" PRIu16 "s\n",
+                    ed_get_short_addr(ed), timestamp + 1 - ed->uwb.seen_last_s,
+                    backoff_s);
+            }
+        }
+        else {
+            LOG_WARNING("[pepper]: req skip encounter, missing over BLE\n");
+        }
+    }
+    return false;
+}
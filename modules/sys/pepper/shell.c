@@ -16,6 +16,7 @@
  *
  * @}
  */
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -30,6 +31,18 @@
 #include "twr.h"
 #endif
 #include "ed.h"
+#if IS_USED(MODULE_LATENCY)
+#include "latency.h"
+#endif
+#if IS_USED(MODULE_WATERMARK)
+#include "watermark.h"
+#endif
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
 
 static void _print_usage(void)
 {
@@ -37,10 +50,25 @@ static void _print_usage(void)
     puts("\tpepper status: controller status information");
     puts("\tpepper start [-d <epoch duration s>] [-i <ms interval>] [-r <advs per slice>]"
          " [-e (align end epoch)] [-a (align start epoch)] [-c <iterations> ] [-s <win_ms,itvl_ms>]");
+    puts("\tpepper update [-d <epoch duration s>] [-i <ms interval>] [-r <advs per slice>]"
+         " [-s <win_ms,itvl_ms>]: updates a running proximity tracing, keeping its encounters,"
+         " -c, -e and -a are only valid on start");
     puts("\tpepper stop: stop proximity tracing");
     puts("\tpepper set bn <base name>: sets base name for logging");
     puts("\tpepper get bn: returns base name for logging");
     puts("\tpepper get uid: returns unique identifier");
+#if IS_USED(MODULE_LATENCY)
+    puts("\tpepper latency [reset]: scan to range pipeline latencies this epoch");
+#endif
+#if IS_USED(MODULE_WATERMARK)
+    puts("\tpepper mem [reset]: memory pools usage this epoch and thread stacks usage");
+#endif
+#if IS_USED(MODULE_ENERGY)
+    puts("\tpepper energy [reset]: radio time in state and energy estimate this epoch");
+#endif
+#if IS_USED(MODULE_BOOT_PROFILE)
+    puts("\tpepper boot: boot phases start and duration");
+#endif
 #if IS_USED(MODULE_TWR)
     puts("\tpepper twr get win: returns the listen window in us");
     puts("\tpepper twr get backoff: returns backoff in seconds");
@@ -115,6 +143,115 @@ static int _twr_handler(int argc, char **argv)
 }
 #endif
 
+#if IS_USED(MODULE_LATENCY)
+static int _latency_handler(int argc, char **argv)
+{
+    if (argc > 1) {
+        if (!strcmp(argv[1], "reset")) {
+            latency_reset();
+            return 0;
+        }
+        _print_usage();
+        return -1;
+    }
+
+    latency_summary_t summaries[LATENCY_STAGE_NUMOF];
+
+    latency_summary_all(summaries);
+    printf("%-16s %8s %8s %8s %8s %8s\n", "stage (us)", "n", "min", "avg", "p99", "max");
+    for (unsigned i = 0; i < LATENCY_STAGE_NUMOF; i++) {
+        printf("%-16s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "\n",
+               latency_stage_name(i), summaries[i].count, summaries[i].min_us,
+               summaries[i].avg_us, summaries[i].p99_us, summaries[i].max_us);
+    }
+    return 0;
+}
+#endif
+
+#if IS_USED(MODULE_WATERMARK)
+static int _mem_handler(int argc, char **argv)
+{
+    if (argc > 1) {
+        if (!strcmp(argv[1], "reset")) {
+            pepper_watermark_reset();
+            return 0;
+        }
+        _print_usage();
+        return -1;
+    }
+
+    watermark_pool_t pools[WATERMARK_POOL_NUMOF];
+    watermark_stack_t stacks[CONFIG_WATERMARK_STACKS_NUMOF];
+
+    pepper_watermark_pools(pools);
+    printf("%-16s %8s %8s %8s %8s\n", "pool (blocks)", "size", "used", "high", "fails");
+    for (unsigned i = 0; i < WATERMARK_POOL_NUMOF; i++) {
+        if (pools[i].size) {
+            printf("%-16s %8u %8u %8u %8u\n", watermark_pool_name(i),
+                   pools[i].size, pools[i].used, pools[i].high, pools[i].fails);
+        }
+    }
+    unsigned numof = pepper_watermark_stacks(stacks, CONFIG_WATERMARK_STACKS_NUMOF);
+    printf("%-16s %8s %8s\n", "stack (bytes)", "size", "used");
+    for (unsigned i = 0; i < numof; i++) {
+        printf("%-16s %8u %8u\n", stacks[i].name, stacks[i].size, stacks[i].used);
+    }
+    return 0;
+}
+#endif
+
+#if IS_USED(MODULE_ENERGY)
+static int _energy_handler(int argc, char **argv)
+{
+    if (argc > 1) {
+        if (!strcmp(argv[1], "reset")) {
+            energy_reset();
+            return 0;
+        }
+        _print_usage();
+        return -1;
+    }
+
+    energy_summary_t summaries[ENERGY_STATE_NUMOF];
+    uint32_t total = energy_summary_all(summaries);
+
+    printf("%-16s %8s %10s %10s\n", "state", "n", "ms", "uJ");
+    for (unsigned i = 0; i < ENERGY_STATE_NUMOF; i++) {
+        printf("%-16s %8" PRIu32 " %10" PRIu32 " %10" PRIu32 "\n",
+               energy_state_name(i), summaries[i].count, summaries[i].time_ms,
+               summaries[i].uj);
+    }
+    printf("%-16s %8s %10s %10" PRIu32 "\n", "total", "", "", total);
+    return 0;
+}
+#endif
+
+#if IS_USED(MODULE_BOOT_PROFILE)
+static int _boot_handler(int argc, char **argv)
+{
+    (void)argv;
+    if (argc > 1) {
+        _print_usage();
+        return -1;
+    }
+
+    boot_profile_entry_t entry;
+
+    printf("%-16s %10s %10s\n", "phase", "start ms", "us");
+    for (unsigned i = 0; i < BOOT_PHASE_NUMOF; i++) {
+        boot_profile_get(i, &entry);
+        if (entry.done) {
+            printf("%-16s %10" PRIu32 " %10" PRIu32 "\n", boot_profile_phase_name(i),
+                   entry.start_ms, entry.us);
+        }
+        else {
+            printf("%-16s %10s %10s\n", boot_profile_phase_name(i), "-", "-");
+        }
+    }
+    return 0;
+}
+#endif
+
 static int _parse_scan_params(char *arg, uint32_t *win_ms, uint32_t *itvl_ms)
 {
     char *value = strtok(arg, ",");
@@ -130,6 +267,92 @@ static int _parse_scan_params(char *arg, uint32_t *win_ms, uint32_t *itvl_ms)
     return -1;
 }
 
+static int _parse_params(int argc, char **argv, pepper_start_params_t *params,
+                         bool *align_start, bool update)
+{
+    int res = 0;
+
+    for (int i = 2; i < argc; i++) {
+        char *arg = argv[i];
+        /* iterations and alignment only apply to pepper start */
+        if (update && arg[1] != '\0' && strchr("cea", arg[1])) {
+            res = 1;
+            continue;
+        }
+        switch (arg[1]) {
+        case 'd':
+            if ((i++) < argc) {
+                params->epoch_duration_s = (uint32_t)atoi(argv[i]);
+                continue;
+            }
+        /* intentionally falls through */
+        case 'h':
+            res = 1;
+            continue;
+        /* intentionally falls through */
+        case 'i':
+            if ((++i) < argc) {
+                params->adv_itvl_ms = (uint32_t)atoi(argv[i]);
+                continue;
+            }
+        /* intentionally falls through */
+        case 'c':
+            if ((++i) < argc) {
+                params->epoch_iterations = (uint32_t)atoi(argv[i]);
+                continue;
+            }
+        /* intentionally falls through */
+        case 'r':
+            if ((++i) < argc) {
+                params->advs_per_slice = (uint32_t)atoi(argv[i]);
+                continue;
+            }
+        /* intentionally falls through */
+        case 'e':
+            params->align = true;
+            continue;
+        /* intentionally falls through */
+        case 'a':
+            *align_start = true;
+            continue;
+        /* intentionally falls through */
+        case 's':
+            if ((++i) < argc) {
+                uint32_t scan_itvl_ms = 0;
+                uint32_t scan_win_ms = 0;
+                _parse_scan_params(argv[i], &scan_win_ms, &scan_itvl_ms);
+                params->scan_itvl_ms = scan_itvl_ms;
+                params->scan_win_ms = scan_win_ms;
+                continue;
+            }
+        /* intentionally falls through */
+        default:
+            res = 1;
+            break;
+        }
+    }
+
+    if (params->scan_itvl_ms < params->scan_win_ms) {
+        res = 1;
+    }
+    return res;
+}
+
+static void _print_params(const pepper_start_params_t *params)
+{
+    printf("\tepoch_duration: %" PRIu32 "[s]\n", params->epoch_duration_s);
+    if (params->epoch_iterations != 0 && params->epoch_iterations != UINT32_MAX) {
+        printf("\tepoch_iterations: %" PRIu32 "\n", params->epoch_iterations);
+    }
+    else {
+        printf("\tepoch_iterations: until stopped\n");
+    }
+    printf("\tadv_per_slice: %" PRIu32 "\n", params->advs_per_slice);
+    printf("\tadv_itvl: %" PRIu32 "[ms]\n", params->adv_itvl_ms);
+    printf("\tscan_itvl: %" PRIu32 "[ms]\n", params->scan_itvl_ms);
+    printf("\tscan_win: %" PRIu32 "[ms]\n", params->scan_win_ms);
+}
+
 static int _pepper_handler(int argc, char **argv)
 {
     if (argc < 2) {
@@ -147,68 +370,10 @@ static int _pepper_handler(int argc, char **argv)
             .scan_win_ms = CONFIG_BLE_SCAN_WIN_MS,
             .align = false,
         };
-        int res = 0;
         bool align_start = false;
 
         /* parse command line arguments */
-        for (int i = 2; i < argc; i++) {
-            char *arg = argv[i];
-            switch (arg[1]) {
-            case 'd':
-                if ((i++) < argc) {
-                    params.epoch_duration_s = (uint32_t)atoi(argv[i]);
-                    continue;
-                }
-            /* intentionally falls through */
-            case 'h':
-                res = 1;
-                continue;
-            /* intentionally falls through */
-            case 'i':
-                if ((++i) < argc) {
-                    params.adv_itvl_ms = (uint32_t)atoi(argv[i]);
-                    continue;
-                }
-            /* intentionally falls through */
-            case 'c':
-                if ((++i) < argc) {
-                    params.epoch_iterations = (uint32_t)atoi(argv[i]);
-                    continue;
-                }
-            /* intentionally falls through */
-            case 'r':
-                if ((++i) < argc) {
-                    params.advs_per_slice = (uint32_t)atoi(argv[i]);
-                    continue;
-                }
-            /* intentionally falls through */
-            case 'e':
-                params.align = true;
-                continue;
-            /* intentionally falls through */
-            case 'a':
-                align_start = true;
-                continue;
-            /* intentionally falls through */
-            case 's':
-                if ((++i) < argc) {
-                    uint32_t scan_itvl_ms = 0;
-                    uint32_t scan_win_ms = 0;
-                    _parse_scan_params(argv[i], &scan_win_ms, &scan_itvl_ms);
-                    params.scan_itvl_ms = scan_itvl_ms;
-                    params.scan_win_ms = scan_win_ms;
-                    continue;
-                }
-            /* intentionally falls through */
-            default:
-                res = 1;
-                break;
-            }
-        }
-
-        if (params.scan_itvl_ms < params.scan_win_ms) {
-            res = 1;
-        }
+        int res = _parse_params(argc, argv, &params, &align_start, false);
 
         if (res != 0) {
             _print_usage();
@@ -220,17 +385,7 @@ static int _pepper_handler(int argc, char **argv)
             ztimer_sleep(ZTIMER_EPOCH, delay);
         }
         puts("[pepper] shell: start proximity tracing");
-        printf("\tepoch_duration: %" PRIu32 "[s]\n", params.epoch_duration_s);
-        if (params.epoch_iterations != 0 && params.epoch_iterations != UINT32_MAX) {
-            printf("\tepoch_iterations: %" PRIu32 "\n", params.epoch_iterations);
-        }
-        else {
-            printf("\tepoch_iterations: until stopped\n");
-        }
-        printf("\tadv_per_slice: %" PRIu32 "\n", params.advs_per_slice);
-        printf("\tadv_itvl: %" PRIu32 "[ms]\n", params.adv_itvl_ms);
-        printf("\tscan_itvl: %" PRIu32 "[ms]\n", params.scan_itvl_ms);
-        printf("\tscan_win: %" PRIu32 "[ms]\n", params.scan_win_ms);
+        _print_params(&params);
         pepper_start(&params);
         if (IS_ACTIVE(CONFIG_PEPPER_SHELL_BLOCKING)) {
             /* if iterations == 0 the loop will not run and this wont't block
@@ -242,6 +397,30 @@ static int _pepper_handler(int argc, char **argv)
         return 0;
     }
 
+    if (!strcmp(argv[1], "update")) {
+        pepper_start_params_t params;
+        bool align_start = false;
+
+        /* unspecified parameters keep their current value */
+        pepper_get_params(&params);
+        if (_parse_params(argc, argv, &params, &align_start, true)) {
+            _print_usage();
+            return 1;
+        }
+        int res = pepper_update_params(&params);
+        if (res == -EPERM) {
+            puts("[pepper] shell: not active, use pepper start");
+            return 1;
+        }
+        if (res) {
+            puts("[pepper] shell: invalid parameters");
+            return 1;
+        }
+        puts("[pepper] shell: update proximity tracing");
+        _print_params(&params);
+        return 0;
+    }
+
     if (!strcmp(argv[1], "get")) {
         if (argc >= 2) {
             if (!strcmp(argv[2], "time")) {
@@ -298,6 +477,30 @@ static int _pepper_handler(int argc, char **argv)
     }
 #endif
 
+#if IS_USED(MODULE_LATENCY)
+    if (!strcmp(argv[1], "latency")) {
+        return _latency_handler(argc - 1, &argv[1]);
+    }
+#endif
+
+#if IS_USED(MODULE_WATERMARK)
+    if (!strcmp(argv[1], "mem")) {
+        return _mem_handler(argc - 1, &argv[1]);
+    }
+#endif
+
+#if IS_USED(MODULE_ENERGY)
+    if (!strcmp(argv[1], "energy")) {
+        return _energy_handler(argc - 1, &argv[1]);
+    }
+#endif
+
+#if IS_USED(MODULE_BOOT_PROFILE)
+    if (!strcmp(argv[1], "boot")) {
+        return _boot_handler(argc - 1, &argv[1]);
+    }
+#endif
+
     if (!strcmp(argv[1], "set")) {
         if (argc >= 3) {
             if (!strcmp(argv[2], "bn")) {
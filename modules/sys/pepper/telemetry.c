@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     pepper
+ * @{
+ *
+ * @file
+ * @brief       Framed binary telemetry over a GATT notify characteristic
+ *
+ * Samples and epochs are encoded as compact binary records and batched in
+ * frames as large as the ATT MTU allows. A frame is sent when the next record
+ * does not fit, or @ref CONFIG_PEPPER_TELEMETRY_FLUSH_MS after its first
+ * record was added. Frames carry a sequence number so that a receiver can
+ * detect lost frames, frames are dropped when NimBLE runs out of buffers
+ * rather than stalling the caller.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "byteorder.h"
+#include "event/timeout.h"
+#include "mutex.h"
+#include "xfa.h"
+#include "ztimer.h"
+
+#include "host/ble_gap.h"
+#include "host/ble_gatt.h"
+#include "host/ble_hs.h"
+
+#include "pepper.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_INFO
+#endif
+#include "log.h"
+
+/* ATT notification header: opcode + attribute handle */
+#define ATT_NOTIFY_HDR_LEN          (3U)
+/* record header: type + length */
+#define RECORD_HDR_LEN              (2U)
+#define FRAME_MAX                   (CONFIG_PEPPER_TELEMETRY_MTU_MAX - ATT_NOTIFY_HDR_LEN)
+
+/* UUID = ce2ae1d5-b067-c348-985a-ba2f2b0ac8f0 */
+static const ble_uuid128_t gatt_svr_svc_pepper_telemetry_uuid
+    = BLE_UUID128_INIT(0xf0, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
+                       0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
+
+/* UUID = ce2ae1d5-b067-c348-985a-ba2f2b0ac8f1 */
+static const ble_uuid128_t gatt_svr_chr_pepper_telemetry_uuid
+    = BLE_UUID128_INIT(0xf1, 0xc8, 0x0a, 0x2b, 0x2f, 0xba, 0x5a, 0x98,
+                       0x48, 0xc3, 0x67, 0xb0, 0xd5, 0xe1, 0x2a, 0xce);
+
+typedef struct {
+    mutex_t lock;
+    event_t flush;
+    event_timeout_t flush_timeout;
+    uint16_t conn_handle;           /* subscriber, BLE_HS_CONN_HANDLE_NONE if none */
+    uint16_t seq;
+    size_t len;                     /* frame length, 0 if no records */
+    uint8_t frame[FRAME_MAX];
+    pepper_telemetry_stats_t stats;
+} _telemetry_t;
+
+static int _pepper_telemetry_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                     struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static uint16_t _val_handle;
+static struct ble_gap_event_listener _gap_listener;
+static _telemetry_t _telemetry = {
+    .lock = MUTEX_INIT,
+    .conn_handle = BLE_HS_CONN_HANDLE_NONE,
+};
+
+XFA_USE_CONST(struct ble_gatt_svc_def, gatt_svr_svcs);
+XFA_CONST(gatt_svr_svcs, 0) struct ble_gatt_svc_def _gatt_svr_pepper_telemetry = {
+    /* PEPPER Telemetry Service */
+    .type = BLE_GATT_SVC_TYPE_PRIMARY,
+    .uuid = (ble_uuid_t *)&gatt_svr_svc_pepper_telemetry_uuid.u,
+    .characteristics = (struct ble_gatt_chr_def[]) {
+        {
+            /* Characteristic: telemetry frames */
+            .uuid = (ble_uuid_t *)&gatt_svr_chr_pepper_telemetry_uuid.u,
+            .access_cb = _pepper_telemetry_handler,
+            .val_handle = &_val_handle,
+            .flags = BLE_GATT_CHR_F_NOTIFY,
+        },
+        {
+            0,         /* No more characteristics in this service */
+        },
+    }
+};
+
+static int _pepper_telemetry_handler(uint16_t conn_handle, uint16_t attr_handle,
+                                     struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)ctxt;
+    (void)arg;
+    /* notify only */
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+static size_t _frame_capacity(void)
+{
+    size_t mtu = ble_att_mtu(_telemetry.conn_handle);
+
+    if (mtu <= ATT_NOTIFY_HDR_LEN) {
+        return 0;
+    }
+    mtu -= ATT_NOTIFY_HDR_LEN;
+    return mtu < FRAME_MAX ? mtu : FRAME_MAX;
+}
+
+/* sends the pending frame, lock must be held */
+static void _frame_send(void)
+{
+    if (_telemetry.len <= sizeof(pepper_telemetry_frame_t)) {
+        return;
+    }
+    event_timeout_clear(&_telemetry.flush_timeout);
+
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(_telemetry.frame, _telemetry.len);
+    /* the mbuf is consumed, even on failure */
+    if (!om || ble_gatts_notify_custom(_telemetry.conn_handle, _val_handle, om)) {
+        _telemetry.stats.dropped++;
+    }
+    else {
+        _telemetry.stats.frames++;
+    }
+    /* dropped frames still use a sequence number, gaps show the losses */
+    _telemetry.seq++;
+    _telemetry.len = 0;
+}
+
+static void _frame_reset(void)
+{
+    pepper_telemetry_frame_t *hdr = (pepper_telemetry_frame_t *)_telemetry.frame;
+
+    hdr->seq = htoles(_telemetry.seq);
+    hdr->records = 0;
+    hdr->flags = 0;
+    _telemetry.len = sizeof(*hdr);
+}
+
+/* appends a record, sending the pending frame first if it does not fit */
+static void _record_add(uint8_t type, const void *data, size_t len)
+{
+    mutex_lock(&_telemetry.lock);
+    if (_telemetry.conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        mutex_unlock(&_telemetry.lock);
+        return;
+    }
+
+    size_t capacity = _frame_capacity();
+    if (sizeof(pepper_telemetry_frame_t) + RECORD_HDR_LEN + len > capacity) {
+        /* will never fit, the MTU is too small */
+        _telemetry.stats.oversized++;
+        mutex_unlock(&_telemetry.lock);
+        return;
+    }
+    if (_telemetry.len && _telemetry.len + RECORD_HDR_LEN + len > capacity) {
+        _frame_send();
+    }
+    if (!_telemetry.len) {
+        _frame_reset();
+        event_timeout_set(&_telemetry.flush_timeout, CONFIG_PEPPER_TELEMETRY_FLUSH_MS);
+    }
+
+    uint8_t *pos = &_telemetry.frame[_telemetry.len];
+    pos[0] = type;
+    pos[1] = len;
+    memcpy(&pos[RECORD_HDR_LEN], data, len);
+    _telemetry.len += RECORD_HDR_LEN + len;
+    ((pepper_telemetry_frame_t *)_telemetry.frame)->records++;
+    _telemetry.stats.records++;
+    mutex_unlock(&_telemetry.lock);
+}
+
+static int16_t _rssi_cdbm(float rssi)
+{
+    return (int16_t)(rssi * 100);
+}
+
+void pepper_telemetry_uwb(const ed_uwb_data_t *data)
+{
+    uint8_t rec[14];
+
+    byteorder_htolebufl(&rec[0], data->time);
+    byteorder_htolebufl(&rec[4], data->cid);
+    byteorder_htolebufs(&rec[8], data->d_cm);
+#if IS_USED(MODULE_ED_UWB_LOS)
+    byteorder_htolebufs(&rec[10], data->los);
+#else
+    byteorder_htolebufs(&rec[10], UINT16_MAX);
+#endif
+#if IS_USED(MODULE_ED_UWB_RSSI)
+    byteorder_htolebufs(&rec[12], _rssi_cdbm(data->rssi));
+#else
+    byteorder_htolebufs(&rec[12], INT16_MIN);
+#endif
+    _record_add(PEPPER_TELEMETRY_UWB, rec, sizeof(rec));
+}
+
+void pepper_telemetry_ble(const ed_ble_data_t *data)
+{
+    uint8_t rec[10];
+
+    byteorder_htolebufl(&rec[0], data->time);
+    byteorder_htolebufl(&rec[4], data->cid);
+    byteorder_htolebufs(&rec[8], _rssi_cdbm(data->rssi));
+    _record_add(PEPPER_TELEMETRY_BLE, rec, sizeof(rec));
+}
+
+void pepper_telemetry_epoch(epoch_data_t *epoch)
+{
+    uint8_t contacts = epoch_contacts(epoch);
+    uint8_t rec[2 * PET_SIZE + 7];
+
+    byteorder_htolebufl(&rec[0], epoch->timestamp);
+    rec[4] = contacts;
+    _record_add(PEPPER_TELEMETRY_EPOCH, rec, 5);
+
+    for (uint8_t i = 0; i < contacts; i++) {
+        contact_data_t *contact = &epoch->contacts[i];
+        rec[0] = i;
+        memcpy(&rec[1], contact->pet.et, PET_SIZE);
+        memcpy(&rec[1 + PET_SIZE], contact->pet.rt, PET_SIZE);
+#if IS_USED(MODULE_ED_UWB)
+        byteorder_htolebufs(&rec[1 + 2 * PET_SIZE], contact->uwb.exposure_s);
+        byteorder_htolebufs(&rec[3 + 2 * PET_SIZE], contact->uwb.req_count);
+        byteorder_htolebufs(&rec[5 + 2 * PET_SIZE], contact->uwb.avg_d_cm);
+        _record_add(PEPPER_TELEMETRY_CONTACT, rec, sizeof(rec));
+#else
+        _record_add(PEPPER_TELEMETRY_CONTACT, rec, 1 + 2 * PET_SIZE);
+#endif
+    }
+    /* the epoch is complete, no need to wait for more records */
+    pepper_telemetry_flush();
+}
+
+void pepper_telemetry_flush(void)
+{
+    mutex_lock(&_telemetry.lock);
+    _frame_send();
+    mutex_unlock(&_telemetry.lock);
+}
+
+void pepper_telemetry_get_stats(pepper_telemetry_stats_t *stats)
+{
+    mutex_lock(&_telemetry.lock);
+    *stats = _telemetry.stats;
+    mutex_unlock(&_telemetry.lock);
+}
+
+static void _flush_handler(event_t *event)
+{
+    (void)event;
+    pepper_telemetry_flush();
+}
+
+static int _gap_event_cb(struct ble_gap_event *event, void *arg)
+{
+    (void)arg;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        if (event->subscribe.attr_handle != _val_handle) {
+            break;
+        }
+        mutex_lock(&_telemetry.lock);
+        if (event->subscribe.cur_notify) {
+            LOG_INFO("[pepper] telemetry: subscribed\n");
+            _telemetry.conn_handle = event->subscribe.conn_handle;
+        }
+        else if (event->subscribe.conn_handle == _telemetry.conn_handle) {
+            _telemetry.conn_handle = BLE_HS_CONN_HANDLE_NONE;
+            _telemetry.len = 0;
+        }
+        mutex_unlock(&_telemetry.lock);
+        break;
+    case BLE_GAP_EVENT_DISCONNECT:
+        mutex_lock(&_telemetry.lock);
+        if (event->disconnect.conn.conn_handle == _telemetry.conn_handle) {
+            _telemetry.conn_handle = BLE_HS_CONN_HANDLE_NONE;
+            _telemetry.len = 0;
+        }
+        mutex_unlock(&_telemetry.lock);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void pepper_telemetry_init(void)
+{
+    _telemetry.flush.handler = _flush_handler;
+    event_timeout_ztimer_init(&_telemetry.flush_timeout, ZTIMER_MSEC,
+                              CONFIG_PEPPER_LOW_EVENT_PRIO, &_telemetry.flush);
+    ble_gap_event_listener_register(&_gap_listener, _gap_event_cb, NULL);
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_pepper_srv
+ * @{
+ *
+ * @file
+ * @brief       Asynchronous per-endpoint dispatch implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "event.h"
+#include "kernel_defines.h"
+#include "thread.h"
+#include "ztimer.h"
+
+#include "pepper_srv.h"
+#include "pepper_srv_async.h"
+#include "pepper_srv_ring.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+typedef struct {
+    const pepper_srv_endpoint_t *endpoint;
+    event_queue_t *queue;
+    event_queue_t own_queue;
+    event_t epoch_evt;
+    event_t uwb_evt;
+    event_t ble_evt;
+    event_t inf_evt;
+    epoch_data_t *epoch_data;
+    bool infected;
+    uint32_t epoch_posted;
+    uint32_t uwb_posted;
+    uint32_t ble_posted;
+    uint32_t inf_posted;
+    pepper_srv_ring_t uwb_ring;
+    ed_uwb_data_t uwb_buf[CONFIG_PEPPER_SRV_ASYNC_BACKLOG];
+    atomic_bool uwb_ready[CONFIG_PEPPER_SRV_ASYNC_BACKLOG];
+    pepper_srv_ring_t ble_ring;
+    ed_ble_data_t ble_buf[CONFIG_PEPPER_SRV_ASYNC_BACKLOG];
+    atomic_bool ble_ready[CONFIG_PEPPER_SRV_ASYNC_BACKLOG];
+    uint32_t jobs;
+    uint32_t dropped;
+    uint32_t latency_last;
+    uint32_t latency_max;
+    uint32_t latency_sum;
+} _worker_t;
+
+static _worker_t _workers[CONFIG_PEPPER_SRV_ASYNC_ENDPOINTS_MAX];
+static uint8_t _workers_numof = 0;
+/* endpoints without a stack of their own share this worker */
+static event_queue_t _shared_queue;
+static char _shared_stack[CONFIG_PEPPER_SRV_ASYNC_STACKSIZE];
+static kernel_pid_t _shared_pid = KERNEL_PID_UNDEF;
+
+static _worker_t *_get_worker(uint8_t idx)
+{
+    return idx < _workers_numof ? &_workers[idx] : NULL;
+}
+
+static void _account(_worker_t *worker, uint32_t posted)
+{
+    uint32_t latency = ztimer_now(ZTIMER_MSEC) - posted;
+
+    worker->jobs++;
+    worker->latency_last = latency;
+    worker->latency_sum += latency;
+    if (latency > worker->latency_max) {
+        worker->latency_max = latency;
+    }
+}
+
+static void _epoch_handler(event_t *event)
+{
+    _worker_t *worker = container_of(event, _worker_t, epoch_evt);
+    epoch_data_t *data = worker->epoch_data;
+
+    worker->endpoint->notify_epoch_data(data);
+    worker->epoch_data = NULL;
+    pepper_srv_epoch_data_release();
+    _account(worker, worker->epoch_posted);
+}
+
+static void _uwb_handler(event_t *event)
+{
+    _worker_t *worker = container_of(event, _worker_t, uwb_evt);
+    void *elems;
+    size_t count;
+
+    while ((count = pepper_srv_ring_peek(&worker->uwb_ring, &elems))) {
+        worker->endpoint->notify_uwb_data(elems, count);
+        pepper_srv_ring_release(&worker->uwb_ring, count);
+    }
+    _account(worker, worker->uwb_posted);
+}
+
+static void _ble_handler(event_t *event)
+{
+    _worker_t *worker = container_of(event, _worker_t, ble_evt);
+    void *elems;
+    size_t count;
+
+    while ((count = pepper_srv_ring_peek(&worker->ble_ring, &elems))) {
+        worker->endpoint->notify_ble_data(elems, count);
+        pepper_srv_ring_release(&worker->ble_ring, count);
+    }
+    _account(worker, worker->ble_posted);
+}
+
+static void _inf_handler(event_t *event)
+{
+    _worker_t *worker = container_of(event, _worker_t, inf_evt);
+
+    worker->endpoint->notify_infection(worker->infected);
+    _account(worker, worker->inf_posted);
+}
+
+static void *_worker_thread(void *arg)
+{
+    event_queue_t *queue = arg;
+
+    event_queue_claim(queue);
+    event_loop(queue);
+    return NULL;
+}
+
+static event_queue_t *_worker_queue(_worker_t *worker)
+{
+    const pepper_srv_endpoint_t *endpoint = worker->endpoint;
+
+    if (endpoint->stack) {
+        event_queue_init_detached(&worker->own_queue);
+        thread_create(endpoint->stack, endpoint->stacksize,
+                      CONFIG_PEPPER_SRV_ASYNC_PRIO, THREAD_CREATE_STACKTEST,
+                      _worker_thread, &worker->own_queue, "pepper_srv_ep");
+        return &worker->own_queue;
+    }
+    if (_shared_pid == KERNEL_PID_UNDEF) {
+        event_queue_init_detached(&_shared_queue);
+        _shared_pid = thread_create(_shared_stack, sizeof(_shared_stack),
+                                    CONFIG_PEPPER_SRV_ASYNC_PRIO,
+                                    THREAD_CREATE_STACKTEST, _worker_thread,
+                                    &_shared_queue, "pepper_srv_async");
+    }
+    return &_shared_queue;
+}
+
+int pepper_srv_async_init(uint8_t idx, const pepper_srv_endpoint_t *endpoint)
+{
+    if (idx >= CONFIG_PEPPER_SRV_ASYNC_ENDPOINTS_MAX) {
+        LOG_ERROR("[pepper_srv] async: too many endpoints\n");
+        return -ENOMEM;
+    }
+
+    _worker_t *worker = &_workers[idx];
+
+    memset(worker, '\0', sizeof(*worker));
+    worker->endpoint = endpoint;
+    worker->epoch_evt.handler = _epoch_handler;
+    worker->uwb_evt.handler = _uwb_handler;
+    worker->ble_evt.handler = _ble_handler;
+    worker->inf_evt.handler = _inf_handler;
+    pepper_srv_ring_init(&worker->uwb_ring, worker->uwb_buf, worker->uwb_ready,
+                         sizeof(ed_uwb_data_t), CONFIG_PEPPER_SRV_ASYNC_BACKLOG);
+    pepper_srv_ring_init(&worker->ble_ring, worker->ble_buf, worker->ble_ready,
+                         sizeof(ed_ble_data_t), CONFIG_PEPPER_SRV_ASYNC_BACKLOG);
+    worker->queue = _worker_queue(worker);
+    _workers_numof = idx + 1 > _workers_numof ? idx + 1 : _workers_numof;
+
+    /* endpoint internal events are serialized with its notifications */
+    return endpoint->init(worker->queue);
+}
+
+int pepper_srv_async_epoch_data(uint8_t idx, epoch_data_t *data)
+{
+    _worker_t *worker = _get_worker(idx);
+
+    if (!worker) {
+        return -EINVAL;
+    }
+
+    if (worker->epoch_data) {
+        worker->dropped++;
+        return -EBUSY;
+    }
+    worker->epoch_data = data;
+    worker->epoch_posted = ztimer_now(ZTIMER_MSEC);
+    event_post(worker->queue, &worker->epoch_evt);
+    return 0;
+}
+
+static int _queue_samples(_worker_t *worker, pepper_srv_ring_t *ring,
+                          event_t *event, uint32_t *posted,
+                          const uint8_t *data, size_t elem_size, size_t len)
+{
+    int res = 0;
+    bool was_empty;
+
+    for (size_t i = 0; i < len; i++) {
+        if (pepper_srv_ring_push(ring, &data[i * elem_size], &was_empty)) {
+            worker->dropped++;
+            res = -ENOMEM;
+        }
+        else if (was_empty) {
+            *posted = ztimer_now(ZTIMER_MSEC);
+        }
+    }
+    event_post(worker->queue, event);
+    return res;
+}
+
+int pepper_srv_async_uwb_data(uint8_t idx, ed_uwb_data_t *data, size_t len)
+{
+    _worker_t *worker = _get_worker(idx);
+
+    if (!worker) {
+        return -EINVAL;
+    }
+
+    return _queue_samples(worker, &worker->uwb_ring, &worker->uwb_evt,
+                          &worker->uwb_posted, (uint8_t *)data,
+                          sizeof(ed_uwb_data_t), len);
+}
+
+int pepper_srv_async_ble_data(uint8_t idx, ed_ble_data_t *data, size_t len)
+{
+    _worker_t *worker = _get_worker(idx);
+
+    if (!worker) {
+        return -EINVAL;
+    }
+
+    return _queue_samples(worker, &worker->ble_ring, &worker->ble_evt,
+                          &worker->ble_posted, (uint8_t *)data,
+                          sizeof(ed_ble_data_t), len);
+}
+
+void pepper_srv_async_infection(uint8_t idx, bool infected)
+{
+    _worker_t *worker = _get_worker(idx);
+
+    if (!worker) {
+        return;
+    }
+
+    /* only the latest status matters, a pending update is simply refreshed */
+    worker->infected = infected;
+    worker->inf_posted = ztimer_now(ZTIMER_MSEC);
+    event_post(worker->queue, &worker->inf_evt);
+}
+
+int pepper_srv_async_stats(uint8_t idx, pepper_srv_endpoint_stats_t *stats)
+{
+    _worker_t *worker = _get_worker(idx);
+    pepper_srv_ring_stats_t uwb;
+    pepper_srv_ring_stats_t ble;
+
+    if (!worker) {
+        return -EINVAL;
+    }
+    pepper_srv_ring_stats(&worker->uwb_ring, &uwb);
+    pepper_srv_ring_stats(&worker->ble_ring, &ble);
+    stats->jobs = worker->jobs;
+    stats->dropped = worker->dropped;
+    stats->latency_last_ms = worker->latency_last;
+    stats->latency_max_ms = worker->latency_max;
+    stats->latency_avg_ms = worker->jobs ? worker->latency_sum / worker->jobs : 0;
+    stats->backlog = pepper_srv_ring_used(&worker->uwb_ring) +
+                     pepper_srv_ring_used(&worker->ble_ring);
+    stats->backlog_hwm = uwb.high_watermark > ble.high_watermark ?
+                         uwb.high_watermark : ble.high_watermark;
+    return 0;
+}
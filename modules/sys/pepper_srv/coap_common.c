@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_pepper_srv
+ * @{
+ *
+ * @file
+ * @brief       State shared by the CoAP and CoAPS endpoints
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <stdio.h>
+
+#include "pepper.h"
+#include "pepper_srv_coap.h"
+#include "coap/utils.h"
+#include "ztimer.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_DEBUG
+#endif
+#include "log.h"
+
+void pepper_srv_coap_common_init(pepper_srv_coap_common_t *common,
+                                 coap_req_cb_t esr_cb, void *arg)
+{
+    sprintf(common->ertl_uri, "/%s/ertl", pepper_get_uid_str());
+    sprintf(common->inf_uri, "/%s/infected", pepper_get_uid_str());
+    sprintf(common->esr_uri, "/%s/esr", pepper_get_uid_str());
+    mutex_init(&common->ertl_lock);
+    common->esr_obs_tried = false;
+    common->esr_known = false;
+
+    coap_init_remote(&common->remote, CONFIG_PEPPER_SRV_COAP_HOST,
+                     CONFIG_PEPPER_SRV_COAP_PORT);
+    coap_obs_ctx_init(&common->esr_obs, esr_cb, arg);
+    /* the server notifies status changes from now on, if it cannot be
+       reached yet this is retried on every exposure request */
+    pepper_srv_coap_esr_observe(common);
+}
+
+void pepper_srv_coap_esr_observe(pepper_srv_coap_common_t *common)
+{
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+
+    if (coap_obs_is_registered(&common->esr_obs) ||
+        (common->esr_obs_tried &&
+         now - common->esr_obs_last < CONFIG_PEPPER_SRV_COAP_OBS_RETRY_MS)) {
+        return;
+    }
+    common->esr_obs_tried = true;
+    common->esr_obs_last = now;
+
+    LOG_INFO("[pepper_srv] coap: observe esr at %s\n", common->esr_uri);
+    if (coap_observe(&common->remote, &common->esr_obs, common->esr_uri,
+                     COAP_FORMAT_CBOR) < 0) {
+        LOG_DEBUG("[pepper_srv] coap: esr observe failed\n");
+    }
+}
+
+void pepper_srv_coap_common_set_remote(pepper_srv_coap_common_t *common,
+                                       char *addr_str, uint16_t port)
+{
+    coap_observe_cancel(&common->esr_obs);
+    common->esr_obs_tried = false;
+    common->esr_known = false;
+    coap_init_remote(&common->remote, addr_str, port);
+    pepper_srv_coap_esr_observe(common);
+}
+
+void pepper_srv_coap_ertl_done(int res, void *data, size_t data_len, void *arg)
+{
+    pepper_srv_coap_common_t *common = arg;
+
+    (void)data;
+    (void)data_len;
+    if (res != 0) {
+        LOG_WARNING("[pepper_srv] coap: ertl upload failed=(%d)\n", res);
+    }
+    mutex_unlock(&common->ertl_lock);
+}
@@ -27,33 +27,75 @@
 
 #include "xfa.h"
 #include "mutex.h"
+#include "ztimer.h"
 #include "event/callback.h"
 #include "event/timeout.h"
 
 #include "security_ctx.h"
 #include "edhoc/coap.h"
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
+
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+#include "mtd_flashpage.h"
+#include "periph/flashpage.h"
+#if IS_USED(MODULE_STORAGE_FLASHLOG)
+#include "storage.h"
+#endif
+#endif
 
 #ifndef CONFIG_COAPS_ERTL_PAYLOAD_BUFFER
 #define CONFIG_COAPS_ERTL_PAYLOAD_BUFFER            1024
 #endif
 
-#ifndef CONFIG_COAPS_ERTL_COSE_BUFFER
-#define CONFIG_COAPS_ERTL_COSE_BUFFER               1546
+/**
+ * @brief   Size of the buffer encrypted exposure status notifications are
+ *          copied to before being decrypted on the endpoint queue
+ */
+#ifndef CONFIG_COAPS_ESR_PAYLOAD_BUFFER
+#define CONFIG_COAPS_ESR_PAYLOAD_BUFFER             SECURITY_CTX_ENCODE_BUF_LEN(16)
+#endif
+
+/**
+ * @brief   Time in ms to wait before retrying a failed EDHOC key exchange
+ */
+#ifndef CONFIG_COAPS_HANDSHAKE_RETRY_WAIT
+#define CONFIG_COAPS_HANDSHAKE_RETRY_WAIT           (30 * MS_PER_SEC)
 #endif
 
-#ifndef CONFIG_COAPS_INF_COSE_BUFFER
-#define CONFIG_COAPS_INF_COSE_BUFFER                128
+/**
+ * @brief   Set up the security context and EDHOC credentials on first use
+ *          instead of on init
+ *
+ * The credentials parsing, context restore and key exchange are then left
+ * out of the boot and start with the first upload or notification.
+ */
+#ifndef CONFIG_COAPS_EDHOC_LAZY_INIT
+#define CONFIG_COAPS_EDHOC_LAZY_INIT                0
 #endif
 
-#ifndef CONFIG_COAPS_ESR_COSE_BUFFER
-#define CONFIG_COAPS_ESR_COSE_BUFFER                128
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST) || defined(DOXYGEN)
+/**
+ * @brief   Number of internal flash pages the security context is kept in
+ */
+#ifndef CONFIG_COAPS_SECURITY_CTX_PAGES
+#define CONFIG_COAPS_SECURITY_CTX_PAGES             (2U)
 #endif
 
 /**
- * @brief   Frequency in seconds at which attemp EDHOC keys exchanges
+ * @brief   First internal flash page the security context is kept in, right
+ *          below the storage flash log if used
  */
-#ifndef CONFIG_COAPS_HANDSHAKE_RETRY_WAIT
-#define CONFIG_COAPS_HANDSHAKE_RETRY_WAIT           (30 * MS_PER_SEC)
+#ifndef CONFIG_COAPS_SECURITY_CTX_FIRST_PAGE
+#if IS_USED(MODULE_STORAGE_FLASHLOG)
+#define CONFIG_COAPS_SECURITY_CTX_FIRST_PAGE        \
+    (CONFIG_STORAGE_FLASHLOG_FIRST_PAGE - CONFIG_COAPS_SECURITY_CTX_PAGES)
+#else
+#define CONFIG_COAPS_SECURITY_CTX_FIRST_PAGE        \
+    (FLASHPAGE_NUMOF - CONFIG_COAPS_SECURITY_CTX_PAGES)
+#endif
+#endif
 #endif
 
 #ifndef LOG_LEVEL
@@ -70,103 +112,187 @@ static struct {
 
 static event_queue_t *_evt_queue;
 
-/* TODO: these could be moved to common module */
-static sock_udp_ep_t _remote;
-static coap_req_ctx_t _get_ctx;
-static coap_block_ctx_t _block_ctx;
-static char _ertl_uri[sizeof("/DW") + sizeof("/ertl") + 2 * PEPPER_UID_LEN];
-static char _inf_uri[sizeof("/DW") + sizeof("/infected") + 2 * PEPPER_UID_LEN];
-static char _esr_uri[sizeof("/DW") + sizeof("/esr") + 2 * PEPPER_UID_LEN];
-static mutex_t _wait_esr = MUTEX_INIT;
+static pepper_srv_coap_common_t _common;
 
 static security_ctx_t _sec_ctx;
 static edhoc_coap_ctx_t _edhoc_ctx;
-/* pointer to the encrypted cose object */
 /* TODO: this should handle the worst scenario CBOR length */
-static uint8_t _ertl_buf[CONFIG_COAPS_ERTL_PAYLOAD_BUFFER];
-static uint8_t _ertl_cose_buf[CONFIG_COAPS_ERTL_COSE_BUFFER];
-static uint8_t _esr_cose_buf[CONFIG_COAPS_ESR_COSE_BUFFER];
-static uint8_t _inf_cose_buf[CONFIG_COAPS_INF_COSE_BUFFER];
-
-/* instead of periodic handshake we will try a handshake whenever we need
-   to send, and if we fail block retries for a while */
-static void _handshake_reset(void *arg);
-static bool _handshake_retry = true;
+/* the ertl is serialized after SECURITY_CTX_HEADROOM and encrypted in place */
+static uint8_t _ertl_buf[SECURITY_CTX_ENCODE_BUF_LEN(CONFIG_COAPS_ERTL_PAYLOAD_BUFFER)];
+
+/* the key exchange runs on the endpoint queue ahead of need, on failure it
+   is retried every CONFIG_COAPS_HANDSHAKE_RETRY_WAIT until it succeeds */
+static void _handshake_start(void *arg);
+static bool _handshake_pending = false;
+static bool _security_ready = false;
 static event_timeout_t _handshake_timeout;
 static event_callback_t _handshake_event = EVENT_CALLBACK_INIT(
-    _handshake_reset, NULL
+    _handshake_start, NULL
     );
 
-static void _handshake_reset(void *arg)
+/* notifications arrive on the gcoap thread, they are copied and decrypted
+   on the endpoint queue that owns the security context */
+static void _esr_decode(void *arg);
+static mutex_t _esr_lock = MUTEX_INIT;
+static uint8_t _esr_buf[CONFIG_COAPS_ESR_PAYLOAD_BUFFER];
+static size_t _esr_len;
+static event_callback_t _esr_event = EVENT_CALLBACK_INIT(_esr_decode, NULL);
+
+/* a remote change invalidates the context on the endpoint queue as well */
+static void _invalidate(void *arg);
+static event_callback_t _invalidate_event = EVENT_CALLBACK_INIT(_invalidate, NULL);
+
+static void _handshake_done(edhoc_coap_ctx_t *ctx, int res, void *arg)
 {
     (void)arg;
-    _handshake_retry = true;
+    if (res == 0 && security_ctx_edhoc_derive(&_sec_ctx, &ctx->ctx) == 0) {
+        _handshake_pending = false;
+        return;
+    }
+    LOG_WARNING("[pepper_srv] coaps: handshake failed, retry in %" PRIu32 "ms\n",
+                (uint32_t)CONFIG_COAPS_HANDSHAKE_RETRY_WAIT);
+    event_timeout_set(&_handshake_timeout, CONFIG_COAPS_HANDSHAKE_RETRY_WAIT);
 }
 
-static bool _check_security_ctx(void)
+static void _handshake_start(void *arg)
 {
-    if (_sec_ctx.valid == false && _handshake_retry) {
-        security_ctx_edhoc_handshake(&_sec_ctx, &_edhoc_ctx.ctx, &_remote);
-        _handshake_retry = false;
+    (void)arg;
+    if (edhoc_coap_handshake_start(&_edhoc_ctx, &_common.remote, _evt_queue,
+                                   EDHOC_AUTH_SIGN_SIGN, EDHOC_CIPHER_SUITE_0,
+                                   _handshake_done, NULL) < 0) {
         event_timeout_set(&_handshake_timeout, CONFIG_COAPS_HANDSHAKE_RETRY_WAIT);
     }
+}
+
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+static mtd_flashpage_t _mtd_flashpage = MTD_FLASHPAGE_INIT_VAL(1);
+
+static void _security_ctx_restore(void)
+{
+    if (mtd_init(&_mtd_flashpage.base) < 0 ||
+        security_ctx_persist_init(&_mtd_flashpage.base,
+                                  CONFIG_COAPS_SECURITY_CTX_FIRST_PAGE,
+                                  CONFIG_COAPS_SECURITY_CTX_PAGES) < 0) {
+        LOG_WARNING("[pepper_srv] coaps: security context not persisted\n");
+        return;
+    }
+    /* a restored context spares the key exchange after a reboot */
+    if (security_ctx_restore(&_sec_ctx) == 0) {
+        LOG_INFO("[pepper_srv] coaps: restored security context\n");
+    }
+}
+#endif
+
+static void _security_setup(void);
+
+static bool _check_security_ctx(void)
+{
+    if (!_security_ready) {
+        _security_setup();
+    }
+    /* never blocks, a missing context triggers a key exchange in the
+       background and the caller simply tries again later */
+    if (_sec_ctx.valid == false && !_handshake_pending) {
+        _handshake_pending = true;
+        event_post(_evt_queue, &_handshake_event.super);
+    }
     return _sec_ctx.valid;
 }
 
-void _esr_callback(int res, void *data, size_t data_len, void *arg)
+static void _esr_decode(void *arg)
 {
     (void)arg;
-    if (res != 0 || (data_len == 0 || data == NULL)) {
-        LOG_DEBUG("[pepper_srv] coaps: esr get failed=(%d)\n", res);
-        mutex_unlock(&_wait_esr);
-        goto exit;
-    }
+    uint8_t buf[CONFIG_COAPS_ESR_PAYLOAD_BUFFER];
+
+    mutex_lock(&_esr_lock);
+    size_t len = _esr_len;
+    memcpy(buf, _esr_buf, len);
+    mutex_unlock(&_esr_lock);
+
     if (_check_security_ctx()) {
-        uint8_t out[32];
+        uint8_t *out;
         size_t out_len = 0;
         LOG_INFO("[pepper_srv] coaps: decrypt esr... ");
-        int ret = security_ctx_decode(
-            &_sec_ctx, data, data_len, _esr_cose_buf, sizeof(_esr_cose_buf), out, &out_len);
+        int ret = security_ctx_decode(&_sec_ctx, buf, len, &out, &out_len);
         if (ret == 0) {
             LOG_INFO("success\n");
-            pepper_srv_esr_load_cbor(out, out_len, &_coap_state.exposed);
-            goto exit;
+            if (pepper_srv_esr_load_cbor(out, out_len, &_coap_state.exposed) == 0) {
+                _common.esr_known = true;
+            }
+            return;
         }
         /* if failed to decode assume ctx is no longer valid */
-        _sec_ctx.valid = false;
+        security_ctx_invalidate(&_sec_ctx);
         LOG_INFO("failed\n");
-        goto exit;
     }
-
-    exit:
-        mutex_unlock(&_wait_esr);
 }
 
-int _coaps_srv_init(event_queue_t *evt_queue)
+static void _invalidate(void *arg)
 {
-    _evt_queue = evt_queue;
-    sprintf(_ertl_uri, "/%s/ertl", pepper_get_uid_str());
-    sprintf(_inf_uri, "/%s/infected", pepper_get_uid_str());
-    sprintf(_esr_uri, "/%s/esr", pepper_get_uid_str());
-
-    coap_init_remote(&_remote, CONFIG_PEPPER_SRV_COAP_HOST, CONFIG_PEPPER_SRV_COAP_PORT);
+    (void)arg;
+    if (_security_ready) {
+        security_ctx_invalidate(&_sec_ctx);
+    }
+}
 
-    coap_req_ctx_init(&_get_ctx, _esr_callback, NULL);
-    coap_req_ctx_init(&_block_ctx.req_ctx, NULL, NULL);
+void _esr_callback(int res, void *data, size_t data_len, void *arg)
+{
+    (void)arg;
+    if (res != 0 || (data_len == 0 || data == NULL)) {
+        LOG_DEBUG("[pepper_srv] coaps: esr notification failed=(%d)\n", res);
+        return;
+    }
+    if (data_len > sizeof(_esr_buf)) {
+        LOG_WARNING("[pepper_srv] coaps: esr notification too large\n");
+        return;
+    }
+    /* only the latest status matters, a notification still waiting to be
+       decoded is overwritten */
+    mutex_lock(&_esr_lock);
+    memcpy(_esr_buf, data, data_len);
+    _esr_len = data_len;
+    mutex_unlock(&_esr_lock);
+    event_post(_evt_queue, &_esr_event.super);
+}
 
+static void _security_setup(void)
+{
+    _security_ready = true;
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_EDHOC_INIT);
+#endif
     security_ctx_init(&_sec_ctx, (uint8_t *)pepper_get_uid_str(), strlen(pepper_get_uid_str()),
                       (uint8_t *)pepper_server_id, sizeof(pepper_server_id));
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+    _security_ctx_restore();
+#endif
 
     /* setup initiator context */
     if (edhoc_coap_init(&_edhoc_ctx, EDHOC_IS_INITIATOR, (uint8_t *)pepper_get_uid_str(),
                         strlen(pepper_get_uid_str())) == 0) {
         event_timeout_ztimer_init(&_handshake_timeout, ZTIMER_MSEC, _evt_queue,
                                   &_handshake_event.super);
-        _handshake_retry = true;
     }
     else {
+        /* without credentials no key exchange is ever attempted */
+        _handshake_pending = true;
         LOG_ERROR("[pepper_srv] coaps: failed to initialize security\n");
     }
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_EDHOC_INIT);
+#endif
+}
+
+int _coaps_srv_init(event_queue_t *evt_queue)
+{
+    _evt_queue = evt_queue;
+    pepper_srv_coap_common_init(&_common, _esr_callback, NULL);
+
+    if (!IS_ACTIVE(CONFIG_COAPS_EDHOC_LAZY_INIT)) {
+        /* derive the keys right away instead of on the first upload,
+           unless a persisted context was restored */
+        _check_security_ctx();
+    }
 
     return 0;
 }
@@ -178,31 +304,38 @@ int _coaps_srv_notify_epoch_data(epoch_data_t *epoch_data)
         return -1;
     }
 
-    if (!mutex_trylock(&_block_ctx.req_ctx.resp_wait)) {
-        LOG_DEBUG("[pepper_srv] coaps: block context is not freed\n");
+    if (!mutex_trylock(&_common.ertl_lock)) {
+        LOG_DEBUG("[pepper_srv] coaps: previous ertl upload in progress\n");
         return -1;
     }
-    mutex_unlock(&_block_ctx.req_ctx.resp_wait);
 
-    size_t data_len = contact_data_serialize_all_cbor(epoch_data, _ertl_buf, sizeof(_ertl_buf));
+    uint8_t *payload = _ertl_buf + SECURITY_CTX_HEADROOM;
+    size_t data_len = contact_data_serialize_all_cbor(epoch_data, payload,
+                                                      CONFIG_COAPS_ERTL_PAYLOAD_BUFFER);
 
-    /* pointer to encrypted object location, since we are blocking on send it can
-       remain in function context */
+    /* pointer to encrypted object location inside _ertl_buf, which stays
+       reserved by the ertl lock until the upload ends */
     uint8_t *_ertl_cose_ptr = NULL;
-    size_t cose_len = security_ctx_encode(&_sec_ctx,
-                                            _ertl_buf, data_len,
-                                            _ertl_cose_buf, sizeof(_ertl_cose_buf),
-                                            &_ertl_cose_ptr);
+    int cose_len = security_ctx_encode(&_sec_ctx, payload, data_len,
+                                       _ertl_buf, sizeof(_ertl_buf),
+                                       &_ertl_cose_ptr);
+    if (cose_len < 0) {
+        LOG_WARNING("[pepper_srv] coaps: failed to encrypt ertl\n");
+        mutex_unlock(&_common.ertl_lock);
+        return -1;
+    }
     LOG_INFO("[pepper_srv] coaps: encrypted ertl, len=(%d)\n", cose_len);
 
-    if (coap_block_post(&_remote, &_block_ctx, _ertl_cose_ptr, cose_len,
-                        _ertl_uri, COAP_FORMAT_CBOR, COAP_TYPE_NON) < 0) {
+    /* non blocking, the ertl buffers are released once the upload ends */
+    coap_block_ctx_t *ctx = coap_block_ctx_alloc(pepper_srv_coap_ertl_done,
+                                                 &_common, 0);
+    if (!ctx || coap_block_post(&_common.remote, ctx, _ertl_cose_ptr, cose_len,
+                                _common.ertl_uri, COAP_FORMAT_CBOR) < 0) {
 
         LOG_WARNING("[pepper_srv] coaps: ERROR in block post\n");
+        mutex_unlock(&_common.ertl_lock);
+        return -1;
     }
-    /* force a blocking wait */
-    mutex_lock(&_block_ctx.req_ctx.resp_wait);
-    mutex_unlock(&_block_ctx.req_ctx.resp_wait);
     return 0;
 }
 
@@ -214,23 +347,26 @@ int _coaps_srv_notify_infection(bool infected)
     }
 
     _coap_state.infected = infected;
-    uint8_t buf[8];
+    uint8_t buf[SECURITY_CTX_ENCODE_BUF_LEN(8)];
 
     /* serialize */
-    size_t len = pepper_srv_infected_serialize_cbor(buf, sizeof(buf), infected);
+    size_t len = pepper_srv_infected_serialize_cbor(buf + SECURITY_CTX_HEADROOM, 8,
+                                                    infected);
 
     LOG_INFO("[pepper_srv] coaps: serialize infected=%s, len=(%d)\n",
              infected ? "true": "false", len);
 
-    /* encrypt */
+    /* encrypt in place */
     uint8_t *out = NULL;
-    size_t out_len = security_ctx_encode(&_sec_ctx,
-                                         buf, len,
-                                         _inf_cose_buf, sizeof(_inf_cose_buf),
-                                         &out);
+    int out_len = security_ctx_encode(&_sec_ctx, buf + SECURITY_CTX_HEADROOM, len,
+                                      buf, sizeof(buf), &out);
+    if (out_len < 0) {
+        return out_len;
+    }
     LOG_INFO("[pepper_srv] coaps: encrypted infected status, len=(%d)\n", out_len);
 
-    return coap_post(&_remote, NULL, out, out_len, _inf_uri, COAP_FORMAT_CBOR, COAP_TYPE_CON);
+    return coap_post(&_common.remote, NULL, out, out_len, _common.inf_uri,
+                     COAP_FORMAT_CBOR, COAP_TYPE_CON);
 }
 
 int _coaps_srv_request_exposure(bool *esr /*out*/)
@@ -242,31 +378,27 @@ int _coaps_srv_request_exposure(bool *esr /*out*/)
         return -1;
     }
 
-    if (!coap_req_ctx_is_free(&_get_ctx)) {
-        LOG_DEBUG("[pepper_srv] coaps: get context is not freed\n");
+    /* answered from the cached notified status, no request is sent once
+       the Observe relationship is established */
+    pepper_srv_coap_esr_observe(&_common);
+    if (!_common.esr_known) {
+        LOG_DEBUG("[pepper_srv] coaps: esr not notified yet\n");
         return -1;
     }
-
-    LOG_INFO("[pepper_srv] coaps: fetch esr at %s\n", _esr_uri);
-
-    /* non blocking get */
-    if (coap_get(&_remote, &_get_ctx, _esr_uri, COAP_FORMAT_CBOR, COAP_TYPE_NON) < 0) {
-        return -1;
-    }
-
-    /* TODO: rexamine this, this is faking the blocking part the signature requires */
-    mutex_lock(&_wait_esr);
     return 0;
 }
 
 void pepper_srv_coap_init_remote(char *addr_str, uint16_t port)
 {
-    coap_init_remote(&_remote, addr_str, port);
+    /* keys were derived with the previous server, invalidated ahead of any
+       new key exchange since both run on the endpoint queue */
+    event_post(_evt_queue, &_invalidate_event.super);
+    pepper_srv_coap_common_set_remote(&_common, addr_str, port);
 }
 
 XFA_CONST(pepper_srv_endpoints, 0) pepper_srv_endpoint_t _pepper_srv_coaps = {
     .init = _coaps_srv_init,
     .notify_epoch_data = _coaps_srv_notify_epoch_data,
     .notify_infection = _coaps_srv_notify_infection,
-    .request_exposure = _coaps_srv_request_exposure
+    .request_exposure = _coaps_srv_request_exposure,
 };
@@ -1,4 +1,10 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
 #include "pepper_srv.h"
+#include "pepper_srv_ring.h"
+#include "pepper_srv_async.h"
 #include "event.h"
 #include "event/callback.h"
 #include "event/thread.h"
@@ -8,6 +14,9 @@
 #include "ztimer.h"
 #include "timex.h"
 #include "random.h"
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_WARNING
@@ -18,11 +27,14 @@ XFA_INIT_CONST(pepper_srv_endpoint_t, pepper_srv_endpoints);
 
 static uint8_t number_endpoints = 0;
 static epoch_data_t _epoch_data;
-static ed_uwb_data_t _uwb_data;
-static ed_ble_data_t _ble_data;
+static ed_uwb_data_t _uwb_buf[CONFIG_PEPPER_SRV_UWB_RING_SIZE];
+static atomic_bool _uwb_ready[CONFIG_PEPPER_SRV_UWB_RING_SIZE];
+static pepper_srv_ring_t _uwb_ring;
+static ed_ble_data_t _ble_buf[CONFIG_PEPPER_SRV_BLE_RING_SIZE];
+static atomic_bool _ble_ready[CONFIG_PEPPER_SRV_BLE_RING_SIZE];
+static pepper_srv_ring_t _ble_ring;
 static mutex_t _epoch_lock = MUTEX_INIT;
-static mutex_t _uwb_lock = MUTEX_INIT;
-static mutex_t _ble_lock = MUTEX_INIT;
+static atomic_uint _epoch_refs;
 static event_queue_t *_evt_queue = NULL;
 static event_timeout_t _notify_epoch_timeout;
 static event_timeout_t _notify_uwb_timeout;
@@ -59,47 +71,125 @@ void pepper_srv_data_submit(epoch_data_t *data)
     }
 }
 
+/* drain a sample ring, handing contiguous batches to the endpoints */
+static void _drain(pepper_srv_ring_t *ring, event_timeout_t *timeout,
+                   int (*notify)(void *, size_t))
+{
+    void *elems;
+    size_t count;
+
+    while ((count = pepper_srv_ring_peek(ring, &elems))) {
+        notify(elems, count);
+        pepper_srv_ring_release(ring, count);
+    }
+    /* a producer might still be copying its sample, try again later */
+    if (pepper_srv_ring_used(ring)) {
+        event_timeout_set(timeout, random_uint32_range(5, 10));
+    }
+}
+
+static int _notify_uwb_batch(void *elems, size_t count)
+{
+    return pepper_srv_notify_uwb_data(elems, count);
+}
+
 /* callback to notify new uwb_data */
 static void _notify_uwb_data(void *arg)
 {
-    ed_uwb_data_t *data = (ed_uwb_data_t *)arg;
-
-    pepper_srv_notify_uwb_data(data);
+    (void)arg;
+    _drain(&_uwb_ring, &_notify_uwb_timeout, _notify_uwb_batch);
 }
 static event_callback_t _uwb_data_submit_event = EVENT_CALLBACK_INIT(
-    _notify_uwb_data, &_uwb_data);
+    _notify_uwb_data, NULL);
 
 void pepper_srv_uwb_data_submit(ed_uwb_data_t *data)
 {
-    /* try to acquire the lock, if failed, just drop the data */
-    if (mutex_trylock(&_uwb_lock)) {
-        memcpy(&_uwb_data, data, sizeof(ed_uwb_data_t));
-        event_timeout_set(&_notify_uwb_timeout, random_uint32_range(5, 10));
+    bool was_empty;
+
+    if (pepper_srv_ring_push(&_uwb_ring, data, &was_empty)) {
+        LOG_DEBUG("[pepper_srv]: dropped uwb data\n");
+        return;
     }
-    else {
-        printf("[pepper_srv]: dropped uwb data\n");
+    /* batch samples arriving within the notification delay */
+    if (was_empty) {
+        event_timeout_set(&_notify_uwb_timeout, random_uint32_range(5, 10));
     }
 }
 
+static int _notify_ble_batch(void *elems, size_t count)
+{
+    return pepper_srv_notify_ble_data(elems, count);
+}
+
 /* callback to notify new ble_data */
 static void _notify_ble_data(void *arg)
 {
-    ed_ble_data_t *data = (ed_ble_data_t *)arg;
-
-    pepper_srv_notify_ble_data(data);
+    (void)arg;
+    _drain(&_ble_ring, &_notify_ble_timeout, _notify_ble_batch);
 }
 static event_callback_t _ble_data_submit_event = EVENT_CALLBACK_INIT(
-    _notify_ble_data, &_ble_data);
+    _notify_ble_data, NULL);
 
 void pepper_srv_ble_data_submit(ed_ble_data_t *data)
 {
-    /* try to acquire the lock, if failed, just drop the data */
-    if (mutex_trylock(&_ble_lock)) {
-        memcpy(&_ble_data, data, sizeof(ed_ble_data_t));
+    bool was_empty;
+
+    if (pepper_srv_ring_push(&_ble_ring, data, &was_empty)) {
+        LOG_DEBUG("[pepper_srv]: dropped ble data\n");
+        return;
+    }
+    /* batch samples arriving within the notification delay */
+    if (was_empty) {
         event_timeout_set(&_notify_ble_timeout, random_uint32_range(5, 10));
     }
-    else {
-        printf("[pepper_srv]: dropped ble data\n");
+}
+
+void pepper_srv_uwb_stats(pepper_srv_ring_stats_t *stats)
+{
+    pepper_srv_ring_stats(&_uwb_ring, stats);
+}
+
+void pepper_srv_ble_stats(pepper_srv_ring_stats_t *stats)
+{
+    pepper_srv_ring_stats(&_ble_ring, stats);
+}
+
+static void _print_ring_stats(const char *name, pepper_srv_ring_t *ring)
+{
+    pepper_srv_ring_stats_t stats;
+
+    pepper_srv_ring_stats(ring, &stats);
+    printf("\t%s: submitted=%" PRIu32 ", dropped=%" PRIu32 ", batches=%" PRIu32
+           ", hwm=%" PRIu16 "/%" PRIu16 "\n", name, stats.submitted,
+           stats.dropped, stats.batches, stats.high_watermark, stats.size);
+}
+
+int pepper_srv_endpoint_stats(uint8_t idx, pepper_srv_endpoint_stats_t *stats)
+{
+    if (IS_USED(MODULE_PEPPER_SRV_ASYNC)) {
+        return pepper_srv_async_stats(idx, stats);
+    }
+    (void)idx;
+    (void)stats;
+    return -ENOTSUP;
+}
+
+void pepper_srv_print_stats(void)
+{
+    pepper_srv_endpoint_stats_t stats;
+
+    printf("[pepper_srv]: rings\n");
+    _print_ring_stats("uwb", &_uwb_ring);
+    _print_ring_stats("ble", &_ble_ring);
+    for (uint8_t i = 0; i < number_endpoints; i++) {
+        if (pepper_srv_endpoint_stats(i, &stats) == 0) {
+            printf("\tendpoint %d: jobs=%" PRIu32 ", dropped=%" PRIu32
+                   ", backlog=%" PRIu16 " (hwm=%" PRIu16 ")\n", i, stats.jobs,
+                   stats.dropped, stats.backlog, stats.backlog_hwm);
+            printf("\t\tlatency[ms]: last=%" PRIu32 ", avg=%" PRIu32
+                   ", max=%" PRIu32 "\n", stats.latency_last_ms,
+                   stats.latency_avg_ms, stats.latency_max_ms);
+        }
     }
 }
 
@@ -108,10 +198,17 @@ int pepper_srv_init(event_queue_t *evt_queue)
 {
     int ret = 0;
 
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_SRV_INIT);
+#endif
     LOG_INFO("[pepper_srv]: init\n");
     number_endpoints = XFA_LEN(pepper_srv_endpoint_t, pepper_srv_endpoints);
 
     _evt_queue = evt_queue; /* keep for internal event handling */
+    pepper_srv_ring_init(&_uwb_ring, _uwb_buf, _uwb_ready,
+                         sizeof(ed_uwb_data_t), CONFIG_PEPPER_SRV_UWB_RING_SIZE);
+    pepper_srv_ring_init(&_ble_ring, _ble_buf, _ble_ready,
+                         sizeof(ed_ble_data_t), CONFIG_PEPPER_SRV_BLE_RING_SIZE);
     event_timeout_ztimer_init(&_notify_epoch_timeout, ZTIMER_MSEC, _evt_queue,
                               &_epoch_data_submit_event.super);
     event_timeout_ztimer_init(&_notify_uwb_timeout, ZTIMER_MSEC, _evt_queue,
@@ -121,76 +218,96 @@ int pepper_srv_init(event_queue_t *evt_queue)
 
     LOG_INFO("[pepper_srv]: number_endpoints %d\n", number_endpoints);
     for (uint8_t i = 0; i < number_endpoints; i++) {
-        ret = pepper_srv_endpoints[i].init(evt_queue);
+        if (IS_USED(MODULE_PEPPER_SRV_ASYNC)) {
+            ret = pepper_srv_async_init(i, &pepper_srv_endpoints[i]);
+        }
+        else {
+            ret = pepper_srv_endpoints[i].init(evt_queue);
+        }
         if (ret) {
             ret |= (1 << i);
         }
     }
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_SRV_INIT);
+#endif
     return ret;
 }
 
+void pepper_srv_epoch_data_release(void)
+{
+    /* unlock epoch_data lock once all endpoints are done with it, allowing
+       for new data to be submitted */
+    if (atomic_fetch_sub(&_epoch_refs, 1) == 1) {
+        mutex_unlock(&_epoch_lock);
+    }
+}
+
 /* notify (non-blocking) : add to ring buffer and notify all endpoints
    (post event handler for doing this)*/
 int pepper_srv_notify_epoch_data(epoch_data_t *epoch_data)
 {
     int ret = 0;
 
-    /* Blocking calls : TODO check if useful to do it in async way by posting
-       event handler(s) */
+    /* hold a reference while dispatching */
+    atomic_store(&_epoch_refs, 1);
     for (uint8_t i = 0; i < number_endpoints; i++) {
         if (pepper_srv_endpoints[i].notify_epoch_data) {
-            ret = pepper_srv_endpoints[i].notify_epoch_data(epoch_data);
-            if (ret) {
+            if (IS_USED(MODULE_PEPPER_SRV_ASYNC)) {
+                atomic_fetch_add(&_epoch_refs, 1);
+                if (pepper_srv_async_epoch_data(i, epoch_data)) {
+                    pepper_srv_epoch_data_release();
+                    ret |= (1 << i);
+                }
+            }
+            else if (pepper_srv_endpoints[i].notify_epoch_data(epoch_data)) {
                 ret |= (1 << i);
             }
         }
     }
-    /* unlock epoch_data lock, allowing for new data to be submitted */
-    mutex_unlock(&_epoch_lock);
+    pepper_srv_epoch_data_release();
     return ret;
 }
 
 /* notify (non-blocking) : add to ring buffer and notify all endpoints
    (post event handler for doing this)*/
-int pepper_srv_notify_uwb_data(ed_uwb_data_t *data)
+int pepper_srv_notify_uwb_data(ed_uwb_data_t *data, size_t len)
 {
     int ret = 0;
 
-    LOG_INFO("[pepper_srv]: number_endpoints %d\n", number_endpoints);
-    /* Blocking calls : TODO check if useful to do it in async way by posting
-       event handler(s) */
     for (uint8_t i = 0; i < number_endpoints; i++) {
         if (pepper_srv_endpoints[i].notify_uwb_data) {
-            ret = pepper_srv_endpoints[i].notify_uwb_data(data);
-            if (ret) {
+            if (IS_USED(MODULE_PEPPER_SRV_ASYNC)) {
+                if (pepper_srv_async_uwb_data(i, data, len)) {
+                    ret |= (1 << i);
+                }
+            }
+            else if (pepper_srv_endpoints[i].notify_uwb_data(data, len)) {
                 ret |= (1 << i);
             }
         }
     }
-    /* unlock uwb_data lock, allowing for new data to be submitted */
-    mutex_unlock(&_uwb_lock);
     return ret;
 }
 
 /* notify (non-blocking) : add to ring buffer and notify all endpoints
    (post event handler for doing this)*/
-int pepper_srv_notify_ble_data(ed_ble_data_t *data)
+int pepper_srv_notify_ble_data(ed_ble_data_t *data, size_t len)
 {
     int ret = 0;
 
-    LOG_INFO("[pepper_srv]: number_endpoints %d\n", number_endpoints);
-    /* Blocking calls : TODO check if useful to do it in async way by posting
-       event handler(s) */
     for (uint8_t i = 0; i < number_endpoints; i++) {
         if (pepper_srv_endpoints[i].notify_ble_data) {
-            ret = pepper_srv_endpoints[i].notify_ble_data(data);
-            if (ret) {
+            if (IS_USED(MODULE_PEPPER_SRV_ASYNC)) {
+                if (pepper_srv_async_ble_data(i, data, len)) {
+                    ret |= (1 << i);
+                }
+            }
+            else if (pepper_srv_endpoints[i].notify_ble_data(data, len)) {
                 ret |= (1 << i);
             }
         }
     }
-    /* unlock ble_data lock, allowing for new data to be submitted */
-    mutex_unlock(&_ble_lock);
     return ret;
 }
 
@@ -206,12 +323,12 @@ int pepper_srv_notify_infection(bool infected)
         _set_status_led(CONFIG_PEPPER_SRV_INF_LED, 1);
     }
 
-    /* Blocking calls : TODO check if useful to do it in async way by posting
-       event handler(s) */
     for (uint8_t i = 0; i <  number_endpoints; i++) {
         if (pepper_srv_endpoints[i].notify_infection) {
-            ret = pepper_srv_endpoints[i].notify_infection(infected);
-            if (ret) {
+            if (IS_USED(MODULE_PEPPER_SRV_ASYNC)) {
+                pepper_srv_async_infection(i, infected);
+            }
+            else if (pepper_srv_endpoints[i].notify_infection(infected)) {
                 ret |= (1 << i);
             }
         }
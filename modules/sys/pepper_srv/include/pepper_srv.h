@@ -24,6 +24,7 @@
 #include "epoch.h"
 #include "event.h"
 #include "board.h"
+#include "pepper_srv_ring.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,9 +54,40 @@ extern "C" {
 #endif
 #endif
 
+/**
+ * @brief   Depth of the UWB sample ring, must be a power of two
+ */
+#ifndef CONFIG_PEPPER_SRV_UWB_RING_SIZE
+#define CONFIG_PEPPER_SRV_UWB_RING_SIZE     (16U)
+#endif
+
+/**
+ * @brief   Depth of the BLE sample ring, must be a power of two
+ */
+#ifndef CONFIG_PEPPER_SRV_BLE_RING_SIZE
+#define CONFIG_PEPPER_SRV_BLE_RING_SIZE     (16U)
+#endif
+
+/**
+ * @brief   Per endpoint dispatch statistics (pepper_srv_async)
+ */
+typedef struct {
+    uint32_t jobs;              /**< handled notifications */
+    uint32_t dropped;           /**< notifications dropped, backlog full */
+    uint32_t latency_last_ms;   /**< last dispatch to completion latency */
+    uint32_t latency_max_ms;    /**< maximum latency */
+    uint32_t latency_avg_ms;    /**< average latency */
+    uint16_t backlog;           /**< queued samples */
+    uint16_t backlog_hwm;       /**< queued samples high watermark */
+} pepper_srv_endpoint_stats_t;
+
 /**
  * @brief   Initialize the pepper server interface
  *
+ * With pepper_srv_async every endpoint is initialized with the event queue
+ * of its worker instead of @p evt_queue, which is then only used for sample
+ * batching.
+ *
  * @param[in]       evt_queue           A shared event queue for firing events
  *
  * @return  a status flag equal 0 if all went fine and a bitmap indicating the plugin endpoint init flags.
@@ -73,19 +105,39 @@ void pepper_srv_data_submit(epoch_data_t *data);
 /**
  * @brief   Submit new ed_uwb_data_t to the server broker
  *
+ * The sample is copied into a ring and handed to the endpoints in batches,
+ * safe to call from several threads.
+ *
  * @param[in]       data                UWB data to offload to server
  *
  */
 void pepper_srv_uwb_data_submit(ed_uwb_data_t *data);
 
+/**
+ * @brief   Get the UWB sample ring statistics
+ *
+ * @param[out]      stats               the ring statistics
+ */
+void pepper_srv_uwb_stats(pepper_srv_ring_stats_t *stats);
+
 /**
  * @brief   Submit new ed_ble_data_t to the server broker
  *
+ * The sample is copied into a ring and handed to the endpoints in batches,
+ * safe to call from several threads.
+ *
  * @param[in]       data                ble data to offload to server
  *
  */
 void pepper_srv_ble_data_submit(ed_ble_data_t *data);
 
+/**
+ * @brief   Get the ble sample ring statistics
+ *
+ * @param[out]      stats               the ring statistics
+ */
+void pepper_srv_ble_stats(pepper_srv_ring_stats_t *stats);
+
 /**
  * @brief   Notify end of epoch for offloading the encounter data
  *
@@ -96,22 +148,24 @@ void pepper_srv_ble_data_submit(ed_ble_data_t *data);
 int pepper_srv_notify_epoch_data(epoch_data_t *epoch_data);
 
 /**
- * @brief   Notify new ed_uwb_data is ready to be offloaded
+ * @brief   Notify a batch of new ed_uwb_data is ready to be offloaded
  *
- * @param[in]       data                 UWB data to offload to server
+ * @param[in]       data                 UWB data array to offload to server
+ * @param[in]       len                  number of elements in @p data
  *
  * @return  a status flag equal 0 if all went fine and a bitmap indicating the plugin endpoint init flags.
  */
-int pepper_srv_notify_uwb_data(ed_uwb_data_t *data);
+int pepper_srv_notify_uwb_data(ed_uwb_data_t *data, size_t len);
 
 /**
- * @brief   Notify new ed_ble_data is ready to be offloaded
+ * @brief   Notify a batch of new ed_ble_data is ready to be offloaded
  *
- * @param[in]       data                 ble data to offload to server
+ * @param[in]       data                 ble data array to offload to server
+ * @param[in]       len                  number of elements in @p data
  *
  * @return  a status flag equal 0 if all went fine and a bitmap indicating the plugin endpoint init flags.
  */
-int pepper_srv_notify_ble_data(ed_ble_data_t *data);
+int pepper_srv_notify_ble_data(ed_ble_data_t *data, size_t len);
 
 /**
  * @brief   Notify the notification status update
@@ -131,6 +185,21 @@ int pepper_srv_notify_infection(bool infected);
  */
 int pepper_srv_esr(bool *esr);
 
+/**
+ * @brief   Get the dispatch statistics of an endpoint (pepper_srv_async)
+ *
+ * @param[in]       idx             the endpoint index
+ * @param[out]      stats           the endpoint statistics
+ *
+ * @return  0 on success, <0 otherwise
+ */
+int pepper_srv_endpoint_stats(uint8_t idx, pepper_srv_endpoint_stats_t *stats);
+
+/**
+ * @brief   Print the pepper server interface statistics
+ */
+void pepper_srv_print_stats(void);
+
 /**
  * @brief   Endpoint plugin interface for bridging the client with a local/remote server instance.
  */
@@ -138,11 +207,14 @@ typedef struct pepper_srv_endpoint {
     int (*init)(event_queue_t *evt_queue);          /**< Shared event queue for posting events required by the plugin endpoint */
     /* core --> endpoint */
     int (*notify_epoch_data)(epoch_data_t *);       /**< Handler to process end of epoch data */
-    int (*notify_uwb_data)(ed_uwb_data_t *);        /**< Handler to process end of uwb data */
-    int (*notify_ble_data)(ed_ble_data_t *);        /**< Handler to process end of ble data */
+    int (*notify_uwb_data)(ed_uwb_data_t *, size_t);    /**< Handler to process a batch of uwb data */
+    int (*notify_ble_data)(ed_ble_data_t *, size_t);    /**< Handler to process a batch of ble data */
     int (*notify_infection)(bool infected);         /**< Handler to process infection update event */
     /* core <-- endpoint */
     int (*request_exposure)(bool *esr /*out*/);     /**< Handler to query the exposure status */
+    /* pepper_srv_async */
+    char *stack;                                    /**< Worker stack, NULL to share the common worker */
+    size_t stacksize;                               /**< Worker stack size */
 } pepper_srv_endpoint_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_pepper_srv
+ * @{
+ *
+ * @file
+ * @brief       Asynchronous per-endpoint dispatch
+ *
+ * With the pepper_srv_async module notifications are queued in per-endpoint
+ * bounded rings and handled on worker threads, so a slow endpoint only drops
+ * its own samples and never delays the caller.
+ *
+ * Endpoints that block, e.g. on the SD card, provide their own stack in
+ * @ref pepper_srv_endpoint_t and get a worker of their own, so they do not
+ * delay the other endpoints either. All other endpoints
+ * share a single worker, only stacks of the endpoints actually built in
+ * take RAM.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef PEPPER_SRV_ASYNC_H
+#define PEPPER_SRV_ASYNC_H
+
+#include "kernel_defines.h"
+#include "pepper_srv.h"
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Maximum number of endpoints handled asynchronously
+ */
+#ifndef CONFIG_PEPPER_SRV_ASYNC_ENDPOINTS_MAX
+#define CONFIG_PEPPER_SRV_ASYNC_ENDPOINTS_MAX   (4U)
+#endif
+
+/**
+ * @brief   Per endpoint sample backlog, must be a power of two
+ */
+#ifndef CONFIG_PEPPER_SRV_ASYNC_BACKLOG
+#define CONFIG_PEPPER_SRV_ASYNC_BACKLOG         (8U)
+#endif
+
+/**
+ * @brief   Shared endpoint worker thread stacksize
+ *
+ * The CoAP and CoAPS endpoints do not block, their ERTL uploads and EDHOC
+ * handshakes are driven by gcoap callbacks, but they serialize and encrypt
+ * on the shared worker.
+ */
+#ifndef CONFIG_PEPPER_SRV_ASYNC_STACKSIZE
+#if IS_USED(MODULE_PEPPER_SRV_COAP) || IS_USED(MODULE_PEPPER_SRV_COAPS)
+#define CONFIG_PEPPER_SRV_ASYNC_STACKSIZE       (THREAD_STACKSIZE_LARGE)
+#else
+#define CONFIG_PEPPER_SRV_ASYNC_STACKSIZE       (THREAD_STACKSIZE_DEFAULT)
+#endif
+#endif
+
+/**
+ * @brief   Storage endpoint worker thread stacksize
+ */
+#ifndef CONFIG_PEPPER_SRV_ASYNC_STORAGE_STACKSIZE
+#define CONFIG_PEPPER_SRV_ASYNC_STORAGE_STACKSIZE   (THREAD_STACKSIZE_LARGE)
+#endif
+
+/**
+ * @brief   Endpoint worker thread priority, lower than BLE/UWB processing
+ */
+#ifndef CONFIG_PEPPER_SRV_ASYNC_PRIO
+#define CONFIG_PEPPER_SRV_ASYNC_PRIO            (THREAD_PRIORITY_MAIN + 1)
+#endif
+
+/**
+ * @brief   Start the worker of an endpoint and init the endpoint on it
+ *
+ * @param[in]   idx         the endpoint index
+ * @param[in]   endpoint    the endpoint
+ *
+ * @return  the endpoint init return value
+ */
+int pepper_srv_async_init(uint8_t idx, const pepper_srv_endpoint_t *endpoint);
+
+/**
+ * @brief   Queue epoch data to an endpoint, @ref pepper_srv_epoch_data_release
+ *          is called once it was handled
+ *
+ * @return  0 on success, <0 if the endpoint is still busy with previous data
+ */
+int pepper_srv_async_epoch_data(uint8_t idx, epoch_data_t *data);
+
+/**
+ * @brief   Queue a batch of uwb data to an endpoint
+ *
+ * @return  0 on success, <0 if samples were dropped
+ */
+int pepper_srv_async_uwb_data(uint8_t idx, ed_uwb_data_t *data, size_t len);
+
+/**
+ * @brief   Queue a batch of ble data to an endpoint
+ *
+ * @return  0 on success, <0 if samples were dropped
+ */
+int pepper_srv_async_ble_data(uint8_t idx, ed_ble_data_t *data, size_t len);
+
+/**
+ * @brief   Queue an infection status update to an endpoint
+ */
+void pepper_srv_async_infection(uint8_t idx, bool infected);
+
+/**
+ * @brief   Get the statistics of an endpoint
+ *
+ * @return  0 on success, <0 if @p idx is not a valid endpoint
+ */
+int pepper_srv_async_stats(uint8_t idx, pepper_srv_endpoint_stats_t *stats);
+
+/**
+ * @brief   Called by the workers when done with the epoch data
+ */
+void pepper_srv_epoch_data_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEPPER_SRV_ASYNC_H */
+/** @} */
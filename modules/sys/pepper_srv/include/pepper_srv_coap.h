@@ -23,6 +23,9 @@
 
 #include "epoch.h"
 #include "event.h"
+#include "mutex.h"
+#include "pepper.h"
+#include "coap/utils.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,15 +39,80 @@ extern "C" {
 #ifndef CONFIG_PEPPER_SRV_COAP_PORT
 #define CONFIG_PEPPER_SRV_COAP_PORT         5683
 #endif
+/**
+ * @brief   Minimum time in ms between exposure status Observe registrations,
+ *          only used while not registered
+ */
+#ifndef CONFIG_PEPPER_SRV_COAP_OBS_RETRY_MS
+#define CONFIG_PEPPER_SRV_COAP_OBS_RETRY_MS (60LU * 1000)
+#endif
 
 /**
  * @brief   Initialize the CoAP remote endpoint
  *
+ * Any previous exposure status Observe registration is cancelled and a new
+ * one is sent to the remote. Exposure requests fail until the remote notified
+ * the status.
+ *
  * @param[in] addr_str      the address
  * @param[in] port          the port
  */
 void pepper_srv_coap_init_remote(char *addr_str, uint16_t port);
 
+/**
+ * @brief   State shared by the CoAP and CoAPS endpoints
+ */
+typedef struct {
+    sock_udp_ep_t remote;       /**< the server */
+    char ertl_uri[sizeof("/DW") + sizeof("/ertl") + 2 * PEPPER_UID_LEN];    /**< ertl upload uri */
+    char inf_uri[sizeof("/DW") + sizeof("/infected") + 2 * PEPPER_UID_LEN]; /**< infection status uri */
+    char esr_uri[sizeof("/DW") + sizeof("/esr") + 2 * PEPPER_UID_LEN];      /**< exposure status uri */
+    coap_obs_ctx_t esr_obs;     /**< exposure status Observe relationship */
+    uint32_t esr_obs_last;      /**< time of the last registration attempt */
+    bool esr_obs_tried;         /**< a registration was attempted */
+    bool esr_known;             /**< the server notified the exposure status */
+    mutex_t ertl_lock;          /**< held while an ertl upload is in progress */
+} pepper_srv_coap_common_t;
+
+/**
+ * @brief   Initialize the shared endpoint state and register to the
+ *          exposure status of the CONFIG_PEPPER_SRV_COAP_HOST server
+ *
+ * @param[out]      common      the state to initialize
+ * @param[in]       esr_cb      called with every exposure status notification,
+ *                              from the gcoap thread
+ * @param[in]       arg         @p esr_cb argument
+ */
+void pepper_srv_coap_common_init(pepper_srv_coap_common_t *common,
+                                 coap_req_cb_t esr_cb, void *arg);
+
+/**
+ * @brief   Register to the exposure status if not registered, at most every
+ *          CONFIG_PEPPER_SRV_COAP_OBS_RETRY_MS
+ *
+ * @param[inout]    common      the shared endpoint state
+ */
+void pepper_srv_coap_esr_observe(pepper_srv_coap_common_t *common);
+
+/**
+ * @brief   Change the server, the exposure status is unknown until the new
+ *          server notifies it
+ *
+ * @param[inout]    common      the shared endpoint state
+ * @param[in]       addr_str    the address
+ * @param[in]       port        the port
+ */
+void pepper_srv_coap_common_set_remote(pepper_srv_coap_common_t *common,
+                                       char *addr_str, uint16_t port);
+
+/**
+ * @brief   Upload completion callback, releases @ref
+ *          pepper_srv_coap_common_t::ertl_lock
+ *
+ * To be passed to @ref coap_block_ctx_alloc with the shared state as argument.
+ */
+void pepper_srv_coap_ertl_done(int res, void *data, size_t data_len, void *arg);
+
 /**
  * @brief   PEPPER server CTX id 'PEPPER'
  */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_pepper_srv
+ * @{
+ *
+ * @file
+ * @brief       Multi-producer single-consumer sample ring
+ *
+ * Producers reserve a slot with a compare-and-swap on the head index, copy
+ * their sample and then flag the slot as ready. The single consumer hands
+ * contiguous ready slots to the endpoints in place and releases them
+ * afterwards, so no lock is taken on the submission path.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef PEPPER_SRV_RING_H
+#define PEPPER_SRV_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Ring statistics
+ */
+typedef struct {
+    uint32_t submitted;         /**< samples successfully queued */
+    uint32_t dropped;           /**< samples dropped because the ring was full */
+    uint32_t batches;           /**< batches handed to the endpoints */
+    uint16_t high_watermark;    /**< highest ring occupancy */
+    uint16_t size;              /**< ring depth */
+} pepper_srv_ring_stats_t;
+
+/**
+ * @brief   Multi-producer single-consumer ring
+ */
+typedef struct {
+    uint8_t *buf;               /**< sample storage, size * elem_size */
+    atomic_bool *ready;         /**< per slot ready flags */
+    size_t elem_size;           /**< sample size */
+    unsigned size;              /**< ring depth, power of two */
+    atomic_uint head;           /**< next slot to reserve */
+    atomic_uint tail;           /**< next slot to consume */
+    atomic_uint submitted;      /**< samples successfully queued */
+    atomic_uint dropped;        /**< samples dropped */
+    atomic_uint high_watermark; /**< highest occupancy */
+    uint32_t batches;           /**< batches consumed */
+} pepper_srv_ring_t;
+
+/**
+ * @brief   Init a ring
+ *
+ * @param[out]  ring        the ring
+ * @param[in]   buf         sample storage, at least @p size * @p elem_size
+ * @param[in]   ready       @p size ready flags
+ * @param[in]   elem_size   sample size
+ * @param[in]   size        ring depth, must be a power of two
+ */
+void pepper_srv_ring_init(pepper_srv_ring_t *ring, void *buf,
+                          atomic_bool *ready, size_t elem_size, unsigned size);
+
+/**
+ * @brief   Queue a sample, safe to call concurrently from several threads
+ *
+ * @param[in]   ring        the ring
+ * @param[in]   elem        the sample to copy in
+ * @param[out]  was_empty   set to true if the ring was empty, i.e. the
+ *                          consumer needs to be scheduled, may be NULL
+ *
+ * @return  0 on success, -ENOMEM if the ring is full
+ */
+int pepper_srv_ring_push(pepper_srv_ring_t *ring, const void *elem,
+                         bool *was_empty);
+
+/**
+ * @brief   Get the contiguous ready samples at the ring tail
+ *
+ * Must only be called by the consumer, samples stay valid until released.
+ *
+ * @param[in]   ring        the ring
+ * @param[out]  elems       pointer to the first sample
+ *
+ * @return  the number of contiguous ready samples
+ */
+size_t pepper_srv_ring_peek(pepper_srv_ring_t *ring, void **elems);
+
+/**
+ * @brief   Release samples previously returned by @ref pepper_srv_ring_peek
+ *
+ * @param[in]   ring        the ring
+ * @param[in]   count       number of samples to release
+ */
+void pepper_srv_ring_release(pepper_srv_ring_t *ring, size_t count);
+
+/**
+ * @brief   Number of reserved (queued or being written) samples
+ *
+ * @param[in]   ring        the ring
+ */
+unsigned pepper_srv_ring_used(pepper_srv_ring_t *ring);
+
+/**
+ * @brief   Get ring statistics
+ *
+ * @param[in]   ring        the ring
+ * @param[out]  stats       the statistics
+ */
+void pepper_srv_ring_stats(pepper_srv_ring_t *ring,
+                           pepper_srv_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEPPER_SRV_RING_H */
+/** @} */
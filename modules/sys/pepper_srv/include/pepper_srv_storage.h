@@ -41,6 +41,16 @@ extern "C" {
 #define CONFIG_PEPPER_SRV_STORAGE_BLE_DATA_FILE         "ble"
 #endif
 
+/**
+ * @brief   Mount the storage on first use instead of on init
+ *
+ * Mounting and recreating the directory hierarchy is then left out of the
+ * boot, a missing card is only noticed when the first data is logged.
+ */
+#ifndef CONFIG_PEPPER_SRV_STORAGE_LAZY_MOUNT
+#define CONFIG_PEPPER_SRV_STORAGE_LAZY_MOUNT            0
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_pepper_srv
+ * @{
+ *
+ * @file
+ * @brief       Multi-producer single-consumer sample ring implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "pepper_srv_ring.h"
+
+void pepper_srv_ring_init(pepper_srv_ring_t *ring, void *buf,
+                          atomic_bool *ready, size_t elem_size, unsigned size)
+{
+    /* size must be a power of two */
+    assert(size && !(size & (size - 1)));
+
+    ring->buf = buf;
+    ring->ready = ready;
+    ring->elem_size = elem_size;
+    ring->size = size;
+    for (unsigned i = 0; i < size; i++) {
+        atomic_init(&ring->ready[i], false);
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->submitted, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->high_watermark, 0);
+    ring->batches = 0;
+}
+
+int pepper_srv_ring_push(pepper_srv_ring_t *ring, const void *elem,
+                         bool *was_empty)
+{
+    unsigned head = atomic_load(&ring->head);
+    unsigned used;
+
+    /* reserve a slot */
+    do {
+        used = head - atomic_load(&ring->tail);
+        if (used >= ring->size) {
+            atomic_fetch_add(&ring->dropped, 1);
+            return -ENOMEM;
+        }
+    } while (!atomic_compare_exchange_weak(&ring->head, &head, head + 1));
+
+    unsigned idx = head & (ring->size - 1);
+    memcpy(&ring->buf[idx * ring->elem_size], elem, ring->elem_size);
+    atomic_store(&ring->ready[idx], true);
+
+    atomic_fetch_add(&ring->submitted, 1);
+    unsigned hwm = atomic_load(&ring->high_watermark);
+    while (used + 1 > hwm &&
+           !atomic_compare_exchange_weak(&ring->high_watermark, &hwm, used + 1)) {}
+
+    if (was_empty) {
+        *was_empty = used == 0;
+    }
+    return 0;
+}
+
+size_t pepper_srv_ring_peek(pepper_srv_ring_t *ring, void **elems)
+{
+    unsigned tail = atomic_load(&ring->tail);
+    unsigned idx = tail & (ring->size - 1);
+    size_t count = 0;
+
+    /* stop at the first slot still being written or at the ring end */
+    while (idx + count < ring->size && atomic_load(&ring->ready[idx + count])) {
+        count++;
+    }
+    *elems = &ring->buf[idx * ring->elem_size];
+    return count;
+}
+
+void pepper_srv_ring_release(pepper_srv_ring_t *ring, size_t count)
+{
+    unsigned tail = atomic_load(&ring->tail);
+
+    for (size_t i = 0; i < count; i++) {
+        atomic_store(&ring->ready[(tail + i) & (ring->size - 1)], false);
+    }
+    if (count) {
+        ring->batches++;
+    }
+    atomic_store(&ring->tail, tail + count);
+}
+
+unsigned pepper_srv_ring_used(pepper_srv_ring_t *ring)
+{
+    return atomic_load(&ring->head) - atomic_load(&ring->tail);
+}
+
+void pepper_srv_ring_stats(pepper_srv_ring_t *ring,
+                           pepper_srv_ring_stats_t *stats)
+{
+    stats->submitted = atomic_load(&ring->submitted);
+    stats->dropped = atomic_load(&ring->dropped);
+    stats->batches = ring->batches;
+    stats->high_watermark = atomic_load(&ring->high_watermark);
+    stats->size = ring->size;
+}
@@ -52,20 +52,26 @@ int _shell_srv_notify_epoch_data(epoch_data_t *epoch_data)
     return 0;
 }
 
-int _shell_srv_notify_uwb_data(ed_uwb_data_t *data)
+int _shell_srv_notify_uwb_data(ed_uwb_data_t *data, size_t len)
 {
     (void)data;
+    (void)len;
 #if IS_USED(MODULE_ED_UWB)
-    ed_serialize_uwb_printf(data, pepper_get_serializer_bn());
+    for (size_t i = 0; i < len; i++) {
+        ed_serialize_uwb_printf(&data[i], pepper_get_serializer_bn());
+    }
 #endif
     return 0;
 }
 
-int _shell_srv_notify_ble_data(ed_ble_data_t *data)
+int _shell_srv_notify_ble_data(ed_ble_data_t *data, size_t len)
 {
     (void)data;
+    (void)len;
 #if IS_USED(MODULE_ED_BLE) || IS_USED(MODULE_ED_BLE_WIN)
-    ed_serialize_ble_printf(data, pepper_get_serializer_bn());
+    for (size_t i = 0; i < len; i++) {
+        ed_serialize_ble_printf(&data[i], pepper_get_serializer_bn());
+    }
 #endif
     return 0;
 }
@@ -105,6 +111,7 @@ static void _shell_pepperd_print_usage(void)
         "\tpepperd exp [true|false] : sets/unsets flag indicating that his node is a contact case. If without params, dumps current exposure status");
     puts("\tpepperd inf : returns the infection flag indicating that his node is infected.");
     puts("\tpepperd ed : dumps last received epoch data");
+    puts("\tpepperd stats : dumps sample ring statistics");
 }
 
 static void _shell_pepperd_print_epoch_data(void)
@@ -150,6 +157,11 @@ static int _pepperd_shell_handler(int argc, char **argv)
         return 0;
     }
 
+    if (!strcmp(argv[1], "stats")) {
+        pepper_srv_print_stats();
+        return 0;
+    }
+
     _shell_pepperd_print_usage();
     return -1;
 }
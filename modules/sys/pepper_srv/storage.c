@@ -27,8 +27,12 @@
 #include "pepper.h"
 #include "pepper_srv.h"
 #include "pepper_srv_storage.h"
+#include "pepper_srv_async.h"
 #include "storage.h"
 #include "ztimer.h"
+#if IS_USED(MODULE_BOOT_PROFILE)
+#include "boot_profile.h"
+#endif
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_WARNING
@@ -40,7 +44,15 @@
 #endif
 
 #ifndef PEPPER_SRV_SERIALIZE_BUFFER_SIZE
-#define PEPPER_SRV_SERIALIZE_BUFFER_SIZE    2048
+/* room for the pipeline latencies, memory watermarks and radio energy as well */
+#define PEPPER_SRV_SERIALIZE_BUFFER_SIZE    (2048 + IS_USED(MODULE_LATENCY) * 512 + \
+                                             IS_USED(MODULE_WATERMARK) * 512 + \
+                                             IS_USED(MODULE_ENERGY) * 256)
+#endif
+
+#ifndef PEPPER_SRV_SAMPLE_JSON_MAX
+/* upper bound of a single serialized uwb/ble sample */
+#define PEPPER_SRV_SAMPLE_JSON_MAX          256
 #endif
 
 #define PEPPER_SRV_SD_CARD_PRESENT          (1 << 0)
@@ -58,6 +70,22 @@ static uint8_t _buffer[PEPPER_SRV_SERIALIZE_BUFFER_SIZE];
 /* event queue */
 static event_queue_t *_evt_queue = NULL;
 
+static int _mount_sd_card(void)
+{
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_begin(BOOT_PHASE_STORAGE_MOUNT);
+#endif
+    int res = storage_init();
+
+#if IS_USED(MODULE_BOOT_PROFILE)
+    boot_profile_end(BOOT_PHASE_STORAGE_MOUNT);
+#endif
+    if (res == 0) {
+        _status |= PEPPER_SRV_SD_CARD_MOUNTED;
+    }
+    return res;
+}
+
 static void _umount_sd_card(void *arg)
 {
     (void)arg;
@@ -106,9 +134,16 @@ int _storage_srv_init(event_queue_t *evt_queue)
         /* init software debounce timer */
         _cd_debouncer.callback = _debounce_cb;
     }
-    if (storage_init() == 0) {
+    if (IS_ACTIVE(CONFIG_PEPPER_SRV_STORAGE_LAZY_MOUNT)) {
+        /* assume a card until proven otherwise, mounted on first use */
+        if (!gpio_is_valid(SDCARD_SPI_PARAM_CD) ||
+            gpio_read(SDCARD_SPI_PARAM_CD) == 0) {
+            _status |= PEPPER_SRV_SD_CARD_PRESENT;
+        }
+        return 0;
+    }
+    if (_mount_sd_card() == 0) {
         _status |= PEPPER_SRV_SD_CARD_PRESENT;
-        _status |= PEPPER_SRV_SD_CARD_MOUNTED;
     }
 
     return 0;
@@ -120,8 +155,9 @@ bool _storage_srv_sd_ready(void)
         if (!(_status & PEPPER_SRV_SD_CARD_MOUNTED)) {
             /* mount sd card */
             LOG_DEBUG("[pepper_srv] storage: init storage\n");
-            if (storage_init() == 0) {
-                _status |= PEPPER_SRV_SD_CARD_MOUNTED;
+            if (_mount_sd_card() != 0 && !gpio_is_valid(SDCARD_SPI_PARAM_CD)) {
+                /* without card detection do not retry on every sample */
+                _status &= ~PEPPER_SRV_SD_CARD_PRESENT;
             }
         }
     }
@@ -147,6 +183,10 @@ int _storage_srv_notify_epoch_data(epoch_data_t *epoch_data)
         size_t len = contact_data_serialize_all_json(
             epoch_data, _buffer, sizeof(_buffer), pepper_get_serializer_bn()
             );
+        if (len == 0) {
+            LOG_WARNING("[pepper_srv] storage: ERROR, failed to serialize epoch data\n");
+            return -1;
+        }
         char logfile[CONFIG_PEPPER_BASE_NAME_BUFFER + sizeof(CONFIG_PEPPER_LOGS_DIR) +
                      sizeof(CONFIG_PEPPER_LOG_EXT)];
         // TODO: I wanted to use pepper_get_serializer_bn() but for some reason
@@ -163,63 +203,111 @@ int _storage_srv_notify_epoch_data(epoch_data_t *epoch_data)
     return 0;
 }
 
-int _storage_srv_notify_uwb_data(ed_uwb_data_t *data)
+static int _storage_srv_log_buffer(const char *file, size_t len)
 {
-    LOG_DEBUG("[pepper_srv] storage: new uwb data, ts = %ld\n",
-              data->time);
+    char logfile[CONFIG_PEPPER_BASE_NAME_BUFFER + sizeof(CONFIG_PEPPER_LOGS_DIR) +
+                 sizeof(CONFIG_PEPPER_LOG_EXT)];
+
+    sprintf(logfile, "%s%s%s", CONFIG_PEPPER_LOGS_DIR, file, CONFIG_PEPPER_LOG_EXT);
+    if (storage_log(logfile, _buffer, len)) {
+        LOG_DEBUG("[pepper_srv] storage: ERROR, failed to log to %s\n", logfile);
+        return -1;
+    }
+    LOG_DEBUG("[pepper_srv] storage: logged to %s\n", logfile);
+    return 0;
+}
+
+int _storage_srv_notify_uwb_data(ed_uwb_data_t *data, size_t len)
+{
+    LOG_DEBUG("[pepper_srv] storage: new uwb data, count = %d\n", (int)len);
 
     if (_storage_srv_sd_ready()) {
-        /* serialize and store in sd_storage_srv_notify_epoch_data-card */
-        size_t len = ed_serialize_uwb_json(data,
-                                           pepper_get_serializer_bn(), _buffer, sizeof(_buffer));
-        char logfile[CONFIG_PEPPER_BASE_NAME_BUFFER + sizeof(CONFIG_PEPPER_LOGS_DIR) +
-                     sizeof(CONFIG_PEPPER_LOG_EXT)];
-        // TODO: I wanted to use pepper_get_serializer_bn() but for some reason
-        // it fails two often, need to investigate..
-        sprintf(logfile, "%s%s%s", CONFIG_PEPPER_LOGS_DIR,
-                CONFIG_PEPPER_SRV_STORAGE_UWB_DATA_FILE, CONFIG_PEPPER_LOG_EXT);
-        if (storage_log(logfile, _buffer, len - 1)) {
-            LOG_DEBUG("[pepper_srv] storage: ERROR, failed to log to %s\n", logfile);
-            return -1;
+        /* serialize the whole batch and log it with as few writes as possible */
+        size_t pos = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (sizeof(_buffer) - pos < PEPPER_SRV_SAMPLE_JSON_MAX) {
+                if (_storage_srv_log_buffer(CONFIG_PEPPER_SRV_STORAGE_UWB_DATA_FILE,
+                                            pos)) {
+                    return -1;
+                }
+                pos = 0;
+            }
+            size_t n = ed_serialize_uwb_json(&data[i], pepper_get_serializer_bn(),
+                                            &_buffer[pos], sizeof(_buffer) - pos);
+            if (n == 0) {
+                LOG_WARNING("[pepper_srv] storage: ERROR, failed to serialize "
+                            "uwb sample %d/%d\n", (int)i, (int)len);
+                /* keep what was serialized so far, report the rest as lost */
+                if (pos) {
+                    _storage_srv_log_buffer(CONFIG_PEPPER_SRV_STORAGE_UWB_DATA_FILE, pos);
+                }
+                return -1;
+            }
+            /* drop the trailing null character */
+            pos += n - 1;
+        }
+        if (pos) {
+            return _storage_srv_log_buffer(CONFIG_PEPPER_SRV_STORAGE_UWB_DATA_FILE,
+                                           pos);
         }
-        LOG_DEBUG("[pepper_srv] storage: logged to %s\n", logfile);
     }
 
     return 0;
 }
 
-
-int _storage_srv_notify_ble_data(ed_ble_data_t *data)
+int _storage_srv_notify_ble_data(ed_ble_data_t *data, size_t len)
 {
-    LOG_DEBUG("[pepper_srv] storage: new ble data, ts = %ld\n",
-              data->time);
+    LOG_DEBUG("[pepper_srv] storage: new ble data, count = %d\n", (int)len);
 
     if (_storage_srv_sd_ready()) {
-        /* serialize and store in sd_storage_srv_notify_epoch_data-card */
-        size_t len = ed_serialize_ble_json(data,
-                                           pepper_get_serializer_bn(), _buffer, sizeof(_buffer));
-        char logfile[CONFIG_PEPPER_BASE_NAME_BUFFER + sizeof(CONFIG_PEPPER_LOGS_DIR) +
-                     sizeof(CONFIG_PEPPER_LOG_EXT)];
-        // TODO: I wanted to use pepper_get_serializer_bn() but for some reason
-        // it fails two often, need to investigate..
-        sprintf(logfile, "%s%s%s", CONFIG_PEPPER_LOGS_DIR,
-                CONFIG_PEPPER_SRV_STORAGE_BLE_DATA_FILE, CONFIG_PEPPER_LOG_EXT);
-        if (storage_log(logfile, _buffer, len - 1)) {
-            LOG_DEBUG("[pepper_srv] storage: ERROR, failed to log to %s\n", logfile);
-            return -1;
+        /* serialize the whole batch and log it with as few writes as possible */
+        size_t pos = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (sizeof(_buffer) - pos < PEPPER_SRV_SAMPLE_JSON_MAX) {
+                if (_storage_srv_log_buffer(CONFIG_PEPPER_SRV_STORAGE_BLE_DATA_FILE,
+                                            pos)) {
+                    return -1;
+                }
+                pos = 0;
+            }
+            size_t n = ed_serialize_ble_json(&data[i], pepper_get_serializer_bn(),
+                                            &_buffer[pos], sizeof(_buffer) - pos);
+            if (n == 0) {
+                LOG_WARNING("[pepper_srv] storage: ERROR, failed to serialize "
+                            "ble sample %d/%d\n", (int)i, (int)len);
+                /* keep what was serialized so far, report the rest as lost */
+                if (pos) {
+                    _storage_srv_log_buffer(CONFIG_PEPPER_SRV_STORAGE_BLE_DATA_FILE, pos);
+                }
+                return -1;
+            }
+            /* drop the trailing null character */
+            pos += n - 1;
+        }
+        if (pos) {
+            return _storage_srv_log_buffer(CONFIG_PEPPER_SRV_STORAGE_BLE_DATA_FILE,
+                                           pos);
         }
-        LOG_DEBUG("[pepper_srv] storage: logged to %s\n", logfile);
     }
 
     return 0;
 }
 
 
+#if IS_USED(MODULE_PEPPER_SRV_ASYNC)
+/* blocks on the card, keep it off the shared worker */
+static char _async_stack[CONFIG_PEPPER_SRV_ASYNC_STORAGE_STACKSIZE];
+#endif
+
 XFA_CONST(pepper_srv_endpoints, 0) pepper_srv_endpoint_t _pepper_srv_storage = {
     .init = _storage_srv_init,
     .notify_epoch_data = _storage_srv_notify_epoch_data,
     .notify_uwb_data = _storage_srv_notify_uwb_data,
     .notify_ble_data = _storage_srv_notify_ble_data,
     .notify_infection = NULL,
-    .request_exposure = NULL
+    .request_exposure = NULL,
+#if IS_USED(MODULE_PEPPER_SRV_ASYNC)
+    .stack = _async_stack,
+    .stacksize = sizeof(_async_stack),
+#endif
 };
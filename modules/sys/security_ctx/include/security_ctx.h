@@ -25,11 +25,16 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include <stddef.h>
+
+#include "tinycrypt/aes.h"
 
 #if IS_USED(MODULE_EDHOC_COAP)
 #include "edhoc/coap.h"
-#include "net/sock.h"
-#include "random.h"
+#endif
+
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+#include "mtd.h"
 #endif
 
 #ifdef __cplusplus
@@ -52,6 +57,33 @@ extern "C" {
  * @brief   Security context ID max length
  */
 #define     SECURITY_CTX_ID_MAX_LEN       (6)
+/**
+ * @brief   AEAD (AES-CCM-16-64-128) authentication tag length
+ */
+#define     SECURITY_CTX_TAG_LEN          (8U)
+/**
+ * @brief   Space needed in front of the plaintext for the COSE_Encrypt0
+ *          headers when encoding in place
+ */
+#define     SECURITY_CTX_HEADROOM         (25U)
+/**
+ * @brief   Buffer size needed to encode @p len bytes
+ */
+#define     SECURITY_CTX_ENCODE_BUF_LEN(len) \
+    (SECURITY_CTX_HEADROOM + (len) + SECURITY_CTX_TAG_LEN)
+/**
+ * @brief   Last usable sequence number, the context expires once reached
+ */
+#define     SECURITY_CTX_SEQNR_MAX        (UINT16_MAX)
+/**
+ * @brief   Sequence numbers reserved by every persisted high-water mark
+ *
+ * The high-water mark is written every that many messages, after a reboot
+ * the sequence number resumes from it so no nonce is ever reused.
+ */
+#ifndef CONFIG_SECURITY_CTX_SEQNR_WINDOW
+#define CONFIG_SECURITY_CTX_SEQNR_WINDOW  (64U)
+#endif
 /**
  * @brief   Security context EDHOC exporter salt label
  */
@@ -72,9 +104,13 @@ typedef struct security_ctx {
     size_t recv_id_len;                             /**< the recv context id len */
     uint16_t seqnr;                                 /**< the seqnr, increased on
                                                           every send */
+    uint16_t seqnr_hwm;                             /**< persisted seqnr
+                                                         high-water mark */
     uint8_t* recv_id;                               /**< the recv context id */
     uint8_t* send_id;                               /**< the send context id */
     bool valid;                                     /**< current context validity */
+    struct tc_aes_key_sched_struct send_sched;      /**< send key schedule */
+    struct tc_aes_key_sched_struct recv_sched;      /**< recv key schedule */
 } security_ctx_t;
 
 /**
@@ -99,6 +135,9 @@ void security_ctx_init(security_ctx_t *ctx, uint8_t *send_id,
  * @param[in]       secret      the secret
  * @param[in]       secret_len  the secret length
  *
+ * The sequence number is reset, with the security_ctx_persist module and
+ * persistence set up the new context is saved to flash.
+ *
  * @returns     0 if succeeded, <0 otherwise
  */
 int security_ctx_key_gen(security_ctx_t *ctx, uint8_t *salt, size_t salt_len,
@@ -119,49 +158,119 @@ void security_ctx_gen_nonce(security_ctx_t *ctx, uint8_t *ctx_id,
                             size_t ctx_id_len, uint8_t *nonce);
 
 /**
- * @brief   Encode data
+ * @brief   Encode data as a COSE_Encrypt0 object
+ *
+ * The data is encrypted in place at @p buf + @ref SECURITY_CTX_HEADROOM, the
+ * COSE headers are written right in front of it. If @p data is not already
+ * at that location it is first copied there, so placing the plaintext there
+ * avoids the copy and a second buffer.
  *
  * @param[in]       ctx         the ctx
  * @param[in]       data        data to encode
  * @param[in]       data_len    length of data to encode
- * @param[inout]    buf         encoding buffer
+ * @param[inout]    buf         encoding buffer, at least
+ *                              SECURITY_CTX_ENCODE_BUF_LEN(@p data_len)
  * @param[in]       buf_len     length of encoding buffer
- * @param[inout]    out         pointer to encoded data location
+ * @param[inout]    out         pointer to encoded data location in @p buf
  *
- * @return          length of encoded data, <0 on error
+ * @return          length of encoded data, -ESTALE if the sequence numbers
+ *                  are exhausted (the context is then invalidated, see
+ *                  @ref security_ctx_invalidate), <0 on other errors
  */
 int security_ctx_encode(security_ctx_t *ctx, uint8_t *data, size_t data_len,
                         uint8_t *buf, size_t buf_len, uint8_t **out);
 
 /**
- * @brief   Decode data
+ * @brief   Decode a COSE_Encrypt0 object in place
  *
  * @param[in]       ctx         the ctx
- * @param[in]       in          data to decode
+ * @param[inout]    in          data to decode, overwritten by the plaintext
  * @param[in]       in_len      length of data to decode
- * @param[inout]    buf         decoding buffer for COSE intermediates
- * @param[in]       buf_len     length of decoding
- * @param[inout]    out         output buffer
- * @param[inout]    olen        output buffer length, length of decoded data
+ * @param[out]      out         pointer to the decoded data inside @p in
+ * @param[out]      olen        length of decoded data
  *
- * @return          length of encoded data, <0 on error
+ * @return          0 on success, <0 on error
  */
 int security_ctx_decode(security_ctx_t *ctx, uint8_t *in, size_t in_len,
-                        uint8_t *buf, size_t buf_len, uint8_t *out, size_t *olen);
+                        uint8_t **out, size_t *olen);
+
+/**
+ * @brief   Invalidate a security context, new keys must be negotiated
+ *
+ * With the security_ctx_persist module and persistence set up the persisted
+ * context is invalidated as well, so it is not restored on the next boot.
+ *
+ * @param[inout]    ctx     the security context
+ */
+void security_ctx_invalidate(security_ctx_t *ctx);
+
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST) || defined(DOXYGEN)
+/**
+ * @brief   Set up the flash area security contexts are persisted to
+ *
+ * Every save appends a self contained record to a @ref sys_flashlog ring,
+ * the latest valid record is the one restored.
+ *
+ * @param[in]       mtd             the MTD device, already initialized
+ * @param[in]       first_sector    first sector of the area
+ * @param[in]       sector_numof    number of sectors, must be >= 2
+ *
+ * @returns     0 if succeeded, <0 otherwise
+ */
+int security_ctx_persist_init(mtd_dev_t *mtd, uint32_t first_sector,
+                              uint32_t sector_numof);
+
+/**
+ * @brief   Persist keys, common IV and a sequence number high-water mark
+ *
+ * The next @ref CONFIG_SECURITY_CTX_SEQNR_WINDOW sequence numbers are
+ * reserved, @ref security_ctx_encode saves again once they are used.
+ *
+ * @param[inout]    ctx     the valid security context
+ *
+ * @returns     0 if succeeded, -ENODEV if persistence is not set up,
+ *              <0 otherwise
+ */
+int security_ctx_save(security_ctx_t *ctx);
+
+/**
+ * @brief   Restore the last persisted security context
+ *
+ * The context must have been initialized with @ref security_ctx_init, only
+ * a context saved with the same ids is restored. The sequence number skips
+ * ahead to the persisted high-water mark and a new one is saved before the
+ * context is used.
+ *
+ * @param[inout]    ctx     the security context
+ *
+ * @returns     0 if a valid context was restored, -ENOENT if none was found,
+ *              -ESTALE if it expired or was invalidated, <0 otherwise
+ */
+int security_ctx_restore(security_ctx_t *ctx);
+
+/**
+ * @brief   Mark the persisted context with the same ids as invalid, it is
+ *          not restored until new keys are saved
+ *
+ * @param[in]       ctx     the security context
+ *
+ * @returns     0 if succeeded, -ENODEV if persistence is not set up,
+ *              <0 otherwise
+ */
+int security_ctx_forget(const security_ctx_t *ctx);
+#endif
 
 #if IS_USED(MODULE_EDHOC_COAP)
 /**
- * @brief   Utility to initiate a security context via salt/secret deriver from
- *          an EDHOC key exchange
+ * @brief   Utility to initiate a security context via salt/secret derived from
+ *          a completed EDHOC key exchange, see @ref edhoc_coap_handshake_start
  *
  * @param[inout]    ctx     the security context
- * @param[in]       e_ctx   the edhoc context
- * @param[in]       remote  the remote endpoint
+ * @param[in]       e_ctx   the finalized edhoc context
  *
  * @returns     0 if succeeded, <0 otherwise
  */
-int security_ctx_edhoc_handshake(security_ctx_t *ctx, edhoc_ctx_t *e_ctx,
-                                 sock_udp_ep_t *remote);
+int security_ctx_edhoc_derive(security_ctx_t *ctx, edhoc_ctx_t *e_ctx);
 #endif
 
 #ifdef __cplusplus
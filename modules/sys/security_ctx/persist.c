@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_security_ctx
+ * @{
+ *
+ * @file
+ * @brief       Security context flash persistence
+ *
+ * Every save appends a self contained record (ids, keys, common IV and
+ * sequence number high-water mark) to a small @ref sys_flashlog ring, so
+ * saves are wear leveled and a torn write simply leaves the previous record
+ * as the latest valid one. Since a sequence number is only used once a
+ * high-water mark above it was written, resuming from the last persisted
+ * mark never reuses a nonce. A context invalidated at runtime appends an
+ * invalidation record, without keys, so it is not restored on the next boot.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "flashlog.h"
+#include "security_ctx.h"
+#include "tinycrypt/aes.h"
+#include "tinycrypt/constants.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+/* flashlog record tag ("SC") */
+#define SECURITY_CTX_PERSIST_TAG    (0x5343U)
+/* flashlog invalidation record tag ("SI") */
+#define SECURITY_CTX_INVALID_TAG    (0x5349U)
+
+typedef struct {
+    uint16_t seqnr_hwm;
+    uint8_t send_id_len;
+    uint8_t recv_id_len;
+    uint8_t send_id[SECURITY_CTX_ID_MAX_LEN];
+    uint8_t recv_id[SECURITY_CTX_ID_MAX_LEN];
+    uint8_t send_ctx_key[SECURITY_CTX_KEY_LEN];
+    uint8_t recv_ctx_key[SECURITY_CTX_KEY_LEN];
+    uint8_t common_iv[SECURITY_CTX_COMMON_IV_LEN];
+} _record_t;
+
+static flashlog_t _log;
+static bool _initialized = false;
+
+int security_ctx_persist_init(mtd_dev_t *mtd, uint32_t first_sector,
+                              uint32_t sector_numof)
+{
+    if (flashlog_init(&_log, mtd, first_sector, sector_numof)) {
+        LOG_ERROR("[security_ctx]: failed to setup persistence\n");
+        return -1;
+    }
+    _initialized = true;
+    return 0;
+}
+
+static bool _ids_match(const security_ctx_t *ctx, const _record_t *rec)
+{
+    return rec->send_id_len == ctx->send_id_len &&
+           rec->recv_id_len == ctx->recv_id_len &&
+           !memcmp(rec->send_id, ctx->send_id, ctx->send_id_len) &&
+           !memcmp(rec->recv_id, ctx->recv_id, ctx->recv_id_len);
+}
+
+static void _record_ids(const security_ctx_t *ctx, _record_t *rec)
+{
+    memset(rec, '\0', sizeof(*rec));
+    rec->send_id_len = ctx->send_id_len;
+    rec->recv_id_len = ctx->recv_id_len;
+    memcpy(rec->send_id, ctx->send_id, ctx->send_id_len);
+    memcpy(rec->recv_id, ctx->recv_id, ctx->recv_id_len);
+}
+
+int security_ctx_save(security_ctx_t *ctx)
+{
+    _record_t rec;
+
+    if (!_initialized) {
+        return -ENODEV;
+    }
+    if (!ctx->valid) {
+        return -EINVAL;
+    }
+
+    _record_ids(ctx, &rec);
+    rec.seqnr_hwm = ctx->seqnr + CONFIG_SECURITY_CTX_SEQNR_WINDOW;
+    if (SECURITY_CTX_SEQNR_MAX - ctx->seqnr < CONFIG_SECURITY_CTX_SEQNR_WINDOW) {
+        rec.seqnr_hwm = SECURITY_CTX_SEQNR_MAX;
+    }
+    memcpy(rec.send_ctx_key, ctx->send_ctx_key, SECURITY_CTX_KEY_LEN);
+    memcpy(rec.recv_ctx_key, ctx->recv_ctx_key, SECURITY_CTX_KEY_LEN);
+    memcpy(rec.common_iv, ctx->common_iv, SECURITY_CTX_COMMON_IV_LEN);
+
+    if (flashlog_append(&_log, SECURITY_CTX_PERSIST_TAG, &rec, sizeof(rec)) < 0) {
+        LOG_WARNING("[security_ctx]: failed to persist context\n");
+        return -EIO;
+    }
+    /* only now can the reserved seqnr be used */
+    ctx->seqnr_hwm = rec.seqnr_hwm;
+    return 0;
+}
+
+int security_ctx_forget(const security_ctx_t *ctx)
+{
+    _record_t rec;
+
+    if (!_initialized) {
+        return -ENODEV;
+    }
+
+    _record_ids(ctx, &rec);
+    if (flashlog_append(&_log, SECURITY_CTX_INVALID_TAG, &rec, sizeof(rec)) < 0) {
+        LOG_WARNING("[security_ctx]: failed to invalidate persisted context\n");
+        return -EIO;
+    }
+    return 0;
+}
+
+int security_ctx_restore(security_ctx_t *ctx)
+{
+    flashlog_iter_t iter;
+    flashlog_record_hdr_t hdr;
+    _record_t rec;
+    _record_t last;
+    bool found = false;
+    bool invalidated = false;
+    int len;
+
+    if (!_initialized) {
+        return -ENODEV;
+    }
+
+    /* records are iterated oldest first, the last match is the latest */
+    flashlog_iter_init(&_log, &iter);
+    while ((len = flashlog_iter_next(&_log, &iter, &hdr, &rec, sizeof(rec))) > 0) {
+        if (len != sizeof(rec) || !_ids_match(ctx, &rec)) {
+            continue;
+        }
+        if (hdr.tag == SECURITY_CTX_PERSIST_TAG) {
+            memcpy(&last, &rec, sizeof(rec));
+            found = true;
+        }
+        else if (hdr.tag == SECURITY_CTX_INVALID_TAG) {
+            invalidated = true;
+            found = false;
+        }
+    }
+    if (!found) {
+        return invalidated ? -ESTALE : -ENOENT;
+    }
+    if (last.seqnr_hwm == SECURITY_CTX_SEQNR_MAX) {
+        return -ESTALE;
+    }
+
+    memcpy(ctx->send_ctx_key, last.send_ctx_key, SECURITY_CTX_KEY_LEN);
+    memcpy(ctx->recv_ctx_key, last.recv_ctx_key, SECURITY_CTX_KEY_LEN);
+    memcpy(ctx->common_iv, last.common_iv, SECURITY_CTX_COMMON_IV_LEN);
+    if (tc_aes128_set_encrypt_key(&ctx->send_sched, ctx->send_ctx_key) !=
+        TC_CRYPTO_SUCCESS ||
+        tc_aes128_set_encrypt_key(&ctx->recv_sched, ctx->recv_ctx_key) !=
+        TC_CRYPTO_SUCCESS) {
+        return -EINVAL;
+    }
+    /* skip ahead, every seqnr below the mark may have been used, the next
+       encode reserves a new window before using it */
+    ctx->seqnr = last.seqnr_hwm;
+    ctx->seqnr_hwm = last.seqnr_hwm;
+    ctx->valid = true;
+    LOG_INFO("[security_ctx]: restored context, seqnr=%u\n", ctx->seqnr);
+    return 0;
+}
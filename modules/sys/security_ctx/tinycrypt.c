@@ -18,16 +18,18 @@
  * @}
  */
 
+#include <errno.h>
+#include <string.h>
+
 #include "kernel_defines.h"
 #include "assert.h"
 #include "security_ctx.h"
-#include "cose.h"
+#include "tinycrypt/aes.h"
+#include "tinycrypt/ccm_mode.h"
 #include "tinycrypt/constants.h"
 #include "tinycrypt/hkdf.h"
 
 #if IS_USED(MODULE_EDHOC_COAP)
-#include "net/sock.h"
-#include "random.h"
 #include "edhoc/coap.h"
 #endif
 
@@ -36,6 +38,21 @@
 #endif
 #include "log.h"
 
+/* COSE_Encrypt0 tag, array(3) and protected header bstr({1: AES-CCM-16-64-128}) */
+static const uint8_t _cose_hdr[] = { 0xd0, 0x83, 0x43, 0xa1, 0x01, 0x0a };
+/* unprotected header {5: bstr(nonce)} */
+static const uint8_t _cose_iv_hdr[] = { 0xa1, 0x05, 0x40 | SECURITY_CTX_NONCE_LEN };
+/* length of the headers in front of the ciphertext bstr head */
+#define COSE_HDR_LEN        (sizeof(_cose_hdr) + sizeof(_cose_iv_hdr) + \
+                             SECURITY_CTX_NONCE_LEN)
+/* Enc_structure prefix, array(3) and "Encrypt0", followed by the protected
+   header and an empty external aad */
+static const uint8_t _enc_structure[] = {
+    0x83, 0x68, 'E', 'n', 'c', 'r', 'y', 'p', 't', '0'
+};
+/* maximum supported protected header length when decoding */
+#define COSE_PROTECTED_MAX  (16U)
+
 void security_ctx_init(security_ctx_t *ctx, uint8_t *send_id,
                        size_t send_id_len, uint8_t *recv_id,
                        size_t recv_id_len)
@@ -50,6 +67,7 @@ void security_ctx_init(security_ctx_t *ctx, uint8_t *send_id,
     ctx->send_id_len = send_id_len;
     ctx->recv_id_len = recv_id_len;
     ctx->seqnr = 0;
+    ctx->seqnr_hwm = 0;
     ctx->valid = false;
 }
 
@@ -80,11 +98,34 @@ int security_ctx_key_gen(security_ctx_t *ctx,
         return -1;
     }
 
-    /* valid security context */
+    /* the key schedules are only computed once per derived key */
+    if (tc_aes128_set_encrypt_key(&ctx->send_sched, ctx->send_ctx_key) !=
+        TC_CRYPTO_SUCCESS ||
+        tc_aes128_set_encrypt_key(&ctx->recv_sched, ctx->recv_ctx_key) !=
+        TC_CRYPTO_SUCCESS) {
+        return -1;
+    }
+
+    /* valid security context, new keys start a new nonce space */
+    ctx->seqnr = 0;
+    ctx->seqnr_hwm = 0;
     ctx->valid = true;
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+    /* a failure only means a handshake is needed after reboot */
+    security_ctx_save(ctx);
+#endif
     return 0;
 }
 
+void security_ctx_invalidate(security_ctx_t *ctx)
+{
+    ctx->valid = false;
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+    /* restoring it after a reboot would only fail again */
+    security_ctx_forget(ctx);
+#endif
+}
+
 /* TODO: libcose does not support not making the nonce public */
 void security_ctx_gen_nonce(security_ctx_t *ctx, uint8_t *ctx_id,
                             size_t ctx_id_len, uint8_t *nonce)
@@ -101,48 +142,219 @@ void security_ctx_gen_nonce(security_ctx_t *ctx, uint8_t *ctx_id,
     }
 }
 
+static size_t _bstr_head(uint8_t *buf, size_t len)
+{
+    if (len < 24) {
+        buf[0] = 0x40 | len;
+        return 1;
+    }
+    if (len <= UINT8_MAX) {
+        buf[0] = 0x58;
+        buf[1] = len;
+        return 2;
+    }
+    buf[0] = 0x59;
+    buf[1] = len >> 8;
+    buf[2] = len & 0xFF;
+    return 3;
+}
+
+static size_t _enc_structure_build(uint8_t *buf, const uint8_t *protected,
+                                   size_t protected_len)
+{
+    size_t len = sizeof(_enc_structure);
+
+    memcpy(buf, _enc_structure, len);
+    len += _bstr_head(&buf[len], protected_len);
+    memcpy(&buf[len], protected, protected_len);
+    len += protected_len;
+    /* empty external aad */
+    buf[len++] = 0x40;
+    return len;
+}
+
 int security_ctx_encode(security_ctx_t *ctx, uint8_t *data, size_t data_len,
                         uint8_t *buf, size_t buf_len, uint8_t **out)
 {
-    /* setup cose key */
-    cose_key_t key;
+    size_t ct_len = data_len + SECURITY_CTX_TAG_LEN;
+    uint8_t *payload = buf + SECURITY_CTX_HEADROOM;
+    uint8_t aad[sizeof(_enc_structure) + 2 + COSE_PROTECTED_MAX];
+    uint8_t nonce[SECURITY_CTX_NONCE_LEN];
+    uint8_t head[3];
+    struct tc_ccm_mode_struct ccm;
 
-    cose_key_init(&key);
-    cose_key_set_kid(&key, ctx->send_id, ctx->send_id_len);
-    cose_key_set_keys(&key, 0, COSE_ALGO_AESCCM_16_64_128, NULL, NULL,
-                      ctx->send_ctx_key);
+    if (buf_len < SECURITY_CTX_ENCODE_BUF_LEN(data_len) || ct_len > UINT16_MAX) {
+        return -ENOBUFS;
+    }
+    if (ctx->seqnr == SECURITY_CTX_SEQNR_MAX) {
+        /* nonces exhausted, new keys must be negotiated */
+        security_ctx_invalidate(ctx);
+        return -ESTALE;
+    }
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+    /* never use a seqnr that could be reused after a reboot */
+    if (ctx->seqnr >= ctx->seqnr_hwm) {
+        int res = security_ctx_save(ctx);
+        if (res < 0 && res != -ENODEV) {
+            return -EIO;
+        }
+    }
+#endif
+    if (data != payload) {
+        memmove(payload, data, data_len);
+    }
 
     /* generate nonce */
-    uint8_t nonce[SECURITY_CTX_NONCE_LEN];
-    security_ctx_gen_nonce(ctx, ctx->send_id, ctx->send_id_len,
-                           nonce);
-
-    /* setup cose encrypt */
-    cose_encrypt_t crypt;
-    crypt.ext_aad = NULL;
-    crypt.ext_aad_len = 0;
-    cose_encrypt_init(&crypt, COSE_FLAGS_ENCRYPT0);
-    cose_encrypt_add_recipient(&crypt, &key);
-    cose_encrypt_set_payload(&crypt, data, data_len);
-    cose_encrypt_set_algo(&crypt, COSE_ALGO_DIRECT);
-
-    /* encrypt and encode */
-    return cose_encrypt_encode(&crypt, buf, buf_len, nonce, out);
+    security_ctx_gen_nonce(ctx, ctx->send_id, ctx->send_id_len, nonce);
+
+    /* headers go right in front of the ciphertext */
+    size_t head_len = _bstr_head(head, ct_len);
+    uint8_t *pos = payload - head_len - COSE_HDR_LEN;
+    *out = pos;
+    memcpy(pos, _cose_hdr, sizeof(_cose_hdr));
+    pos += sizeof(_cose_hdr);
+    memcpy(pos, _cose_iv_hdr, sizeof(_cose_iv_hdr));
+    pos += sizeof(_cose_iv_hdr);
+    memcpy(pos, nonce, sizeof(nonce));
+    pos += sizeof(nonce);
+    memcpy(pos, head, head_len);
+
+    /* protected header is the bstr content at _cose_hdr[3] */
+    size_t aad_len = _enc_structure_build(aad, &_cose_hdr[3],
+                                          sizeof(_cose_hdr) - 3);
+
+    /* encrypt in place */
+    if (tc_ccm_config(&ccm, &ctx->send_sched, nonce, sizeof(nonce),
+                      SECURITY_CTX_TAG_LEN) != TC_CRYPTO_SUCCESS ||
+        tc_ccm_generation_encryption(payload, ct_len, aad, aad_len,
+                                     payload, data_len, &ccm) != TC_CRYPTO_SUCCESS) {
+        return -EINVAL;
+    }
+    return payload + ct_len - *out;
+}
+
+/* reads a CBOR item head, returns the major type or -1 */
+static int _cbor_head(uint8_t **pos, const uint8_t *end, uint32_t *val)
+{
+    if (*pos >= end) {
+        return -1;
+    }
+    uint8_t byte = *(*pos)++;
+    uint8_t info = byte & 0x1F;
+    size_t len = 0;
+
+    if (info < 24) {
+        *val = info;
+        return byte >> 5;
+    }
+    switch (info) {
+    case 24: len = 1; break;
+    case 25: len = 2; break;
+    case 26: len = 4; break;
+    default: return -1;
+    }
+    if ((size_t)(end - *pos) < len) {
+        return -1;
+    }
+    *val = 0;
+    while (len--) {
+        *val = (*val << 8) | *(*pos)++;
+    }
+    return byte >> 5;
+}
+
+/* reads a bstr or tstr, returns its content */
+static uint8_t *_cbor_str(uint8_t **pos, const uint8_t *end, int major,
+                          size_t *len)
+{
+    uint32_t val;
+
+    if (_cbor_head(pos, end, &val) != major || (size_t)(end - *pos) < val) {
+        return NULL;
+    }
+    uint8_t *str = *pos;
+    *pos += val;
+    *len = val;
+    return str;
 }
 
 int security_ctx_decode(security_ctx_t *ctx, uint8_t *in, size_t in_len,
-                        uint8_t *buf, size_t buf_len, uint8_t *out, size_t *olen)
+                        uint8_t **out, size_t *olen)
 {
-    cose_key_t key;
-
-    /* setup cose key */
-    cose_key_init(&key);
-    cose_key_set_kid(&key, ctx->recv_id, ctx->recv_id_len);
-    cose_key_set_keys(&key, 0, COSE_ALGO_AESCCM_16_64_128, NULL, NULL,
-                      ctx->recv_ctx_key);
-    cose_encrypt_dec_t decrypt;
-    cose_encrypt_decode(&decrypt, in, in_len);
-    return cose_encrypt_decrypt(&decrypt, NULL, &key, buf, buf_len, out, olen);
+    const uint8_t *end = in + in_len;
+    uint8_t *pos = in;
+    uint8_t *protected;
+    uint8_t *nonce = NULL;
+    uint8_t *ct;
+    size_t protected_len;
+    size_t ct_len;
+    uint32_t val;
+
+    /* optional COSE_Encrypt0 tag */
+    if (pos < end && *pos == _cose_hdr[0]) {
+        pos++;
+    }
+    if (_cbor_head(&pos, end, &val) != 4 || val != 3) {
+        return -EBADMSG;
+    }
+    protected = _cbor_str(&pos, end, 2, &protected_len);
+    if (!protected || protected_len > COSE_PROTECTED_MAX) {
+        return -EBADMSG;
+    }
+    /* unprotected header map, only the IV is used */
+    if (_cbor_head(&pos, end, &val) != 5) {
+        return -EBADMSG;
+    }
+    for (uint32_t i = 0; i < val; i++) {
+        uint32_t label;
+        uint32_t num;
+        uint8_t *value;
+        size_t len;
+        int major = _cbor_head(&pos, end, &label);
+
+        if ((major != 0 && major != 1) || pos >= end) {
+            return -EBADMSG;
+        }
+        switch (*pos >> 5) {
+        case 0:
+        case 1:
+            /* integer values are not needed */
+            _cbor_head(&pos, end, &num);
+            break;
+        case 2:
+        case 3:
+            value = _cbor_str(&pos, end, *pos >> 5, &len);
+            if (!value) {
+                return -EBADMSG;
+            }
+            if (major == 0 && label == 5 && len == SECURITY_CTX_NONCE_LEN) {
+                nonce = value;
+            }
+            break;
+        default:
+            return -EBADMSG;
+        }
+    }
+    ct = _cbor_str(&pos, end, 2, &ct_len);
+    if (!nonce || !ct || ct_len < SECURITY_CTX_TAG_LEN) {
+        return -EBADMSG;
+    }
+
+    uint8_t aad[sizeof(_enc_structure) + 2 + COSE_PROTECTED_MAX];
+    size_t aad_len = _enc_structure_build(aad, protected, protected_len);
+    struct tc_ccm_mode_struct ccm;
+
+    /* decrypt in place */
+    if (tc_ccm_config(&ccm, &ctx->recv_sched, nonce, SECURITY_CTX_NONCE_LEN,
+                      SECURITY_CTX_TAG_LEN) != TC_CRYPTO_SUCCESS ||
+        tc_ccm_decryption_verification(ct, ct_len - SECURITY_CTX_TAG_LEN,
+                                       aad, aad_len, ct, ct_len,
+                                       &ccm) != TC_CRYPTO_SUCCESS) {
+        return -EBADMSG;
+    }
+    *out = ct;
+    *olen = ct_len - SECURITY_CTX_TAG_LEN;
+    return 0;
 }
 
 #if IS_USED(MODULE_EDHOC_COAP)
@@ -160,17 +372,10 @@ static void print_bstr(const uint8_t *bstr, size_t bstr_len)
     LOG_INFO("\n");
 }
 
-int security_ctx_edhoc_handshake(security_ctx_t *ctx, edhoc_ctx_t *e_ctx,
-                                 sock_udp_ep_t *remote)
+int security_ctx_edhoc_derive(security_ctx_t *ctx, edhoc_ctx_t *e_ctx)
 {
-    /* create a random 4 bytes token */
-    uint8_t token[4];
-    uint32_t rand = random_uint32();
-
-    memcpy(&token, &rand, sizeof(token));
-    LOG_INFO("[enrollment]: initialize security context...\n");
-    int ret = edhoc_coap_handshake(e_ctx, remote, EDHOC_AUTH_SIGN_SIGN,
-                                   EDHOC_CIPHER_SUITE_0);
+    int ret = e_ctx->state == EDHOC_FINALIZED ? 0 : -1;
+
     if (ret == 0) {
         LOG_DEBUG("[security_ctx]: derive security ctx\n");
         uint8_t secret[16];
@@ -202,7 +407,7 @@ int security_ctx_edhoc_handshake(security_ctx_t *ctx, edhoc_ctx_t *e_ctx,
         LOG_DEBUG("[security_ctx]: error generating context\n");
         return -1;
     }
-    LOG_DEBUG("[security_ctx]: failed handshake\n");
+    LOG_DEBUG("[security_ctx]: handshake not finalized\n");
     return -1;
 }
 #endif
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sys_sim_bus Simulated Radio Bus
+ * @ingroup     sys
+ * @brief       Radio frames exchange between native instances
+ *
+ * Several `native` instances of an application exchange simulated BLE and
+ * UWB frames over UDP on the loopback interface: node `i` of `n` receives on
+ * port @ref CONFIG_SIM_BUS_PORT + `i` and sends every frame to the other
+ * `n - 1` ports. This is the transport of the `desire_advertiser_sim`,
+ * `desire_scanner_sim` and `twr_sim` backends.
+ *
+ * Every frame carries the sender position, the receiver applies the link
+ * model:
+ * - frames from further than `range_cm` are never received
+ * - frames are lost with a probability growing from `loss_permille` to 1 with
+ *   the square of the distance over `range_cm`
+ * - the RSSI follows free space path loss from `rssi_1m_dbm` at 1m, with a
+ *   uniform noise of +/- `rssi_noise_dbm`
+ * - ranging results are the distance with a uniform noise of
+ *   +/- `range_noise_cm`, see @ref sim_bus_ranging_cm
+ *
+ * The node, number of nodes and position are read from the environment on
+ * initialization:
+ *
+ * | Variable         | Default     |
+ * |------------------|-------------|
+ * | `SIM_BUS_NODE`   | 0           |
+ * | `SIM_BUS_NODES`  | 2           |
+ * | `SIM_BUS_X_CM`   | node * 100  |
+ * | `SIM_BUS_Y_CM`   | 0           |
+ *
+ * `SIM_BUS_NODES` is at most @ref CONFIG_SIM_BUS_NODES_MAX and `SIM_BUS_NODE`
+ * below `SIM_BUS_NODES`.
+ *
+ * Received frames are copied from the SIGIO handler into a queue, the model
+ * and the receive callbacks run on @ref CONFIG_SIM_BUS_EVENT_PRIO. The
+ * position and link model can be changed at runtime, with the `sim` shell
+ * command if `sim_bus_shell` is used.
+ *
+ * @{
+ *
+ * @file
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include <stdint.h>
+
+#include "event/thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Port of the first node, node i receives on port + i
+ */
+#ifndef CONFIG_SIM_BUS_PORT
+#define CONFIG_SIM_BUS_PORT             (17750U)
+#endif
+
+/**
+ * @brief   Maximum number of nodes on the bus
+ */
+#ifndef CONFIG_SIM_BUS_NODES_MAX
+#define CONFIG_SIM_BUS_NODES_MAX        (16U)
+#endif
+
+/**
+ * @brief   Received frames queue size, frames are dropped when it is full
+ */
+#ifndef CONFIG_SIM_BUS_RX_QUEUE_SIZE
+#define CONFIG_SIM_BUS_RX_QUEUE_SIZE    (16U)
+#endif
+
+/**
+ * @brief   Maximum frame payload size
+ */
+#ifndef CONFIG_SIM_BUS_PAYLOAD_MAX
+#define CONFIG_SIM_BUS_PAYLOAD_MAX      (32U)
+#endif
+
+/**
+ * @brief   Event queue the receive callbacks run on
+ */
+#ifndef CONFIG_SIM_BUS_EVENT_PRIO
+#define CONFIG_SIM_BUS_EVENT_PRIO       (EVENT_PRIO_HIGHEST)
+#endif
+
+/**
+ * @brief   Default radio range in cm
+ */
+#ifndef CONFIG_SIM_BUS_RANGE_CM
+#define CONFIG_SIM_BUS_RANGE_CM         (1000U)
+#endif
+
+/**
+ * @brief   Default loss at a null distance, in permille
+ */
+#ifndef CONFIG_SIM_BUS_LOSS_PERMILLE
+#define CONFIG_SIM_BUS_LOSS_PERMILLE    (0U)
+#endif
+
+/**
+ * @brief   Default RSSI at 1m
+ */
+#ifndef CONFIG_SIM_BUS_RSSI_1M_DBM
+#define CONFIG_SIM_BUS_RSSI_1M_DBM      (-59)
+#endif
+
+/**
+ * @brief   Default RSSI noise amplitude
+ */
+#ifndef CONFIG_SIM_BUS_RSSI_NOISE_DBM
+#define CONFIG_SIM_BUS_RSSI_NOISE_DBM   (4U)
+#endif
+
+/**
+ * @brief   Default ranging noise amplitude
+ */
+#ifndef CONFIG_SIM_BUS_RANGE_NOISE_CM
+#define CONFIG_SIM_BUS_RANGE_NOISE_CM   (10U)
+#endif
+
+/**
+ * @brief   Frame types
+ */
+typedef enum {
+    SIM_BUS_FRAME_BLE_ADV = 0,      /**< BLE advertisement */
+    SIM_BUS_FRAME_UWB_POLL,         /**< UWB ranging request */
+    SIM_BUS_FRAME_UWB_RESP,         /**< UWB ranging response */
+    SIM_BUS_FRAME_NUMOF,            /**< number of frame types */
+} sim_bus_frame_type_t;
+
+/**
+ * @brief   A frame, as sent on the bus
+ */
+typedef struct __attribute__((__packed__)) {
+    uint8_t type;                                   /**< the frame type */
+    uint8_t node;                                   /**< the sender node, set on send */
+    int32_t x_cm;                                   /**< the sender position, set on send */
+    int32_t y_cm;                                   /**< the sender position, set on send */
+    uint16_t src;                                   /**< the source short address */
+    uint16_t dst;                                   /**< the destination short address */
+    uint8_t len;                                    /**< the payload length */
+    uint8_t payload[CONFIG_SIM_BUS_PAYLOAD_MAX];    /**< the payload */
+} sim_bus_frame_t;
+
+/**
+ * @brief   Link to the sender of a received frame
+ */
+typedef struct {
+    uint16_t distance_cm;   /**< distance to the sender */
+    int8_t rssi;            /**< the frame RSSI */
+} sim_bus_link_t;
+
+/**
+ * @brief   Link model parameters
+ */
+typedef struct {
+    uint16_t range_cm;          /**< radio range */
+    uint16_t loss_permille;     /**< loss at a null distance */
+    int8_t rssi_1m_dbm;         /**< RSSI at 1m */
+    uint8_t rssi_noise_dbm;     /**< RSSI noise amplitude */
+    uint8_t range_noise_cm;     /**< ranging noise amplitude */
+} sim_bus_model_t;
+
+/**
+ * @brief   Bus counters
+ */
+typedef struct {
+    uint32_t tx;            /**< frames sent */
+    uint32_t rx;            /**< frames received */
+    uint32_t lost;          /**< frames lost by the model */
+    uint32_t out_of_range;  /**< frames from out of range nodes */
+    uint32_t overflow;      /**< frames dropped, receive queue full */
+} sim_bus_stats_t;
+
+/**
+ * @brief   Receive callback, runs on @ref CONFIG_SIM_BUS_EVENT_PRIO
+ *
+ * @param[in]   frame   the received frame
+ * @param[in]   link    the link to the sender
+ */
+typedef void (*sim_bus_rx_cb_t)(const sim_bus_frame_t *frame,
+                                const sim_bus_link_t *link);
+
+/**
+ * @brief   Initialize the bus, only the first call has an effect
+ *
+ * @return  0 on success, -EINVAL if the environment holds an invalid or out
+ *          of range value, <0 if the sockets could not be set up
+ */
+int sim_bus_init(void);
+
+/**
+ * @brief   Set the receive callback of a frame type
+ *
+ * @param[in]   type    the frame type
+ * @param[in]   cb      the callback, NULL to drop frames of that type
+ */
+void sim_bus_set_rx_cb(sim_bus_frame_type_t type, sim_bus_rx_cb_t cb);
+
+/**
+ * @brief   Send a frame to all other nodes
+ *
+ * @param[inout]    frame   the frame, the sender node and position are set
+ *
+ * @return  0 on success, <0 if the frame could not be sent to some node
+ */
+int sim_bus_send(sim_bus_frame_t *frame);
+
+/**
+ * @brief   This node on the bus
+ *
+ * @return  the node index
+ */
+uint8_t sim_bus_node(void);
+
+/**
+ * @brief   Set this node position
+ *
+ * @param[in]   x_cm    the x coordinate
+ * @param[in]   y_cm    the y coordinate
+ */
+void sim_bus_set_position(int32_t x_cm, int32_t y_cm);
+
+/**
+ * @brief   Get this node position
+ *
+ * @param[out]  x_cm    the x coordinate
+ * @param[out]  y_cm    the y coordinate
+ */
+void sim_bus_get_position(int32_t *x_cm, int32_t *y_cm);
+
+/**
+ * @brief   Set the link model, applied to frames received from now on
+ *
+ * @param[in]   model   the model
+ */
+void sim_bus_set_model(const sim_bus_model_t *model);
+
+/**
+ * @brief   Get the link model
+ *
+ * @param[out]  model   the model
+ */
+void sim_bus_get_model(sim_bus_model_t *model);
+
+/**
+ * @brief   A ranging result over a link, the distance with the model noise
+ *
+ * @param[in]   link    the link
+ *
+ * @return  the range in cm
+ */
+uint16_t sim_bus_ranging_cm(const sim_bus_link_t *link);
+
+/**
+ * @brief   Get the bus counters
+ *
+ * @param[out]  stats   the counters
+ */
+void sim_bus_get_stats(sim_bus_stats_t *stats);
+
+/**
+ * @brief   Clear the bus counters
+ */
+void sim_bus_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_BUS_H */
+/** @} */
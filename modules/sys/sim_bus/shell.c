@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief       Simulated radio bus shell commands
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "shell.h"
+#include "xfa.h"
+
+#include "sim_bus.h"
+
+static void _print_usage(void)
+{
+    puts("Usage:");
+    puts("\tsim: prints the node position, link model and counters");
+    puts("\tsim pos <x_cm> <y_cm>: moves the node");
+    puts("\tsim model <range_cm> <loss_permille> [rssi_1m_dbm] [rssi_noise_dbm] "
+         "[range_noise_cm]: sets the link model");
+    puts("\tsim reset: clears the counters");
+}
+
+static void _print_status(void)
+{
+    int32_t x_cm, y_cm;
+    sim_bus_model_t model;
+    sim_bus_stats_t stats;
+
+    sim_bus_get_position(&x_cm, &y_cm);
+    sim_bus_get_model(&model);
+    sim_bus_get_stats(&stats);
+    printf("node=%u pos=(%" PRId32 ", %" PRId32 ")\n", sim_bus_node(), x_cm, y_cm);
+    printf("range=%" PRIu16 "cm loss=%" PRIu16 "/1000 rssi_1m=%" PRId8
+           "dBm rssi_noise=%" PRIu8 "dBm range_noise=%" PRIu8 "cm\n",
+           model.range_cm, model.loss_permille, model.rssi_1m_dbm,
+           model.rssi_noise_dbm, model.range_noise_cm);
+    printf("tx=%" PRIu32 " rx=%" PRIu32 " lost=%" PRIu32 " out_of_range=%" PRIu32
+           " overflow=%" PRIu32 "\n", stats.tx, stats.rx, stats.lost,
+           stats.out_of_range, stats.overflow);
+}
+
+static int _sim_handler(int argc, char **argv)
+{
+    if (argc == 1) {
+        _print_status();
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "pos") && argc == 4) {
+        sim_bus_set_position(atoi(argv[2]), atoi(argv[3]));
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "model") && argc >= 4) {
+        sim_bus_model_t model;
+        sim_bus_get_model(&model);
+        model.range_cm = atoi(argv[2]);
+        model.loss_permille = atoi(argv[3]);
+        if (!model.range_cm || model.loss_permille > 1000) {
+            _print_usage();
+            return -1;
+        }
+        if (argc >= 5) {
+            model.rssi_1m_dbm = atoi(argv[4]);
+        }
+        if (argc >= 6) {
+            model.rssi_noise_dbm = atoi(argv[5]);
+        }
+        if (argc >= 7) {
+            model.range_noise_cm = atoi(argv[6]);
+        }
+        sim_bus_set_model(&model);
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "reset")) {
+        sim_bus_reset_stats();
+        return 0;
+    }
+
+    _print_usage();
+    return -1;
+}
+
+SHELL_COMMAND(sim, "simulated radio bus", _sim_handler);
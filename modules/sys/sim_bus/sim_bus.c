@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_sim_bus
+ * @{
+ *
+ * @file
+ * @brief       Simulated radio bus over loopback UDP
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "async_read.h"
+#include "native_internal.h"
+
+#include "irq.h"
+#include "event.h"
+#include "random.h"
+
+#include "sim_bus.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+/* frame size without payload */
+#define FRAME_HDR_SIZE      (sizeof(sim_bus_frame_t) - CONFIG_SIM_BUS_PAYLOAD_MAX)
+
+static bool _init = false;
+static uint8_t _node;
+static uint8_t _nodes;
+static int32_t _x_cm;
+static int32_t _y_cm;
+static int _rx_sock = -1;
+/* one socket per node, connected to its port */
+static int _tx_socks[CONFIG_SIM_BUS_NODES_MAX];
+
+static sim_bus_model_t _model = {
+    .range_cm = CONFIG_SIM_BUS_RANGE_CM,
+    .loss_permille = CONFIG_SIM_BUS_LOSS_PERMILLE,
+    .rssi_1m_dbm = CONFIG_SIM_BUS_RSSI_1M_DBM,
+    .rssi_noise_dbm = CONFIG_SIM_BUS_RSSI_NOISE_DBM,
+    .range_noise_cm = CONFIG_SIM_BUS_RANGE_NOISE_CM,
+};
+static sim_bus_stats_t _stats;
+static sim_bus_rx_cb_t _rx_cbs[SIM_BUS_FRAME_NUMOF];
+
+/* frames received in the SIGIO handler, waiting to be processed */
+static sim_bus_frame_t _rx_frames[CONFIG_SIM_BUS_RX_QUEUE_SIZE];
+static unsigned _rx_head;
+static unsigned _rx_count;
+
+static int _noise(unsigned amplitude)
+{
+    return (int)random_uint32_range(0, 2 * amplitude + 1) - (int)amplitude;
+}
+
+static uint16_t _distance_cm(const sim_bus_frame_t *frame)
+{
+    float dx = frame->x_cm - _x_cm;
+    float dy = frame->y_cm - _y_cm;
+    float d = sqrtf(dx * dx + dy * dy);
+
+    return d > UINT16_MAX ? UINT16_MAX : (uint16_t)d;
+}
+
+static bool _lost(uint16_t d_cm)
+{
+    uint64_t d2 = (uint64_t)d_cm * d_cm;
+    uint64_t r2 = (uint64_t)_model.range_cm * _model.range_cm;
+    uint32_t loss = _model.loss_permille +
+                    (1000 - _model.loss_permille) * d2 / r2;
+
+    return random_uint32_range(0, 1000) < loss;
+}
+
+static int8_t _rssi(uint16_t d_cm)
+{
+    /* free space path loss, flat under 10cm */
+    float d_m = (d_cm < 10 ? 10 : d_cm) / 100.0f;
+    int rssi = _model.rssi_1m_dbm - (int)(20 * log10f(d_m)) +
+               _noise(_model.rssi_noise_dbm);
+
+    return rssi < INT8_MIN ? INT8_MIN : rssi;
+}
+
+static void _rx_handler(event_t *event)
+{
+    (void)event;
+    sim_bus_frame_t frame;
+
+    while (1) {
+        unsigned state = irq_disable();
+        if (!_rx_count) {
+            irq_restore(state);
+            return;
+        }
+        unsigned tail = (_rx_head + CONFIG_SIM_BUS_RX_QUEUE_SIZE - _rx_count) %
+                        CONFIG_SIM_BUS_RX_QUEUE_SIZE;
+        frame = _rx_frames[tail];
+        _rx_count--;
+        irq_restore(state);
+
+        if (frame.type >= SIM_BUS_FRAME_NUMOF || frame.node == _node) {
+            continue;
+        }
+        sim_bus_link_t link = { .distance_cm = _distance_cm(&frame) };
+        if (link.distance_cm > _model.range_cm) {
+            _stats.out_of_range++;
+            continue;
+        }
+        if (_lost(link.distance_cm)) {
+            _stats.lost++;
+            continue;
+        }
+        link.rssi = _rssi(link.distance_cm);
+        _stats.rx++;
+        if (_rx_cbs[frame.type]) {
+            _rx_cbs[frame.type](&frame, &link);
+        }
+    }
+}
+static event_t _rx_event = { .handler = _rx_handler };
+
+static void _sigio_cb(int fd, void *arg)
+{
+    (void)arg;
+    ssize_t res;
+
+    /* runs in ISR context, only copy the frames out */
+    do {
+        /* when full the head is the oldest queued frame, drain the datagram
+           without overwriting it */
+        static sim_bus_frame_t scratch;
+        bool full = _rx_count == CONFIG_SIM_BUS_RX_QUEUE_SIZE;
+        sim_bus_frame_t *frame = full ? &scratch : &_rx_frames[_rx_head];
+        res = real_read(fd, frame, sizeof(*frame));
+        /* drop truncated or inconsistent frames before they are queued */
+        if (res < (ssize_t)FRAME_HDR_SIZE ||
+            frame->len > CONFIG_SIM_BUS_PAYLOAD_MAX ||
+            (ssize_t)frame->len != res - (ssize_t)FRAME_HDR_SIZE) {
+            continue;
+        }
+        if (full) {
+            _stats.overflow++;
+            continue;
+        }
+        _rx_head = (_rx_head + 1) % CONFIG_SIM_BUS_RX_QUEUE_SIZE;
+        _rx_count++;
+    } while (res > 0);
+    event_post(CONFIG_SIM_BUS_EVENT_PRIO, &_rx_event);
+    native_async_read_continue(fd);
+}
+
+static void _loopback_addr(struct sockaddr_in *addr, uint8_t node)
+{
+    memset(addr, '\0', sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(CONFIG_SIM_BUS_PORT + node);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+/* reads a number within [min, max] from the environment */
+static int _getenv_long(const char *name, long def, long min, long max, long *val)
+{
+    const char *str = getenv(name);
+    char *end;
+
+    if (!str) {
+        *val = def;
+        return 0;
+    }
+    errno = 0;
+    *val = strtol(str, &end, 10);
+    if (errno || end == str || *end != '\0' || *val < min || *val > max) {
+        LOG_ERROR("[sim_bus]: invalid %s=%s\n", name, str);
+        return -EINVAL;
+    }
+    return 0;
+}
+
+int sim_bus_init(void)
+{
+    struct sockaddr_in addr;
+    long node, nodes, x_cm, y_cm;
+
+    if (_init) {
+        return 0;
+    }
+    if (_getenv_long("SIM_BUS_NODES", 2, 1, CONFIG_SIM_BUS_NODES_MAX, &nodes) ||
+        _getenv_long("SIM_BUS_NODE", 0, 0, nodes - 1, &node) ||
+        _getenv_long("SIM_BUS_X_CM", node * 100, INT32_MIN, INT32_MAX, &x_cm) ||
+        _getenv_long("SIM_BUS_Y_CM", 0, INT32_MIN, INT32_MAX, &y_cm)) {
+        return -EINVAL;
+    }
+    _node = node;
+    _nodes = nodes;
+    _x_cm = x_cm;
+    _y_cm = y_cm;
+
+    _rx_sock = real_socket(AF_INET, SOCK_DGRAM, 0);
+    _loopback_addr(&addr, _node);
+    if (_rx_sock < 0 ||
+        real_bind(_rx_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR("[sim_bus]: can not bind port %u\n", ntohs(addr.sin_port));
+        return -EADDRINUSE;
+    }
+    for (uint8_t i = 0; i < _nodes; i++) {
+        _tx_socks[i] = -1;
+        if (i == _node) {
+            continue;
+        }
+        _loopback_addr(&addr, i);
+        _tx_socks[i] = real_socket(AF_INET, SOCK_DGRAM, 0);
+        if (_tx_socks[i] < 0 ||
+            real_connect(_tx_socks[i], (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            LOG_ERROR("[sim_bus]: can not reach node %u\n", i);
+            return -ENOTCONN;
+        }
+    }
+
+    native_async_read_setup();
+    native_async_read_add_handler(_rx_sock, NULL, _sigio_cb);
+    /* every pending frame is read on SIGIO */
+    real_fcntl(_rx_sock, F_SETFL, real_fcntl(_rx_sock, F_GETFL) | O_NONBLOCK);
+    _init = true;
+    LOG_INFO("[sim_bus]: node %u/%u at (%" PRId32 ", %" PRId32 ")\n",
+             _node, _nodes, _x_cm, _y_cm);
+    return 0;
+}
+
+void sim_bus_set_rx_cb(sim_bus_frame_type_t type, sim_bus_rx_cb_t cb)
+{
+    assert(type < SIM_BUS_FRAME_NUMOF);
+    _rx_cbs[type] = cb;
+}
+
+int sim_bus_send(sim_bus_frame_t *frame)
+{
+    int res = 0;
+
+    assert(_init && frame->len <= CONFIG_SIM_BUS_PAYLOAD_MAX);
+    frame->node = _node;
+    frame->x_cm = _x_cm;
+    frame->y_cm = _y_cm;
+    for (uint8_t i = 0; i < _nodes; i++) {
+        if (i == _node) {
+            continue;
+        }
+        /* a node that is not running yet is not an error */
+        if (real_write(_tx_socks[i], frame, FRAME_HDR_SIZE + frame->len) < 0 &&
+            errno != ECONNREFUSED) {
+            res = -EIO;
+        }
+    }
+    _stats.tx++;
+    return res;
+}
+
+uint8_t sim_bus_node(void)
+{
+    return _node;
+}
+
+void sim_bus_set_position(int32_t x_cm, int32_t y_cm)
+{
+    unsigned state = irq_disable();
+
+    _x_cm = x_cm;
+    _y_cm = y_cm;
+    irq_restore(state);
+}
+
+void sim_bus_get_position(int32_t *x_cm, int32_t *y_cm)
+{
+    unsigned state = irq_disable();
+
+    *x_cm = _x_cm;
+    *y_cm = _y_cm;
+    irq_restore(state);
+}
+
+void sim_bus_set_model(const sim_bus_model_t *model)
+{
+    assert(model->range_cm && model->loss_permille <= 1000);
+    _model = *model;
+}
+
+void sim_bus_get_model(sim_bus_model_t *model)
+{
+    *model = _model;
+}
+
+uint16_t sim_bus_ranging_cm(const sim_bus_link_t *link)
+{
+    int range = link->distance_cm + _noise(_model.range_noise_cm);
+
+    return range < 0 ? 0 : range;
+}
+
+void sim_bus_get_stats(sim_bus_stats_t *stats)
+{
+    unsigned state = irq_disable();
+
+    *stats = _stats;
+    irq_restore(state);
+}
+
+void sim_bus_reset_stats(void)
+{
+    unsigned state = irq_disable();
+
+    memset(&_stats, '\0', sizeof(_stats));
+    irq_restore(state);
+}
@@ -19,10 +19,14 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
+#include "mutex.h"
 #include "vfs.h"
 #include "board.h"
 
@@ -72,15 +76,25 @@ VFS_AUTO_MOUNT(fatfs, VFS_MTD(_mtd_sdcard_mtd0), VFS_DEFAULT_NVM(0), 0);
 #endif
 #endif
 
+/* longest path of a directory entry */
+#define STORAGE_PATH_MAX    (64U)
+
+/* files are written and read back from different threads */
+static mutex_t _lock = MUTEX_INIT;
+
 int storage_init(void)
 {
     if (MTD_0) {
+        mutex_lock(&_lock);
         int res = vfs_mount_by_path(VFS_STORAGE_DATA);
         if ( res != 0 && res != -EBUSY) {
+            mutex_unlock(&_lock);
             LOG_ERROR("[fs]: ERROR, failed to setup %s res=(%d)\n", VFS_STORAGE_DATA, res);
             return -1;
         }
-        return storage_dirs_create_sys_hier();
+        res = storage_dirs_create_sys_hier();
+        mutex_unlock(&_lock);
+        return res;
     }
     else {
         return -1;
@@ -90,7 +104,10 @@ int storage_init(void)
 int storage_deinit(void)
 {
     if (MTD_0) {
-        return vfs_unmount_by_path(VFS_STORAGE_DATA);
+        mutex_lock(&_lock);
+        int res = vfs_unmount_by_path(VFS_STORAGE_DATA);
+        mutex_unlock(&_lock);
+        return res;
     }
     else {
         return -1;
@@ -100,19 +117,99 @@ int storage_deinit(void)
 int storage_log(const char *path, uint8_t *buffer, size_t len)
 {
     if (MTD_0) {
+        mutex_lock(&_lock);
         int fd = vfs_open(path, O_WRONLY | O_APPEND | O_CREAT, 0);
 
         if (fd < 0) {
+            mutex_unlock(&_lock);
             LOG_ERROR("[fs]: error while trying to create %s\n", path);
-            return 1;
+            return fd;
         }
-        if (vfs_write(fd, buffer, len) != (ssize_t)len) {
+        ssize_t res = vfs_write(fd, buffer, len);
+        vfs_close(fd);
+        mutex_unlock(&_lock);
+        if (res != (ssize_t)len) {
             LOG_ERROR("[fs]: error while writing\n");
+            return res < 0 ? res : -EIO;
         }
-        vfs_close(fd);
         return 0;
     }
     (void)buffer;
     (void)len;
-    return -1;
+    return -ENODEV;
+}
+
+ssize_t storage_read(const char *path, size_t offset, uint8_t *buffer, size_t len)
+{
+    if (MTD_0) {
+        mutex_lock(&_lock);
+        int fd = vfs_open(path, O_RDONLY, 0);
+
+        if (fd < 0) {
+            mutex_unlock(&_lock);
+            return fd;
+        }
+        /* seeking past the end leaves nothing to read */
+        ssize_t res = vfs_lseek(fd, offset, SEEK_SET);
+        if (res >= 0) {
+            res = vfs_read(fd, buffer, len);
+        }
+        vfs_close(fd);
+        mutex_unlock(&_lock);
+        return res;
+    }
+    (void)offset;
+    (void)buffer;
+    (void)len;
+    return -ENODEV;
+}
+
+int storage_dir_entry(const char *dir, unsigned idx, char *name, size_t name_len,
+                      size_t *size)
+{
+    if (MTD_0) {
+        vfs_DIR dirp;
+        vfs_dirent_t entry;
+        char path[STORAGE_PATH_MAX];
+        size_t dir_len = strlen(dir);
+        const char *sep = dir_len && dir[dir_len - 1] == '/' ? "" : "/";
+
+        mutex_lock(&_lock);
+        int res = vfs_opendir(&dirp, dir);
+        if (res < 0) {
+            mutex_unlock(&_lock);
+            return res;
+        }
+        while ((res = vfs_readdir(&dirp, &entry)) > 0) {
+            struct stat st;
+            if (!strcmp(entry.d_name, ".") || !strcmp(entry.d_name, "..") ||
+                snprintf(path, sizeof(path), "%s%s%s", dir, sep, entry.d_name) >=
+                (int)sizeof(path) ||
+                vfs_stat(path, &st) < 0 || S_ISDIR(st.st_mode)) {
+                continue;
+            }
+            if (idx--) {
+                continue;
+            }
+            if (strlen(entry.d_name) >= name_len) {
+                res = -ENOBUFS;
+                break;
+            }
+            strcpy(name, entry.d_name);
+            if (size) {
+                *size = st.st_size;
+            }
+            break;
+        }
+        vfs_closedir(&dirp);
+        mutex_unlock(&_lock);
+        /* readdir returns 0 past the last entry */
+        return res < 0 ? res : (res ? 0 : -ENOENT);
+    }
+    (void)dir;
+    (void)idx;
+    (void)name;
+    (void)name_len;
+    (void)size;
+    return -ENODEV;
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_storage
+ * @{
+ *
+ * @file
+ * @brief       Storage internal flash circular log backend
+ *
+ * Instead of files on a mounted filesystem every @ref storage_log call
+ * appends a record to a @ref sys_flashlog ring in the last pages of the
+ * internal flash, tagged with a hash of the target path. Buffers larger than
+ * a record are split over consecutive records.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "mtd_flashpage.h"
+#include "periph/flashpage.h"
+
+#include "storage.h"
+#include "flashlog.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+static mtd_flashpage_t _mtd_flashpage = MTD_FLASHPAGE_INIT_VAL(1);
+static flashlog_t _flashlog;
+static bool _initialized = false;
+
+uint16_t storage_flashlog_tag(const char *path)
+{
+    /* djb2 folded to 16 bits */
+    uint32_t hash = 5381;
+
+    while (*path) {
+        hash = ((hash << 5) + hash) + (uint8_t)*path++;
+    }
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+flashlog_t *storage_flashlog_get(void)
+{
+    return _initialized ? &_flashlog : NULL;
+}
+
+int storage_init(void)
+{
+    if (_initialized) {
+        return 0;
+    }
+    mtd_dev_t *mtd = &_mtd_flashpage.base;
+    if (mtd_init(mtd) < 0) {
+        LOG_ERROR("[fs]: ERROR, failed to init flashpage mtd\n");
+        return -1;
+    }
+    if (flashlog_init(&_flashlog, mtd, CONFIG_STORAGE_FLASHLOG_FIRST_PAGE,
+                      CONFIG_STORAGE_FLASHLOG_PAGES)) {
+        LOG_ERROR("[fs]: ERROR, failed to setup flash log\n");
+        return -1;
+    }
+    _initialized = true;
+    return 0;
+}
+
+int storage_deinit(void)
+{
+    /* records are written through, nothing to flush */
+    return _initialized ? 0 : -1;
+}
+
+int storage_log(const char *path, uint8_t *buffer, size_t len)
+{
+    if (!_initialized) {
+        return -ENODEV;
+    }
+    /* as appending to a file, larger buffers are split over several
+       records with the same tag */
+    size_t max = flashlog_max_len(&_flashlog);
+    while (len) {
+        size_t chunk = len < max ? len : max;
+        int32_t seq = flashlog_append(&_flashlog, storage_flashlog_tag(path),
+                                      buffer, chunk);
+        if (seq < 0) {
+            LOG_ERROR("[fs]: error while writing %s\n", path);
+            return seq;
+        }
+        LOG_DEBUG("[fs]: logged %s, seq=%" PRId32 "\n", path, seq);
+        buffer += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+#if IS_USED(MODULE_SHELL)
+#include <stdio.h>
+#include <string.h>
+#include "shell.h"
+
+static int _cmd_flashlog(int argc, char **argv)
+{
+    if (!_initialized) {
+        puts("[fs]: flash log not initialized");
+        return -1;
+    }
+    if (argc == 2 && !strcmp(argv[1], "clear")) {
+        return flashlog_clear(&_flashlog);
+    }
+    if (argc != 1) {
+        puts("Usage: flashlog [clear]");
+        return -1;
+    }
+    flashlog_print_stats(&_flashlog);
+    return 0;
+}
+
+SHELL_COMMAND(flashlog, "internal flash log statistics", _cmd_flashlog);
+#endif
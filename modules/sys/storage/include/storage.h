@@ -25,8 +25,10 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
 
 #include "board.h"
+#include "kernel_defines.h"
 #include "mtd.h"
 
 #ifdef __cplusplus
@@ -64,10 +66,79 @@ int storage_deinit(void);
  * @param buffer    buffer holding data to log
  * @param len       size of data to log
  *
- * @return 0 on success, <0 otherwise
+ * @return 0 on success, negative errno otherwise
  */
 int storage_log(const char* path, uint8_t *buffer, size_t len);
 
+#if !IS_USED(MODULE_STORAGE_FLASHLOG) || defined(DOXYGEN)
+/**
+ * @brief   Read back a logged file
+ *
+ * @param path      filesystem path of the file
+ * @param offset    offset in the file to read from
+ * @param buffer    buffer to read into
+ * @param len       size of @p buffer
+ *
+ * @return number of bytes read, 0 at the end of the file, negative errno
+ *         otherwise
+ */
+ssize_t storage_read(const char *path, size_t offset, uint8_t *buffer, size_t len);
+
+/**
+ * @brief   Get a file of a directory by its index
+ *
+ * Files are indexed in directory order, subdirectories are skipped. As logs
+ * are only appended to, files created later get the next indexes.
+ *
+ * @param dir       directory path
+ * @param idx       index of the file in @p dir
+ * @param name      buffer for the file name
+ * @param name_len  size of @p name
+ * @param size      file size, may be NULL
+ *
+ * @return 0 on success, -ENOENT if @p dir has less than @p idx + 1 files,
+ *         negative errno otherwise
+ */
+int storage_dir_entry(const char *dir, unsigned idx, char *name, size_t name_len,
+                      size_t *size);
+#endif
+
+#if IS_USED(MODULE_STORAGE_FLASHLOG) || defined(DOXYGEN)
+#include "flashlog.h"
+
+/**
+ * @brief   Number of internal flash pages used by the circular log
+ *
+ * Pages are taken from the end of the internal flash, make sure they do
+ * not overlap with the firmware (or SUIT slots).
+ */
+#ifndef CONFIG_STORAGE_FLASHLOG_PAGES
+#define CONFIG_STORAGE_FLASHLOG_PAGES       (16U)
+#endif
+
+/**
+ * @brief   First internal flash page used by the circular log
+ */
+#ifndef CONFIG_STORAGE_FLASHLOG_FIRST_PAGE
+#define CONFIG_STORAGE_FLASHLOG_FIRST_PAGE  (FLASHPAGE_NUMOF - CONFIG_STORAGE_FLASHLOG_PAGES)
+#endif
+
+/**
+ * @brief   Record tag for a given path, records logged through
+ *          @ref storage_log are tagged with the hash of their path
+ *
+ * @param path      filesystem path the buffer was logged to
+ *
+ * @return the record tag
+ */
+uint16_t storage_flashlog_tag(const char *path);
+
+/**
+ * @brief   Returns the internal flash log, NULL if not initialized
+ */
+flashlog_t *storage_flashlog_get(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    sys_watermark Memory Pool and Stack Watermarks
+ * @ingroup     sys
+ * @brief       Usage watermarks of the static memory managers and thread stacks
+ *
+ * The encounter data and TWR event memory managers are fixed size
+ * memarrays. When this module is used each of them counts its current
+ * usage, its high watermark and its failed allocations, so that buffer sizes
+ * can be chosen from field data.
+ *
+ * Thread stack watermarks are measured from the stack painting done by
+ * RIOT when DEVELHELP is set, they are not available otherwise. Callers pass
+ * the threads they care about, so that these are reported whatever the
+ * number of threads.
+ *
+ * @{
+ *
+ * @file
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef WATERMARK_H
+#define WATERMARK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Maximum number of thread stacks reported in epoch data
+ */
+#ifndef CONFIG_WATERMARK_STACKS_NUMOF
+#define CONFIG_WATERMARK_STACKS_NUMOF   (8U)
+#endif
+
+/**
+ * @brief   Instrumented memory pools
+ */
+typedef enum {
+    WATERMARK_POOL_ED = 0,      /**< encounter data */
+    WATERMARK_POOL_TWR,         /**< TWR events */
+    WATERMARK_POOL_NUMOF,       /**< number of pools */
+} watermark_pool_id_t;
+
+/**
+ * @brief   Memory pool usage
+ */
+typedef struct {
+    uint16_t size;      /**< pool size in blocks */
+    uint16_t used;      /**< currently allocated blocks */
+    uint16_t high;      /**< most blocks allocated at once */
+    uint16_t fails;     /**< failed allocations */
+} watermark_pool_t;
+
+/**
+ * @brief   Thread stack usage
+ */
+typedef struct {
+    const char *name;   /**< thread name */
+    uint16_t size;      /**< stack size in bytes */
+    uint16_t used;      /**< most stack bytes used */
+} watermark_stack_t;
+
+/**
+ * @brief   Initialize a pool usage
+ *
+ * @param[out]  pool    the pool usage
+ * @param[in]   size    the pool size in blocks
+ */
+static inline void watermark_pool_init(watermark_pool_t *pool, uint16_t size)
+{
+    pool->size = size;
+    pool->used = 0;
+    pool->high = 0;
+    pool->fails = 0;
+}
+
+/**
+ * @brief   Account for an allocation attempt
+ *
+ * @note    Not locked, called wherever the pool itself is accessed
+ *
+ * @param[inout]    pool    the pool usage
+ * @param[in]       ok      true if a block was allocated
+ */
+static inline void watermark_pool_alloc(watermark_pool_t *pool, bool ok)
+{
+    if (!ok) {
+        pool->fails++;
+        return;
+    }
+    if (++pool->used > pool->high) {
+        pool->high = pool->used;
+    }
+}
+
+/**
+ * @brief   Account for a released block
+ *
+ * @param[inout]    pool    the pool usage
+ */
+static inline void watermark_pool_free(watermark_pool_t *pool)
+{
+    pool->used--;
+}
+
+/**
+ * @brief   Restart the high watermark from the current usage and clear
+ *          the failed allocations, e.g. at the start of an epoch
+ *
+ * @param[inout]    pool    the pool usage
+ */
+static inline void watermark_pool_reset(watermark_pool_t *pool)
+{
+    pool->high = pool->used;
+    pool->fails = 0;
+}
+
+/**
+ * @brief   Name of a pool
+ *
+ * @param[in]   id      the pool
+ *
+ * @return  the pool name
+ */
+const char *watermark_pool_name(watermark_pool_id_t id);
+
+/**
+ * @brief   Measure the stack usage of threads
+ *
+ * The threads in @p pids are measured first, the remaining @p stacks are
+ * filled with the other threads in PID order.
+ *
+ * @param[out]  stacks      the stack usages
+ * @param[in]   numof       the number of @p stacks
+ * @param[in]   pids        the threads to report first, invalid and
+ *                          duplicate PIDs are skipped, may be NULL
+ * @param[in]   pids_numof  the number of @p pids
+ *
+ * @return  the number of threads measured, 0 without DEVELHELP
+ */
+unsigned watermark_stacks(watermark_stack_t *stacks, unsigned numof,
+                          const kernel_pid_t *pids, unsigned pids_numof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WATERMARK_H */
+/** @} */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     sys_watermark
+ * @{
+ *
+ * @file
+ * @brief       Memory pool and stack watermarks implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include "sched.h"
+#include "thread.h"
+
+#include "watermark.h"
+
+static const char *_names[WATERMARK_POOL_NUMOF] = {
+    [WATERMARK_POOL_ED] = "ed",
+    [WATERMARK_POOL_TWR] = "twr",
+};
+
+const char *watermark_pool_name(watermark_pool_id_t id)
+{
+    return id < WATERMARK_POOL_NUMOF ? _names[id] : "unknown";
+}
+
+#ifdef DEVELHELP
+static bool _listed(kernel_pid_t pid, const kernel_pid_t *pids, unsigned numof)
+{
+    for (unsigned i = 0; i < numof; i++) {
+        if (pids[i] == pid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool _measure(kernel_pid_t pid, watermark_stack_t *stack)
+{
+    thread_t *thread = thread_get(pid);
+
+    if (thread == NULL) {
+        return false;
+    }
+    /* same measure as ps, from the untouched stack painting */
+    int size = thread_get_stacksize(thread);
+
+    stack->name = thread_get_name(thread);
+    stack->size = size;
+    stack->used = size - thread_measure_stack_free(thread_get_stackstart(thread));
+    return true;
+}
+#endif
+
+unsigned watermark_stacks(watermark_stack_t *stacks, unsigned numof,
+                          const kernel_pid_t *pids, unsigned pids_numof)
+{
+    unsigned count = 0;
+
+#ifdef DEVELHELP
+    for (unsigned i = 0; i < pids_numof && count < numof; i++) {
+        if (!_listed(pids[i], pids, i) && _measure(pids[i], &stacks[count])) {
+            count++;
+        }
+    }
+    for (kernel_pid_t pid = KERNEL_PID_FIRST;
+         pid <= KERNEL_PID_LAST && count < numof; pid++) {
+        if (!_listed(pid, pids, pids_numof) && _measure(pid, &stacks[count])) {
+            count++;
+        }
+    }
+#else
+    (void)stacks;
+    (void)numof;
+    (void)pids;
+    (void)pids_numof;
+#endif
+    return count;
+}
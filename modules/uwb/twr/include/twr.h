@@ -41,19 +41,48 @@
  * are two nodes one will be able to perform ranging correctly while the second one
  * will fail.
  *
+ * ### Neighbour Clock Estimates
+ *
+ * With the `twr_peer` module completed exchanges are used to estimate, per
+ * neighbour short address, where its requests land in the local listen
+ * windows (offset) and its clock drift relative to the local one. Managed
+ * listen events are then centered on the predicted arrival of the
+ * neighbour request, see @ref twr_peer_predict_us.
+ *
+ * Only the responder can observe where a request lands in its window, so
+ * the correction is applied to listen events and not to requests.
+ *
+ * ### Simulated Radio
+ *
+ * With the `twr_sim` module uwb-core is replaced by exchanges over the
+ * simulated radio bus (see @ref sys_sim_bus), so that the same API runs on
+ * `native`. A request is a poll frame to the destination short address,
+ * a node within its listen window answers with the range given by the bus
+ * link model and both ends complete the exchange. The initiator times out
+ * after @ref CONFIG_TWR_SIM_RESPONSE_TIMEOUT_US, the responder at the end of
+ * its listen window. `twr_shell` needs uwb-core and is not available.
+ * `twr_peer` is fed where polls land in the listen windows, the simulated
+ * nodes all run on the host clock so their drift is sampled as 0.
+ *
  */
 
 #ifndef TWR_H
 #define TWR_H
 
+#include "kernel_defines.h"
 #include "memarray.h"
 #include "event.h"
 #include "event/timeout.h"
 #include "event/callback.h"
+#if !IS_USED(MODULE_TWR_SIM)
 #include "uwb/uwb_ftypes.h"
+#endif
 
 #include "board.h"
 #include "periph/gpio.h"
+#if IS_USED(MODULE_WATERMARK)
+#include "watermark.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -118,6 +147,38 @@ extern "C" {
 #define CONFIG_TWR_RESET_ON_LOCK        1
 #endif
 
+/**
+ * @brief   Time for a simulated request to be answered, see `twr_sim`
+ */
+#ifndef CONFIG_TWR_SIM_RESPONSE_TIMEOUT_US
+#define CONFIG_TWR_SIM_RESPONSE_TIMEOUT_US  (5000U)
+#endif
+
+/**
+ * @brief   Number of neighbours to keep clock estimates for
+ */
+#ifndef CONFIG_TWR_PEER_NUMOF
+#define CONFIG_TWR_PEER_NUMOF           (8U)
+#endif
+/**
+ * @brief   Weight of a new sample in the neighbour estimates, as 1 / 2^shift
+ */
+#ifndef CONFIG_TWR_PEER_EWMA_SHIFT
+#define CONFIG_TWR_PEER_EWMA_SHIFT      (2U)
+#endif
+/**
+ * @brief   Samples required before a neighbour estimate is used
+ */
+#ifndef CONFIG_TWR_PEER_SAMPLES_MIN
+#define CONFIG_TWR_PEER_SAMPLES_MIN     (2U)
+#endif
+/**
+ * @brief   Maximum listen window correction in us
+ */
+#ifndef CONFIG_TWR_PEER_CORRECTION_MAX_US
+#define CONFIG_TWR_PEER_CORRECTION_MAX_US   ((int32_t)CONFIG_TWR_LISTEN_WINDOW_US)
+#endif
+
 /**
  * @brief   TWR status enum
  */
@@ -145,8 +206,31 @@ typedef struct twr_event {
     event_timeout_t timeout;    /**< the event timeout */
     event_callback_t event;     /**< the event callback */
     uint16_t addr;              /**< the address of destination */
+#if IS_USED(MODULE_TWR_PEER)
+    uint16_t offset;            /**< the scheduled offset in ticks */
+    int16_t correction;         /**< the listen window correction in ticks */
+#endif
+#if IS_USED(MODULE_LATENCY)
+    uint32_t deadline;          /**< the scheduled start, see latency_deadline() */
+#endif
 } twr_event_t;
 
+/**
+ * @brief   Neighbour clock estimates
+ */
+typedef struct twr_peer {
+    uint16_t addr;              /**< the neighbour address */
+    uint16_t offset_samples;    /**< samples taken for offset_us */
+    uint16_t drift_samples;     /**< samples taken for drift_ppb */
+    int32_t offset_us;          /**< arrival of the neighbour requests relative
+                                     to the center of the listen window, the
+                                     scheduling offset independent part */
+    int32_t drift_ppb;          /**< neighbour clock drift, positive if
+                                     faster than the local clock */
+    uint32_t last;              /**< last update sequence number, the least
+                                     recently updated entry is replaced */
+} twr_peer_t;
+
 /**
  * @brief   Callback for ranging event notification
  */
@@ -158,6 +242,9 @@ typedef void (*twr_callback_t)(twr_event_data_t *, twr_status_t);
 typedef struct twr_event_mem_manager {
     uint8_t buf[CONFIG_TWR_EVENT_BUF_SIZE * sizeof(twr_event_t)];   /**< event buffer */
     memarray_t mem;                                                 /**< Memarray management */
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_t watermark;                                     /**< usage watermarks */
+#endif
 } twr_event_mem_manager_t;
 
 /**
@@ -320,6 +407,61 @@ void twr_disable(void);
  */
 void twr_reset(void);
 
+/**
+ * @brief   Predict the arrival of a neighbour request
+ *
+ * @param[in]   addr        the neighbour address
+ * @param[in]   offset_us   the offset at which the exchange is scheduled
+ *
+ * @return  the arrival in us relative to the center of a listen window
+ *          scheduled at @p offset_us, 0 if unknown
+ */
+int32_t twr_peer_predict_us(uint16_t addr, uint32_t offset_us);
+
+/**
+ * @brief   Get the clock estimates of a neighbour
+ *
+ * @param[in]   addr        the neighbour address
+ * @param[out]  peer        the estimates
+ *
+ * @return  0 on success, -ENOENT if unknown
+ */
+int twr_peer_get(uint16_t addr, twr_peer_t *peer);
+
+/**
+ * @brief   Get the clock estimates by table index
+ *
+ * @param[in]   idx         the table index, < CONFIG_TWR_PEER_NUMOF
+ * @param[out]  peer        the estimates
+ *
+ * @return  0 on success, -ENOENT if the entry is unused
+ */
+int twr_peer_get_by_idx(unsigned idx, twr_peer_t *peer);
+
+/**
+ * @brief   Drop all neighbour clock estimates
+ */
+void twr_peer_reset(void);
+
+/**
+ * @brief   Feed the arrival of a request in a listen window
+ *
+ * @param[in]   addr        the neighbour address
+ * @param[in]   arrival_us  the arrival relative to the center of the
+ *                          uncorrected listen window
+ * @param[in]   offset_us   the offset at which the listen was scheduled
+ */
+void twr_peer_sample_offset(uint16_t addr, int32_t arrival_us,
+                            uint32_t offset_us);
+
+/**
+ * @brief   Feed a clock drift measurement
+ *
+ * @param[in]   addr        the neighbour address
+ * @param[in]   drift_ppb   the neighbour drift, positive if faster
+ */
+void twr_peer_sample_drift(uint16_t addr, int32_t drift_ppb);
+
 #ifdef __cplusplus
 }
 #endif
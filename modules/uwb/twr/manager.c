@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_twr
+ * @{
+ *
+ * @file
+ * @brief       TWR event buffer memory manager, common to all backends
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+#include <string.h>
+
+#include "twr.h"
+
+void twr_event_mem_manager_init(twr_event_mem_manager_t *manager)
+{
+    memset(manager, '\0', sizeof(twr_event_mem_manager_t));
+    memarray_init(&manager->mem, manager->buf, sizeof(twr_event_t),
+                  CONFIG_TWR_EVENT_BUF_SIZE);
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_init(&manager->watermark, CONFIG_TWR_EVENT_BUF_SIZE);
+#endif
+}
+
+void twr_event_mem_manager_free(twr_event_mem_manager_t *manager,
+                                twr_event_t *event)
+{
+    memarray_free(&manager->mem, event);
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_free(&manager->watermark);
+#endif
+}
+
+twr_event_t *twr_event_mem_manager_calloc(twr_event_mem_manager_t *manager)
+{
+    twr_event_t *event = memarray_calloc(&manager->mem);
+
+#if IS_USED(MODULE_WATERMARK)
+    watermark_pool_alloc(&manager->watermark, event != NULL);
+#endif
+    return event;
+}
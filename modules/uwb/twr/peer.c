@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_twr
+ * @{
+ *
+ * @file
+ * @brief       Per neighbour clock offset and drift estimation
+ *
+ * Both sides of an exchange schedule their event at the same offset after
+ * the advertisement, one on the advertisement transmission and the other
+ * on its reception. The arrival of a neighbour request inside the local
+ * listen window is then off by a constant part (OS and radio latencies)
+ * and a part proportional to the scheduling offset (the relative clock
+ * drift). The constant part is measured on the responder side, the drift
+ * from the carrier integrator on the initiator side.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "irq.h"
+#include "timex.h"
+#include "twr.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+static twr_peer_t _peers[CONFIG_TWR_PEER_NUMOF];
+static uint32_t _updates;
+
+static bool _used(const twr_peer_t *peer)
+{
+    return peer->offset_samples || peer->drift_samples;
+}
+
+static twr_peer_t *_find(uint16_t addr)
+{
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_NUMOF; i++) {
+        if (_used(&_peers[i]) && _peers[i].addr == addr) {
+            return &_peers[i];
+        }
+    }
+    return NULL;
+}
+
+/* get the entry for addr, replace the least recently updated if unknown */
+static twr_peer_t *_get(uint16_t addr)
+{
+    twr_peer_t *peer = _find(addr);
+
+    if (peer) {
+        return peer;
+    }
+    peer = &_peers[0];
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_NUMOF; i++) {
+        if (!_used(&_peers[i])) {
+            peer = &_peers[i];
+            break;
+        }
+        if ((int32_t)(_peers[i].last - peer->last) < 0) {
+            peer = &_peers[i];
+        }
+    }
+    memset(peer, '\0', sizeof(*peer));
+    peer->addr = addr;
+    return peer;
+}
+
+static int32_t _ewma(int32_t avg, int32_t sample, uint16_t count)
+{
+    /* converge faster while there are few samples */
+    if (count < (1 << CONFIG_TWR_PEER_EWMA_SHIFT)) {
+        return avg + (sample - avg) / (count + 1);
+    }
+    return avg + ((sample - avg) >> CONFIG_TWR_PEER_EWMA_SHIFT);
+}
+
+/* drift accumulated over offset_us, positive if the neighbour clock is
+   fast: its timers expire early in local time */
+static int32_t _drift_us(const twr_peer_t *peer, uint32_t offset_us)
+{
+    return (int32_t)((int64_t)offset_us * peer->drift_ppb / (int64_t)NS_PER_SEC);
+}
+
+void twr_peer_sample_offset(uint16_t addr, int32_t arrival_us,
+                            uint32_t offset_us)
+{
+    unsigned state = irq_disable();
+    twr_peer_t *peer = _get(addr);
+
+    /* only keep the scheduling offset independent part */
+    int32_t sample = arrival_us + _drift_us(peer, offset_us);
+
+    peer->offset_us = _ewma(peer->offset_us, sample, peer->offset_samples);
+    if (peer->offset_samples < UINT16_MAX) {
+        peer->offset_samples++;
+    }
+    peer->last = ++_updates;
+    irq_restore(state);
+    LOG_DEBUG("[twr]: 0x%04" PRIx16 " arrival %" PRId32 "us, offset %" PRId32
+              "us\n", addr, arrival_us, peer->offset_us);
+}
+
+void twr_peer_sample_drift(uint16_t addr, int32_t drift_ppb)
+{
+    unsigned state = irq_disable();
+    twr_peer_t *peer = _get(addr);
+
+    peer->drift_ppb = _ewma(peer->drift_ppb, drift_ppb, peer->drift_samples);
+    if (peer->drift_samples < UINT16_MAX) {
+        peer->drift_samples++;
+    }
+    peer->last = ++_updates;
+    irq_restore(state);
+}
+
+int32_t twr_peer_predict_us(uint16_t addr, uint32_t offset_us)
+{
+    int32_t predict = 0;
+    unsigned state = irq_disable();
+    twr_peer_t *peer = _find(addr);
+
+    if (peer) {
+        if (peer->offset_samples >= CONFIG_TWR_PEER_SAMPLES_MIN) {
+            predict += peer->offset_us;
+        }
+        if (peer->drift_samples >= CONFIG_TWR_PEER_SAMPLES_MIN) {
+            predict -= _drift_us(peer, offset_us);
+        }
+    }
+    irq_restore(state);
+    if (predict > CONFIG_TWR_PEER_CORRECTION_MAX_US) {
+        predict = CONFIG_TWR_PEER_CORRECTION_MAX_US;
+    }
+    else if (predict < -CONFIG_TWR_PEER_CORRECTION_MAX_US) {
+        predict = -CONFIG_TWR_PEER_CORRECTION_MAX_US;
+    }
+    return predict;
+}
+
+int twr_peer_get(uint16_t addr, twr_peer_t *peer)
+{
+    unsigned state = irq_disable();
+    twr_peer_t *entry = _find(addr);
+
+    if (entry) {
+        *peer = *entry;
+    }
+    irq_restore(state);
+    return entry ? 0 : -ENOENT;
+}
+
+int twr_peer_get_by_idx(unsigned idx, twr_peer_t *peer)
+{
+    if (idx >= CONFIG_TWR_PEER_NUMOF || !_used(&_peers[idx])) {
+        return -ENOENT;
+    }
+    unsigned state = irq_disable();
+
+    *peer = _peers[idx];
+    irq_restore(state);
+    return 0;
+}
+
+void twr_peer_reset(void)
+{
+    unsigned state = irq_disable();
+
+    memset(_peers, '\0', sizeof(_peers));
+    irq_restore(state);
+}
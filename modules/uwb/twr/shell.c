@@ -33,6 +33,9 @@ static void _print_usage(void)
     puts("Usage:");
     puts("\ttwr get win: returns the listen window in us");
     puts("\ttwr set <win_us>: sets listen window in us, win_us < UINT16_MAX");
+    if (IS_USED(MODULE_TWR_PEER)) {
+        puts("\ttwr peers: prints neighbour clock estimates");
+    }
 }
 
 static int _twr_handler(int argc, char **argv)
@@ -80,6 +83,20 @@ static int _twr_handler(int argc, char **argv)
         printf("    rng_sem: %d \n", rng->sem.sem.sema.value);
         return 0;
     }
+#if IS_USED(MODULE_TWR_PEER)
+    if (!strcmp(argv[1], "peers")) {
+        twr_peer_t peer;
+        puts("  addr    offset_us  drift_ppb  samples");
+        for (unsigned i = 0; i < CONFIG_TWR_PEER_NUMOF; i++) {
+            if (!twr_peer_get_by_idx(i, &peer)) {
+                printf("  0x%04" PRIx16 "  %9" PRId32 "  %9" PRId32 "  %" PRIu16
+                       "/%" PRIu16 "\n", peer.addr, peer.offset_us, peer.drift_ppb,
+                       peer.offset_samples, peer.drift_samples);
+            }
+        }
+        return 0;
+    }
+#endif
     _print_usage();
     return -1;
 }
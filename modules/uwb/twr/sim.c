@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     module_twr
+ * @{
+ *
+ * @file
+ * @brief       Two Way Ranging over the simulated radio bus
+ *
+ * Exchanges complete on the simulated radio bus event queue, listen and
+ * request events start them from the twr event queue, the exchange state is
+ * only changed with interrupts disabled.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "twr.h"
+#include "sim_bus.h"
+
+#include "irq.h"
+#include "timex.h"
+#include "ztimer.h"
+#include "event.h"
+#include "event/callback.h"
+#include "event/timeout.h"
+#if IS_USED(MODULE_LATENCY)
+#include "latency.h"
+#endif
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_WARNING
+#endif
+#include "log.h"
+
+/* pointer to user set callback */
+static twr_callback_t _usr_complete_cb = NULL;
+static twr_callback_t _usr_rx_timeout_cb = NULL;
+static twr_callback_t _usr_rx_cb = NULL;
+static twr_callback_t _usr_busy_cb = NULL;
+/* the event queue to offload to */
+static event_queue_t *_twr_queue = NULL;
+
+/* listening window duration in us */
+static uint16_t listen_window_us = CONFIG_TWR_LISTEN_WINDOW_US;
+
+/* mask TWR activity */
+static bool _enabled = false;
+/* the simulated radio is asleep */
+static bool _sleeping = false;
+/* status variable */
+static twr_status_t _status = TWR_RNG_IDLE;
+/* the present req dest short addr, or allowed short addr */
+static uint16_t _other_short_addr;
+static uint16_t _short_addr;
+
+/* the ongoing exchange, and the exchange the timeout expired for */
+static uint32_t _exchange;
+static uint32_t _expired;
+
+/* memory manager pointer if any */
+static twr_event_mem_manager_t *_manager = NULL;
+
+#if IS_USED(MODULE_TWR_PEER)
+/* the ongoing listen window */
+static uint32_t _listen_start;
+static uint16_t _listen_offset;
+static int16_t _listen_correction;
+
+static int32_t _ticks_to_us(int32_t ticks)
+{
+    return (int64_t)ticks * (int64_t)US_PER_SEC /
+           (int64_t)CONFIG_ZTIMER_MSEC_BASE_FREQ;
+}
+
+static int32_t _us_to_ticks(int32_t us)
+{
+    return (int64_t)us * (int64_t)CONFIG_ZTIMER_MSEC_BASE_FREQ /
+           (int64_t)US_PER_SEC;
+}
+
+static void _peer_sample_offset(uint16_t addr, uint32_t now_ticks)
+{
+    /* the responder completes the exchange on the request reception */
+    int32_t arrival_us = _ticks_to_us(now_ticks - _listen_start) -
+                         listen_window_us / 2;
+
+    /* relative to the uncorrected window */
+    arrival_us += _ticks_to_us(_listen_correction);
+    twr_peer_sample_offset(addr, arrival_us, _ticks_to_us(_listen_offset));
+}
+
+static int16_t _peer_correction(uint16_t addr, uint16_t offset)
+{
+    int32_t ticks = _us_to_ticks(twr_peer_predict_us(addr, _ticks_to_us(offset)));
+
+    /* never schedule in the past, and saturate to the stored correction */
+    if (ticks < -(int32_t)offset) {
+        ticks = -(int32_t)offset;
+    }
+    if (ticks < INT16_MIN) {
+        ticks = INT16_MIN;
+    }
+    else if (ticks > INT16_MAX) {
+        ticks = INT16_MAX;
+    }
+    return ticks;
+}
+#endif
+
+static void _enter_sleep(void)
+{
+    _sleeping = true;
+#if IS_USED(MODULE_ENERGY)
+    energy_begin(ENERGY_STATE_UWB_SLEEP);
+#endif
+}
+
+static void _wakeup(void)
+{
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_UWB_SLEEP);
+#endif
+    _sleeping = false;
+}
+
+static void _sleep_handler(event_t *event)
+{
+    (void)event;
+    if (IS_USED(MODULE_TWR_SLEEP)) {
+        if (!_sleeping && _status == TWR_RNG_IDLE) {
+            _enter_sleep();
+        }
+    }
+}
+static event_t _sleep_event = { .handler = _sleep_handler };
+
+static void _energy_end(void)
+{
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_UWB_LISTEN);
+    energy_end(ENERGY_STATE_UWB_REQUEST);
+#endif
+}
+
+static void _timeout_handler(event_t *event)
+{
+    (void)event;
+    unsigned state = irq_disable();
+
+    if (_expired != _exchange || _status == TWR_RNG_IDLE) {
+        /* completed meanwhile */
+        irq_restore(state);
+        return;
+    }
+    twr_status_t status = _status;
+    _status = TWR_RNG_IDLE;
+    irq_restore(state);
+
+    LOG_DEBUG("[twr]: rx_timeout 0x%04"PRIx16"\n", _other_short_addr);
+    _energy_end();
+    if (_usr_rx_timeout_cb) {
+        twr_event_data_t data = { .addr = _other_short_addr };
+        _usr_rx_timeout_cb(&data, status);
+    }
+    event_post(_twr_queue, &_sleep_event);
+}
+static event_t _timeout_event = { .handler = _timeout_handler };
+
+static void _timeout_cb(void *arg)
+{
+    (void)arg;
+    _expired = _exchange;
+    event_post(CONFIG_SIM_BUS_EVENT_PRIO, &_timeout_event);
+}
+static ztimer_t _timeout = { .callback = _timeout_cb };
+
+/* start an exchange, false if one is ongoing */
+static bool _exchange_start(twr_status_t status, const twr_event_t *event,
+                            uint32_t timeout_us)
+{
+    unsigned state = irq_disable();
+
+    if (_status != TWR_RNG_IDLE) {
+        irq_restore(state);
+        return false;
+    }
+    _status = status;
+    _other_short_addr = event->addr;
+#if IS_USED(MODULE_TWR_PEER)
+    if (status == TWR_RNG_RESPONDER) {
+        _listen_offset = event->offset;
+        _listen_correction = event->correction;
+        _listen_start = ztimer_now(ZTIMER_MSEC_BASE);
+    }
+#endif
+    _exchange++;
+    ztimer_set(ZTIMER_MSEC_BASE, &_timeout, (uint64_t)timeout_us *
+               CONFIG_ZTIMER_MSEC_BASE_FREQ / US_PER_SEC);
+    irq_restore(state);
+    return true;
+}
+
+/* complete an exchange, false if there was none in that state */
+static bool _exchange_complete(twr_status_t status)
+{
+    unsigned state = irq_disable();
+
+    if (_status != status) {
+        irq_restore(state);
+        return false;
+    }
+    ztimer_remove(ZTIMER_MSEC_BASE, &_timeout);
+    _status = TWR_RNG_IDLE;
+    irq_restore(state);
+    return true;
+}
+
+static void _complete(uint16_t addr, uint16_t range, const sim_bus_link_t *link,
+                      twr_status_t status)
+{
+    /* always in line of sight */
+    twr_event_data_t data = {
+        .addr = addr,
+        .range = range,
+        .los = 100 * 100,
+        .rssi = link->rssi,
+        .time = ztimer_now(ZTIMER_MSEC),
+    };
+
+#if IS_USED(MODULE_LATENCY)
+    if (status == TWR_RNG_RESPONDER) {
+        latency_end(LATENCY_STAGE_TWR_EXCHANGE);
+    }
+#endif
+    _energy_end();
+    if (_usr_complete_cb) {
+#if IS_USED(MODULE_LATENCY)
+        latency_begin(LATENCY_STAGE_TWR_ACCOUNT);
+#endif
+        _usr_complete_cb(&data, status);
+#if IS_USED(MODULE_LATENCY)
+        latency_end(LATENCY_STAGE_TWR_ACCOUNT);
+#endif
+    }
+    if (status == TWR_RNG_RESPONDER && _usr_rx_cb) {
+        _usr_rx_cb(&data, TWR_RNG_RESPONDER);
+    }
+    event_post(_twr_queue, &_sleep_event);
+}
+
+static void _poll_rx_cb(const sim_bus_frame_t *frame, const sim_bus_link_t *link)
+{
+    if (frame->dst != _short_addr || frame->src != _other_short_addr ||
+        !_exchange_complete(TWR_RNG_RESPONDER)) {
+        return;
+    }
+#if IS_USED(MODULE_TWR_PEER)
+    _peer_sample_offset(frame->src, ztimer_now(ZTIMER_MSEC_BASE));
+#endif
+    uint16_t range = sim_bus_ranging_cm(link);
+    sim_bus_frame_t resp = {
+        .type = SIM_BUS_FRAME_UWB_RESP,
+        .src = _short_addr,
+        .dst = frame->src,
+        .len = sizeof(range),
+    };
+
+    memcpy(resp.payload, &range, sizeof(range));
+    sim_bus_send(&resp);
+    LOG_DEBUG("[twr]: poll from %4" PRIx16 ", range %" PRIu16 "\n", frame->src, range);
+    _complete(frame->src, range, link, TWR_RNG_RESPONDER);
+}
+
+static void _resp_rx_cb(const sim_bus_frame_t *frame, const sim_bus_link_t *link)
+{
+    uint16_t range;
+
+    if (frame->dst != _short_addr || frame->src != _other_short_addr ||
+        frame->len != sizeof(range) || !_exchange_complete(TWR_RNG_INITIATOR)) {
+        return;
+    }
+    memcpy(&range, frame->payload, sizeof(range));
+#if IS_USED(MODULE_TWR_PEER)
+    /* all simulated nodes run on the host clock */
+    twr_peer_sample_drift(frame->src, 0);
+#endif
+    _complete(frame->src, range, link, TWR_RNG_INITIATOR);
+}
+
+void twr_init(event_queue_t *queue)
+{
+    int rc = sim_bus_init();
+
+    assert(rc == 0);
+    (void)rc;
+    sim_bus_set_rx_cb(SIM_BUS_FRAME_UWB_POLL, _poll_rx_cb);
+    sim_bus_set_rx_cb(SIM_BUS_FRAME_UWB_RESP, _resp_rx_cb);
+    /* set pan_id */
+    twr_set_pan_id(CONFIG_TWR_PAN_ID);
+    /* set state idle */
+    _status = TWR_RNG_IDLE;
+    /* set event queue */
+    _twr_queue = queue;
+}
+
+void twr_set_complete_cb(twr_callback_t callback)
+{
+    _usr_complete_cb = callback;
+}
+
+void twr_set_rx_timeout_cb(twr_callback_t callback)
+{
+    _usr_rx_timeout_cb = callback;
+}
+
+void twr_set_rx_cb(twr_callback_t callback)
+{
+    _usr_rx_cb = callback;
+}
+
+void twr_set_busy_cb(twr_callback_t callback)
+{
+    _usr_busy_cb = callback;
+}
+
+void twr_set_listen_window(uint16_t time)
+{
+    listen_window_us = time;
+}
+
+uint16_t twr_get_listen_window(void)
+{
+    return listen_window_us;
+}
+
+void twr_set_short_addr(uint16_t address)
+{
+    _short_addr = address;
+    LOG_DEBUG("[twr]: setting short address to %4" PRIx16 "\n", address);
+}
+
+void twr_set_pan_id(uint16_t pan_id)
+{
+    /* there is a single network on the bus */
+    (void)pan_id;
+}
+
+static void _twr_rng_listen(void *arg)
+{
+    twr_event_t *event = (twr_event_t *)arg;
+
+#if IS_USED(MODULE_LATENCY)
+    latency_record(LATENCY_STAGE_TWR_LISTEN_DELAY, event->deadline);
+#endif
+    if (_enabled) {
+        if (IS_USED(MODULE_TWR_SLEEP) && _sleeping) {
+            _wakeup();
+        }
+        if (_exchange_start(TWR_RNG_RESPONDER, event, listen_window_us)) {
+            LOG_DEBUG("[twr]: rng listen start\n");
+#if IS_USED(MODULE_LATENCY)
+            latency_begin(LATENCY_STAGE_TWR_EXCHANGE);
+#endif
+#if IS_USED(MODULE_ENERGY)
+            energy_begin(ENERGY_STATE_UWB_LISTEN);
+#endif
+            return;
+        }
+        else {
+            LOG_WARNING("[twr]: rng listen aborted, busy\n");
+        }
+    }
+    else {
+        LOG_DEBUG("[twr]: skip, is disabled\n");
+    }
+    if (_usr_busy_cb) {
+        twr_event_data_t data = { .addr = event->addr };
+        _usr_busy_cb(&data, TWR_RNG_RESPONDER);
+    }
+}
+
+static void _twr_rng_listen_managed(void *arg)
+{
+    twr_event_t *event = (twr_event_t *)arg;
+
+    _twr_rng_listen(event);
+    twr_event_mem_manager_free(_manager, (twr_event_t *)arg);
+}
+
+static void _twr_schedule_listen(twr_event_t *event, uint32_t timeout, void (*callback)(void *))
+{
+#if IS_USED(MODULE_LATENCY)
+    event->deadline = latency_deadline(timeout);
+#endif
+    event_callback_init(&event->event, callback, event);
+    event_timeout_ztimer_init(&event->timeout, ZTIMER_MSEC_BASE, _twr_queue, &event->event.super);
+    event_timeout_set(&event->timeout, timeout);
+    LOG_DEBUG("[twr]: schedule rng listen in %" PRIu32 "\n", timeout);
+}
+
+void twr_schedule_listen(twr_event_t *event, uint16_t offset)
+{
+#if IS_USED(MODULE_TWR_PEER)
+    /* samples are still taken, the window is not corrected */
+    event->offset = offset;
+    event->correction = 0;
+#endif
+    _twr_schedule_listen(event, offset, _twr_rng_listen);
+}
+
+int twr_schedule_listen_managed(uint16_t addr, uint16_t offset)
+{
+    assert(_manager);
+    twr_event_t *event = twr_event_mem_manager_calloc(_manager);
+    uint32_t timeout = offset;
+
+    if (!event) {
+        LOG_ERROR("[twr]: error, no lst event\n");
+        if (IS_ACTIVE(CONFIG_TWR_RESET_ON_LOCK)) {
+            twr_reset();
+        }
+        return -ENOMEM;
+    }
+    event->addr = addr;
+#if IS_USED(MODULE_TWR_PEER)
+    /* center the window on the predicted arrival of the neighbour request,
+       the correction is never below -offset */
+    event->offset = offset;
+    event->correction = _peer_correction(addr, offset);
+    timeout = (uint32_t)((int32_t)offset + event->correction);
+#endif
+    _twr_schedule_listen(event, timeout, _twr_rng_listen_managed);
+    return 0;
+}
+
+static void _twr_rng_request(void *arg)
+{
+    twr_event_t *event = (twr_event_t *)arg;
+
+    if (_enabled) {
+        if (IS_USED(MODULE_TWR_SLEEP) && _sleeping) {
+            _wakeup();
+        }
+        if (_exchange_start(TWR_RNG_INITIATOR, event,
+                            CONFIG_TWR_SIM_RESPONSE_TIMEOUT_US)) {
+            LOG_DEBUG("[twr]: rng request to %4" PRIx16 "\n", event->addr);
+#if IS_USED(MODULE_ENERGY)
+            /* ends on completion or timeout */
+            energy_begin(ENERGY_STATE_UWB_REQUEST);
+#endif
+            sim_bus_frame_t poll = {
+                .type = SIM_BUS_FRAME_UWB_POLL,
+                .src = _short_addr,
+                .dst = event->addr,
+            };
+            sim_bus_send(&poll);
+            return;
+        }
+        else {
+            LOG_WARNING("[twr]: rng request aborted, busy\n");
+        }
+    }
+    else {
+        LOG_DEBUG("[twr]: skip, is disabled\n");
+    }
+    if (_usr_busy_cb) {
+        twr_event_data_t data = { .addr = event->addr };
+        _usr_busy_cb(&data, TWR_RNG_INITIATOR);
+    }
+}
+
+static void _twr_rng_request_managed(void *arg)
+{
+    twr_event_t *event = (twr_event_t *)arg;
+
+    _twr_rng_request(event);
+    twr_event_mem_manager_free(_manager, (twr_event_t *)arg);
+}
+
+static void _twr_schedule_request(twr_event_t *event, uint16_t dest, uint16_t offset,
+                                  void (*callback)(void *))
+{
+    event->addr = dest;
+    event_callback_init(&event->event, callback, event);
+    event_timeout_ztimer_init(&event->timeout, ZTIMER_MSEC_BASE, _twr_queue, &event->event.super);
+    event_timeout_set(&event->timeout, offset);
+    LOG_DEBUG("[twr]: schedule rng request to %4" PRIx16 " in %" PRIu16 "\n",
+              event->addr, offset);
+}
+
+void twr_schedule_request(twr_event_t *event, uint16_t dest, uint16_t offset)
+{
+    _twr_schedule_request(event, dest, offset, _twr_rng_request);
+}
+
+int twr_schedule_request_managed(uint16_t dest, uint16_t offset)
+{
+    assert(_manager);
+    twr_event_t *event = twr_event_mem_manager_calloc(_manager);
+
+    if (!event) {
+        LOG_ERROR("[twr]: error, no req event\n");
+        if (IS_ACTIVE(CONFIG_TWR_RESET_ON_LOCK)) {
+            twr_reset();
+        }
+        return -ENOMEM;
+    }
+    _twr_schedule_request(event, dest, offset, _twr_rng_request_managed);
+    return 0;
+}
+
+void twr_managed_set_manager(twr_event_mem_manager_t *manager)
+{
+    _manager = manager;
+}
+
+twr_event_mem_manager_t *twr_managed_get_manager(void)
+{
+    return _manager;
+}
+
+void twr_enable(void)
+{
+    _enabled = true;
+    if (IS_USED(MODULE_TWR_SLEEP) && _sleeping) {
+        _wakeup();
+    }
+}
+
+void twr_reset(void)
+{
+    unsigned state = irq_disable();
+
+    ztimer_remove(ZTIMER_MSEC_BASE, &_timeout);
+    _status = TWR_RNG_IDLE;
+    irq_restore(state);
+    _energy_end();
+}
+
+void twr_disable(void)
+{
+    _enabled = false;
+    twr_reset();
+    if (IS_USED(MODULE_TWR_SLEEP) && !_sleeping) {
+        _enter_sleep();
+    }
+}
@@ -29,6 +29,12 @@
 #include "event.h"
 #include "event/callback.h"
 #include "event/timeout.h"
+#if IS_USED(MODULE_LATENCY)
+#include "latency.h"
+#endif
+#if IS_USED(MODULE_ENERGY)
+#include "energy.h"
+#endif
 
 #ifndef LOG_LEVEL
 #define LOG_LEVEL   LOG_WARNING
@@ -60,6 +66,67 @@ static uint16_t _other_short_addr;
 /* memory manager pointer if any */
 static twr_event_mem_manager_t *_manager = NULL;
 
+#if IS_USED(MODULE_TWR_PEER)
+/* UWB usec to usec, a UWB usec is 65536 / (128 * 499.2MHz) */
+#define UWB_USEC_TO_USEC(_t)    ((uint64_t)(_t) * 65536 / 63898)
+/* the ongoing listen window */
+static uint32_t _listen_start;
+static uint16_t _listen_offset;
+static int16_t _listen_correction;
+
+static int32_t _ticks_to_us(int32_t ticks)
+{
+    return (int64_t)ticks * (int64_t)US_PER_SEC /
+           (int64_t)CONFIG_ZTIMER_MSEC_BASE_FREQ;
+}
+
+static int32_t _us_to_ticks(int32_t us)
+{
+    return (int64_t)us * (int64_t)CONFIG_ZTIMER_MSEC_BASE_FREQ /
+           (int64_t)US_PER_SEC;
+}
+
+static void _peer_sample_offset(uint16_t addr, uint32_t now_ticks)
+{
+    /* the responder completes the exchange once the response is sent, which
+       is scheduled tx_holdoff_delay after the request reception */
+    int32_t arrival_us = _ticks_to_us(now_ticks - _listen_start) -
+                         UWB_USEC_TO_USEC(_rng->config.tx_holdoff_delay) -
+                         listen_window_us / 2;
+
+    /* relative to the uncorrected window */
+    arrival_us += _ticks_to_us(_listen_correction);
+    twr_peer_sample_offset(addr, arrival_us, _ticks_to_us(_listen_offset));
+}
+
+static void _peer_sample_drift(struct uwb_dev *inst, uint16_t addr)
+{
+    /* the ratio scales remote durations to local ones, it is positive if the
+       remote clock is slow */
+    float ratio = uwb_calc_clock_offset_ratio(inst, inst->carrier_integrator,
+                                              UWB_CR_CARRIER_INTEGRATOR);
+
+    twr_peer_sample_drift(addr, (int32_t)(-ratio * NS_PER_SEC));
+}
+
+static int16_t _peer_correction(uint16_t addr, uint16_t offset)
+{
+    int32_t ticks = _us_to_ticks(twr_peer_predict_us(addr, _ticks_to_us(offset)));
+
+    /* never schedule in the past, and saturate to the stored correction */
+    if (ticks < -(int32_t)offset) {
+        ticks = -(int32_t)offset;
+    }
+    if (ticks < INT16_MIN) {
+        ticks = INT16_MIN;
+    }
+    else if (ticks > INT16_MAX) {
+        ticks = INT16_MAX;
+    }
+    return ticks;
+}
+#endif
+
 static void _set_status_led(gpio_t pin, uint8_t state)
 {
     if (IS_USED(MODULE_TWR_GPIO)) {
@@ -69,6 +136,23 @@ static void _set_status_led(gpio_t pin, uint8_t state)
     }
 }
 
+static void _enter_sleep(void)
+{
+    uwb_sleep_config(_udev);
+    uwb_enter_sleep(_udev);
+#if IS_USED(MODULE_ENERGY)
+    energy_begin(ENERGY_STATE_UWB_SLEEP);
+#endif
+}
+
+static void _wakeup(void)
+{
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_UWB_SLEEP);
+#endif
+    uwb_wakeup(_udev);
+}
+
 /* */
 static void _sleep_handler(event_t *event)
 {
@@ -77,8 +161,7 @@ static void _sleep_handler(event_t *event)
              only go to sleep if the next event is not close */
     if (IS_USED(MODULE_TWR_SLEEP)) {
         if (!_udev->status.sleeping) {
-            uwb_sleep_config(_udev);
-            uwb_enter_sleep(_udev);
+            _enter_sleep();
         }
     }
 }
@@ -112,8 +195,21 @@ static bool _complete_cb(struct uwb_dev *inst, struct uwb_mac_interface *cbs)
         return false;
     }
 
+#if IS_USED(MODULE_LATENCY)
+    if (_status == TWR_RNG_RESPONDER) {
+        latency_end(LATENCY_STAGE_TWR_EXCHANGE);
+    }
+#endif
+#if IS_USED(MODULE_ENERGY)
+    if (_status == TWR_RNG_INITIATOR) {
+        energy_end(ENERGY_STATE_UWB_REQUEST);
+    }
+#endif
     /* timestamp */
     uint32_t now = ztimer_now(ZTIMER_MSEC);
+#if IS_USED(MODULE_TWR_PEER)
+    uint32_t now_ticks = ztimer_now(ZTIMER_MSEC_BASE);
+#endif
 
     /* get received frame and parse data*/
     struct uwb_rng_instance *rng = (struct uwb_rng_instance *)cbs->inst_ptr;
@@ -141,6 +237,15 @@ static bool _complete_cb(struct uwb_dev *inst, struct uwb_mac_interface *cbs)
     /* TODO: can this be negative sometimes? */
     data.range = ((uint16_t)(range_f * 100));
 
+#if IS_USED(MODULE_TWR_PEER)
+    if (_status == TWR_RNG_RESPONDER) {
+        _peer_sample_offset(data.addr, now_ticks);
+    }
+    else if (_status == TWR_RNG_INITIATOR) {
+        _peer_sample_drift(inst, data.addr);
+    }
+#endif
+
     if (_usr_complete_cb == NULL) {
         LOG_DEBUG("[twr]: %" PRIu16 ", no usr callback\n", data.addr);
         LOG_DEBUG("\t - range: %" PRIu16 ".%" PRIu16 "\n",
@@ -152,7 +257,13 @@ static bool _complete_cb(struct uwb_dev *inst, struct uwb_mac_interface *cbs)
     }
     else {
         LOG_DEBUG("[twr]: %" PRIu32 ", calling usr callback\n", data.time);
+#if IS_USED(MODULE_LATENCY)
+        latency_begin(LATENCY_STAGE_TWR_ACCOUNT);
+#endif
         _usr_complete_cb(&data, _status);
+#if IS_USED(MODULE_LATENCY)
+        latency_end(LATENCY_STAGE_TWR_ACCOUNT);
+#endif
     }
     _status = TWR_RNG_IDLE;
     return true;
@@ -171,6 +282,11 @@ static bool _rx_timeout_cb(struct uwb_dev *inst, struct uwb_mac_interface *cbs)
     (void)cbs;
     (void)inst;
     LOG_DEBUG("[twr]: rx_timeout 0x%04"PRIx16"\n", _other_short_addr);
+#if IS_USED(MODULE_ENERGY)
+    if (_status == TWR_RNG_INITIATOR) {
+        energy_end(ENERGY_STATE_UWB_REQUEST);
+    }
+#endif
     if (_usr_rx_timeout_cb) {
         twr_event_data_t data = { .addr = _other_short_addr };
         _usr_rx_timeout_cb(&data, _status);
@@ -269,16 +385,33 @@ static void _twr_rng_listen(void *arg)
     (void)arg;
     twr_event_t *event = (twr_event_t *)arg;
 
+#if IS_USED(MODULE_LATENCY)
+    latency_record(LATENCY_STAGE_TWR_LISTEN_DELAY, event->deadline);
+#endif
     if (_enabled) {
         if (dpl_sem_get_count(&_rng->sem) == 1) {
             LOG_DEBUG("[twr]: rng listen start\n");
             _set_status_led(CONFIG_TWR_RESPONDER_PIN, 1);
             if (IS_USED(MODULE_TWR_SLEEP) && _udev->status.sleeping) {
-                uwb_wakeup(_udev);
+                _wakeup();
             }
             _status = TWR_RNG_RESPONDER;
             _other_short_addr = event->addr;
+#if IS_USED(MODULE_TWR_PEER)
+            _listen_offset = event->offset;
+            _listen_correction = event->correction;
+            _listen_start = ztimer_now(ZTIMER_MSEC_BASE);
+#endif
+#if IS_USED(MODULE_LATENCY)
+            latency_begin(LATENCY_STAGE_TWR_EXCHANGE);
+#endif
+#if IS_USED(MODULE_ENERGY)
+            energy_begin(ENERGY_STATE_UWB_LISTEN);
+#endif
             struct uwb_dev_status status = uwb_rng_listen(_rng, listen_window_us, UWB_BLOCKING);
+#if IS_USED(MODULE_ENERGY)
+            energy_end(ENERGY_STATE_UWB_LISTEN);
+#endif
             if (!status.rx_error && !status.rx_timeout_error && !status.start_rx_error) {
                 LOG_DEBUG("[twr]: rng listen OK\n");
                 twr_event_data_t data = { .addr = event->addr };
@@ -309,16 +442,24 @@ static void _twr_rng_listen_managed(void *arg)
     twr_event_mem_manager_free(_manager, (twr_event_t *)arg);
 }
 
-static void _twr_schedule_listen(twr_event_t *event, uint16_t offset, void (*callback)(void *))
+static void _twr_schedule_listen(twr_event_t *event, uint32_t timeout, void (*callback)(void *))
 {
+#if IS_USED(MODULE_LATENCY)
+    event->deadline = latency_deadline(timeout);
+#endif
     event_callback_init(&event->event, callback, event);
     event_timeout_ztimer_init(&event->timeout, ZTIMER_MSEC_BASE, _twr_queue, &event->event.super);
-    event_timeout_set(&event->timeout, offset);
-    LOG_DEBUG("[twr]: schedule rng listen in %" PRIu16 "\n", offset);
+    event_timeout_set(&event->timeout, timeout);
+    LOG_DEBUG("[twr]: schedule rng listen in %" PRIu32 "\n", timeout);
 }
 
 void twr_schedule_listen(twr_event_t *event, uint16_t offset)
 {
+#if IS_USED(MODULE_TWR_PEER)
+    /* samples are still taken, the window is not corrected */
+    event->offset = offset;
+    event->correction = 0;
+#endif
     _twr_schedule_listen(event, offset, _twr_rng_listen);
 }
 
@@ -326,8 +467,7 @@ int twr_schedule_listen_managed(uint16_t addr, uint16_t offset)
 {
     assert(_manager);
     twr_event_t *event = twr_event_mem_manager_calloc(_manager);
-
-    event->addr = addr;
+    uint32_t timeout = offset;
 
     if (!event) {
         LOG_ERROR("[twr]: error, no lst event\n");
@@ -336,7 +476,15 @@ int twr_schedule_listen_managed(uint16_t addr, uint16_t offset)
         }
         return -ENOMEM;
     }
-    _twr_schedule_listen(event, offset, _twr_rng_listen_managed);
+    event->addr = addr;
+#if IS_USED(MODULE_TWR_PEER)
+    /* center the window on the predicted arrival of the neighbour request,
+       the correction is never below -offset */
+    event->offset = offset;
+    event->correction = _peer_correction(addr, offset);
+    timeout = (uint32_t)((int32_t)offset + event->correction);
+#endif
+    _twr_schedule_listen(event, timeout, _twr_rng_listen_managed);
     return 0;
 }
 
@@ -352,9 +500,13 @@ static void _twr_rng_request(void *arg)
             /* wake up if needed */
             _set_status_led(CONFIG_TWR_INITIATOR_PIN, 1);
             if (IS_USED(MODULE_TWR_SLEEP) && _udev->status.sleeping) {
-                uwb_wakeup(_udev);
+                _wakeup();
             }
             _status = TWR_RNG_INITIATOR;
+#if IS_USED(MODULE_ENERGY)
+            /* ends on completion or timeout */
+            energy_begin(ENERGY_STATE_UWB_REQUEST);
+#endif
             uwb_rng_request(_rng, event->addr, CONFIG_TWR_EVENT_ALGO_DEFAULT);
             _set_status_led(CONFIG_TWR_INITIATOR_PIN, 0);
             event_post(_twr_queue, &_sleep_event);
@@ -413,24 +565,6 @@ int twr_schedule_request_managed(uint16_t dest, uint16_t offset)
     return 0;
 }
 
-void twr_event_mem_manager_init(twr_event_mem_manager_t *manager)
-{
-    memset(manager, '\0', sizeof(twr_event_mem_manager_t));
-    memarray_init(&manager->mem, manager->buf, sizeof(twr_event_t),
-                  CONFIG_TWR_EVENT_BUF_SIZE);
-}
-
-void twr_event_mem_manager_free(twr_event_mem_manager_t *manager,
-                                twr_event_t *event)
-{
-    memarray_free(&manager->mem, event);
-}
-
-twr_event_t *twr_event_mem_manager_calloc(twr_event_mem_manager_t *manager)
-{
-    return memarray_calloc(&manager->mem);
-}
-
 void twr_managed_set_manager(twr_event_mem_manager_t *manager)
 {
     _manager = manager;
@@ -445,7 +579,7 @@ void twr_enable(void)
 {
     _enabled = true;
     if (IS_USED(MODULE_TWR_SLEEP) && _udev->status.sleeping) {
-        uwb_wakeup(_udev);
+        _wakeup();
         uwb_phy_forcetrxoff(_udev);
     }
 }
@@ -454,19 +588,24 @@ void twr_disable(void)
 {
     _enabled = false;
     _status = TWR_RNG_IDLE;
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_UWB_REQUEST);
+#endif
     /* TODO: this should make sure that at least at the end of an epoch all twr
        event get releases: it would be important to log when it happens... */
     uwb_phy_forcetrxoff(_udev);
 
     if (IS_USED(MODULE_TWR_SLEEP) && !_udev->status.sleeping) {
-        uwb_sleep_config(_udev);
-        uwb_enter_sleep(_udev);
+        _enter_sleep();
     }
 }
 
 void twr_reset(void)
 {
     _status = TWR_RNG_IDLE;
+#if IS_USED(MODULE_ENERGY)
+    energy_end(ENERGY_STATE_UWB_REQUEST);
+#endif
     uwb_phy_forcetrxoff(_udev);
     if (dpl_sem_get_count(&_rng->sem) == 0) {
         dpl_error_t err = dpl_sem_release(&_rng->sem);
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Pipelined CoAP block upload test application
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "net/gcoap.h"
+#include "ztimer.h"
+#include "net/ipv6/addr.h"
+#include "coap/utils.h"
+
+#define TEST_DATA_LEN       (1024U)
+#define TEST_CLIENT_BLK     (128U)
+#define TEST_SERVER_SZX     (2U)        /* 64 bytes */
+#define TEST_UNIT           (16U)       /* smallest block size */
+
+static uint8_t _data[TEST_DATA_LEN];
+static uint8_t _received[TEST_DATA_LEN];
+static uint64_t _received_units;
+static unsigned _requests;
+static coap_block_ctx_t _ctx;
+static int _res;
+static atomic_uint _pending;
+static atomic_uint _failed;
+
+static ssize_t _upload_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len,
+                               void *ctx)
+{
+    (void)ctx;
+    coap_block1_t block1;
+
+    if (DROP_EVERY && (++_requests % DROP_EVERY) == 0) {
+        /* no response, the client will retransmit */
+        return 0;
+    }
+    if (coap_get_block1(pdu, &block1) < 0 ||
+        block1.offset + pdu->payload_len > TEST_DATA_LEN) {
+        return gcoap_response(pdu, buf, len, COAP_CODE_BAD_REQUEST);
+    }
+
+    memcpy(&_received[block1.offset], pdu->payload, pdu->payload_len);
+    for (size_t i = 0; i < pdu->payload_len; i += TEST_UNIT) {
+        _received_units |= 1ULL << ((block1.offset + i) / TEST_UNIT);
+    }
+
+    if (block1.blknum == 0 && block1.szx > TEST_SERVER_SZX) {
+        block1.szx = TEST_SERVER_SZX;
+    }
+    bool complete = _received_units == UINT64_MAX;
+    gcoap_resp_init(pdu, buf, len,
+                    complete ? COAP_CODE_CHANGED : COAP_CODE_CONTINUE);
+    coap_opt_add_block1_control(pdu, &block1);
+    return coap_opt_finish(pdu, COAP_OPT_FINISH_NONE);
+}
+
+static ssize_t _ping_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len,
+                             void *ctx)
+{
+    (void)ctx;
+    gcoap_resp_init(pdu, buf, len, COAP_CODE_CONTENT);
+    return coap_opt_finish(pdu, COAP_OPT_FINISH_NONE);
+}
+
+static const coap_resource_t _resources[] = {
+    { "/ping", COAP_GET, _ping_handler, NULL },
+    { "/upload", COAP_POST, _upload_handler, NULL },
+};
+
+static gcoap_listener_t _listener = {
+    (coap_resource_t *)&_resources[0],
+    ARRAY_SIZE(_resources),
+    NULL,
+    NULL,
+    NULL
+};
+
+static void _done_cb(int ret, void *data, size_t len, void *arg)
+{
+    (void)data;
+    (void)len;
+    (void)arg;
+    _res = ret;
+}
+
+static void _pool_cb(int ret, void *data, size_t len, void *arg)
+{
+    (void)data;
+    (void)len;
+    (void)arg;
+    /* runs in the gcoap thread while main polls the counters */
+    if (ret) {
+        atomic_fetch_add(&_failed, 1);
+    }
+    atomic_fetch_sub(&_pending, 1);
+}
+
+static void _reset_server(void)
+{
+    memset(_received, '\0', sizeof(_received));
+    _received_units = 0;
+}
+
+static int _upload(sock_udp_ep_t *remote, uint8_t window)
+{
+    _reset_server();
+    _res = -1;
+
+    coap_block_ctx_init(&_ctx, _done_cb, NULL, TEST_CLIENT_BLK);
+    _ctx.window = window;
+    if (coap_block_post(remote, &_ctx, _data, sizeof(_data), "/upload",
+                        COAP_FORMAT_OCTET) < 0) {
+        return -1;
+    }
+    /* wait for the transaction to end */
+    mutex_lock(&_ctx.req_ctx.resp_wait);
+    mutex_unlock(&_ctx.req_ctx.resp_wait);
+
+    printf("window=%u: %u blocks in %" PRIu32 "ms, retransmits=%u\n",
+           window, _ctx.stats.blocks, _ctx.stats.duration_ms,
+           _ctx.stats.retransmits);
+    if (_res || memcmp(_data, _received, sizeof(_data))) {
+        return -1;
+    }
+    return 0;
+}
+
+static int _concurrent(sock_udp_ep_t *remote)
+{
+    coap_block_ctx_t *block = coap_block_ctx_alloc(_pool_cb, NULL,
+                                                   TEST_CLIENT_BLK);
+
+    _reset_server();
+    atomic_store(&_pending, 1);
+    atomic_store(&_failed, 0);
+    if (!block || coap_block_post(remote, block, _data, sizeof(_data),
+                                  "/upload", COAP_FORMAT_OCTET) < 0) {
+        return -1;
+    }
+    /* requests share the remote with the ongoing upload */
+    for (unsigned i = 0; i < CONFIG_COAP_UTILS_REQ_POOL_SIZE; i++) {
+        coap_req_ctx_t *ctx = coap_req_ctx_alloc(_pool_cb, NULL);
+        atomic_fetch_add(&_pending, 1);
+        if (!ctx || coap_get(remote, ctx, "/ping", COAP_FORMAT_TEXT,
+                             COAP_TYPE_NON) < 0) {
+            return -1;
+        }
+    }
+    for (unsigned i = 0; atomic_load(&_pending) && i < 100; i++) {
+        ztimer_sleep(ZTIMER_MSEC, 100);
+    }
+    unsigned pending = atomic_load(&_pending);
+    unsigned failed = atomic_load(&_failed);
+    printf("concurrent: %u requests pending, %u failed\n", pending, failed);
+    if (pending || failed || memcmp(_data, _received, sizeof(_data))) {
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    sock_udp_ep_t remote = {
+        .family = AF_INET6,
+        .netif = SOCK_ADDR_ANY_NETIF,
+        .port = CONFIG_GCOAP_PORT,
+    };
+
+    memcpy(remote.addr.ipv6, &ipv6_addr_loopback, sizeof(remote.addr.ipv6));
+    for (unsigned i = 0; i < sizeof(_data); i++) {
+        _data[i] = i;
+    }
+    gcoap_register_listener(&_listener);
+
+    if (_upload(&remote, 1) || _upload(&remote, CONFIG_COAP_UTILS_BLOCK_WINDOW) ||
+        _concurrent(&remote)) {
+        puts("[FAILED]");
+        return -1;
+    }
+    puts("[SUCCESS]");
+    return 0;
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import os
+import sys
+from testrunner import run
+
+TEST_DATA_LEN = 1024
+TEST_CLIENT_BLK = 128
+DROP_EVERY = int(os.environ.get("DROP_EVERY", "0"))
+
+
+def expect_upload(child):
+    child.expect(r"window=(\d+): (\d+) blocks in (\d+)ms, retransmits=(\d+)")
+    return tuple(map(int, child.match.groups()))
+
+
+def testfunc(child):
+    window, blocks, _, retransmits = expect_upload(child)
+    assert window == 1
+    assert blocks >= TEST_DATA_LEN // TEST_CLIENT_BLK
+    # only dropped blocks are retransmitted
+    assert DROP_EVERY or retransmits == 0
+    window, pipelined, _, retransmits = expect_upload(child)
+    assert window > 1
+    # the window changes the pacing, not the block size negotiation
+    assert pipelined == blocks, \
+        "window={} sent {} blocks, lock-step {}".format(window, pipelined,
+                                                        blocks)
+    assert DROP_EVERY or retransmits == 0
+    child.expect(r"concurrent: (\d+) requests pending, (\d+) failed")
+    pending, failed = map(int, child.match.groups())
+    assert pending == 0 and failed == 0
+    child.expect_exact("[SUCCESS]")
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
@@ -68,9 +68,9 @@ int _cmd_post_ertl(int argc, char **argv)
 {
     (void)argc;
     (void)argv;
-    coap_req_ctx_init(&block_ctx.req_ctx, _block_end_callback, NULL);
+    coap_block_ctx_init(&block_ctx, _block_end_callback, NULL, 0);
     coap_block_post(&remote, &block_ctx, ertl, sizeof(ertl), "/DW0456/ertl",
-                    COAP_FORMAT_CBOR, COAP_TYPE_NON);
+                    COAP_FORMAT_CBOR);
     return 0;
 }
 
@@ -122,7 +122,7 @@ int _cmd_get_esr(int argc, char **argv)
     (void)argc;
     (void)argv;
     coap_req_ctx_init(&get_ctx, _get_callback, NULL);
-    coap_get(&remote, &get_ctx, "/DW0456/esr", COAP_FORMAT_CBOR, COAP_TYPE_NON);
+    coap_get(&remote, &get_ctx, "/DW0456/esr", COAP_FORMAT_CBOR);
 
     return 0;
 }
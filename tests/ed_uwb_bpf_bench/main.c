@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Encounter filtering benchmark, native vs femto-container
+ *
+ * Filters the same random encounters with ed_uwb_finish, with one
+ * femto-container invocation per encounter (ed_uwb_bpf_finish) and with
+ * one invocation per batch (ed_uwb_bpf_finish_batch), and reports the time
+ * spent per encounter by each path.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ed.h"
+#include "bpf/ed.h"
+#include "kernel_defines.h"
+#include "random.h"
+#include "shell.h"
+#include "ztimer.h"
+
+/**
+ * @brief   Largest number of encounters per run, as an epoch could hold
+ */
+#ifndef CONFIG_BENCH_ENCOUNTERS_MAX
+#define CONFIG_BENCH_ENCOUNTERS_MAX     (256U)
+#endif
+
+/**
+ * @brief   Default number of runs per path
+ */
+#ifndef CONFIG_BENCH_RUNS
+#define CONFIG_BENCH_RUNS               (100U)
+#endif
+
+static ed_t _ref[CONFIG_BENCH_ENCOUNTERS_MAX];
+static ed_t _eds[CONFIG_BENCH_ENCOUNTERS_MAX];
+static ed_t *_list[CONFIG_BENCH_ENCOUNTERS_MAX];
+
+static void _generate(unsigned numof)
+{
+    for (unsigned i = 0; i < numof; i++) {
+        ed_t *ed = &_ref[i];
+        ed_init(ed, i);
+        ed->uwb.req_count = random_uint32_range(0, 2 * MIN_REQUEST_COUNT + 4);
+        ed->uwb.seen_first_s = random_uint32_range(0, 60);
+        ed->uwb.seen_last_s = ed->uwb.seen_first_s +
+                              random_uint32_range(0, 2 * MIN_EXPOSURE_TIME_S);
+        ed->uwb.cumulative_d_cm = ed->uwb.req_count *
+                                  random_uint32_range(0, 2 * MAX_DISTANCE_CM);
+    }
+}
+
+/* filters modify the encounters, restart each run from the reference */
+static void _restore(unsigned numof)
+{
+    for (unsigned i = 0; i < numof; i++) {
+        _eds[i] = _ref[i];
+        _list[i] = &_eds[i];
+    }
+}
+
+static unsigned _run_native(unsigned numof)
+{
+    unsigned valid = 0;
+
+    for (unsigned i = 0; i < numof; i++) {
+        valid += ed_uwb_finish(&_eds[i], MIN_EXPOSURE_TIME_S);
+    }
+    return valid;
+}
+
+static unsigned _run_bpf(unsigned numof)
+{
+    unsigned valid = 0;
+
+    for (unsigned i = 0; i < numof; i++) {
+        valid += ed_uwb_bpf_finish(&_eds[i]);
+    }
+    return valid;
+}
+
+static unsigned _run_batch(unsigned numof)
+{
+    return ed_uwb_bpf_finish_batch(_list, numof);
+}
+
+static const struct {
+    const char *name;
+    unsigned (*run)(unsigned numof);
+} _paths[] = {
+    { "native", _run_native },
+    { "bpf", _run_bpf },
+    { "bpf_batch", _run_batch },
+};
+
+static int _bench(unsigned numof, unsigned runs)
+{
+    _generate(numof);
+    for (unsigned p = 0; p < ARRAY_SIZE(_paths); p++) {
+        uint32_t elapsed = 0;
+        unsigned valid = 0;
+        for (unsigned r = 0; r < runs; r++) {
+            _restore(numof);
+            uint32_t start = ztimer_now(ZTIMER_USEC);
+            valid = _paths[p].run(numof);
+            elapsed += ztimer_now(ZTIMER_USEC) - start;
+        }
+        printf("%-10s encounters=%u valid=%u total=%" PRIu32 "us "
+               "per_encounter=%" PRIu32 "ns\n", _paths[p].name, numof, valid,
+               elapsed / runs, (uint32_t)((1000ULL * elapsed) / (runs * numof)));
+    }
+    return 0;
+}
+
+/* strtoul silently wraps negative values around, reject them */
+static int _parse_uint(const char *arg, unsigned *val)
+{
+    char *end;
+
+    if (*arg == '-') {
+        return -1;
+    }
+    errno = 0;
+    unsigned long res = strtoul(arg, &end, 0);
+
+    if (end == arg || *end != '\0' || errno || res > UINT_MAX) {
+        return -1;
+    }
+    *val = res;
+    return 0;
+}
+
+static int _cmd_bench(int argc, char **argv)
+{
+    unsigned numof = ED_UWB_BPF_BATCH_SIZE;
+    unsigned runs = CONFIG_BENCH_RUNS;
+
+    if (argc > 1 && _parse_uint(argv[1], &numof)) {
+        numof = 0;
+    }
+    if (argc > 2 && _parse_uint(argv[2], &runs)) {
+        runs = 0;
+    }
+    /* the time per encounter is averaged over runs * numof */
+    if (numof == 0 || numof > CONFIG_BENCH_ENCOUNTERS_MAX || runs == 0 ||
+        runs > UINT_MAX / numof) {
+        printf("usage: %s [encounters <= %u] [runs]\n", argv[0],
+               CONFIG_BENCH_ENCOUNTERS_MAX);
+        return -1;
+    }
+    return _bench(numof, runs);
+}
+
+static const shell_command_t _commands[] = {
+    { "bench", "time native, per encounter and batch contact filters", _cmd_bench },
+    { NULL, NULL, NULL }
+};
+
+/* all paths must reach the same verdict for every encounter */
+static int _self_test(void)
+{
+    bool verdicts[CONFIG_BENCH_ENCOUNTERS_MAX];
+
+    _generate(CONFIG_BENCH_ENCOUNTERS_MAX);
+    for (unsigned p = 0; p < ARRAY_SIZE(_paths); p++) {
+        _restore(CONFIG_BENCH_ENCOUNTERS_MAX);
+        unsigned valid = _paths[p].run(CONFIG_BENCH_ENCOUNTERS_MAX);
+        printf("%-10s encounters=%u valid=%u\n", _paths[p].name,
+               CONFIG_BENCH_ENCOUNTERS_MAX, valid);
+        for (unsigned i = 0; i < CONFIG_BENCH_ENCOUNTERS_MAX; i++) {
+            if (p == 0) {
+                verdicts[i] = _eds[i].uwb.valid;
+            }
+            else if (verdicts[i] != _eds[i].uwb.valid) {
+                printf("%s: encounter %u mismatch\n", _paths[p].name, i);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    char line_buf[SHELL_DEFAULT_BUFSIZE];
+
+    ed_uwb_bpf_init();
+    puts(_self_test() ? "[FAILED]" : "[SUCCESS]");
+
+    shell_run(_commands, line_buf, SHELL_DEFAULT_BUFSIZE);
+    return 0;
+}
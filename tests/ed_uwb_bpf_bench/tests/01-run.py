@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import sys
+from testrunner import run
+
+PATHS = ("native", "bpf", "bpf_batch")
+
+
+def expect_paths(child, numof=None, timed=False):
+    valid = None
+    for path in PATHS:
+        child.expect(r"{}\s+encounters=(\d+) valid=(\d+)".format(path))
+        encounters, count = map(int, child.match.groups())
+        assert numof is None or encounters == numof
+        assert count <= encounters
+        # the filters must agree, whatever the path
+        assert valid is None or count == valid, \
+            "{} accepted {} encounters, expected {}".format(path, count, valid)
+        numof, valid = encounters, count
+        if timed:
+            child.expect(r" total=(\d+)us per_encounter=(\d+)ns")
+    return numof
+
+
+def testfunc(child):
+    numof = expect_paths(child)
+    child.expect_exact("[SUCCESS]")
+    # the self test runs the largest supported number of encounters
+    for args in ("-1", "0", str(numof + 1), "64 -1", "64 x"):
+        child.sendline("bench " + args)
+        child.expect_exact("usage: bench")
+    child.sendline("bench 64 2")
+    expect_paths(child, 64, True)
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
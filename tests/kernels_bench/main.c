@@ -0,0 +1,543 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Micro-benchmarks of the encounter data kernels
+ *
+ * Every kernel runs on fixed inputs: a batch of inputs is prepared untimed,
+ * then the whole batch is timed so that the timer resolution does not
+ * matter, and averaged over a number of runs. The time per operation is
+ * reported in ns, and in cycles when the core clock is known.
+ *
+ * All kernels must leave the memory pools as they found them, this is
+ * checked with the pool watermarks, and produce the expected results.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ebid.h"
+#include "ed.h"
+#include "epoch.h"
+#include "json_encoder.h"
+#include "kernel_defines.h"
+#include "periph_conf.h"
+#include "random.h"
+#include "rdl_window.h"
+#include "shell.h"
+#include "watermark.h"
+#include "ztimer.h"
+
+/**
+ * @brief   Operations per timed batch
+ */
+#ifndef CONFIG_BENCH_BATCH
+#define CONFIG_BENCH_BATCH          (32U)
+#endif
+
+/**
+ * @brief   Default number of runs per kernel
+ */
+#ifndef CONFIG_BENCH_RUNS
+#define CONFIG_BENCH_RUNS           (100U)
+#endif
+
+/**
+ * @brief   Serialization buffer size, holds a full epoch in JSON
+ */
+#ifndef CONFIG_BENCH_BUF_SIZE
+#define CONFIG_BENCH_BUF_SIZE       (8192U)
+#endif
+
+/* fixed inputs seed */
+#define BENCH_SEED                  (0x5EED)
+#define BENCH_RSSI(i)               (-40 - (int)((i) % 50))
+#define BENCH_TIME_S(i)             ((i) * CONFIG_EPOCH_DURATION_SEC / CONFIG_BENCH_BATCH)
+/* encounters in the epoch_finish list */
+#define BENCH_ENCOUNTERS            (CONFIG_ED_BUF_SIZE)
+#define BENCH_CONTACTS              (BENCH_ENCOUNTERS < CONFIG_EPOCH_MAX_ENCOUNTERS ? \
+                                     BENCH_ENCOUNTERS : CONFIG_EPOCH_MAX_ENCOUNTERS)
+
+typedef struct {
+    const char *name;
+    unsigned batch;             /* operations per batch */
+    void (*prepare)(void);      /* untimed, prepares a batch */
+    void (*run)(unsigned i);    /* timed, i-th operation of a batch */
+    bool (*check)(void);        /* checks the last batch results */
+} _bench_t;
+
+static ebid_t _ref;
+static ebid_t _local;
+static uint8_t _adv_slices[EBID_PARTS][EBID_SLICE_SIZE_LONG];
+static crypto_manager_keys_t _keys;
+
+static ebid_t _ebids[CONFIG_BENCH_BATCH];
+static ed_t _eds[CONFIG_BENCH_BATCH];
+static rdl_windows_t _wins[CONFIG_BENCH_BATCH];
+static ed_memory_manager_t _ed_mem;
+static ed_list_t _ed_list;
+static epoch_data_t _epoch;
+static epoch_data_t _loaded;
+static json_encoder_t _enc;
+static uint8_t _buf[CONFIG_BENCH_BUF_SIZE];
+static size_t _len;
+static int _ret;
+
+/* same slices as advertised, the third one with front padding */
+static void _setup(void)
+{
+    uint8_t pk[EBID_SIZE];
+
+    random_init(BENCH_SEED);
+    random_bytes(pk, sizeof(pk));
+    ebid_init(&_ref);
+    ebid_generate_from_pk(&_ref, pk);
+    for (uint8_t part = 0; part < EBID_PARTS; part++) {
+        if (part == EBID_SLICE_3) {
+            memcpy(_adv_slices[part] + EBID_SLICE_SIZE_LONG - EBID_SLICE_SIZE_SHORT,
+                   ebid_get_slice3(&_ref), EBID_SLICE_SIZE_SHORT);
+        }
+        else {
+            memcpy(_adv_slices[part], ebid_get_slice(&_ref, part),
+                   EBID_SLICE_SIZE_LONG);
+        }
+    }
+    ebid_init(&_local);
+    crypto_manager_gen_keypair(&_keys);
+    ed_memory_manager_init(&_ed_mem);
+}
+
+static void _contacts_fill(epoch_data_t *epoch)
+{
+    epoch_init(epoch, 1234, NULL);
+    for (unsigned i = 0; i < CONFIG_EPOCH_MAX_ENCOUNTERS; i++) {
+        contact_data_t *contact = &epoch->contacts[i];
+        for (unsigned j = 0; j < PET_SIZE; j++) {
+            contact->pet.et[j] = i * PET_SIZE + j;
+            contact->pet.rt[j] = ~(i * PET_SIZE + j);
+        }
+#if IS_USED(MODULE_ED_UWB)
+        contact->uwb.exposure_s = MIN_EXPOSURE_TIME_S + i;
+        contact->uwb.avg_d_cm = 50 + i;
+        contact->uwb.req_count = 100 + i;
+#endif
+#if IS_USED(MODULE_ED_BLE)
+        contact->ble.exposure_s = MIN_EXPOSURE_TIME_S + i;
+        contact->ble.avg_rssi = BENCH_RSSI(i) + 0.25f;
+        contact->ble.avg_d_cm = 60 + i;
+        contact->ble.scan_count = 200 + i;
+#endif
+#if IS_USED(MODULE_ED_BLE_WIN)
+        contact->ble_win.exposure_s = MIN_EXPOSURE_TIME_S + i;
+        for (unsigned j = 0; j < WINDOWS_PER_EPOCH; j++) {
+            contact->ble_win.wins[j].samples = 10 + j;
+            contact->ble_win.wins[j].avg = BENCH_RSSI(i + j) + 0.5f;
+        }
+#endif
+    }
+}
+
+static void _ebid_reconstruct_prepare(void)
+{
+    /* every slice is missing in turn */
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        ebid_init(&_ebids[i]);
+        for (uint8_t part = 0; part < EBID_PARTS; part++) {
+            if (part != i % EBID_PARTS) {
+                ebid_set_slice(&_ebids[i], ebid_get_slice(&_ref, part), part);
+            }
+        }
+    }
+}
+
+static void _ebid_reconstruct_run(unsigned i)
+{
+    ebid_reconstruct(&_ebids[i]);
+}
+
+static bool _ebid_reconstruct_check(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        if (!ebid_compare(&_ebids[i], &_ref)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _ed_add_slice_prepare(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        ed_init(&_eds[i], i);
+        for (uint8_t part = 0; part < EBID_PARTS; part++) {
+            if (part != i % EBID_PARTS) {
+                ed_add_slice(&_eds[i], 0, _adv_slices[part], part);
+            }
+        }
+    }
+}
+
+/* the last slice, the EBID is reconstructed */
+static void _ed_add_slice_run(unsigned i)
+{
+    uint8_t part = i % EBID_PARTS;
+
+    ed_add_slice(&_eds[i], BENCH_TIME_S(i), _adv_slices[part], part);
+}
+
+static bool _ed_add_slice_check(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        if (_eds[i].ebid.status.status != EBID_HAS_ALL ||
+            !ebid_compare(&_eds[i].ebid, &_ref)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _rdl_windows_update_prepare(void)
+{
+    rdl_windows_init(&_wins[0]);
+}
+
+/* samples spread over the epoch */
+static void _rdl_windows_update_run(unsigned i)
+{
+    rdl_windows_update(&_wins[0], BENCH_RSSI(i), BENCH_TIME_S(i));
+}
+
+static bool _rdl_windows_update_check(void)
+{
+    unsigned samples = 0;
+
+    for (unsigned i = 0; i < WINDOWS_PER_EPOCH; i++) {
+        samples += _wins[0].wins[i].samples;
+    }
+    /* windows overlap, a sample can be counted twice */
+    return samples >= CONFIG_BENCH_BATCH;
+}
+
+static void _rdl_windows_finalize_prepare(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        rdl_windows_init(&_wins[i]);
+        for (unsigned j = 0; j < CONFIG_BENCH_BATCH; j++) {
+            rdl_windows_update(&_wins[i], BENCH_RSSI(i + j), BENCH_TIME_S(j));
+        }
+    }
+}
+
+static void _rdl_windows_finalize_run(unsigned i)
+{
+    rdl_windows_finalize(&_wins[i]);
+}
+
+static void _eds_prepare(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        ed_init(&_eds[i], i);
+    }
+}
+
+#if IS_USED(MODULE_ED_UWB)
+static void _ed_uwb_process_data_run(unsigned i)
+{
+    ed_uwb_process_data(&_eds[i], BENCH_TIME_S(i), 100 + i, 0, BENCH_RSSI(i));
+}
+
+static bool _ed_uwb_process_data_check(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        if (_eds[i].uwb.req_count != 1 || _eds[i].uwb.cumulative_d_cm != 100 + i) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+#if IS_USED(MODULE_ED_BLE)
+static void _ed_ble_process_data_run(unsigned i)
+{
+    ed_ble_process_data(&_eds[i], BENCH_TIME_S(i), BENCH_RSSI(i));
+}
+
+static bool _ed_ble_process_data_check(void)
+{
+    for (unsigned i = 0; i < CONFIG_BENCH_BATCH; i++) {
+        if (_eds[i].ble.scan_count != 1 || _eds[i].ble.cumulative_rssi <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+#if IS_USED(MODULE_ED_BLE_WIN)
+static void _ed_ble_win_process_data_run(unsigned i)
+{
+    ed_ble_win_process_data(&_eds[i], BENCH_TIME_S(i), BENCH_RSSI(i));
+}
+#endif
+
+/* a full encounter list, as at the end of an epoch */
+static void _epoch_finish_prepare(void)
+{
+    epoch_init(&_epoch, 0, NULL);
+    _epoch.keys = &_keys;
+    ed_list_init(&_ed_list, &_ed_mem, &_local);
+    ed_list_set_min_exposure(&_ed_list, 0);
+    for (unsigned i = 0; i < BENCH_ENCOUNTERS; i++) {
+        /* same EBID for all, only PETs generation matters */
+        for (uint8_t part = 0; part < EBID_PARTS; part++) {
+            ed_list_process_slice(&_ed_list, i, 0, _adv_slices[part], part);
+        }
+        for (unsigned j = 0; j < CONFIG_BENCH_BATCH; j++) {
+            ed_list_process_rng_data(&_ed_list, i, BENCH_TIME_S(j), 50 + i, 0,
+                                     BENCH_RSSI(j));
+#if IS_USED(MODULE_ED_BLE) || IS_USED(MODULE_ED_BLE_WIN)
+            ed_list_process_scan_data(&_ed_list, i, BENCH_TIME_S(j), BENCH_RSSI(j));
+#endif
+        }
+    }
+    ed_list_finish(&_ed_list);
+}
+
+static void _epoch_finish_run(unsigned i)
+{
+    (void)i;
+    epoch_finish(&_epoch, &_ed_list);
+}
+
+static bool _epoch_finish_check(void)
+{
+    return epoch_contacts(&_epoch) == BENCH_CONTACTS &&
+           _ed_list.list.next == NULL;
+}
+
+static void _epoch_prepare(void)
+{
+    _contacts_fill(&_epoch);
+}
+
+static void _serialize_all_cbor_run(unsigned i)
+{
+    (void)i;
+    _len = contact_data_serialize_all_cbor(&_epoch, _buf, sizeof(_buf));
+}
+
+static void _serialize_all_json_run(unsigned i)
+{
+    (void)i;
+    _len = contact_data_serialize_all_json(&_epoch, _buf, sizeof(_buf), "bench");
+}
+
+static bool _serialize_check(void)
+{
+    return _len > 0 && _len < sizeof(_buf);
+}
+
+static void _load_all_cbor_prepare(void)
+{
+    _contacts_fill(&_epoch);
+    _len = contact_data_serialize_all_cbor(&_epoch, _buf, sizeof(_buf));
+}
+
+static void _load_all_cbor_run(unsigned i)
+{
+    (void)i;
+    memset(&_loaded, '\0', sizeof(_loaded));
+    _ret = contact_data_load_all_cbor(_buf, _len, &_loaded);
+}
+
+static bool _load_all_cbor_check(void)
+{
+    if (_ret < 0 || _loaded.timestamp != _epoch.timestamp) {
+        return false;
+    }
+    for (unsigned i = 0; i < CONFIG_EPOCH_MAX_ENCOUNTERS; i++) {
+        if (memcmp(&_loaded.contacts[i].pet, &_epoch.contacts[i].pet,
+                   sizeof(pet_t))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _json_float_prepare(void)
+{
+    json_encoder_init(&_enc, (char *)_buf, sizeof(_buf));
+    json_array_open(&_enc);
+    _ret = 0;
+}
+
+static void _json_float_run(unsigned i)
+{
+    _ret |= json_float(&_enc, BENCH_RSSI(i) + i / 8.0f);
+}
+
+static bool _json_float_check(void)
+{
+    return _ret >= 0 && json_encoder_len(&_enc) > CONFIG_BENCH_BATCH;
+}
+
+static const _bench_t _benches[] = {
+    { "ebid_reconstruct", CONFIG_BENCH_BATCH, _ebid_reconstruct_prepare,
+      _ebid_reconstruct_run, _ebid_reconstruct_check },
+    { "ed_add_slice", CONFIG_BENCH_BATCH, _ed_add_slice_prepare,
+      _ed_add_slice_run, _ed_add_slice_check },
+    { "rdl_windows_update", CONFIG_BENCH_BATCH, _rdl_windows_update_prepare,
+      _rdl_windows_update_run, _rdl_windows_update_check },
+    { "rdl_windows_finalize", CONFIG_BENCH_BATCH, _rdl_windows_finalize_prepare,
+      _rdl_windows_finalize_run, NULL },
+#if IS_USED(MODULE_ED_UWB)
+    { "ed_uwb_process_data", CONFIG_BENCH_BATCH, _eds_prepare,
+      _ed_uwb_process_data_run, _ed_uwb_process_data_check },
+#endif
+#if IS_USED(MODULE_ED_BLE)
+    { "ed_ble_process_data", CONFIG_BENCH_BATCH, _eds_prepare,
+      _ed_ble_process_data_run, _ed_ble_process_data_check },
+#endif
+#if IS_USED(MODULE_ED_BLE_WIN)
+    { "ed_ble_win_process_data", CONFIG_BENCH_BATCH, _eds_prepare,
+      _ed_ble_win_process_data_run, NULL },
+#endif
+    { "epoch_finish", 1, _epoch_finish_prepare, _epoch_finish_run,
+      _epoch_finish_check },
+    { "serialize_all_cbor", 1, _epoch_prepare, _serialize_all_cbor_run,
+      _serialize_check },
+    { "serialize_all_json", 1, _epoch_prepare, _serialize_all_json_run,
+      _serialize_check },
+    { "load_all_cbor", 1, _load_all_cbor_prepare, _load_all_cbor_run,
+      _load_all_cbor_check },
+    { "json_float", CONFIG_BENCH_BATCH, _json_float_prepare, _json_float_run,
+      _json_float_check },
+};
+
+static int _bench(const _bench_t *bench, unsigned runs)
+{
+    watermark_pool_t before = _ed_mem.watermark;
+    uint32_t elapsed = 0;
+    bool ok = true;
+
+    for (unsigned r = 0; r < runs; r++) {
+        bench->prepare();
+        uint32_t start = ztimer_now(ZTIMER_USEC);
+        for (unsigned i = 0; i < bench->batch; i++) {
+            bench->run(i);
+        }
+        elapsed += ztimer_now(ZTIMER_USEC) - start;
+        if (bench->check) {
+            ok &= bench->check();
+        }
+    }
+    /* whatever was taken from the pools must have been given back */
+    bool alloc_free = _ed_mem.watermark.used == before.used &&
+                      _ed_mem.watermark.fails == before.fails;
+    uint32_t ns = (1000ULL * elapsed) / (runs * bench->batch);
+
+    printf("%-24s ops=%-6u ns/op=%-8" PRIu32, bench->name,
+           runs * bench->batch, ns);
+#ifdef CLOCK_CORECLOCK
+    printf(" cycles/op=%-8" PRIu32,
+           (uint32_t)((uint64_t)ns * CLOCK_CORECLOCK / NS_PER_SEC));
+#endif
+    printf(" alloc_free=%s check=%s\n", alloc_free ? "yes" : "no",
+           ok ? "ok" : "failed");
+    return ok && alloc_free ? 0 : -1;
+}
+
+/* strtoul silently wraps negative values around, reject them */
+static int _parse_uint(const char *arg, unsigned *val)
+{
+    char *end;
+
+    if (*arg == '-') {
+        return -1;
+    }
+    errno = 0;
+    unsigned long res = strtoul(arg, &end, 0);
+
+    if (end == arg || *end != '\0' || errno || res > UINT_MAX) {
+        return -1;
+    }
+    *val = res;
+    return 0;
+}
+
+static int _cmd_bench(int argc, char **argv)
+{
+    const char *name = NULL;
+    unsigned runs = CONFIG_BENCH_RUNS;
+    int res = 0;
+    bool found = false;
+
+    if (argc > 1 && strcmp(argv[1], "all")) {
+        name = argv[1];
+    }
+    /* ops are counted as runs * batch */
+    if (argc > 2 && (_parse_uint(argv[2], &runs) ||
+                     runs > UINT_MAX / CONFIG_BENCH_BATCH)) {
+        runs = 0;
+    }
+    for (unsigned i = 0; i < ARRAY_SIZE(_benches); i++) {
+        if (!name || !strcmp(name, _benches[i].name)) {
+            found = true;
+            res |= runs ? _bench(&_benches[i], runs) : 0;
+        }
+    }
+    if (!found || runs == 0) {
+        printf("usage: %s [all", argv[0]);
+        for (unsigned i = 0; i < ARRAY_SIZE(_benches); i++) {
+            printf("|%s", _benches[i].name);
+        }
+        puts("] [runs]");
+        return -1;
+    }
+    return res;
+}
+
+static const shell_command_t _commands[] = {
+    { "bench", "time the encounter data kernels", _cmd_bench },
+    { NULL, NULL, NULL }
+};
+
+/* all kernels produce the expected results without leaking pool blocks */
+static int _self_test(void)
+{
+    int res = 0;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_benches); i++) {
+        res |= _bench(&_benches[i], 1);
+    }
+    return res;
+}
+
+int main(void)
+{
+    char line_buf[SHELL_DEFAULT_BUFSIZE];
+
+    _setup();
+    puts(_self_test() ? "[FAILED]" : "[SUCCESS]");
+
+    shell_run(_commands, line_buf, SHELL_DEFAULT_BUFSIZE);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import sys
+from testrunner import run
+
+KERNELS = (
+    "ebid_reconstruct", "ed_add_slice", "rdl_windows_update",
+    "rdl_windows_finalize", "epoch_finish", "serialize_all_cbor",
+    "load_all_cbor", "json_float",
+)
+LINE = (r"(\w+)\s+ops=(\d+)\s+ns/op=(\d+)[^\n]*"
+        r"alloc_free=(\w+) check=(\w+)")
+
+
+def testfunc(child):
+    ops = {}
+    # the self test runs every kernel once
+    while child.expect([LINE, r"\[SUCCESS\]", r"\[FAILED\]"]) == 0:
+        name, count, _, alloc_free, check = child.match.groups()
+        assert alloc_free == "yes", "{} leaked from the pools".format(name)
+        assert check == "ok", "{} returned wrong results".format(name)
+        ops[name] = int(count)
+    assert child.match.group(0) == "[SUCCESS]"
+    for name in KERNELS:
+        assert name in ops, "{} was not run".format(name)
+    # negative run counts must not wrap around
+    child.sendline("bench ed_add_slice -1")
+    child.expect_exact("usage: bench")
+    child.sendline("bench nope")
+    child.expect_exact("usage: bench")
+    child.sendline("bench ed_add_slice 3")
+    child.expect(LINE)
+    name, count, _, alloc_free, check = child.match.groups()
+    assert name == "ed_add_slice"
+    assert int(count) == 3 * ops[name], "ops are not runs * batch"
+    assert alloc_free == "yes" and check == "ok"
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
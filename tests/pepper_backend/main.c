@@ -0,0 +1,647 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Local PEPPER backend stand-in
+ *
+ * Serves the pepper_srv_coap resources of any number of devices:
+ *  - POST /<uid>/ertl:      block-wise ERTL upload, PETs are stored
+ *  - POST /<uid>/infected:  infection status declaration
+ *  - GET  /<uid>/esr:       exposure status, the device RTs intersected
+ *                           with the ETs uploaded by infected devices,
+ *                           observable, a notification is sent when it flips
+ *
+ * The bench command feeds synthetic ERTLs from simulated devices through
+ * the same ingestion path and reports ingestion rate and exposure status
+ * latency as the PET count grows.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epoch.h"
+#include "mutex.h"
+#include "nanocbor/nanocbor.h"
+#include "net/gcoap.h"
+#include "random.h"
+#include "shell.h"
+#include "ztimer.h"
+
+#include "pet_store.h"
+
+/* same as CONFIG_PEPPER_SRV_INFECTED_CBOR_TAG and CONFIG_PEPPER_SRV_ESR_CBOR_TAG */
+#define INFECTED_CBOR_TAG       (0xCAFA)
+#define ESR_CBOR_TAG            (0xCAFF)
+
+/**
+ * @brief   Largest ERTL accepted, as CONFIG_COAP_ERTL_PATLOAD_BUFFER
+ */
+#ifndef CONFIG_BACKEND_ERTL_MAX
+#define CONFIG_BACKEND_ERTL_MAX         (1024U)
+#endif
+
+/**
+ * @brief   Number of concurrent block-wise uploads
+ */
+#ifndef CONFIG_BACKEND_UPLOAD_SLOTS
+#define CONFIG_BACKEND_UPLOAD_SLOTS     (8U)
+#endif
+
+/**
+ * @brief   Maximum number of simulated devices
+ */
+#ifndef CONFIG_BACKEND_SIM_DEVICES_MAX
+#define CONFIG_BACKEND_SIM_DEVICES_MAX  (1024U)
+#endif
+
+/**
+ * @brief   Maximum number of devices with an observable exposure status
+ */
+#ifndef CONFIG_BACKEND_OBSERVERS_MAX
+#define CONFIG_BACKEND_OBSERVERS_MAX    CONFIG_GCOAP_OBS_REGISTRATIONS_MAX
+#endif
+
+/* smallest block size, received blocks are tracked in units of it */
+#define UPLOAD_UNIT             (16U)
+#define UPLOAD_UNITS            (CONFIG_BACKEND_ERTL_MAX / UPLOAD_UNIT)
+/* first report once that many PETs are stored, then at every doubling */
+#define BENCH_FIRST_REPORT      (1UL << 14)
+/* simulated encounters last up to an epoch */
+#define SIM_EXPOSURE_MAX_S      (15 * 60U)
+
+typedef struct {
+    int dev;                    /* -1 when free */
+    uint32_t last;              /* last block time, oldest is recycled */
+    size_t len;                 /* total length, 0 until the last block */
+    uint64_t units;             /* received UPLOAD_UNIT chunks */
+    uint8_t buf[CONFIG_BACKEND_ERTL_MAX];
+} _upload_t;
+
+static_assert(UPLOAD_UNITS <= 64, "upload bitmap too small");
+
+/* gcoap keeps a single observer per resource, every device gets its own
+   /<uid>/esr resource */
+typedef struct {
+    char path[CONFIG_NANOCOAP_URI_MAX];     /* empty when free */
+    bool exposed;                           /* last sent status */
+} _observer_t;
+
+/* the store is shared between the gcoap thread and the shell */
+static mutex_t _store_lock = MUTEX_INIT;
+static _upload_t _uploads[CONFIG_BACKEND_UPLOAD_SLOTS];
+static uint32_t _ertls;
+
+static _observer_t _observers[CONFIG_BACKEND_OBSERVERS_MAX];
+static coap_resource_t _esr_resources[CONFIG_BACKEND_OBSERVERS_MAX];
+
+static epoch_data_t _sim_epochs[CONFIG_BACKEND_SIM_DEVICES_MAX];
+static int _sim_devs[CONFIG_BACKEND_SIM_DEVICES_MAX];
+static uint8_t _sim_buf[CONFIG_BACKEND_ERTL_MAX];
+
+static int _ertl_ingest(int dev, uint8_t *buf, size_t len)
+{
+    nanocbor_value_t dec;
+    nanocbor_value_t arr;
+    nanocbor_value_t contacts;
+    nanocbor_value_t contact;
+    uint32_t tag;
+    uint32_t timestamp;
+    int count = 0;
+
+    nanocbor_decoder_init(&dec, buf, len);
+    if (nanocbor_get_tag(&dec, &tag) < 0 || tag != EPOCH_CBOR_TAG ||
+        nanocbor_enter_array(&dec, &arr) < 0 ||
+        nanocbor_get_uint32(&arr, &timestamp) < 0 ||
+        nanocbor_enter_array(&arr, &contacts) < 0) {
+        return -EBADMSG;
+    }
+    while (!nanocbor_at_end(&contacts)) {
+        const uint8_t *et;
+        const uint8_t *rt;
+        size_t et_len;
+        size_t rt_len;
+
+        if (nanocbor_enter_array(&contacts, &contact) < 0 ||
+            nanocbor_get_bstr(&contact, &et, &et_len) < 0 ||
+            nanocbor_get_bstr(&contact, &rt, &rt_len) < 0 ||
+            et_len != PET_SIZE || rt_len != PET_SIZE) {
+            return -EBADMSG;
+        }
+        if (pet_store_add(dev, et, rt)) {
+            return -ENOMEM;
+        }
+        /* encounter data is not needed for the exposure status */
+        while (!nanocbor_at_end(&contact)) {
+            if (nanocbor_get_type(&contact) == NANOCBOR_TYPE_TAG) {
+                nanocbor_get_tag(&contact, &tag);
+            }
+            nanocbor_skip(&contact);
+        }
+        nanocbor_leave_container(&contacts, &contact);
+        count++;
+    }
+    _ertls++;
+    return count;
+}
+
+static _upload_t *_upload_get(int dev)
+{
+    _upload_t *oldest = &_uploads[0];
+
+    for (unsigned i = 0; i < CONFIG_BACKEND_UPLOAD_SLOTS; i++) {
+        if (_uploads[i].dev == dev) {
+            return &_uploads[i];
+        }
+        if (_uploads[i].dev < 0 ||
+            (oldest->dev >= 0 && _uploads[i].last < oldest->last)) {
+            oldest = &_uploads[i];
+        }
+    }
+    /* a free slot or the most stale upload */
+    oldest->dev = dev;
+    oldest->len = 0;
+    oldest->units = 0;
+    return oldest;
+}
+
+static bool _upload_complete(_upload_t *upload)
+{
+    unsigned units = (upload->len + UPLOAD_UNIT - 1) / UPLOAD_UNIT;
+
+    return upload->len &&
+           (upload->units & (UINT64_MAX >> (64 - units))) == (UINT64_MAX >> (64 - units));
+}
+
+static ssize_t _ertl_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len, int dev)
+{
+    coap_block1_t block1;
+    bool blockwise = coap_get_block1(pdu, &block1) > 0;
+
+    if (!blockwise) {
+        block1.offset = 0;
+        block1.more = 0;
+    }
+    if (block1.offset + pdu->payload_len > CONFIG_BACKEND_ERTL_MAX ||
+        block1.offset % UPLOAD_UNIT) {
+        return gcoap_response(pdu, buf, len, COAP_CODE_REQUEST_ENTITY_TOO_LARGE);
+    }
+
+    _upload_t *upload = _upload_get(dev);
+
+    upload->last = ztimer_now(ZTIMER_MSEC);
+    memcpy(&upload->buf[block1.offset], pdu->payload, pdu->payload_len);
+    for (size_t i = 0; i < pdu->payload_len; i += UPLOAD_UNIT) {
+        upload->units |= 1ULL << ((block1.offset + i) / UPLOAD_UNIT);
+    }
+    if (!block1.more) {
+        upload->len = block1.offset + pdu->payload_len;
+    }
+
+    unsigned code = COAP_CODE_CONTINUE;
+    if (_upload_complete(upload)) {
+        int res = _ertl_ingest(dev, upload->buf, upload->len);
+        upload->dev = -1;
+        code = res < 0 ? COAP_CODE_BAD_REQUEST : COAP_CODE_CHANGED;
+    }
+    gcoap_resp_init(pdu, buf, len, code);
+    if (blockwise) {
+        coap_opt_add_block1_control(pdu, &block1);
+    }
+    return coap_opt_finish(pdu, COAP_OPT_FINISH_NONE);
+}
+
+static ssize_t _infected_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len,
+                                 int dev)
+{
+    nanocbor_value_t dec;
+    nanocbor_value_t arr;
+    uint32_t tag;
+    bool infected;
+
+    nanocbor_decoder_init(&dec, pdu->payload, pdu->payload_len);
+    if (nanocbor_get_tag(&dec, &tag) < 0 || tag != INFECTED_CBOR_TAG ||
+        nanocbor_enter_array(&dec, &arr) < 0 ||
+        nanocbor_get_bool(&arr, &infected) < 0) {
+        return gcoap_response(pdu, buf, len, COAP_CODE_BAD_REQUEST);
+    }
+    pet_store_set_infected(dev, infected);
+    return gcoap_response(pdu, buf, len, COAP_CODE_CHANGED);
+}
+
+static size_t _esr_payload(coap_pkt_t *pdu, bool exposed)
+{
+    nanocbor_encoder_t enc;
+
+    coap_opt_add_format(pdu, COAP_FORMAT_CBOR);
+    size_t len = coap_opt_finish(pdu, COAP_OPT_FINISH_PAYLOAD);
+
+    nanocbor_encoder_init(&enc, pdu->payload, pdu->payload_len);
+    nanocbor_fmt_tag(&enc, ESR_CBOR_TAG);
+    nanocbor_fmt_array(&enc, 1);
+    nanocbor_fmt_bool(&enc, exposed);
+    return len + nanocbor_encoded_len(&enc);
+}
+
+/* the store device of an observer, its index changes on a store reset */
+static int _observer_device(const _observer_t *obs)
+{
+    /* path is /<uid>/esr */
+    return pet_store_device(&obs->path[1], strlen(obs->path) - sizeof("/esr"));
+}
+
+static ssize_t _esr_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len,
+                            void *ctx)
+{
+    _observer_t *obs = ctx;
+
+    mutex_lock(&_store_lock);
+    int dev = _observer_device(obs);
+    if (dev < 0) {
+        mutex_unlock(&_store_lock);
+        return gcoap_response(pdu, buf, len, COAP_CODE_INTERNAL_SERVER_ERROR);
+    }
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    obs->exposed = pet_store_exposed(dev);
+    uint32_t elapsed = ztimer_now(ZTIMER_USEC) - start;
+    mutex_unlock(&_store_lock);
+
+    gcoap_resp_init(pdu, buf, len, COAP_CODE_CONTENT);
+    printf("esr: device %d exposed=%d in %" PRIu32 "us\n", dev, obs->exposed,
+           elapsed);
+    return _esr_payload(pdu, obs->exposed);
+}
+
+/* notifies the observers whose exposure status flipped */
+static void _esr_notify(void)
+{
+    uint8_t buf[CONFIG_GCOAP_PDU_BUF_SIZE];
+    coap_pkt_t pdu;
+
+    for (unsigned i = 0; i < CONFIG_BACKEND_OBSERVERS_MAX; i++) {
+        _observer_t *obs = &_observers[i];
+        if (!obs->path[0]) {
+            continue;
+        }
+        mutex_lock(&_store_lock);
+        int dev = _observer_device(obs);
+        bool exposed = dev >= 0 && pet_store_exposed(dev);
+        mutex_unlock(&_store_lock);
+        if (exposed == obs->exposed ||
+            gcoap_obs_init(&pdu, buf, sizeof(buf), &_esr_resources[i]) !=
+            GCOAP_OBS_INIT_OK) {
+            continue;
+        }
+        obs->exposed = exposed;
+        size_t len = _esr_payload(&pdu, exposed);
+        if (gcoap_obs_send(buf, len, &_esr_resources[i]) > 0) {
+            printf("esr: notified %s exposed=%d\n", obs->path, exposed);
+        }
+    }
+}
+
+/* matches GET /<uid>/esr, the resource of a device is created on its
+   first request */
+static int _esr_matcher(gcoap_listener_t *listener,
+                        const coap_resource_t **resource, coap_pkt_t *pdu)
+{
+    (void)listener;
+    char uri[CONFIG_NANOCOAP_URI_MAX];
+    _observer_t *free_obs = NULL;
+
+    if (coap_get_code_detail(pdu) != COAP_METHOD_GET ||
+        coap_get_uri_path(pdu, (uint8_t *)uri) <= 0) {
+        return GCOAP_RESOURCE_NO_PATH;
+    }
+    size_t len = strlen(uri);
+    if (strncmp(uri, "/DW", 3) || len <= sizeof("/DW/esr") - 1 ||
+        strcmp(&uri[len - (sizeof("/esr") - 1)], "/esr") ||
+        memchr(&uri[1], '/', len - sizeof("/esr")) != NULL) {
+        return GCOAP_RESOURCE_NO_PATH;
+    }
+    for (unsigned i = 0; i < CONFIG_BACKEND_OBSERVERS_MAX; i++) {
+        if (!strcmp(_observers[i].path, uri)) {
+            *resource = &_esr_resources[i];
+            return GCOAP_RESOURCE_FOUND;
+        }
+        if (!free_obs && !_observers[i].path[0]) {
+            free_obs = &_observers[i];
+        }
+    }
+    if (!free_obs) {
+        printf("esr: no observer left for %s\n", uri);
+        return GCOAP_RESOURCE_ERROR;
+    }
+    unsigned i = free_obs - _observers;
+    memcpy(free_obs->path, uri, len + 1);
+    _esr_resources[i] = (coap_resource_t){
+        free_obs->path, COAP_GET, _esr_handler, free_obs
+    };
+    *resource = &_esr_resources[i];
+    return GCOAP_RESOURCE_FOUND;
+}
+
+static ssize_t _device_handler(coap_pkt_t *pdu, uint8_t *buf, size_t len,
+                               void *ctx)
+{
+    (void)ctx;
+    char uri[CONFIG_NANOCOAP_URI_MAX];
+    ssize_t res;
+
+    /* uri is /<uid>/<resource> */
+    if (coap_get_uri_path(pdu, (uint8_t *)uri) <= 0) {
+        return gcoap_response(pdu, buf, len, COAP_CODE_BAD_REQUEST);
+    }
+    char *uid = &uri[1];
+    char *resource = strchr(uid, '/');
+    if (!resource) {
+        return gcoap_response(pdu, buf, len, COAP_CODE_PATH_NOT_FOUND);
+    }
+
+    unsigned method = coap_get_code_detail(pdu);
+    mutex_lock(&_store_lock);
+    int dev = pet_store_device(uid, resource - uid);
+    if (dev < 0) {
+        res = gcoap_response(pdu, buf, len, COAP_CODE_INTERNAL_SERVER_ERROR);
+    }
+    else if (!strcmp(resource, "/ertl") && method == COAP_METHOD_POST) {
+        res = _ertl_handler(pdu, buf, len, dev);
+    }
+    else if (!strcmp(resource, "/infected") && method == COAP_METHOD_POST) {
+        res = _infected_handler(pdu, buf, len, dev);
+    }
+    else {
+        res = gcoap_response(pdu, buf, len, COAP_CODE_PATH_NOT_FOUND);
+    }
+    mutex_unlock(&_store_lock);
+    /* uploads and infection declarations may flip exposure statuses */
+    _esr_notify();
+    return res;
+}
+
+/* pepper uids all start with "DW", GET /<uid>/esr is matched first by
+   _esr_listener */
+static const coap_resource_t _resources[] = {
+    { "/DW", COAP_POST | COAP_MATCH_SUBTREE, _device_handler, NULL },
+};
+
+static gcoap_listener_t _esr_listener = {
+    _esr_resources,
+    CONFIG_BACKEND_OBSERVERS_MAX,
+    NULL,
+    NULL,
+    _esr_matcher
+};
+
+static gcoap_listener_t _listener = {
+    (coap_resource_t *)&_resources[0],
+    ARRAY_SIZE(_resources),
+    NULL,
+    NULL,
+    NULL
+};
+
+static void _sim_contact(epoch_data_t *a, epoch_data_t *b, uint8_t *na,
+                         uint8_t *nb)
+{
+    contact_data_t *ca = &a->contacts[(*na)++];
+    contact_data_t *cb = &b->contacts[(*nb)++];
+
+    /* the RT of one side is the ET of the other */
+    random_bytes(ca->pet.et, PET_SIZE);
+    random_bytes(ca->pet.rt, PET_SIZE);
+    memcpy(cb->pet.et, ca->pet.rt, PET_SIZE);
+    memcpy(cb->pet.rt, ca->pet.et, PET_SIZE);
+    ca->uwb.exposure_s = random_uint32_range(1, SIM_EXPOSURE_MAX_S);
+    cb->uwb.exposure_s = ca->uwb.exposure_s;
+}
+
+/* every device meets CONFIG_EPOCH_MAX_ENCOUNTERS others and uploads its ERTL */
+static int _sim_round(unsigned devices, uint32_t timestamp, uint32_t *ingest_us)
+{
+    static uint8_t counts[CONFIG_BACKEND_SIM_DEVICES_MAX];
+
+    for (unsigned i = 0; i < devices; i++) {
+        epoch_init(&_sim_epochs[i], timestamp, NULL);
+        counts[i] = 0;
+    }
+    for (unsigned k = 0; k < CONFIG_EPOCH_MAX_ENCOUNTERS / 2; k++) {
+        unsigned shift = random_uint32_range(1, devices);
+        for (unsigned i = 0; i < devices; i++) {
+            unsigned j = (i + shift) % devices;
+            _sim_contact(&_sim_epochs[i], &_sim_epochs[j], &counts[i], &counts[j]);
+        }
+    }
+    for (unsigned i = 0; i < devices; i++) {
+        size_t len = contact_data_serialize_all_cbor(&_sim_epochs[i], _sim_buf,
+                                                     sizeof(_sim_buf));
+        mutex_lock(&_store_lock);
+        uint32_t start = ztimer_now(ZTIMER_USEC);
+        int res = _ertl_ingest(_sim_devs[i], _sim_buf, len);
+        *ingest_us += ztimer_now(ZTIMER_USEC) - start;
+        mutex_unlock(&_store_lock);
+        if (res < 0) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+static void _sim_report(unsigned devices, uint32_t ingest_us, uint32_t pets)
+{
+    pet_store_stats_t stats;
+    uint32_t max_us = 0;
+    uint32_t total_us = 0;
+    unsigned exposed = 0;
+
+    for (unsigned i = 0; i < devices; i++) {
+        mutex_lock(&_store_lock);
+        uint32_t start = ztimer_now(ZTIMER_USEC);
+        exposed += pet_store_exposed(_sim_devs[i]);
+        uint32_t elapsed = ztimer_now(ZTIMER_USEC) - start;
+        mutex_unlock(&_store_lock);
+        total_us += elapsed;
+        max_us = elapsed > max_us ? elapsed : max_us;
+    }
+    mutex_lock(&_store_lock);
+    pet_store_stats(&stats);
+    mutex_unlock(&_store_lock);
+    printf("pets=%" PRIu32 " ingest=%" PRIu32 " pets/s esr_avg=%" PRIu32
+           "us esr_max=%" PRIu32 "us exposed=%u/%u probes/lookup=%" PRIu32 "\n",
+           pets, ingest_us ? (uint32_t)((uint64_t)pets * US_PER_SEC / ingest_us) : 0,
+           total_us / devices, max_us, exposed, devices,
+           stats.lookups ? stats.probes / stats.lookups : 0);
+}
+
+static int _bench(uint32_t target, unsigned devices)
+{
+    char uid[PET_STORE_UID_LEN];
+    pet_store_stats_t stats;
+    uint32_t ingest_us = 0;
+    uint32_t report = BENCH_FIRST_REPORT;
+
+    mutex_lock(&_store_lock);
+    pet_store_reset();
+    for (unsigned i = 0; i < devices; i++) {
+        snprintf(uid, sizeof(uid), "SIM%05u", i);
+        _sim_devs[i] = pet_store_device(uid, strlen(uid));
+    }
+    /* one percent of the devices declare themselves infected */
+    for (unsigned i = 0; i < devices / 100 + 1; i++) {
+        pet_store_set_infected(_sim_devs[i], true);
+    }
+    mutex_unlock(&_store_lock);
+
+    for (uint32_t round = 0;; round++) {
+        if (_sim_round(devices, round, &ingest_us)) {
+            puts("bench: store full");
+            break;
+        }
+        mutex_lock(&_store_lock);
+        pet_store_stats(&stats);
+        mutex_unlock(&_store_lock);
+        uint32_t pets = stats.ets + stats.rts;
+        if (pets >= report || pets >= target) {
+            _sim_report(devices, ingest_us, pets);
+            report *= 2;
+        }
+        if (pets >= target) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/* strtoul silently wraps negative values around, reject them */
+static int _parse_uint(const char *arg, unsigned *val)
+{
+    char *end;
+
+    if (*arg == '-') {
+        return -1;
+    }
+    errno = 0;
+    unsigned long res = strtoul(arg, &end, 0);
+
+    if (end == arg || *end != '\0' || errno || res > UINT_MAX) {
+        return -1;
+    }
+    *val = res;
+    return 0;
+}
+
+static int _cmd_bench(int argc, char **argv)
+{
+    unsigned target = 2 * CONFIG_PET_STORE_PETS_MAX;
+    unsigned devices = CONFIG_BACKEND_SIM_DEVICES_MAX;
+
+    if (argc > 1 && _parse_uint(argv[1], &target)) {
+        target = 0;
+    }
+    if (argc > 2 && _parse_uint(argv[2], &devices)) {
+        devices = 0;
+    }
+    if (target == 0 || devices < 2 ||
+        devices > CONFIG_BACKEND_SIM_DEVICES_MAX) {
+        printf("usage: %s [pets] [devices <= %u]\n", argv[0],
+               CONFIG_BACKEND_SIM_DEVICES_MAX);
+        return -1;
+    }
+    return _bench(target, devices);
+}
+
+static int _cmd_store(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    pet_store_stats_t stats;
+
+    mutex_lock(&_store_lock);
+    pet_store_stats(&stats);
+    mutex_unlock(&_store_lock);
+    printf("devices=%" PRIu32 " infected=%" PRIu32 " ets=%" PRIu32 " rts=%"
+           PRIu32 " duplicates=%" PRIu32 " ertls=%" PRIu32 "\n",
+           stats.devices, stats.infected, stats.ets, stats.rts,
+           stats.duplicates, _ertls);
+    return 0;
+}
+
+static const shell_command_t _commands[] = {
+    { "bench", "ingest synthetic ERTLs and time exposure status requests", _cmd_bench },
+    { "store", "print PET store statistics", _cmd_store },
+    { NULL, NULL, NULL }
+};
+
+/* an infected device exposes the devices it met, and only those */
+static int _self_test(void)
+{
+    static const char *uids[] = { "DWTEST0", "DWTEST1", "DWTEST2" };
+    uint8_t counts[ARRAY_SIZE(uids)] = { 0 };
+    int devs[ARRAY_SIZE(uids)];
+    bool ok = true;
+
+    pet_store_reset();
+    for (unsigned i = 0; i < ARRAY_SIZE(uids); i++) {
+        devs[i] = pet_store_device(uids[i], strlen(uids[i]));
+        epoch_init(&_sim_epochs[i], 0, NULL);
+    }
+    /* the first two devices met, the third met no one */
+    _sim_contact(&_sim_epochs[0], &_sim_epochs[1], &counts[0], &counts[1]);
+    for (unsigned i = 0; i < ARRAY_SIZE(uids); i++) {
+        size_t len = contact_data_serialize_all_cbor(&_sim_epochs[i], _sim_buf,
+                                                     sizeof(_sim_buf));
+        int res = _ertl_ingest(devs[i], _sim_buf, len);
+        printf("%s contacts=%d\n", uids[i], res);
+        ok &= res == counts[i];
+    }
+
+    /* only the device that met the infected one is exposed */
+    pet_store_set_infected(devs[0], true);
+    for (unsigned i = 0; i < ARRAY_SIZE(uids); i++) {
+        bool exposed = pet_store_exposed(devs[i]);
+        printf("%s infected=%d exposed=%d\n", uids[i], i == 0, exposed);
+        ok &= exposed == (i == 1);
+    }
+    pet_store_set_infected(devs[0], false);
+    for (unsigned i = 0; i < ARRAY_SIZE(uids); i++) {
+        bool exposed = pet_store_exposed(devs[i]);
+        printf("%s infected=0 exposed=%d\n", uids[i], exposed);
+        ok &= !exposed;
+    }
+    pet_store_reset();
+    return ok ? 0 : -1;
+}
+
+int main(void)
+{
+    char line_buf[SHELL_DEFAULT_BUFSIZE];
+
+    for (unsigned i = 0; i < CONFIG_BACKEND_UPLOAD_SLOTS; i++) {
+        _uploads[i].dev = -1;
+    }
+
+    puts(_self_test() ? "[FAILED]" : "[SUCCESS]");
+
+    /* listeners are matched in registration order */
+    gcoap_register_listener(&_esr_listener);
+    gcoap_register_listener(&_listener);
+    shell_run(_commands, line_buf, SHELL_DEFAULT_BUFSIZE);
+    return 0;
+}
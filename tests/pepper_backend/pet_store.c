@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Hash indexed PET store implementation
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "pet_store.h"
+
+/* index slots hold entry + 1, 0 marks an empty slot */
+#define INDEX_SIZE          (2 * CONFIG_PET_STORE_PETS_MAX)
+#define DEVICE_INDEX_SIZE   (2 * CONFIG_PET_STORE_DEVICES_MAX)
+#define NONE                (UINT32_MAX)
+
+typedef struct {
+    uint8_t token[PET_SIZE];
+    uint32_t owner;
+    uint32_t next;              /* next RT of the same owner */
+} _entry_t;
+
+typedef struct {
+    _entry_t entries[CONFIG_PET_STORE_PETS_MAX];
+    uint32_t index[INDEX_SIZE];
+    uint32_t count;
+} _pet_set_t;
+
+typedef struct {
+    char uid[PET_STORE_UID_LEN];
+    bool infected;
+    uint32_t rt_head;
+} _device_t;
+
+static _pet_set_t _ets;
+static _pet_set_t _rts;
+static _device_t _devices[CONFIG_PET_STORE_DEVICES_MAX];
+static uint32_t _device_index[DEVICE_INDEX_SIZE];
+static uint32_t _devices_numof;
+static pet_store_stats_t _stats;
+
+static uint32_t _mix(uint32_t h)
+{
+    /* murmur3 finalizer, PETs are hashes already but uids are not */
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t _token_hash(const uint8_t *token)
+{
+    uint32_t h;
+
+    memcpy(&h, token, sizeof(h));
+    return _mix(h);
+}
+
+static uint32_t _uid_hash(const char *uid, size_t len)
+{
+    /* djb2 */
+    uint32_t h = 5381;
+
+    while (len--) {
+        h = ((h << 5) + h) + (uint8_t)*uid++;
+    }
+    return _mix(h);
+}
+
+/* returns the index slot holding token or the empty slot it belongs to */
+static uint32_t *_set_slot(_pet_set_t *set, const uint8_t *token)
+{
+    uint32_t pos = _token_hash(token) & (INDEX_SIZE - 1);
+
+    while (set->index[pos]) {
+        _stats.probes++;
+        if (!memcmp(set->entries[set->index[pos] - 1].token, token, PET_SIZE)) {
+            break;
+        }
+        pos = (pos + 1) & (INDEX_SIZE - 1);
+    }
+    return &set->index[pos];
+}
+
+/* returns 1 if token is new and fits, 0 if already stored, -ENOMEM if full */
+static int _set_reserve(_pet_set_t *set, const uint8_t *token, uint32_t **slot)
+{
+    *slot = _set_slot(set, token);
+    if (**slot) {
+        return 0;
+    }
+    return set->count < CONFIG_PET_STORE_PETS_MAX ? 1 : -ENOMEM;
+}
+
+static uint32_t _set_insert(_pet_set_t *set, uint32_t *slot,
+                            const uint8_t *token, uint32_t owner)
+{
+    uint32_t entry = set->count++;
+
+    memcpy(set->entries[entry].token, token, PET_SIZE);
+    set->entries[entry].owner = owner;
+    set->entries[entry].next = NONE;
+    *slot = entry + 1;
+    return entry;
+}
+
+void pet_store_reset(void)
+{
+    /* entries are overwritten on insertion, only indexes need clearing */
+    memset(_ets.index, 0, sizeof(_ets.index));
+    memset(_rts.index, 0, sizeof(_rts.index));
+    memset(_device_index, 0, sizeof(_device_index));
+    _ets.count = 0;
+    _rts.count = 0;
+    _devices_numof = 0;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int pet_store_device(const char *uid, size_t uid_len)
+{
+    if (uid_len >= PET_STORE_UID_LEN) {
+        return -EINVAL;
+    }
+
+    uint32_t pos = _uid_hash(uid, uid_len) & (DEVICE_INDEX_SIZE - 1);
+
+    while (_device_index[pos]) {
+        _device_t *dev = &_devices[_device_index[pos] - 1];
+        if (!strncmp(dev->uid, uid, uid_len) && dev->uid[uid_len] == '\0') {
+            return _device_index[pos] - 1;
+        }
+        pos = (pos + 1) & (DEVICE_INDEX_SIZE - 1);
+    }
+    if (_devices_numof == CONFIG_PET_STORE_DEVICES_MAX) {
+        return -ENOMEM;
+    }
+
+    _device_t *dev = &_devices[_devices_numof];
+    memcpy(dev->uid, uid, uid_len);
+    dev->uid[uid_len] = '\0';
+    dev->infected = false;
+    dev->rt_head = NONE;
+    _device_index[pos] = ++_devices_numof;
+    return _devices_numof - 1;
+}
+
+int pet_store_add(int dev, const uint8_t *et, const uint8_t *rt)
+{
+    uint32_t *et_slot;
+    uint32_t *rt_slot;
+    int et_new = _set_reserve(&_ets, et, &et_slot);
+    int rt_new = _set_reserve(&_rts, rt, &rt_slot);
+
+    /* both tokens are checked first, a contact is never stored halfway */
+    if (et_new < 0 || rt_new < 0) {
+        return -ENOMEM;
+    }
+    if (et_new) {
+        _set_insert(&_ets, et_slot, et, dev);
+    }
+    else {
+        _stats.duplicates++;
+    }
+    if (rt_new) {
+        /* link the new RT to its owner */
+        uint32_t entry = _set_insert(&_rts, rt_slot, rt, dev);
+        _rts.entries[entry].next = _devices[dev].rt_head;
+        _devices[dev].rt_head = entry;
+    }
+    else {
+        _stats.duplicates++;
+    }
+    return 0;
+}
+
+void pet_store_set_infected(int dev, bool infected)
+{
+    _devices[dev].infected = infected;
+}
+
+bool pet_store_exposed(int dev)
+{
+    for (uint32_t rt = _devices[dev].rt_head; rt != NONE;
+         rt = _rts.entries[rt].next) {
+        uint32_t *slot = _set_slot(&_ets, _rts.entries[rt].token);
+        _stats.lookups++;
+        if (*slot && _devices[_ets.entries[*slot - 1].owner].infected) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void pet_store_stats(pet_store_stats_t *stats)
+{
+    *stats = _stats;
+    stats->devices = _devices_numof;
+    stats->ets = _ets.count;
+    stats->rts = _rts.count;
+    stats->infected = 0;
+    for (uint32_t i = 0; i < _devices_numof; i++) {
+        stats->infected += _devices[i].infected;
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Hash indexed PET store of the PEPPER backend stand-in
+ *
+ * Every uploaded contact holds an exposure token (ET) and a request token
+ * (RT), the RT of one side of an encounter being the ET of the other. ETs
+ * and RTs are kept in two open addressing hash sets, duplicates are ignored.
+ * A device is exposed if one of its RTs matches an ET uploaded by a device
+ * that declared itself infected, so answering an exposure status request
+ * only takes one ET lookup per RT of the device.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef PET_STORE_H
+#define PET_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crypto_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Maximum number of ETs, and of RTs, must be a power of two
+ */
+#ifndef CONFIG_PET_STORE_PETS_MAX
+#define CONFIG_PET_STORE_PETS_MAX       (1UL << 20)
+#endif
+
+/**
+ * @brief   Maximum number of devices, must be a power of two
+ */
+#ifndef CONFIG_PET_STORE_DEVICES_MAX
+#define CONFIG_PET_STORE_DEVICES_MAX    (1UL << 14)
+#endif
+
+/**
+ * @brief   Maximum device uid length, including the terminator
+ */
+#define PET_STORE_UID_LEN               (16U)
+
+/**
+ * @brief   Store statistics
+ */
+typedef struct {
+    uint32_t devices;       /**< known devices */
+    uint32_t infected;      /**< devices that declared themselves infected */
+    uint32_t ets;           /**< stored ETs */
+    uint32_t rts;           /**< stored RTs */
+    uint32_t duplicates;    /**< ignored duplicate tokens */
+    uint32_t probes;        /**< hash slots visited by lookups */
+    uint32_t lookups;       /**< ET lookups */
+} pet_store_stats_t;
+
+/**
+ * @brief   Empty the store
+ */
+void pet_store_reset(void);
+
+/**
+ * @brief   Get a device index, the device is created if unknown
+ *
+ * @param[in]   uid         the device uid
+ * @param[in]   uid_len     the uid length
+ *
+ * @return  the device index, <0 if the device table is full
+ */
+int pet_store_device(const char *uid, size_t uid_len);
+
+/**
+ * @brief   Store the tokens of a contact uploaded by a device
+ *
+ * @param[in]   dev         the device index
+ * @param[in]   et          the exposure token, PET_SIZE bytes
+ * @param[in]   rt          the request token, PET_SIZE bytes
+ *
+ * @return  0 on success, -ENOMEM if the store is full, then neither token is
+ *          stored
+ */
+int pet_store_add(int dev, const uint8_t *et, const uint8_t *rt);
+
+/**
+ * @brief   Update the infection status of a device
+ *
+ * @param[in]   dev         the device index
+ * @param[in]   infected    the infection status
+ */
+void pet_store_set_infected(int dev, bool infected);
+
+/**
+ * @brief   Intersect the RTs of a device with the ETs of infected devices
+ *
+ * @param[in]   dev         the device index
+ *
+ * @return  true if the device is exposed
+ */
+bool pet_store_exposed(int dev);
+
+/**
+ * @brief   Get store statistics
+ *
+ * @param[out]  stats       the statistics
+ */
+void pet_store_stats(pet_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PET_STORE_H */
+/** @} */
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import sys
+from testrunner import run
+
+TEST_DEVICES = 3
+BENCH_PETS = 4096
+BENCH_DEVICES = 8
+
+
+def testfunc(child):
+    # DWTEST0 and DWTEST1 met, DWTEST2 met no one
+    for i, contacts in enumerate((1, 1, 0)):
+        child.expect(r"DWTEST{} contacts=(-?\d+)".format(i))
+        assert int(child.match.group(1)) == contacts
+    # DWTEST0 is infected, then recovers
+    for infected in (1, 0):
+        for i in range(TEST_DEVICES):
+            child.expect(r"DWTEST{} infected=(\d) exposed=(\d)".format(i))
+            exposed = int(child.match.group(2))
+            assert int(child.match.group(1)) == (infected and i == 0)
+            assert exposed == (infected and i == 1), \
+                "DWTEST{} exposed={}".format(i, exposed)
+    child.expect_exact("[SUCCESS]")
+
+    # negative counts must not wrap around
+    for args in ("-1", "0", "{} 1".format(BENCH_PETS),
+                 "{} -8".format(BENCH_PETS), "{} x".format(BENCH_PETS)):
+        child.sendline("bench " + args)
+        child.expect_exact("usage: bench")
+    child.sendline("bench {} {}".format(BENCH_PETS, BENCH_DEVICES))
+    child.expect(r"pets=(\d+) ingest=(\d+) pets/s esr_avg=(\d+)us "
+                 r"esr_max=(\d+)us exposed=(\d+)/(\d+) probes/lookup=(\d+)")
+    pets, _, avg, max_us, exposed, devices, probes = \
+        map(int, child.match.groups())
+    assert pets >= BENCH_PETS and devices == BENCH_DEVICES
+    assert avg <= max_us
+    # the infected device met others and is not exposed itself
+    assert 0 < exposed < devices
+    assert probes >= 1
+    child.sendline("store")
+    child.expect(r"devices=(\d+) infected=(\d+) ets=(\d+) rts=(\d+) "
+                 r"duplicates=(\d+) ertls=(\d+)")
+    devices, infected, ets, rts, _, ertls = map(int, child.match.groups())
+    assert devices == BENCH_DEVICES
+    assert infected == BENCH_DEVICES // 100 + 1
+    # every contact stores the ET and the RT of one side
+    assert ets == rts and ets + rts == pets
+    assert ertls > TEST_DEVICES and (ertls - TEST_DEVICES) % devices == 0
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
@@ -0,0 +1,777 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Discrete event simulation of many PEPPER nodes in one process
+ *
+ * Every simulated node holds the per node state of the controller: keys, EBID,
+ * cid, encounter pool and list and epoch data. Time is virtual, the simulation
+ * jumps from one event to the next instead of waiting on ztimer: advertisements,
+ * TWR exchanges, mobility steps and epoch ends. Advertisements and ranging
+ * results go through the same processing as the controller callbacks and
+ * epochs are finished as the controller does.
+ *
+ * Nodes follow a random waypoint model. Encounters that were in range long
+ * enough are tracked for every pair of nodes, and at every epoch end compared
+ * to the encounters each node kept to compute its recall. Host CPU time spent
+ * in each module is measured with ztimer, only for reporting.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pepper.h"
+#include "pepper/pipeline.h"
+#include "random.h"
+#include "shell.h"
+#include "ztimer.h"
+
+/**
+ * @brief   Maximum number of simulated nodes
+ */
+#ifndef CONFIG_DES_NODES_MAX
+#define CONFIG_DES_NODES_MAX            (128U)
+#endif
+
+/**
+ * @brief   Maximum number of pending events
+ */
+#ifndef CONFIG_DES_EVENTS_MAX
+#define CONFIG_DES_EVENTS_MAX           (16384U)
+#endif
+
+/**
+ * @brief   BLE range in cm, advertisements loss increases with distance
+ */
+#ifndef CONFIG_DES_BLE_RANGE_CM
+#define CONFIG_DES_BLE_RANGE_CM         (1000U)
+#endif
+
+/**
+ * @brief   UWB range in cm, exchanges loss increases with distance
+ */
+#ifndef CONFIG_DES_UWB_RANGE_CM
+#define CONFIG_DES_UWB_RANGE_CM         (1000U)
+#endif
+
+/**
+ * @brief   Time the UWB radio is busy with a TWR exchange, in us
+ */
+#ifndef CONFIG_DES_TWR_DURATION_US
+#define CONFIG_DES_TWR_DURATION_US      (5000U)
+#endif
+
+/**
+ * @brief   Maximum time nodes pause at a waypoint, in s
+ */
+#ifndef CONFIG_DES_PAUSE_MAX_S
+#define CONFIG_DES_PAUSE_MAX_S          (600U)
+#endif
+
+#if CONFIG_DES_NODES_MAX > UINT8_MAX
+#error "CONFIG_DES_NODES_MAX must fit in a uint8_t"
+#endif
+
+/* every node has one pending advertisement, plus the move and epoch events,
+   only TWR events can be dropped */
+#define EVENTS_RESERVED         (CONFIG_DES_NODES_MAX + 2)
+
+static_assert(CONFIG_DES_EVENTS_MAX > EVENTS_RESERVED,
+              "CONFIG_DES_EVENTS_MAX leaves no room for TWR events");
+
+/* advertisements are delayed by up to 10ms, as BLE advDelay */
+#define ADV_DELAY_MAX_MS        (10U)
+#define MOVE_STEP_S             (1U)
+#define RANGING_NOISE_CM        (10)
+#define RSSI_NOISE_DBM          (4)
+/* rssi at 1m */
+#define RSSI_1M_DBM             (-59)
+/* short address without node */
+#define NODE_NONE               (UINT8_MAX)
+
+typedef enum {
+    _EVENT_ADV,                 /* node advertises */
+    _EVENT_TWR,                 /* node requests, peer listens */
+    _EVENT_MOVE,                /* all nodes move */
+    _EVENT_EPOCH,               /* all nodes end their epoch */
+} _event_type_t;
+
+#define TWR_REQ                 (0x01)  /* initiator requested */
+#define TWR_LST                 (0x02)  /* responder listened */
+
+typedef struct {
+    uint64_t time_us;           /* virtual time */
+    uint8_t type;               /* @ref _event_type_t */
+    uint8_t flags;              /* TWR_REQ and TWR_LST */
+    uint8_t node;               /* advertiser or initiator */
+    uint8_t peer;               /* responder */
+} _event_t;
+
+typedef enum {
+    _MODULE_SCAN,               /* pepper_pipeline_scan, EBID and ed_ble */
+    _MODULE_UWB,                /* ed_list_process_rng_data */
+    _MODULE_FINISH,             /* ed_list_finish */
+    _MODULE_EPOCH,              /* epoch_finish, PETs generation */
+    _MODULE_CRYPTO,             /* key pair generation */
+    _MODULE_SIM,                /* scheduling, mobility and propagation */
+    _MODULE_NUMOF,
+} _module_t;
+
+static const char *_module_names[_MODULE_NUMOF] = {
+    "scan", "ed_uwb", "ed_finish", "epoch", "crypto", "sim"
+};
+
+typedef struct {
+    unsigned nodes;             /* simulated nodes */
+    unsigned epochs;            /* simulated epochs */
+    unsigned area_cm;           /* side of the square nodes move in */
+    unsigned speed_cms;         /* walking speed, 0 for static nodes */
+    unsigned loss;              /* % of frames lost at any distance */
+    unsigned adv_itvl_ms;       /* advertisement interval */
+    unsigned epoch_s;           /* epoch duration */
+    unsigned backoff_s;         /* TWR backoff, as pepper_twr_set_backoff */
+} _des_params_t;
+
+typedef struct {
+    uint32_t advs;              /* advertisements sent */
+    uint32_t scans;             /* advertisements received */
+    uint32_t exhausted;         /* advertisements dropped, pool exhausted */
+    uint32_t twr_scheduled;     /* requests and listens scheduled */
+    uint32_t twr_ok;            /* requests and listens completed */
+    uint32_t twr_busy;          /* requests and listens aborted, radio busy */
+    uint32_t truth;             /* encounters in range long enough */
+    uint32_t found;             /* of which kept at the end of the epoch */
+    uint32_t contacts;          /* valid contacts over all epochs */
+    unsigned pool_min;          /* pool low watermark */
+} _node_stats_t;
+
+typedef struct {
+    crypto_manager_keys_t keys;
+    ebid_t ebid;
+    uint32_t cid;
+    uint32_t advs;
+    uint16_t seed;
+    desire_ble_adv_payload_t payload;
+    ed_memory_manager_t ed_mem;
+    ed_list_t ed_list;
+    epoch_data_t epoch;
+    int32_t x_cm;
+    int32_t y_cm;
+    int32_t to_x_cm;            /* next waypoint */
+    int32_t to_y_cm;
+    uint32_t pause_s;           /* remaining pause at the waypoint */
+    uint32_t scan_phase_ms;     /* scan windows are not aligned */
+    uint64_t uwb_busy_us;       /* end of ongoing TWR exchange */
+    _node_stats_t stats;
+} _node_t;
+
+static _node_t _nodes[CONFIG_DES_NODES_MAX];
+static _des_params_t _params;
+static uint64_t _now_us;
+static uint64_t _epoch_start_us;
+static uint32_t _epoch_idx;
+static uint32_t _overflow;
+static uint64_t _cpu_us[_MODULE_NUMOF];
+
+/* min heap of pending events */
+static _event_t _events[CONFIG_DES_EVENTS_MAX];
+static unsigned _events_numof;
+
+/* seconds each pair of nodes spent within MAX_DISTANCE_CM this epoch */
+static uint16_t _exposure_s[CONFIG_DES_NODES_MAX][CONFIG_DES_NODES_MAX];
+/* node currently using a TWR short address */
+static uint8_t _addr_node[UINT16_MAX + 1];
+/* TWR exchanges scheduled by the current advertisement */
+static uint8_t _twr_flags[CONFIG_DES_NODES_MAX];
+
+static void _event_push(uint64_t time_us, _event_type_t type, uint8_t node,
+                        uint8_t peer, uint8_t flags)
+{
+    if (type == _EVENT_TWR &&
+        _events_numof >= CONFIG_DES_EVENTS_MAX - EVENTS_RESERVED) {
+        _overflow++;
+        return;
+    }
+    /* control events always fit in the reserved slots */
+    assert(_events_numof < CONFIG_DES_EVENTS_MAX);
+    unsigned i = _events_numof++;
+    while (i > 0 && _events[(i - 1) / 2].time_us > time_us) {
+        _events[i] = _events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    _events[i] = (_event_t){ .time_us = time_us, .type = type, .node = node,
+                             .peer = peer, .flags = flags };
+}
+
+static _event_t _event_pop(void)
+{
+    _event_t first = _events[0];
+    _event_t last = _events[--_events_numof];
+    unsigned i = 0;
+
+    while (2 * i + 1 < _events_numof) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < _events_numof &&
+            _events[child + 1].time_us < _events[child].time_us) {
+            child++;
+        }
+        if (last.time_us <= _events[child].time_us) {
+            break;
+        }
+        _events[i] = _events[child];
+        i = child;
+    }
+    _events[i] = last;
+    return first;
+}
+
+static uint32_t _cpu_begin(void)
+{
+    return ztimer_now(ZTIMER_USEC);
+}
+
+static void _cpu_end(_module_t module, uint32_t start)
+{
+    _cpu_us[module] += ztimer_now(ZTIMER_USEC) - start;
+}
+
+static int _noise(int amplitude)
+{
+    return (int)random_uint32_range(0, 2 * amplitude + 1) - amplitude;
+}
+
+static uint16_t _distance_cm(const _node_t *a, const _node_t *b)
+{
+    float dx = a->x_cm - b->x_cm;
+    float dy = a->y_cm - b->y_cm;
+    float d = sqrtf(dx * dx + dy * dy);
+
+    return d > UINT16_MAX ? UINT16_MAX : (uint16_t)d;
+}
+
+static bool _lost(uint16_t d_cm, uint16_t range_cm)
+{
+    /* constant loss plus a loss growing with the squared distance */
+    uint32_t base = _params.loss * 10;
+    uint64_t d2 = (uint64_t)d_cm * d_cm;
+    uint64_t r2 = (uint64_t)range_cm * range_cm;
+    uint32_t loss = base + (1000 - base) * d2 / r2;
+
+    return random_uint32_range(0, 1000) < loss;
+}
+
+static int8_t _rssi(uint16_t d_cm)
+{
+    /* free space path loss, flat under 10cm */
+    float d_m = (d_cm < 10 ? 10 : d_cm) / 100.0f;
+
+    return RSSI_1M_DBM - (int)(20 * log10f(d_m)) + _noise(RSSI_NOISE_DBM);
+}
+
+static uint32_t _timestamp(void)
+{
+    /* relative to the start of the epoch, as pepper_sec_since_start */
+    return (_now_us - _epoch_start_us) / US_PER_SEC;
+}
+
+static uint16_t _twr_offset_ms(const ebid_t *ebid, uint16_t seed)
+{
+    /* same EBID based offset as the controller, both ends agree on it */
+    uint32_t offset_ms = (ebid->parts.ebid.u8[0] + (ebid->parts.ebid.u8[1] << 8)) ^ seed;
+
+    return (offset_ms % _params.adv_itvl_ms) + CONFIG_TWR_MIN_OFFSET_MS;
+}
+
+static void _node_slice_rotate(_node_t *n)
+{
+    uint8_t slice[EBID_SLICE_SIZE_LONG];
+    uint8_t slice_id = (n->advs / CONFIG_ADV_PER_SLICE) % EBID_PARTS;
+
+    if (slice_id == EBID_SLICE_3) {
+        /* the third slice is sent with front padding, as the advertiser does */
+        memset(slice, '\0', EBID_SLICE_SIZE_LONG - EBID_SLICE_SIZE_SHORT);
+        memcpy(slice + EBID_SLICE_SIZE_LONG - EBID_SLICE_SIZE_SHORT,
+               ebid_get_slice3(&n->ebid), EBID_SLICE_SIZE_SHORT);
+    }
+    else {
+        memcpy(slice, ebid_get_slice(&n->ebid, slice_id), EBID_SLICE_SIZE_LONG);
+    }
+    n->seed = n->advs;
+    desire_ble_adv_payload_build(&n->payload, slice_id, n->cid, slice, n->seed);
+}
+
+static void _waypoint_pick(_node_t *n)
+{
+    n->to_x_cm = random_uint32_range(0, _params.area_cm + 1);
+    n->to_y_cm = random_uint32_range(0, _params.area_cm + 1);
+}
+
+static void _node_epoch_start(uint8_t idx)
+{
+    _node_t *n = &_nodes[idx];
+    uint32_t start = _cpu_begin();
+
+    crypto_manager_gen_keypair(&n->keys);
+    _cpu_end(_MODULE_CRYPTO, start);
+    ebid_init(&n->ebid);
+    ebid_generate(&n->ebid, &n->keys);
+    /* TWR exchanges are matched on the cid lower 16 bits */
+    if (_addr_node[(uint16_t)n->cid] == idx) {
+        _addr_node[(uint16_t)n->cid] = NODE_NONE;
+    }
+    do {
+        n->cid = random_uint32() & MASK_CID;
+    } while (_addr_node[(uint16_t)n->cid] != NODE_NONE);
+    _addr_node[(uint16_t)n->cid] = idx;
+    n->advs = 0;
+    _node_slice_rotate(n);
+    epoch_init(&n->epoch, _epoch_idx * _params.epoch_s, &n->keys);
+    ed_list_init(&n->ed_list, &n->ed_mem, &n->ebid);
+    ed_list_set_min_exposure(&n->ed_list, _params.epoch_s / 3);
+}
+
+static void _node_init(uint8_t idx)
+{
+    _node_t *n = &_nodes[idx];
+
+    memset(n, '\0', sizeof(*n));
+    ed_memory_manager_init(&n->ed_mem);
+    n->stats.pool_min = CONFIG_ED_BUF_SIZE;
+    n->x_cm = random_uint32_range(0, _params.area_cm + 1);
+    n->y_cm = random_uint32_range(0, _params.area_cm + 1);
+    _waypoint_pick(n);
+    n->pause_s = random_uint32_range(0, CONFIG_DES_PAUSE_MAX_S + 1);
+    n->scan_phase_ms = random_uint32_range(0, CONFIG_BLE_SCAN_ITVL_MS);
+    /* start advertising at a random point of the interval */
+    _event_push(random_uint32_range(0, _params.adv_itvl_ms) * US_PER_MS,
+                _EVENT_ADV, idx, 0, 0);
+}
+
+static bool _node_scanning(const _node_t *n)
+{
+    uint32_t now_ms = _now_us / US_PER_MS + n->scan_phase_ms;
+
+    return now_ms % CONFIG_BLE_SCAN_ITVL_MS < CONFIG_BLE_SCAN_WIN_MS;
+}
+
+static void _node_scan(uint8_t idx, const _node_t *adv, int8_t rssi)
+{
+    _node_t *n = &_nodes[idx];
+    uint32_t timestamp = _timestamp();
+    uint32_t start = _cpu_begin();
+    ed_t *ed = pepper_pipeline_scan(&n->ed_list, timestamp, rssi, &adv->payload);
+
+    _cpu_end(_MODULE_SCAN, start);
+    n->stats.scans++;
+    if (ed == NULL) {
+        n->stats.exhausted++;
+        return;
+    }
+    unsigned available = memarray_available(&n->ed_mem.mem);
+    if (available < n->stats.pool_min) {
+        n->stats.pool_min = available;
+    }
+    /* as the controller scan callback, listen once the EBID is reconstructed */
+    if (ed->ebid.status.status == EBID_HAS_ALL &&
+        pepper_pipeline_twr_should_listen(ed, timestamp,
+                                          _params.backoff_s)) {
+        n->stats.twr_scheduled++;
+        _twr_flags[idx] |= TWR_LST;
+    }
+}
+
+static void _adv_handler(uint8_t idx)
+{
+    _node_t *n = &_nodes[idx];
+    uint32_t timestamp = _timestamp();
+
+    _event_push(_now_us + (_params.adv_itvl_ms +
+                           random_uint32_range(0, ADV_DELAY_MAX_MS)) * US_PER_MS,
+                _EVENT_ADV, idx, 0, 0);
+    n->stats.advs++;
+    memset(_twr_flags, '\0', sizeof(_twr_flags));
+
+    /* neighbours in range and scanning receive the advertisement */
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        if (i == idx || !_node_scanning(&_nodes[i])) {
+            continue;
+        }
+        uint16_t d_cm = _distance_cm(n, &_nodes[i]);
+        if (d_cm > CONFIG_DES_BLE_RANGE_CM || _lost(d_cm, CONFIG_DES_BLE_RANGE_CM)) {
+            continue;
+        }
+        _node_scan(i, n, _rssi(d_cm));
+    }
+
+    /* as the controller advertisement callback, request to recently seen
+       neighbours */
+    ed_t *next = (ed_t *)n->ed_list.list.next;
+    if (next) {
+        do {
+            next = (ed_t *)next->list_node.next;
+            uint8_t peer = _addr_node[ed_get_short_addr(next)];
+            if (peer != NODE_NONE &&
+                pepper_pipeline_twr_should_request(next, timestamp,
+                                                   _params.backoff_s)) {
+                n->stats.twr_scheduled++;
+                _twr_flags[peer] |= TWR_REQ;
+            }
+        } while (next != (ed_t *)n->ed_list.list.next);
+    }
+
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        if (_twr_flags[i]) {
+            uint16_t offset_ms = _twr_offset_ms(&_nodes[i].ebid, n->seed);
+            _event_push(_now_us + offset_ms * US_PER_MS, _EVENT_TWR, idx, i,
+                        _twr_flags[i]);
+        }
+    }
+
+    /* rotate payload if needed, this applies to next advertisement */
+    if (++n->advs % CONFIG_ADV_PER_SLICE == 0) {
+        _node_slice_rotate(n);
+    }
+}
+
+static void _node_range(_node_t *n, const _node_t *peer, uint16_t d_cm,
+                        bool responder)
+{
+    uint32_t timestamp = _timestamp();
+    int range = d_cm + _noise(RANGING_NOISE_CM);
+    uint32_t start = _cpu_begin();
+    ed_t *ed = ed_list_process_rng_data(&n->ed_list, (uint16_t)peer->cid,
+                                        timestamp, range < 0 ? 0 : range, 0,
+                                        _rssi(d_cm));
+
+    _cpu_end(_MODULE_UWB, start);
+    if (ed == NULL) {
+        return;
+    }
+    n->stats.twr_ok++;
+    if (responder) {
+        ed->uwb.seen_last_rx_s = timestamp;
+    }
+}
+
+static void _twr_handler(const _event_t *event)
+{
+    _node_t *init = &_nodes[event->node];
+    _node_t *resp = &_nodes[event->peer];
+
+    /* a request without listen, or a listen without request, times out */
+    if (event->flags != (TWR_REQ | TWR_LST)) {
+        return;
+    }
+    if (init->uwb_busy_us > _now_us || resp->uwb_busy_us > _now_us) {
+        init->stats.twr_busy++;
+        resp->stats.twr_busy++;
+        return;
+    }
+    init->uwb_busy_us = _now_us + CONFIG_DES_TWR_DURATION_US;
+    resp->uwb_busy_us = _now_us + CONFIG_DES_TWR_DURATION_US;
+    uint16_t d_cm = _distance_cm(init, resp);
+    if (d_cm > CONFIG_DES_UWB_RANGE_CM || _lost(d_cm, CONFIG_DES_UWB_RANGE_CM)) {
+        return;
+    }
+    _node_range(init, resp, d_cm, false);
+    _node_range(resp, init, d_cm, true);
+}
+
+static void _node_move(_node_t *n)
+{
+    if (n->pause_s) {
+        n->pause_s--;
+        return;
+    }
+    float dx = n->to_x_cm - n->x_cm;
+    float dy = n->to_y_cm - n->y_cm;
+    float d = sqrtf(dx * dx + dy * dy);
+    float step = _params.speed_cms * MOVE_STEP_S;
+
+    if (d <= step) {
+        n->x_cm = n->to_x_cm;
+        n->y_cm = n->to_y_cm;
+        n->pause_s = random_uint32_range(0, CONFIG_DES_PAUSE_MAX_S + 1);
+        _waypoint_pick(n);
+    }
+    else {
+        n->x_cm += (int32_t)(dx * step / d);
+        n->y_cm += (int32_t)(dy * step / d);
+    }
+}
+
+static void _move_handler(void)
+{
+    _event_push(_now_us + MOVE_STEP_S * US_PER_SEC, _EVENT_MOVE, 0, 0, 0);
+    if (_params.speed_cms) {
+        for (unsigned i = 0; i < _params.nodes; i++) {
+            _node_move(&_nodes[i]);
+        }
+    }
+    /* ground truth, only pairs with i < j are used */
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        for (unsigned j = i + 1; j < _params.nodes; j++) {
+            if (_distance_cm(&_nodes[i], &_nodes[j]) <= MAX_DISTANCE_CM) {
+                _exposure_s[i][j] += MOVE_STEP_S;
+            }
+        }
+    }
+}
+
+static bool _encounter(unsigned a, unsigned b)
+{
+    uint16_t exposure_s = a < b ? _exposure_s[a][b] : _exposure_s[b][a];
+
+    return exposure_s >= _params.epoch_s / 3;
+}
+
+static void _node_epoch_end(uint8_t idx)
+{
+    _node_t *n = &_nodes[idx];
+    uint32_t start = _cpu_begin();
+
+    /* same end of epoch processing as the controller */
+    ed_list_finish(&n->ed_list);
+    _cpu_end(_MODULE_FINISH, start);
+
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        if (i != idx && _encounter(idx, i)) {
+            n->stats.truth++;
+        }
+    }
+    ed_t *next = (ed_t *)n->ed_list.list.next;
+    if (next) {
+        do {
+            next = (ed_t *)next->list_node.next;
+            uint8_t peer = _addr_node[ed_get_short_addr(next)];
+            if (peer != NODE_NONE && _encounter(idx, peer)) {
+                n->stats.found++;
+            }
+        } while (next != (ed_t *)n->ed_list.list.next);
+    }
+
+    start = _cpu_begin();
+    epoch_finish(&n->epoch, &n->ed_list);
+    _cpu_end(_MODULE_EPOCH, start);
+    n->stats.contacts += epoch_contacts(&n->epoch);
+}
+
+static void _epoch_handler(void)
+{
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        _node_epoch_end(i);
+    }
+    memset(_exposure_s, '\0', sizeof(_exposure_s));
+    _epoch_idx++;
+    _epoch_start_us = _now_us;
+    if (_epoch_idx == _params.epochs) {
+        return;
+    }
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        _node_epoch_start(i);
+    }
+    _event_push(_now_us + _params.epoch_s * US_PER_SEC, _EVENT_EPOCH, 0, 0, 0);
+}
+
+static uint64_t _des_run(const _des_params_t *params)
+{
+    uint32_t start = _cpu_begin();
+    uint64_t real_us = 0;
+
+    _params = *params;
+    _now_us = 0;
+    _epoch_start_us = 0;
+    _epoch_idx = 0;
+    _overflow = 0;
+    _events_numof = 0;
+    memset(_cpu_us, '\0', sizeof(_cpu_us));
+    memset(_exposure_s, '\0', sizeof(_exposure_s));
+    memset(_addr_node, NODE_NONE, sizeof(_addr_node));
+
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        _node_init(i);
+        _node_epoch_start(i);
+    }
+    _event_push(0, _EVENT_MOVE, 0, 0, 0);
+    _event_push((uint64_t)_params.epoch_s * US_PER_SEC, _EVENT_EPOCH, 0, 0, 0);
+
+    while (_epoch_idx < _params.epochs && _events_numof) {
+        _event_t event = _event_pop();
+        _now_us = event.time_us;
+        switch (event.type) {
+        case _EVENT_ADV:
+            _adv_handler(event.node);
+            break;
+        case _EVENT_TWR:
+            _twr_handler(&event);
+            break;
+        case _EVENT_MOVE:
+            _move_handler();
+            break;
+        case _EVENT_EPOCH:
+            _epoch_handler();
+            break;
+        }
+        /* accumulate before the 32 bit us timer wraps */
+        uint32_t now = _cpu_begin();
+        real_us += now - start;
+        start = now;
+    }
+
+    /* whatever was not spent in a module was spent simulating */
+    _cpu_us[_MODULE_SIM] = real_us;
+    for (unsigned i = 0; i < _MODULE_SIM; i++) {
+        _cpu_us[_MODULE_SIM] -= _cpu_us[i];
+    }
+    return real_us;
+}
+
+static void _des_print(uint64_t real_us)
+{
+    _node_stats_t total = { .pool_min = CONFIG_ED_BUF_SIZE };
+    uint64_t sim_ms = (uint64_t)_params.epochs * _params.epoch_s * MS_PER_SEC;
+
+    for (unsigned i = 0; i < _params.nodes; i++) {
+        const _node_stats_t *s = &_nodes[i].stats;
+        printf("node=%u recall=%" PRIu32 "/%" PRIu32 " twr=%" PRIu32 "/%" PRIu32
+               " busy=%" PRIu32 " advs=%" PRIu32 " scans=%" PRIu32
+               " exhausted=%" PRIu32 " pool_min=%u contacts=%" PRIu32 "\n",
+               i, s->found, s->truth, s->twr_ok, s->twr_scheduled, s->twr_busy,
+               s->advs, s->scans, s->exhausted, s->pool_min, s->contacts);
+        total.found += s->found;
+        total.truth += s->truth;
+        total.twr_ok += s->twr_ok;
+        total.twr_scheduled += s->twr_scheduled;
+        total.exhausted += s->exhausted;
+        if (s->pool_min < total.pool_min) {
+            total.pool_min = s->pool_min;
+        }
+    }
+    printf("nodes=%u simulated=%" PRIu32 "s real=%" PRIu32 "ms speedup=%" PRIu32
+           " recall=%" PRIu32 "/%" PRIu32 " twr=%" PRIu32 "/%" PRIu32
+           " exhausted=%" PRIu32 " pool_min=%u overflow=%" PRIu32 "\n",
+           _params.nodes, (uint32_t)(sim_ms / MS_PER_SEC),
+           (uint32_t)(real_us / US_PER_MS),
+           real_us ? (uint32_t)(sim_ms * US_PER_MS / real_us) : 0,
+           total.found, total.truth, total.twr_ok, total.twr_scheduled,
+           total.exhausted, total.pool_min, _overflow);
+    printf("cpu");
+    for (unsigned i = 0; i < _MODULE_NUMOF; i++) {
+        printf(" %s=%" PRIu32 "us", _module_names[i], (uint32_t)_cpu_us[i]);
+    }
+    puts("");
+}
+
+/* strtoul silently wraps negative values around, reject them */
+static int _parse_uint(const char *arg, unsigned *val)
+{
+    char *end;
+
+    if (*arg == '-') {
+        return -1;
+    }
+    errno = 0;
+    unsigned long res = strtoul(arg, &end, 0);
+
+    if (end == arg || *end != '\0' || errno || res > UINT_MAX) {
+        return -1;
+    }
+    *val = res;
+    return 0;
+}
+
+static int _cmd_des(int argc, char **argv)
+{
+    _des_params_t params = {
+        .nodes = 100,
+        .epochs = 1,
+        .area_cm = 2000,
+        .speed_cms = 50,
+        .loss = 0,
+        .adv_itvl_ms = 1000,
+        .epoch_s = CONFIG_EPOCH_DURATION_SEC,
+        .backoff_s = CONFIG_PEPPER_TWR_BACK_OFF_S,
+    };
+    unsigned *args[] = {
+        &params.nodes, &params.epochs, &params.area_cm, &params.speed_cms,
+        &params.loss, &params.adv_itvl_ms, &params.epoch_s, &params.backoff_s
+    };
+    bool valid = true;
+
+    for (int i = 1; i < argc && i <= (int)ARRAY_SIZE(args); i++) {
+        valid &= !_parse_uint(argv[i], args[i - 1]);
+    }
+    if (!valid || params.nodes < 2 || params.nodes > CONFIG_DES_NODES_MAX ||
+        params.epochs == 0 || params.area_cm == 0 || params.loss > 100 ||
+        params.adv_itvl_ms == 0 || params.epoch_s < 3 ||
+        params.epoch_s > UINT16_MAX || params.backoff_s > UINT16_MAX) {
+        printf("usage: %s [nodes <= %u] [epochs] [area cm] [speed cm/s] "
+               "[loss %%] [adv itvl ms] [epoch s] [twr backoff s]\n",
+               argv[0], CONFIG_DES_NODES_MAX);
+        return -1;
+    }
+    _des_print(_des_run(&params));
+    return 0;
+}
+
+static const shell_command_t _commands[] = {
+    { "des", "simulate PEPPER nodes in virtual time", _cmd_des },
+    { NULL, NULL, NULL }
+};
+
+#define SELF_TEST_NODES     (4U)
+
+/* close static nodes must all find each other, faster than real time */
+static int _self_test(void)
+{
+    _des_params_t params = {
+        .nodes = SELF_TEST_NODES,
+        .epochs = 1,
+        .area_cm = MAX_DISTANCE_CM / 2,
+        .speed_cms = 0,
+        .loss = 0,
+        .adv_itvl_ms = 1000,
+        .epoch_s = CONFIG_EPOCH_DURATION_SEC,
+        .backoff_s = CONFIG_PEPPER_TWR_BACK_OFF_S,
+    };
+    uint64_t real_us = _des_run(&params);
+    bool ok = real_us < (uint64_t)params.epoch_s * US_PER_SEC && !_overflow;
+
+    _des_print(real_us);
+    for (unsigned i = 0; i < params.nodes; i++) {
+        const _node_stats_t *s = &_nodes[i].stats;
+        ok &= s->truth == SELF_TEST_NODES - 1 && s->found == s->truth;
+        ok &= s->twr_ok > 0 && s->exhausted == 0;
+    }
+    return ok ? 0 : -1;
+}
+
+int main(void)
+{
+    char line_buf[SHELL_DEFAULT_BUFSIZE];
+
+    puts(_self_test() ? "[FAILED]" : "[SUCCESS]");
+
+    shell_run(_commands, line_buf, SHELL_DEFAULT_BUFSIZE);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import sys
+from testrunner import run
+
+SELF_TEST_NODES = 4
+NODE = (r"node=(\d+) recall=(\d+)/(\d+) twr=(\d+)/(\d+) busy=(\d+) "
+        r"advs=(\d+) scans=(\d+) exhausted=(\d+) pool_min=(\d+) "
+        r"contacts=(\d+)")
+SUMMARY = (r"nodes=(\d+) simulated=(\d+)s real=(\d+)ms speedup=(\d+) "
+           r"recall=(\d+)/(\d+) twr=(\d+)/(\d+) exhausted=(\d+) "
+           r"pool_min=(\d+) overflow=(\d+)")
+
+
+def expect_des(child, nodes):
+    stats = []
+    for i in range(nodes):
+        child.expect(NODE)
+        node, found, truth, twr_ok, twr_sched, _, _, _, exhausted, \
+            pool_min, _ = map(int, child.match.groups())
+        assert node == i
+        assert found <= truth and twr_ok <= twr_sched
+        stats.append((found, truth, twr_ok, twr_sched, exhausted, pool_min))
+    child.expect(SUMMARY)
+    numof, simulated, real, _, found, truth, twr_ok, twr_sched, exhausted, \
+        pool_min, overflow = map(int, child.match.groups())
+    assert numof == nodes
+    # the summary adds up the nodes
+    assert found == sum(s[0] for s in stats)
+    assert truth == sum(s[1] for s in stats)
+    assert twr_ok == sum(s[2] for s in stats)
+    assert twr_sched == sum(s[3] for s in stats)
+    assert exhausted == sum(s[4] for s in stats)
+    assert pool_min == min(s[5] for s in stats)
+    assert overflow == 0, "events dropped"
+    child.expect(r"cpu scan=(\d+)us ed_uwb=(\d+)us ed_finish=(\d+)us "
+                 r"epoch=(\d+)us crypto=(\d+)us sim=(\d+)us")
+    return stats, simulated, real
+
+
+def testfunc(child):
+    stats, simulated, real = expect_des(child, SELF_TEST_NODES)
+    # close static nodes all keep each other as encounters
+    for found, truth, twr_ok, _, exhausted, _ in stats:
+        assert truth == SELF_TEST_NODES - 1 and found == truth
+        assert twr_ok > 0 and exhausted == 0
+    assert real < simulated * 1000, "slower than real time"
+    child.expect_exact("[SUCCESS]")
+
+    # negative values must not wrap around
+    for args in ("-1", "1", "4 -1", "4 1 2000 50 101", "4 1 2000 50 0 1000 2",
+                 "4 x"):
+        child.sendline("des " + args)
+        child.expect_exact("usage: des")
+    child.sendline("des 8 2 1000 20 10 1000 60")
+    _, simulated, _ = expect_des(child, 8)
+    assert simulated == 2 * 60
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
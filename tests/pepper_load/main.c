@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Synthetic load generator for the PEPPER encounter pipeline
+ *
+ * Simulated neighbours advertise their EBID slices as DESIRE advertisements
+ * would, with configurable loss and an RSSI trace following a random walk of
+ * their distance. Advertisements go through the same scan processing as the
+ * controller scan callback, ranging results through the same encounter list
+ * call as the controller TWR callback. Every simulated epoch is then finished
+ * as the controller does and processing rate, drops, pool exhaustion and end
+ * of epoch time are reported.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pepper.h"
+#include "pepper/pipeline.h"
+#include "random.h"
+#include "shell.h"
+#include "ztimer.h"
+
+/**
+ * @brief   Maximum number of simulated neighbours
+ */
+#ifndef CONFIG_LOAD_NEIGHBOURS_MAX
+#define CONFIG_LOAD_NEIGHBOURS_MAX      (256U)
+#endif
+
+/* advertisements are delayed by up to 10ms, as BLE advDelay */
+#define ADV_DELAY_MAX_MS        (10U)
+/* simulated neighbours stay within that range */
+#define DISTANCE_MIN_CM         (20U)
+#define RANGING_NOISE_CM        (10)
+#define RSSI_NOISE_DBM          (4)
+/* rssi at 1m */
+#define RSSI_1M_DBM             (-59)
+
+typedef struct {
+    unsigned neighbours;        /* simulated neighbours */
+    unsigned adv_itvl_ms;       /* advertisement interval of each neighbour */
+    unsigned loss;              /* % of advertisements and ranging lost */
+    unsigned rng;               /* % of received advertisements followed by
+                                   a ranging exchange */
+    unsigned d_max_cm;          /* maximum neighbour distance */
+    unsigned epoch_s;           /* simulated epoch duration */
+} _load_params_t;
+
+typedef struct {
+    uint32_t advs;              /* advertisements fed */
+    uint32_t rngs;              /* ranging results fed */
+    uint32_t lost;              /* advertisements and ranging lost */
+    uint32_t exhausted;         /* advertisements dropped, pool exhausted */
+    uint32_t rng_dropped;       /* ranging results without encounter */
+    uint32_t busy_us;           /* time spent processing events */
+    uint32_t finish_us;         /* end of epoch processing time */
+    unsigned pool_min;          /* pool low watermark */
+    unsigned contacts;          /* valid contacts */
+} _load_stats_t;
+
+typedef struct {
+    ebid_t ebid;
+    uint32_t cid;
+    uint16_t d_cm;
+    uint16_t advs;
+} _neighbour_t;
+
+static _neighbour_t _neighbours[CONFIG_LOAD_NEIGHBOURS_MAX];
+static ed_memory_manager_t _ed_mem;
+static ed_list_t _ed_list;
+static ebid_t _ebid;
+static crypto_manager_keys_t _keys;
+static epoch_data_t _epoch;
+
+static void _neighbours_init(unsigned numof, unsigned d_max_cm)
+{
+    uint8_t pk[EBID_SIZE];
+
+    for (unsigned i = 0; i < numof; i++) {
+        _neighbour_t *n = &_neighbours[i];
+        ebid_init(&n->ebid);
+        random_bytes(pk, sizeof(pk));
+        ebid_generate_from_pk(&n->ebid, pk);
+        /* ranging results are matched on the cid lower 16 bits */
+        bool unique;
+        do {
+            n->cid = random_uint32() & MASK_CID;
+            unique = true;
+            for (unsigned j = 0; j < i; j++) {
+                unique &= (uint16_t)_neighbours[j].cid != (uint16_t)n->cid;
+            }
+        } while (!unique);
+        n->d_cm = random_uint32_range(DISTANCE_MIN_CM, d_max_cm + 1);
+        /* neighbours do not start advertising on the same slice */
+        n->advs = random_uint32_range(0, EBID_PARTS);
+    }
+}
+
+static bool _lost(unsigned loss)
+{
+    return random_uint32_range(0, 100) < loss;
+}
+
+static int _noise(int amplitude)
+{
+    return (int)random_uint32_range(0, 2 * amplitude + 1) - amplitude;
+}
+
+static void _neighbour_move(_neighbour_t *n, unsigned d_max_cm)
+{
+    int d_cm = n->d_cm + _noise(RANGING_NOISE_CM);
+
+    if (d_cm < (int)DISTANCE_MIN_CM) {
+        d_cm = DISTANCE_MIN_CM;
+    }
+    if (d_cm > (int)d_max_cm) {
+        d_cm = d_max_cm;
+    }
+    n->d_cm = d_cm;
+}
+
+static int8_t _neighbour_rssi(_neighbour_t *n)
+{
+    /* free space path loss */
+    return RSSI_1M_DBM - (int)(20 * log10f(n->d_cm / 100.0f)) +
+           _noise(RSSI_NOISE_DBM);
+}
+
+static void _neighbour_adv(_neighbour_t *n, desire_ble_adv_payload_t *payload)
+{
+    uint8_t slice[EBID_SLICE_SIZE_LONG];
+    uint8_t slice_id = n->advs++ % EBID_PARTS;
+
+    if (slice_id == EBID_SLICE_3) {
+        /* the third slice is sent with front padding, as the advertiser does */
+        memset(slice, '\0', EBID_SLICE_SIZE_LONG - EBID_SLICE_SIZE_SHORT);
+        memcpy(slice + EBID_SLICE_SIZE_LONG - EBID_SLICE_SIZE_SHORT,
+               ebid_get_slice3(&n->ebid), EBID_SLICE_SIZE_SHORT);
+    }
+    else {
+        memcpy(slice, ebid_get_slice(&n->ebid, slice_id), EBID_SLICE_SIZE_LONG);
+    }
+    desire_ble_adv_payload_build(payload, slice_id, n->cid, slice, n->advs);
+}
+
+static void _epoch_run(const _load_params_t *params, _load_stats_t *stats)
+{
+    desire_ble_adv_payload_t payload;
+    uint32_t rounds = params->epoch_s * MS_PER_SEC / params->adv_itvl_ms;
+
+    memset(stats, '\0', sizeof(*stats));
+    stats->pool_min = CONFIG_ED_BUF_SIZE;
+    epoch_init(&_epoch, 0, &_keys);
+    ed_list_init(&_ed_list, &_ed_mem, &_ebid);
+    ed_list_set_min_exposure(&_ed_list, params->epoch_s / 3);
+
+    /* every neighbour advertises once per round */
+    for (uint32_t round = 0; round < rounds; round++) {
+        uint32_t round_ms = round * params->adv_itvl_ms;
+        for (unsigned i = 0; i < params->neighbours; i++) {
+            _neighbour_t *n = &_neighbours[i];
+            uint32_t timestamp = (round_ms +
+                                  random_uint32_range(0, ADV_DELAY_MAX_MS)) /
+                                 MS_PER_SEC;
+            _neighbour_move(n, params->d_max_cm);
+            _neighbour_adv(n, &payload);
+            stats->advs++;
+            if (_lost(params->loss)) {
+                stats->lost++;
+                continue;
+            }
+            int8_t rssi = _neighbour_rssi(n);
+            uint32_t start = ztimer_now(ZTIMER_USEC);
+            ed_t *ed = pepper_pipeline_scan(&_ed_list, timestamp, rssi, &payload);
+            stats->busy_us += ztimer_now(ZTIMER_USEC) - start;
+            if (ed == NULL) {
+                stats->exhausted++;
+                continue;
+            }
+            unsigned available = memarray_available(&_ed_mem.mem);
+            if (available < stats->pool_min) {
+                stats->pool_min = available;
+            }
+            /* the controller only ranges with reconstructed EBIDs */
+            if (ed->ebid.status.status != EBID_HAS_ALL ||
+                random_uint32_range(0, 100) >= params->rng) {
+                continue;
+            }
+            stats->rngs++;
+            if (_lost(params->loss)) {
+                stats->lost++;
+                continue;
+            }
+            uint16_t d_cm = n->d_cm + _noise(RANGING_NOISE_CM);
+            start = ztimer_now(ZTIMER_USEC);
+            ed = ed_list_process_rng_data(&_ed_list, ed_get_short_addr(ed),
+                                          timestamp, d_cm, 0, rssi);
+            stats->busy_us += ztimer_now(ZTIMER_USEC) - start;
+            if (ed == NULL) {
+                stats->rng_dropped++;
+            }
+        }
+    }
+
+    /* same end of epoch processing as the controller */
+    uint32_t start = ztimer_now(ZTIMER_USEC);
+    ed_list_finish(&_ed_list);
+    epoch_finish(&_epoch, &_ed_list);
+    stats->finish_us = ztimer_now(ZTIMER_USEC) - start;
+    stats->contacts = epoch_contacts(&_epoch);
+}
+
+static void _stats_print(unsigned epoch, const _load_stats_t *stats)
+{
+    uint32_t events = stats->advs + stats->rngs - stats->lost -
+                      stats->exhausted - stats->rng_dropped;
+    uint32_t rate = stats->busy_us ?
+                    (uint64_t)events * US_PER_SEC / stats->busy_us : 0;
+
+    printf("epoch=%u events/s=%" PRIu32 " advs=%" PRIu32 " rngs=%" PRIu32
+           " lost=%" PRIu32 " exhausted=%" PRIu32 " rng_dropped=%" PRIu32
+           " pool_min=%u finish=%" PRIu32 "us contacts=%u\n",
+           epoch, rate, stats->advs, stats->rngs, stats->lost,
+           stats->exhausted, stats->rng_dropped, stats->pool_min,
+           stats->finish_us, stats->contacts);
+}
+
+/* strtoul silently wraps negative values around, reject them */
+static int _parse_uint(const char *arg, unsigned *val)
+{
+    char *end;
+
+    if (*arg == '-') {
+        return -1;
+    }
+    errno = 0;
+    unsigned long res = strtoul(arg, &end, 0);
+
+    if (end == arg || *end != '\0' || errno || res > UINT_MAX) {
+        return -1;
+    }
+    *val = res;
+    return 0;
+}
+
+static int _cmd_load(int argc, char **argv)
+{
+    _load_params_t params = {
+        .neighbours = 8,
+        .adv_itvl_ms = 1000,
+        .loss = 0,
+        .rng = 100,
+        .d_max_cm = 150,
+        .epoch_s = 60,
+    };
+    _load_stats_t stats;
+    unsigned epochs = 1;
+    unsigned *args[] = {
+        &params.neighbours, &params.adv_itvl_ms, &params.loss, &params.rng,
+        &params.d_max_cm, &params.epoch_s, &epochs
+    };
+    bool valid = true;
+
+    for (int i = 1; i < argc && i <= (int)ARRAY_SIZE(args); i++) {
+        valid &= !_parse_uint(argv[i], args[i - 1]);
+    }
+    /* rounds are counted from the epoch duration in ms */
+    if (!valid || params.neighbours == 0 ||
+        params.neighbours > CONFIG_LOAD_NEIGHBOURS_MAX ||
+        params.adv_itvl_ms == 0 || params.loss > 100 || params.rng > 100 ||
+        params.d_max_cm < DISTANCE_MIN_CM || params.epoch_s == 0 ||
+        params.epoch_s > UINT32_MAX / MS_PER_SEC || epochs == 0) {
+        printf("usage: %s [neighbours <= %u] [adv itvl ms] [loss %%] "
+               "[ranging %%] [max distance cm] [epoch s] [epochs]\n",
+               argv[0], CONFIG_LOAD_NEIGHBOURS_MAX);
+        return -1;
+    }
+    for (unsigned i = 0; i < epochs; i++) {
+        /* neighbours change their EBID and cid every epoch */
+        _neighbours_init(params.neighbours, params.d_max_cm);
+        _epoch_run(&params, &stats);
+        _stats_print(i, &stats);
+    }
+    return 0;
+}
+
+static const shell_command_t _commands[] = {
+    { "load", "feed synthetic encounters through the pepper pipeline", _cmd_load },
+    { NULL, NULL, NULL }
+};
+
+#define SELF_TEST_CONTACTS  (CONFIG_ED_BUF_SIZE < CONFIG_EPOCH_MAX_ENCOUNTERS ? \
+                             CONFIG_ED_BUF_SIZE : CONFIG_EPOCH_MAX_ENCOUNTERS)
+
+/* all close neighbours become contacts, extra neighbours exhaust the pool */
+static int _self_test(void)
+{
+    _load_params_t params = {
+        .neighbours = SELF_TEST_CONTACTS,
+        .adv_itvl_ms = 1000,
+        .loss = 0,
+        .rng = 100,
+        .d_max_cm = MAX_DISTANCE_CM / 2,
+        .epoch_s = 60,
+    };
+    _load_stats_t stats;
+    bool ok = true;
+
+    _neighbours_init(params.neighbours, params.d_max_cm);
+    _epoch_run(&params, &stats);
+    _stats_print(0, &stats);
+    ok &= stats.exhausted == 0 && stats.rng_dropped == 0;
+    ok &= stats.contacts == SELF_TEST_CONTACTS;
+
+    params.neighbours = CONFIG_ED_BUF_SIZE + 1;
+    _neighbours_init(params.neighbours, params.d_max_cm);
+    _epoch_run(&params, &stats);
+    _stats_print(1, &stats);
+    ok &= stats.exhausted > 0 && stats.pool_min == 0;
+    ok &= stats.contacts == SELF_TEST_CONTACTS;
+    return ok ? 0 : -1;
+}
+
+int main(void)
+{
+    char line_buf[SHELL_DEFAULT_BUFSIZE];
+
+    ed_memory_manager_init(&_ed_mem);
+    ebid_init(&_ebid);
+
+    puts(_self_test() ? "[FAILED]" : "[SUCCESS]");
+
+    shell_run(_commands, line_buf, SHELL_DEFAULT_BUFSIZE);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import sys
+from testrunner import run
+
+STATS = (r"epoch=(\d+) events/s=(\d+) advs=(\d+) rngs=(\d+) lost=(\d+) "
+         r"exhausted=(\d+) rng_dropped=(\d+) pool_min=(\d+) "
+         r"finish=(\d+)us contacts=(\d+)")
+SELF_TEST_EPOCH_S = 60
+
+
+def expect_stats(child, epoch):
+    child.expect(STATS)
+    stats = list(map(int, child.match.groups()))
+    assert stats[0] == epoch
+    return dict(zip(("advs", "rngs", "lost", "exhausted", "rng_dropped",
+                     "pool_min", "finish", "contacts"), stats[2:]))
+
+
+def testfunc(child):
+    # all close neighbours become contacts
+    first = expect_stats(child, 0)
+    assert first["contacts"] > 0
+    assert first["advs"] == first["contacts"] * SELF_TEST_EPOCH_S
+    assert first["lost"] == 0
+    assert first["exhausted"] == 0 and first["rng_dropped"] == 0
+    # one neighbour more than the pool exhausts it, contacts are kept
+    second = expect_stats(child, 1)
+    assert second["exhausted"] > 0 and second["pool_min"] == 0
+    assert second["contacts"] == first["contacts"]
+    child.expect_exact("[SUCCESS]")
+
+    # negative values must not wrap around
+    for args in ("-1", "0", "4 0", "4 1000 101", "4 1000 0 100 150 -60",
+                 "4 1000 0 100 150 60 0", "4 x"):
+        child.sendline("load " + args)
+        child.expect_exact("usage: load")
+    child.sendline("load 4 500 0 100 150 30 3")
+    for epoch in range(3):
+        stats = expect_stats(child, epoch)
+        assert stats["advs"] == 4 * 30 * 1000 // 500
+        assert stats["rngs"] <= stats["advs"]
+        assert stats["lost"] == 0 and stats["exhausted"] == 0
+        assert stats["contacts"] <= 4
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       pepper_srv_async test, a blocked endpoint must not delay the
+ *              others
+ *
+ * Two endpoints receive the same uwb samples: the slow one has a worker of
+ * its own and blocks until released, the fast one runs on the shared worker.
+ * While the slow endpoint is blocked the fast one must receive every sample,
+ * and the slow one must only keep @ref CONFIG_PEPPER_SRV_ASYNC_BACKLOG
+ * samples and count the others as dropped.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "event/thread.h"
+#include "mutex.h"
+#include "thread.h"
+#include "xfa.h"
+#include "ztimer.h"
+
+#include "pepper_srv.h"
+#include "pepper_srv_async.h"
+
+/* let the workers run, they have a lower priority than main */
+#define SETTLE_MS           (50U)
+/* samples pushed at once, fits in the fast endpoint backlog */
+#define CHUNK               (CONFIG_PEPPER_SRV_ASYNC_BACKLOG / 2)
+#define CHUNKS              (5U)
+
+XFA_USE_CONST(pepper_srv_endpoint_t, pepper_srv_endpoints);
+
+static mutex_t _slow_lock = MUTEX_INIT_LOCKED;
+static unsigned _slow_received;
+static unsigned _fast_received;
+static char _slow_stack[THREAD_STACKSIZE_DEFAULT];
+
+static int _init(event_queue_t *queue)
+{
+    (void)queue;
+    return 0;
+}
+
+static int _slow_notify_uwb_data(ed_uwb_data_t *data, size_t len)
+{
+    (void)data;
+    mutex_lock(&_slow_lock);
+    _slow_received += len;
+    mutex_unlock(&_slow_lock);
+    return 0;
+}
+
+static int _fast_notify_uwb_data(ed_uwb_data_t *data, size_t len)
+{
+    (void)data;
+    _fast_received += len;
+    return 0;
+}
+
+XFA_CONST(pepper_srv_endpoints, 0) pepper_srv_endpoint_t _slow = {
+    .init = _init,
+    .notify_uwb_data = _slow_notify_uwb_data,
+    .stack = _slow_stack,
+    .stacksize = sizeof(_slow_stack),
+};
+
+XFA_CONST(pepper_srv_endpoints, 0) pepper_srv_endpoint_t _fast = {
+    .init = _init,
+    .notify_uwb_data = _fast_notify_uwb_data,
+};
+
+static int _endpoint_idx(const pepper_srv_endpoint_t *endpoint)
+{
+    for (unsigned i = 0; i < XFA_LEN(pepper_srv_endpoint_t, pepper_srv_endpoints); i++) {
+        if (&pepper_srv_endpoints[i] == endpoint) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void _push(unsigned count)
+{
+    ed_uwb_data_t sample;
+
+    memset(&sample, '\0', sizeof(sample));
+    for (unsigned i = 0; i < count; i++) {
+        pepper_srv_notify_uwb_data(&sample, 1);
+    }
+}
+
+int main(void)
+{
+    pepper_srv_endpoint_stats_t slow;
+    pepper_srv_endpoint_stats_t fast;
+    unsigned pushed = 0;
+
+    pepper_srv_init(EVENT_PRIO_MEDIUM);
+
+    /* the slow endpoint blocks on the first batch */
+    for (unsigned i = 0; i < CHUNKS; i++) {
+        _push(CHUNK);
+        pushed += CHUNK;
+        ztimer_sleep(ZTIMER_MSEC, SETTLE_MS);
+    }
+    unsigned fast_blocked = _fast_received;
+    pepper_srv_endpoint_stats(_endpoint_idx(&_slow), &slow);
+    printf("blocked: pushed=%u backlog=%u fast=%u slow=%u slow_dropped=%" PRIu32 "\n",
+           pushed, CONFIG_PEPPER_SRV_ASYNC_BACKLOG, fast_blocked,
+           _slow_received, slow.dropped);
+
+    /* release it, it handles its backlog */
+    mutex_unlock(&_slow_lock);
+    ztimer_sleep(ZTIMER_MSEC, SETTLE_MS);
+    pepper_srv_endpoint_stats(_endpoint_idx(&_slow), &slow);
+    pepper_srv_endpoint_stats(_endpoint_idx(&_fast), &fast);
+    printf("released: fast=%u fast_dropped=%" PRIu32 " slow=%u slow_dropped=%"
+           PRIu32 "\n", _fast_received, fast.dropped, _slow_received,
+           slow.dropped);
+    pepper_srv_print_stats();
+
+    bool ok = fast_blocked == pushed && fast.dropped == 0 &&
+              _slow_received == CONFIG_PEPPER_SRV_ASYNC_BACKLOG &&
+              slow.dropped == pushed - CONFIG_PEPPER_SRV_ASYNC_BACKLOG;
+    puts(ok ? "[SUCCESS]" : "[FAILED]");
+
+    return 0;
+}
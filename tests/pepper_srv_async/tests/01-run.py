@@ -0,0 +1,30 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import sys
+from testrunner import run
+
+
+def testfunc(child):
+    child.expect(
+        r"blocked: pushed=(\d+) backlog=(\d+) fast=(\d+) slow=(\d+) "
+        r"slow_dropped=(\d+)"
+    )
+    pushed, backlog, fast, slow, dropped = map(int, child.match.groups())
+    # the fast endpoint is not delayed by the blocked one
+    assert fast == pushed, "fast endpoint delayed"
+    assert slow == 0, "slow endpoint not blocked"
+    assert dropped == pushed - backlog, "unexpected slow backlog"
+    child.expect(r"released: fast=(\d+) fast_dropped=(\d+) slow=(\d+) "
+                 r"slow_dropped=(\d+)")
+    fast, fast_dropped, slow, dropped = map(int, child.match.groups())
+    assert fast == pushed and fast_dropped == 0
+    assert slow == backlog, "slow endpoint lost its backlog"
+    child.expect_exact("[SUCCESS]")
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Simulated radio bus test, two native instances exchange
+ *              advertisements and TWR exchanges
+ *
+ * Every node advertises every @ref TICK_MS, node 0 requests a TWR exchange
+ * to node 1 on every tick and node 1 keeps listening. Each node succeeds once
+ * it received advertisements from the other one and completed TWR exchanges
+ * with a range matching the distance between them.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "event/thread.h"
+#include "timex.h"
+#include "ztimer.h"
+
+#include "sim_bus.h"
+#include "twr.h"
+
+#define TICK_MS             (100U)
+#define ADVS_MIN            (5U)
+#define RANGES_MIN          (3U)
+/* node 1 listens back to back, windows are at most UINT16_MAX us */
+#define LISTEN_WINDOW_US    (60U * US_PER_MS)
+
+static unsigned _advs;
+static unsigned _ranges;
+static unsigned _errors;
+static twr_event_t _twr_event;
+
+static uint16_t _short_addr(uint8_t node)
+{
+    return node + 1;
+}
+
+static uint16_t _distance_cm(void)
+{
+    /* default positions, nodes are 1m apart */
+    int32_t x_cm, y_cm;
+
+    sim_bus_get_position(&x_cm, &y_cm);
+    return abs((int)x_cm - (sim_bus_node() ? 0 : 100));
+}
+
+static void _adv_rx_cb(const sim_bus_frame_t *frame, const sim_bus_link_t *link)
+{
+    if (frame->node == sim_bus_node() || link->distance_cm != _distance_cm()) {
+        _errors++;
+        return;
+    }
+    _advs++;
+}
+
+static void _listen(void)
+{
+    if (sim_bus_node() == 1) {
+        twr_schedule_listen(&_twr_event, 1);
+    }
+}
+
+static void _complete_cb(twr_event_data_t *data, twr_status_t status)
+{
+    int error = (int)data->range - _distance_cm();
+
+    (void)status;
+    if (data->addr != _short_addr(!sim_bus_node()) ||
+        abs(error) > (int)CONFIG_SIM_BUS_RANGE_NOISE_CM) {
+        printf("unexpected range %" PRIu16 "cm from 0x%04" PRIx16 "\n",
+               data->range, data->addr);
+        _errors++;
+    }
+    else {
+        _ranges++;
+    }
+    _listen();
+}
+
+static void _timeout_cb(twr_event_data_t *data, twr_status_t status)
+{
+    (void)data;
+    (void)status;
+    _listen();
+}
+
+static void _check(void)
+{
+    static bool _done = false;
+
+    if (!_done && _advs >= ADVS_MIN && _ranges >= RANGES_MIN) {
+        _done = true;
+        printf("advs=%u ranges=%u errors=%u\n", _advs, _ranges, _errors);
+        puts(_errors ? "[FAILED]" : "[SUCCESS]");
+    }
+}
+
+int main(void)
+{
+    if (sim_bus_init()) {
+        puts("[FAILED]");
+        return -1;
+    }
+    sim_bus_set_rx_cb(SIM_BUS_FRAME_BLE_ADV, _adv_rx_cb);
+    twr_init(EVENT_PRIO_MEDIUM);
+    twr_set_short_addr(_short_addr(sim_bus_node()));
+    twr_set_listen_window(LISTEN_WINDOW_US);
+    twr_set_complete_cb(_complete_cb);
+    twr_set_rx_timeout_cb(_timeout_cb);
+    twr_enable();
+    _listen();
+
+    while (1) {
+        sim_bus_frame_t adv = { .type = SIM_BUS_FRAME_BLE_ADV };
+        sim_bus_send(&adv);
+        if (sim_bus_node() == 0) {
+            twr_schedule_request(&_twr_event, _short_addr(1), 1);
+        }
+        _check();
+        ztimer_sleep(ZTIMER_MSEC, TICK_MS);
+    }
+
+    return 0;
+}
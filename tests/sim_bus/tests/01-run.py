@@ -0,0 +1,27 @@
+#!/usr/bin/env python3
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+import os
+import sys
+
+import pexpect
+from testrunner import run
+
+
+def testfunc(child):
+    # the test instance is node 0, node 1 runs alongside
+    env = dict(os.environ, SIM_BUS_NODE="1", SIM_BUS_NODES="2")
+    peer = pexpect.spawn(os.environ["ELFFILE"], env=env, timeout=10,
+                         encoding="utf-8")
+    try:
+        child.expect_exact("[SUCCESS]")
+        peer.expect_exact("[SUCCESS]")
+    finally:
+        peer.terminate(force=True)
+
+
+if __name__ == "__main__":
+    sys.exit(run(testfunc))
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     unittests
+ * @{
+ *
+ * @file
+ * @brief       RAM backed MTD device for the unittests
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "test_mtd_ram.h"
+
+static uint8_t *_mem(mtd_dev_t *dev)
+{
+    return container_of(dev, test_mtd_ram_t, base)->mem;
+}
+
+static int *_reads_ok(mtd_dev_t *dev)
+{
+    return &container_of(dev, test_mtd_ram_t, base)->reads_ok;
+}
+
+static int _ram_init(mtd_dev_t *dev)
+{
+    (void)dev;
+    return 0;
+}
+
+static int _ram_read_page(mtd_dev_t *dev, void *buff, uint32_t page,
+                          uint32_t offset, uint32_t size)
+{
+    int *reads_ok = _reads_ok(dev);
+
+    if (*reads_ok == 0) {
+        return -EIO;
+    }
+    if (*reads_ok > 0) {
+        (*reads_ok)--;
+    }
+    memcpy(buff, &_mem(dev)[page * dev->page_size + offset], size);
+    return size;
+}
+
+static int _ram_write_page(mtd_dev_t *dev, const void *buff, uint32_t page,
+                           uint32_t offset, uint32_t size)
+{
+    const uint8_t *src = buff;
+    uint8_t *dst = &_mem(dev)[page * dev->page_size + offset];
+
+    /* NOR flash can only clear bits */
+    for (uint32_t i = 0; i < size; i++) {
+        dst[i] &= src[i];
+    }
+    return size;
+}
+
+static int _ram_erase_sector(mtd_dev_t *dev, uint32_t sector, uint32_t count)
+{
+    memset(&_mem(dev)[sector * dev->page_size * dev->pages_per_sector], 0xFF,
+           count * dev->page_size * dev->pages_per_sector);
+    return 0;
+}
+
+static const mtd_desc_t _ram_driver = {
+    .init = _ram_init,
+    .read_page = _ram_read_page,
+    .write_page = _ram_write_page,
+    .erase_sector = _ram_erase_sector,
+};
+
+void test_mtd_ram_init(test_mtd_ram_t *dev, uint8_t *mem, uint32_t page_size,
+                       uint32_t sector_count)
+{
+    memset(dev, '\0', sizeof(*dev));
+    dev->mem = mem;
+    dev->reads_ok = -1;
+    dev->base.driver = &_ram_driver;
+    dev->base.sector_count = sector_count;
+    dev->base.pages_per_sector = 1;
+    dev->base.page_size = page_size;
+    memset(mem, 0xFF, page_size * sector_count);
+    mtd_init(&dev->base);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     unittests
+ * @{
+ *
+ * @file
+ * @brief       RAM backed MTD device for the unittests
+ *
+ * Writes can only clear bits, as on NOR flash, so that tests catch writes
+ * to non erased memory.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef TEST_MTD_RAM_H
+#define TEST_MTD_RAM_H
+
+#include <stdint.h>
+
+#include "mtd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   RAM backed MTD device, one page per sector
+ */
+typedef struct {
+    mtd_dev_t base;         /**< MTD device */
+    uint8_t *mem;           /**< backing memory */
+    int reads_ok;           /**< reads left before they fail, -1 never */
+} test_mtd_ram_t;
+
+/**
+ * @brief   Erase @p mem and init the MTD device over it
+ *
+ * @param[out]  dev             the device
+ * @param[in]   mem             backing memory, @p page_size * @p sector_count
+ * @param[in]   page_size       page and sector size
+ * @param[in]   sector_count    number of sectors
+ */
+void test_mtd_ram_init(test_mtd_ram_t *dev, uint8_t *mem, uint32_t page_size,
+                       uint32_t sector_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_MTD_RAM_H */
+/** @} */
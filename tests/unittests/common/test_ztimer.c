@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     unittests
+ * @{
+ *
+ * @file
+ * @brief       Mocked ZTIMER_USEC, ZTIMER_MSEC_BASE and ZTIMER_MSEC for the
+ *              unittests
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ *
+ * @}
+ */
+
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "timex.h"
+
+#if IS_USED(MODULE_ZTIMER_MOCK) && !IS_USED(MODULE_ZTIMER_INIT)
+
+#include "test_ztimer.h"
+
+ztimer_mock_t test_ztimer_usec;
+ztimer_clock_t *const ZTIMER_USEC = &test_ztimer_usec.super;
+ztimer_mock_t test_ztimer_msec_base;
+ztimer_clock_t *const ZTIMER_MSEC_BASE = &test_ztimer_msec_base.super;
+ztimer_mock_t test_ztimer_msec;
+ztimer_clock_t *const ZTIMER_MSEC = &test_ztimer_msec.super;
+
+static uint64_t _elapsed_us;
+
+void test_ztimer_init(void)
+{
+    memset(&test_ztimer_usec, '\0', sizeof(test_ztimer_usec));
+    ztimer_mock_init(&test_ztimer_usec, 32);
+    memset(&test_ztimer_msec_base, '\0', sizeof(test_ztimer_msec_base));
+    ztimer_mock_init(&test_ztimer_msec_base, 32);
+    memset(&test_ztimer_msec, '\0', sizeof(test_ztimer_msec));
+    ztimer_mock_init(&test_ztimer_msec, 32);
+    _elapsed_us = 0;
+}
+
+void test_ztimer_advance_us(uint32_t us)
+{
+    uint64_t ticks = _elapsed_us * CONFIG_ZTIMER_MSEC_BASE_FREQ / US_PER_SEC;
+    uint64_t ms = _elapsed_us / US_PER_MS;
+
+    _elapsed_us += us;
+    ztimer_mock_advance(&test_ztimer_usec, us);
+    ztimer_mock_advance(&test_ztimer_msec_base,
+                        _elapsed_us * CONFIG_ZTIMER_MSEC_BASE_FREQ / US_PER_SEC -
+                        ticks);
+    ztimer_mock_advance(&test_ztimer_msec, _elapsed_us / US_PER_MS - ms);
+}
+
+#endif
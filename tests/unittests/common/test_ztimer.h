@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     unittests
+ * @{
+ *
+ * @file
+ * @brief       Mocked ZTIMER_USEC, ZTIMER_MSEC_BASE and ZTIMER_MSEC for the
+ *              unittests
+ *
+ * Test suites that time their module add `ztimer_mock` and disable
+ * `ztimer_init`, the clocks are then only advanced by
+ * @ref test_ztimer_advance_us. They are shared by all suites so that they
+ * are defined once in the combined unittests binary.
+ *
+ * @author      Francisco Molina <francois-xavier.molina@inria.fr>
+ */
+
+#ifndef TEST_ZTIMER_H
+#define TEST_ZTIMER_H
+
+#include <stdint.h>
+
+#include "ztimer/mock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Mock behind ZTIMER_USEC
+ */
+extern ztimer_mock_t test_ztimer_usec;
+
+/**
+ * @brief   Mock behind ZTIMER_MSEC_BASE
+ */
+extern ztimer_mock_t test_ztimer_msec_base;
+
+/**
+ * @brief   Mock behind ZTIMER_MSEC
+ */
+extern ztimer_mock_t test_ztimer_msec;
+
+/**
+ * @brief   Reset all clocks to 0
+ */
+void test_ztimer_init(void);
+
+/**
+ * @brief   Advance all clocks, firing the timers that expire
+ *
+ * ZTIMER_MSEC_BASE and ZTIMER_MSEC are advanced by the whole ticks elapsed
+ * since @ref test_ztimer_init, so that rounding does not accumulate.
+ *
+ * @param[in]   us      the time to advance by in us
+ */
+void test_ztimer_advance_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_ZTIMER_H */
+/** @} */
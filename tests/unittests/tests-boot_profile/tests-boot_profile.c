@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "embUnit.h"
+#include "boot_profile.h"
+#include "timex.h"
+#include "test_ztimer.h"
+
+/* a whole number of ticks for any power of two or ten ZTIMER_MSEC_BASE */
+#define STEP_MS     (125U)
+
+static void setUp(void)
+{
+    test_ztimer_init();
+}
+
+static void tearDown(void)
+{
+    /* Finalize */
+}
+
+static void test_boot_profile_not_run(void)
+{
+    boot_profile_entry_t entry;
+
+    boot_profile_get(BOOT_PHASE_EDHOC_INIT, &entry);
+    TEST_ASSERT(!entry.done);
+    TEST_ASSERT_EQUAL_INT(0, entry.us);
+    /* not started, not ended */
+    boot_profile_end(BOOT_PHASE_EDHOC_INIT);
+    boot_profile_get(BOOT_PHASE_EDHOC_INIT, &entry);
+    TEST_ASSERT(!entry.done);
+}
+
+static void test_boot_profile_phase(void)
+{
+    boot_profile_entry_t entry;
+
+    test_ztimer_advance_us(STEP_MS * US_PER_MS);
+    boot_profile_begin(BOOT_PHASE_STORAGE_MOUNT);
+    test_ztimer_advance_us(2 * STEP_MS * US_PER_MS);
+    boot_profile_end(BOOT_PHASE_STORAGE_MOUNT);
+    boot_profile_get(BOOT_PHASE_STORAGE_MOUNT, &entry);
+    TEST_ASSERT(entry.done);
+    TEST_ASSERT_EQUAL_INT(STEP_MS, entry.start_ms);
+    TEST_ASSERT_EQUAL_INT(2 * STEP_MS * US_PER_MS, entry.us);
+
+    /* only the first run is kept */
+    test_ztimer_advance_us(STEP_MS * US_PER_MS);
+    boot_profile_begin(BOOT_PHASE_STORAGE_MOUNT);
+    test_ztimer_advance_us(STEP_MS * US_PER_MS);
+    boot_profile_end(BOOT_PHASE_STORAGE_MOUNT);
+    boot_profile_get(BOOT_PHASE_STORAGE_MOUNT, &entry);
+    TEST_ASSERT_EQUAL_INT(STEP_MS, entry.start_ms);
+    TEST_ASSERT_EQUAL_INT(2 * STEP_MS * US_PER_MS, entry.us);
+}
+
+static void test_boot_profile_mark(void)
+{
+    boot_profile_entry_t entry;
+
+    /* a late milestone, past the wrap around of a 32 bit us start */
+    for (unsigned i = 0; i < 90; i++) {
+        test_ztimer_advance_us(60 * US_PER_SEC);
+    }
+    boot_profile_mark(BOOT_PHASE_FIRST_ADV);
+    boot_profile_get(BOOT_PHASE_FIRST_ADV, &entry);
+    TEST_ASSERT(entry.done);
+    TEST_ASSERT_EQUAL_INT(0, entry.us);
+    TEST_ASSERT_EQUAL_INT(90 * 60 * MS_PER_SEC, entry.start_ms);
+}
+
+Test *tests_boot_profile_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(test_boot_profile_not_run),
+        new_TestFixture(test_boot_profile_phase),
+        new_TestFixture(test_boot_profile_mark),
+    };
+
+    EMB_UNIT_TESTCALLER(boot_profile_tests, setUp, tearDown, fixtures);
+    return (Test *)&boot_profile_tests;
+}
+
+void tests_boot_profile(void)
+{
+    TESTS_RUN(tests_boot_profile_all());
+}
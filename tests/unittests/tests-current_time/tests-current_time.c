@@ -2,9 +2,11 @@
 #include <math.h>
 
 #include "embUnit.h"
+#include "timex.h"
 #include "ztimer.h"
 #include "ztimer/mock.h"
 #include "current_time.h"
+#include "test_ztimer.h"
 
 static current_time_hook_t _post_hook;
 static current_time_hook_t _pre_hook;
@@ -12,6 +14,7 @@ static volatile uint8_t calls = 0;
 
 static ztimer_mock_t zmock;
 ztimer_clock_t *const ZTIMER_EPOCH = &zmock.super;
+static uint32_t sub_ms;
 
 static void _should_be_called(int32_t offset, void *arg)
 {
@@ -75,6 +78,115 @@ static void tests_current_time_in_range(void)
     TEST_ASSERT_EQUAL_INT(0, calls);
 }
 
+static void setUp_discipline(void)
+{
+    memset(&zmock, '\0', sizeof(ztimer_mock_t));
+    ztimer_mock_init(&zmock, 32);
+    test_ztimer_init();
+    sub_ms = 0;
+    /* setup */
+    current_time_init();
+    calls = 0;
+}
+
+/* advance ZTIMER_MSEC by local_ms and ZTIMER_EPOCH by the elapsed seconds */
+static void _advance(uint32_t local_ms)
+{
+    test_ztimer_advance_us(local_ms * US_PER_MS);
+    sub_ms += local_ms;
+    ztimer_mock_advance(&zmock, sub_ms / MS_PER_SEC);
+    sub_ms %= MS_PER_SEC;
+}
+
+static void tests_current_time_discipline_slew(void)
+{
+    current_time_stats_t stats;
+
+    current_time_hook_init(&_pre_hook, _should_not_be_called, NULL);
+    current_time_hook_init(&_post_hook, _should_not_be_called, NULL);
+    current_time_add_pre_cb(&_pre_hook);
+    current_time_add_post_cb(&_post_hook);
+    _advance(CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS);
+    uint64_t before = current_time_get_ms();
+    /* received time is 2s late, in range: slewed and not stepped */
+    current_time_update_ms(before / MS_PER_SEC + 2, before % MS_PER_SEC);
+    current_time_get_stats(&stats);
+    TEST_ASSERT_EQUAL_INT(2 * MS_PER_SEC, stats.offset_ms);
+    TEST_ASSERT_EQUAL_INT(2 * MS_PER_SEC * CONFIG_CURRENT_TIME_DISCIPLINE_KP / 100,
+                          stats.slew_ms);
+    TEST_ASSERT_EQUAL_INT(1, stats.samples);
+    TEST_ASSERT_EQUAL_INT(0, stats.steps);
+    TEST_ASSERT(current_time_get_ms() == before);
+    /* time runs at most CONFIG_CURRENT_TIME_DISCIPLINE_SLEW_MAX_PPM faster */
+    const uint32_t dt = CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS / 2;
+    _advance(dt);
+    uint64_t max = dt + (uint64_t)dt *
+                   (CONFIG_CURRENT_TIME_DISCIPLINE_SLEW_MAX_PPM +
+                    CONFIG_CURRENT_TIME_DISCIPLINE_SKEW_MAX_PPM) / US_PER_SEC;
+    TEST_ASSERT(current_time_get_ms() - before <= max);
+    TEST_ASSERT(current_time_get_ms() - before > dt);
+    /* too early samples are ignored */
+    current_time_update(current_time_get());
+    current_time_get_stats(&stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.samples);
+    TEST_ASSERT_EQUAL_INT(1, stats.ignored);
+}
+
+static void tests_current_time_discipline_skew(void)
+{
+    current_time_stats_t stats;
+    /* local clock runs 50ppm fast, start 300ms behind the reference */
+    uint64_t ref = current_time_get_ms() + 300;
+    const uint32_t itvl = 60 * MS_PER_SEC;
+
+    current_time_hook_init(&_pre_hook, _should_not_be_called, NULL);
+    current_time_hook_init(&_post_hook, _should_not_be_called, NULL);
+    current_time_add_pre_cb(&_pre_hook);
+    current_time_add_post_cb(&_post_hook);
+    for (unsigned i = 0; i < 60; i++) {
+        _advance(itvl + itvl / 20000);
+        ref += itvl;
+        current_time_update_ms(ref / MS_PER_SEC, ref % MS_PER_SEC);
+    }
+    current_time_get_stats(&stats);
+    TEST_ASSERT(stats.skew_ppb < -40000 && stats.skew_ppb > -60000);
+    TEST_ASSERT(stats.offset_ms < 5 && stats.offset_ms > -5);
+    TEST_ASSERT_EQUAL_INT(0, stats.steps);
+}
+
+static void tests_current_time_discipline_follow(void)
+{
+    current_time_stats_t stats;
+    const uint32_t lag_s = CONFIG_CURRENT_TIME_RANGE_S / 2 + 1;
+
+    current_time_hook_init(&_pre_hook, _should_be_called, NULL);
+    current_time_hook_init(&_post_hook, _should_be_called, NULL);
+    current_time_add_pre_cb(&_pre_hook);
+    current_time_add_post_cb(&_post_hook);
+    /* ZTIMER_EPOCH falls lag_s behind the local clock */
+    test_ztimer_advance_us(CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS * US_PER_MS);
+    ztimer_mock_advance(&zmock, CONFIG_CURRENT_TIME_DISCIPLINE_ITVL_MIN_MS /
+                        MS_PER_SEC - lag_s);
+    uint64_t now = current_time_get_ms();
+    TEST_ASSERT_EQUAL_INT(now / MS_PER_SEC - lag_s, current_time_get());
+    /* an on time sample slews nothing, ZTIMER_EPOCH catches up by whole
+       seconds without it being a step */
+    current_time_update_ms(now / MS_PER_SEC, now % MS_PER_SEC);
+    current_time_get_stats(&stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.offset_ms);
+    TEST_ASSERT_EQUAL_INT(0, stats.slew_ms);
+    TEST_ASSERT_EQUAL_INT(1, stats.samples);
+    TEST_ASSERT_EQUAL_INT(0, stats.steps);
+    TEST_ASSERT_EQUAL_INT(2, calls);
+    TEST_ASSERT_EQUAL_INT(now / MS_PER_SEC, current_time_get());
+    TEST_ASSERT(current_time_get_ms() == now);
+    /* out of range samples are still stepped */
+    current_time_update(current_time_get() + 2 * CONFIG_CURRENT_TIME_RANGE_S);
+    current_time_get_stats(&stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.steps);
+    TEST_ASSERT_EQUAL_INT(4, calls);
+}
+
 Test *tests_current_time_all(void)
 {
     EMB_UNIT_TESTFIXTURES(fixtures) {
@@ -87,7 +199,23 @@ Test *tests_current_time_all(void)
     return (Test *)&current_time_tests;
 }
 
+Test *tests_current_time_discipline_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(tests_current_time_discipline_slew),
+        new_TestFixture(tests_current_time_discipline_skew),
+        new_TestFixture(tests_current_time_discipline_follow),
+    };
+
+    EMB_UNIT_TESTCALLER(current_time_discipline_tests, setUp_discipline, tearDown,
+                        fixtures);
+    return (Test *)&current_time_discipline_tests;
+}
+
 void tests_current_time(void)
 {
+    /* the discipline samples ZTIMER_MSEC on every update */
+    test_ztimer_init();
     TESTS_RUN(tests_current_time_all());
+    TESTS_RUN(tests_current_time_discipline_all());
 }
@@ -3,6 +3,8 @@
 
 #include "embUnit.h"
 #include "ed.h"
+#include "bpf/ed.h"
+#include "kernel_defines.h"
 #include "femtocontainer/femtocontainer.h"
 
 static void setUp(void)
@@ -33,10 +35,40 @@ static void test_ed_uwb_bpf_finish(void)
     TEST_ASSERT(ed.uwb.valid == true);
 }
 
+static void test_ed_uwb_bpf_finish_batch(void)
+{
+    /* more than a batch to exercise chunking */
+    static ed_t eds[ED_UWB_BPF_BATCH_SIZE + 3];
+    ed_t *list[ARRAY_SIZE(eds)];
+    unsigned expected = 0;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(eds); i++) {
+        ed_init(&eds[i], i);
+        eds[i].uwb.seen_first_s = 0;
+        eds[i].uwb.seen_last_s = MIN_EXPOSURE_TIME_S;
+        eds[i].uwb.req_count = 4;
+        /* every third encounter is too far */
+        if (i % 3) {
+            eds[i].uwb.cumulative_d_cm = (MAX_DISTANCE_CM - 1) * 4;
+            expected++;
+        }
+        else {
+            eds[i].uwb.cumulative_d_cm = (MAX_DISTANCE_CM + 1) * 4;
+        }
+        list[i] = &eds[i];
+    }
+    TEST_ASSERT_EQUAL_INT(expected,
+                          ed_uwb_bpf_finish_batch(list, ARRAY_SIZE(list)));
+    for (unsigned i = 0; i < ARRAY_SIZE(eds); i++) {
+        TEST_ASSERT(eds[i].uwb.valid == ((i % 3) != 0));
+    }
+}
+
 Test *tests_ed_uwb_bpf_all(void)
 {
     EMB_UNIT_TESTFIXTURES(fixtures) {
         new_TestFixture(test_ed_uwb_bpf_finish),
+        new_TestFixture(test_ed_uwb_bpf_finish_batch),
     };
 
     EMB_UNIT_TESTCALLER(ed_tests, setUp, tearDown, fixtures);
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include <string.h>
+
+#include "embUnit.h"
+#include "energy.h"
+#include "timex.h"
+#include "test_ztimer.h"
+
+/* a whole number of ticks for any power of two or ten ZTIMER_MSEC_BASE */
+#define STEP_MS     (125U)
+
+static energy_summary_t _summaries[ENERGY_STATE_NUMOF];
+
+static void setUp(void)
+{
+    test_ztimer_init();
+    energy_end(ENERGY_STATE_BLE_SCAN);
+    energy_end(ENERGY_STATE_UWB_SLEEP);
+    energy_reset();
+}
+
+static void tearDown(void)
+{
+    /* Finalize */
+}
+
+static void _advance_ms(uint32_t ms)
+{
+    test_ztimer_advance_us(ms * US_PER_MS);
+}
+
+static void test_energy_estimate(void)
+{
+    /* one second at the listen current */
+    uint32_t uj = (uint64_t)CONFIG_ENERGY_UWB_LISTEN_UA *
+                  CONFIG_ENERGY_SUPPLY_MV / MS_PER_SEC;
+
+    TEST_ASSERT_EQUAL_INT(uj, energy_estimate_uj(ENERGY_STATE_UWB_LISTEN, US_PER_SEC));
+    TEST_ASSERT_EQUAL_INT(0, energy_estimate_uj(ENERGY_STATE_UWB_LISTEN, 0));
+}
+
+static void test_energy_add(void)
+{
+    energy_add(ENERGY_STATE_BLE_ADV, CONFIG_ENERGY_BLE_ADV_EVENT_US);
+    energy_add(ENERGY_STATE_BLE_ADV, CONFIG_ENERGY_BLE_ADV_EVENT_US);
+    uint32_t total = energy_summary_all(_summaries);
+
+    TEST_ASSERT_EQUAL_INT(2, _summaries[ENERGY_STATE_BLE_ADV].count);
+    TEST_ASSERT_EQUAL_INT(2 * CONFIG_ENERGY_BLE_ADV_EVENT_US / US_PER_MS,
+                          _summaries[ENERGY_STATE_BLE_ADV].time_ms);
+    TEST_ASSERT_EQUAL_INT(energy_estimate_uj(ENERGY_STATE_BLE_ADV,
+                                             2 * CONFIG_ENERGY_BLE_ADV_EVENT_US),
+                          _summaries[ENERGY_STATE_BLE_ADV].uj);
+    TEST_ASSERT_EQUAL_INT(_summaries[ENERGY_STATE_BLE_ADV].uj, total);
+    TEST_ASSERT_EQUAL_INT(0, _summaries[ENERGY_STATE_UWB_LISTEN].count);
+}
+
+static void test_energy_begin_end(void)
+{
+    /* not entered, nothing accounted */
+    energy_end(ENERGY_STATE_UWB_LISTEN);
+    _advance_ms(STEP_MS);
+    energy_begin(ENERGY_STATE_UWB_LISTEN);
+    _advance_ms(STEP_MS);
+    energy_end(ENERGY_STATE_UWB_LISTEN);
+    _advance_ms(STEP_MS);
+    energy_end(ENERGY_STATE_UWB_LISTEN);
+    uint32_t total = energy_summary_all(_summaries);
+
+    TEST_ASSERT_EQUAL_INT(1, _summaries[ENERGY_STATE_UWB_LISTEN].count);
+    TEST_ASSERT_EQUAL_INT(STEP_MS, _summaries[ENERGY_STATE_UWB_LISTEN].time_ms);
+    /* 118000uA * 3000mV * 125ms */
+    TEST_ASSERT_EQUAL_INT(44250, _summaries[ENERGY_STATE_UWB_LISTEN].uj);
+    TEST_ASSERT_EQUAL_INT(44250, total);
+}
+
+static void test_energy_duty(void)
+{
+    /* a quarter of the time, entering again while entered keeps one count */
+    energy_begin_duty(ENERGY_STATE_BLE_SCAN, ENERGY_DUTY_FULL / 4);
+    _advance_ms(2 * STEP_MS);
+    energy_begin_duty(ENERGY_STATE_BLE_SCAN, ENERGY_DUTY_FULL / 2);
+    _advance_ms(2 * STEP_MS);
+    energy_end(ENERGY_STATE_BLE_SCAN);
+    energy_summary_all(_summaries);
+    TEST_ASSERT_EQUAL_INT(1, _summaries[ENERGY_STATE_BLE_SCAN].count);
+    /* 250ms / 4 + 250ms / 2 */
+    TEST_ASSERT_EQUAL_INT(187, _summaries[ENERGY_STATE_BLE_SCAN].time_ms);
+    /* 5400uA * 3000mV * 187.5ms */
+    TEST_ASSERT_EQUAL_INT(3037, _summaries[ENERGY_STATE_BLE_SCAN].uj);
+}
+
+static void test_energy_reset(void)
+{
+    /* a state still entered is accounted up to now, and from the reset on */
+    energy_begin(ENERGY_STATE_UWB_SLEEP);
+    _advance_ms(8 * STEP_MS);
+    energy_summary_all(_summaries);
+    TEST_ASSERT_EQUAL_INT(8 * STEP_MS, _summaries[ENERGY_STATE_UWB_SLEEP].time_ms);
+    /* 1uA * 3000mV * 1s */
+    TEST_ASSERT_EQUAL_INT(3, _summaries[ENERGY_STATE_UWB_SLEEP].uj);
+    energy_add(ENERGY_STATE_BLE_ADV, CONFIG_ENERGY_BLE_ADV_EVENT_US);
+    energy_reset();
+    energy_summary_all(_summaries);
+    TEST_ASSERT_EQUAL_INT(1, _summaries[ENERGY_STATE_UWB_SLEEP].count);
+    TEST_ASSERT_EQUAL_INT(0, _summaries[ENERGY_STATE_UWB_SLEEP].time_ms);
+    TEST_ASSERT_EQUAL_INT(0, _summaries[ENERGY_STATE_BLE_ADV].count);
+    TEST_ASSERT_EQUAL_INT(0, _summaries[ENERGY_STATE_BLE_ADV].uj);
+    _advance_ms(STEP_MS);
+    energy_end(ENERGY_STATE_UWB_SLEEP);
+    _advance_ms(STEP_MS);
+    energy_summary_all(_summaries);
+    TEST_ASSERT_EQUAL_INT(STEP_MS, _summaries[ENERGY_STATE_UWB_SLEEP].time_ms);
+}
+
+Test *tests_energy_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(test_energy_estimate),
+        new_TestFixture(test_energy_add),
+        new_TestFixture(test_energy_begin_end),
+        new_TestFixture(test_energy_duty),
+        new_TestFixture(test_energy_reset),
+    };
+
+    EMB_UNIT_TESTCALLER(energy_tests, setUp, tearDown, fixtures);
+    return (Test *)&energy_tests;
+}
+
+void tests_energy(void)
+{
+    TESTS_RUN(tests_energy_all());
+}
@@ -0,0 +1,185 @@
+#include <string.h>
+
+#include "embUnit.h"
+#include "flashlog.h"
+#include "test_mtd_ram.h"
+
+#define TEST_PAGE_SIZE      (256U)
+#define TEST_SECTORS        (4U)
+
+static uint8_t _flash[TEST_PAGE_SIZE * TEST_SECTORS];
+static uint8_t _buf[64];
+static flashlog_t _log;
+
+static test_mtd_ram_t _mtd;
+
+static void setUp(void)
+{
+    test_mtd_ram_init(&_mtd, _flash, TEST_PAGE_SIZE, TEST_SECTORS);
+    flashlog_init(&_log, &_mtd.base, 0, TEST_SECTORS);
+}
+
+static void tearDown(void)
+{
+}
+
+static void tests_flashlog_append_read(void)
+{
+    flashlog_iter_t iter;
+    flashlog_record_hdr_t hdr;
+
+    TEST_ASSERT_EQUAL_INT(0, flashlog_append(&_log, 1, "hello", 5));
+    TEST_ASSERT_EQUAL_INT(1, flashlog_append(&_log, 2, "pepper!", 7));
+
+    flashlog_iter_init(&_log, &iter);
+    TEST_ASSERT_EQUAL_INT(5, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                sizeof(_buf)));
+    TEST_ASSERT_EQUAL_INT(1, hdr.tag);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(_buf, "hello", 5));
+    TEST_ASSERT_EQUAL_INT(7, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                sizeof(_buf)));
+    TEST_ASSERT_EQUAL_INT(2, hdr.tag);
+    TEST_ASSERT_EQUAL_INT(1, hdr.seq);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(_buf, "pepper!", 7));
+    TEST_ASSERT_EQUAL_INT(0, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                sizeof(_buf)));
+}
+
+static void tests_flashlog_invalid_len(void)
+{
+    TEST_ASSERT(flashlog_append(&_log, 0, _buf, 0) < 0);
+    TEST_ASSERT(flashlog_append(&_log, 0, _flash,
+                                flashlog_max_len(&_log) + 1) < 0);
+}
+
+static void tests_flashlog_recover(void)
+{
+    flashlog_iter_t iter;
+    flashlog_record_hdr_t hdr;
+
+    flashlog_append(&_log, 0, "a", 1);
+    flashlog_append(&_log, 0, "b", 1);
+    /* re-init, as after a reboot */
+    flashlog_init(&_log, &_mtd.base, 0, TEST_SECTORS);
+    TEST_ASSERT_EQUAL_INT(2, flashlog_append(&_log, 0, "c", 1));
+
+    flashlog_iter_init(&_log, &iter);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(1, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                    sizeof(_buf)));
+        TEST_ASSERT_EQUAL_INT('a' + i, _buf[0]);
+    }
+    TEST_ASSERT_EQUAL_INT(0, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                sizeof(_buf)));
+}
+
+static void tests_flashlog_recover_read_error(void)
+{
+    flashlog_append(&_log, 0, "a", 1);
+    /* sector headers are read, the first record header is not */
+    _mtd.reads_ok = TEST_SECTORS;
+    TEST_ASSERT(flashlog_init(&_log, &_mtd.base, 0, TEST_SECTORS) < 0);
+    _mtd.reads_ok = -1;
+    /* nothing was overwritten */
+    TEST_ASSERT_EQUAL_INT(0, flashlog_init(&_log, &_mtd.base, 0, TEST_SECTORS));
+    TEST_ASSERT_EQUAL_INT(1, flashlog_append(&_log, 0, "b", 1));
+}
+
+static void tests_flashlog_wrap(void)
+{
+    flashlog_iter_t iter;
+    flashlog_record_hdr_t hdr;
+    flashlog_stats_t stats;
+    int32_t seq = 0;
+
+    memset(_buf, 0xA5, sizeof(_buf));
+    /* write enough to cycle through the ring several times */
+    for (unsigned i = 0; i < 10 * TEST_SECTORS * TEST_PAGE_SIZE / sizeof(_buf); i++) {
+        seq = flashlog_append(&_log, 0, _buf, sizeof(_buf));
+        TEST_ASSERT(seq >= 0);
+    }
+
+    flashlog_get_stats(&_log, &stats);
+    TEST_ASSERT(stats.recycled > 0);
+    TEST_ASSERT_EQUAL_INT(0, stats.errors);
+    /* ring order keeps wear even */
+    TEST_ASSERT(stats.erase_max - stats.erase_min <= 1);
+
+    /* oldest records are dropped, the newest one is last */
+    int32_t last = -1;
+    flashlog_iter_init(&_log, &iter);
+    while (flashlog_iter_next(&_log, &iter, &hdr, _buf, sizeof(_buf)) > 0) {
+        TEST_ASSERT(last < 0 || (int32_t)hdr.seq == last + 1);
+        last = hdr.seq;
+    }
+    TEST_ASSERT_EQUAL_INT(seq, last);
+}
+
+static void tests_flashlog_corrupted(void)
+{
+    flashlog_iter_t iter;
+    flashlog_record_hdr_t hdr;
+
+    flashlog_append(&_log, 0, "bad", 3);
+    flashlog_append(&_log, 0, "good", 4);
+    /* flip payload bits of the first record */
+    _flash[FLASHLOG_SECTOR_HDR_SIZE + FLASHLOG_RECORD_HDR_SIZE] = 0;
+
+    flashlog_iter_init(&_log, &iter);
+    TEST_ASSERT_EQUAL_INT(4, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                sizeof(_buf)));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(_buf, "good", 4));
+}
+
+static void tests_flashlog_iter_recycled(void)
+{
+    flashlog_iter_t iter;
+    flashlog_record_hdr_t hdr;
+    int32_t seq = 0;
+
+    memset(_buf, 0x5A, sizeof(_buf));
+    for (unsigned i = 0; i < TEST_SECTORS * TEST_PAGE_SIZE / sizeof(_buf); i++) {
+        flashlog_append(&_log, 0, _buf, sizeof(_buf));
+    }
+    flashlog_iter_init(&_log, &iter);
+    TEST_ASSERT(flashlog_iter_next(&_log, &iter, &hdr, _buf, sizeof(_buf)) > 0);
+    uint32_t last = hdr.seq;
+
+    /* recycle the whole ring, including the sector being read */
+    for (unsigned i = 0; i < TEST_SECTORS * TEST_PAGE_SIZE / sizeof(_buf); i++) {
+        seq = flashlog_append(&_log, 0, _buf, sizeof(_buf));
+    }
+    while (flashlog_iter_next(&_log, &iter, &hdr, _buf, sizeof(_buf)) > 0) {
+        TEST_ASSERT(hdr.seq > last);
+        TEST_ASSERT_EQUAL_INT(0x5A, _buf[sizeof(_buf) - 1]);
+        last = hdr.seq;
+    }
+    TEST_ASSERT_EQUAL_INT(seq, last);
+
+    /* the iterator follows records appended after it reached the end */
+    seq = flashlog_append(&_log, 0, "new", 3);
+    TEST_ASSERT_EQUAL_INT(3, flashlog_iter_next(&_log, &iter, &hdr, _buf,
+                                                sizeof(_buf)));
+    TEST_ASSERT_EQUAL_INT(seq, hdr.seq);
+}
+
+Test *tests_flashlog_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(tests_flashlog_append_read),
+        new_TestFixture(tests_flashlog_invalid_len),
+        new_TestFixture(tests_flashlog_recover),
+        new_TestFixture(tests_flashlog_recover_read_error),
+        new_TestFixture(tests_flashlog_wrap),
+        new_TestFixture(tests_flashlog_corrupted),
+        new_TestFixture(tests_flashlog_iter_recycled),
+    };
+
+    EMB_UNIT_TESTCALLER(flashlog_tests, setUp, tearDown, fixtures);
+    return (Test *)&flashlog_tests;
+}
+
+void tests_flashlog(void)
+{
+    TESTS_RUN(tests_flashlog_all());
+}
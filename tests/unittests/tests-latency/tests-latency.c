@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "embUnit.h"
+#include "latency.h"
+#include "test_ztimer.h"
+
+static latency_hist_t _hist;
+
+static void setUp(void)
+{
+    test_ztimer_init();
+    latency_hist_reset(&_hist);
+}
+
+static void tearDown(void)
+{
+    /* Finalize */
+}
+
+static void test_latency_hist_empty(void)
+{
+    latency_summary_t summary;
+
+    latency_hist_summary(&_hist, &summary);
+    TEST_ASSERT_EQUAL_INT(0, summary.count);
+    TEST_ASSERT_EQUAL_INT(0, summary.avg_us);
+    TEST_ASSERT_EQUAL_INT(0, summary.p99_us);
+}
+
+static void test_latency_hist_summary(void)
+{
+    latency_summary_t summary;
+
+    /* 99 fast samples and a slow one */
+    for (unsigned i = 0; i < 99; i++) {
+        latency_hist_add(&_hist, 100);
+    }
+    latency_hist_add(&_hist, 10100);
+    latency_hist_summary(&_hist, &summary);
+    TEST_ASSERT_EQUAL_INT(100, summary.count);
+    TEST_ASSERT_EQUAL_INT(100, summary.min_us);
+    TEST_ASSERT_EQUAL_INT(10100, summary.max_us);
+    TEST_ASSERT_EQUAL_INT(200, summary.avg_us);
+    /* 100us falls in [64, 128) */
+    TEST_ASSERT_EQUAL_INT(127, summary.p99_us);
+    /* the slow sample is the last percent, [8192, 16384) clamped to max */
+    TEST_ASSERT_EQUAL_INT(10100, latency_hist_percentile(&_hist, 1000));
+}
+
+static void test_latency_hist_percentile(void)
+{
+    /* one sample per bucket up to 2^9 */
+    for (unsigned i = 0; i < 10; i++) {
+        latency_hist_add(&_hist, 1UL << i);
+    }
+    TEST_ASSERT_EQUAL_INT(1, latency_hist_percentile(&_hist, 0));
+    TEST_ASSERT_EQUAL_INT(31, latency_hist_percentile(&_hist, 500));
+    /* [512, 1024) clamped to the largest sample */
+    TEST_ASSERT_EQUAL_INT(512, latency_hist_percentile(&_hist, 990));
+}
+
+static void test_latency_hist_overflow(void)
+{
+    /* beyond the last bucket */
+    latency_hist_add(&_hist, UINT32_MAX);
+    latency_hist_add(&_hist, 0);
+    TEST_ASSERT_EQUAL_INT(1, _hist.buckets[0]);
+    TEST_ASSERT_EQUAL_INT(1, _hist.buckets[CONFIG_LATENCY_HIST_BUCKETS - 1]);
+    TEST_ASSERT_EQUAL_INT(UINT32_MAX, latency_hist_percentile(&_hist, 990));
+    TEST_ASSERT_EQUAL_INT(1, latency_hist_percentile(&_hist, 500));
+}
+
+static void test_latency_stages(void)
+{
+    latency_hist_t hist;
+
+    latency_reset();
+    /* not started, nothing recorded */
+    latency_end(LATENCY_STAGE_SCAN_PROCESS);
+    latency_get(LATENCY_STAGE_SCAN_PROCESS, &hist);
+    TEST_ASSERT_EQUAL_INT(0, hist.count);
+    latency_begin(LATENCY_STAGE_SCAN_PROCESS);
+    test_ztimer_advance_us(150);
+    latency_end(LATENCY_STAGE_SCAN_PROCESS);
+    test_ztimer_advance_us(150);
+    latency_end(LATENCY_STAGE_SCAN_PROCESS);
+    latency_get(LATENCY_STAGE_SCAN_PROCESS, &hist);
+    TEST_ASSERT_EQUAL_INT(1, hist.count);
+    TEST_ASSERT_EQUAL_INT(150, hist.min);
+    TEST_ASSERT_EQUAL_INT(150, hist.max);
+    /* a restart drops the previous start */
+    latency_begin(LATENCY_STAGE_SCAN_PROCESS);
+    test_ztimer_advance_us(1000);
+    latency_begin(LATENCY_STAGE_SCAN_PROCESS);
+    test_ztimer_advance_us(20);
+    latency_end(LATENCY_STAGE_SCAN_PROCESS);
+    latency_get(LATENCY_STAGE_SCAN_PROCESS, &hist);
+    TEST_ASSERT_EQUAL_INT(2, hist.count);
+    TEST_ASSERT_EQUAL_INT(20, hist.min);
+    latency_reset();
+    latency_get(LATENCY_STAGE_SCAN_PROCESS, &hist);
+    TEST_ASSERT_EQUAL_INT(0, hist.count);
+}
+
+static void test_latency_record(void)
+{
+    latency_hist_t hist;
+    /* a deadline about 2ms away, in ZTIMER_MSEC_BASE ticks */
+    uint32_t ticks = 2 * CONFIG_ZTIMER_MSEC_BASE_FREQ / MS_PER_SEC;
+    uint32_t deadline = latency_deadline(ticks);
+
+    latency_reset();
+    /* deadlines in the future are not recorded */
+    latency_record(LATENCY_STAGE_TWR_LISTEN_DELAY, deadline);
+    latency_get(LATENCY_STAGE_TWR_LISTEN_DELAY, &hist);
+    TEST_ASSERT_EQUAL_INT(0, hist.count);
+    test_ztimer_advance_us(2 * US_PER_MS + 300);
+    latency_record(LATENCY_STAGE_TWR_LISTEN_DELAY, deadline);
+    latency_get(LATENCY_STAGE_TWR_LISTEN_DELAY, &hist);
+    TEST_ASSERT_EQUAL_INT(1, hist.count);
+    TEST_ASSERT_EQUAL_INT(2 * US_PER_MS + 300 - (uint64_t)ticks * US_PER_SEC /
+                          CONFIG_ZTIMER_MSEC_BASE_FREQ, hist.max);
+    latency_reset();
+}
+
+Test *tests_latency_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(test_latency_hist_empty),
+        new_TestFixture(test_latency_hist_summary),
+        new_TestFixture(test_latency_hist_percentile),
+        new_TestFixture(test_latency_hist_overflow),
+        new_TestFixture(test_latency_stages),
+        new_TestFixture(test_latency_record),
+    };
+
+    EMB_UNIT_TESTCALLER(latency_tests, setUp, tearDown, fixtures);
+    return (Test *)&latency_tests;
+}
+
+void tests_latency(void)
+{
+    TESTS_RUN(tests_latency_all());
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2021 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @addtogroup  unittests
+ * @{
+ *
+ * @file
+ * @brief       Unittests for the latency
+ *
+ */
+#ifndef TESTS_LATENCY_H
+#define TESTS_LATENCY_H
+
+#include "embUnit/embUnit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  @brief   The entry point of this test suite.
+ */
+void tests_latency(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TESTS_LATENCY_H */
+/** @} */
+
@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "embUnit.h"
+#include "pepper_srv_ring.h"
+
+#define TEST_RING_SIZE      (4U)
+
+static uint32_t _buf[TEST_RING_SIZE];
+static atomic_bool _ready[TEST_RING_SIZE];
+static pepper_srv_ring_t _ring;
+
+static void setUp(void)
+{
+    pepper_srv_ring_init(&_ring, _buf, _ready, sizeof(uint32_t), TEST_RING_SIZE);
+}
+
+static void tearDown(void)
+{
+}
+
+static void tests_pepper_srv_ring_push_peek(void)
+{
+    bool was_empty = false;
+    uint32_t *elems;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pepper_srv_ring_push(&_ring, &i, &was_empty));
+        TEST_ASSERT_EQUAL_INT(i == 0, was_empty);
+    }
+    TEST_ASSERT_EQUAL_INT(3, pepper_srv_ring_used(&_ring));
+    TEST_ASSERT_EQUAL_INT(3, pepper_srv_ring_peek(&_ring, (void **)&elems));
+    for (uint32_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(i, elems[i]);
+    }
+    pepper_srv_ring_release(&_ring, 3);
+    TEST_ASSERT_EQUAL_INT(0, pepper_srv_ring_used(&_ring));
+    TEST_ASSERT_EQUAL_INT(0, pepper_srv_ring_peek(&_ring, (void **)&elems));
+}
+
+static void tests_pepper_srv_ring_full(void)
+{
+    pepper_srv_ring_stats_t stats;
+
+    for (uint32_t i = 0; i < TEST_RING_SIZE; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pepper_srv_ring_push(&_ring, &i, NULL));
+    }
+    uint32_t val = 0xFF;
+    TEST_ASSERT(pepper_srv_ring_push(&_ring, &val, NULL) < 0);
+
+    pepper_srv_ring_stats(&_ring, &stats);
+    TEST_ASSERT_EQUAL_INT(TEST_RING_SIZE, stats.submitted);
+    TEST_ASSERT_EQUAL_INT(1, stats.dropped);
+    TEST_ASSERT_EQUAL_INT(TEST_RING_SIZE, stats.high_watermark);
+}
+
+static void tests_pepper_srv_ring_wrap(void)
+{
+    uint32_t *elems;
+
+    /* move the tail to the middle of the ring */
+    for (uint32_t i = 0; i < 3; i++) {
+        pepper_srv_ring_push(&_ring, &i, NULL);
+    }
+    pepper_srv_ring_peek(&_ring, (void **)&elems);
+    pepper_srv_ring_release(&_ring, 3);
+
+    for (uint32_t i = 10; i < 13; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pepper_srv_ring_push(&_ring, &i, NULL));
+    }
+    /* contiguous batch stops at the end of the ring */
+    TEST_ASSERT_EQUAL_INT(1, pepper_srv_ring_peek(&_ring, (void **)&elems));
+    TEST_ASSERT_EQUAL_INT(10, elems[0]);
+    pepper_srv_ring_release(&_ring, 1);
+    TEST_ASSERT_EQUAL_INT(2, pepper_srv_ring_peek(&_ring, (void **)&elems));
+    TEST_ASSERT_EQUAL_INT(11, elems[0]);
+    TEST_ASSERT_EQUAL_INT(12, elems[1]);
+    pepper_srv_ring_release(&_ring, 2);
+    TEST_ASSERT_EQUAL_INT(0, pepper_srv_ring_used(&_ring));
+}
+
+Test *tests_pepper_srv_ring_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(tests_pepper_srv_ring_push_peek),
+        new_TestFixture(tests_pepper_srv_ring_full),
+        new_TestFixture(tests_pepper_srv_ring_wrap),
+    };
+
+    EMB_UNIT_TESTCALLER(pepper_srv_ring_tests, setUp, tearDown, fixtures);
+    return (Test *)&pepper_srv_ring_tests;
+}
+
+void tests_pepper_srv_ring(void)
+{
+    TESTS_RUN(tests_pepper_srv_ring_all());
+}
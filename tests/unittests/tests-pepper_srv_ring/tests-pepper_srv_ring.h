@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @addtogroup  unittests
+ * @{
+ *
+ * @file
+ * @brief       Unittests for the pepper_srv sample ring
+ *
+ */
+#ifndef TESTS_PEPPER_SRV_RING_H
+#define TESTS_PEPPER_SRV_RING_H
+
+#include "embUnit/embUnit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  @brief   The entry point of this test suite.
+ */
+void tests_pepper_srv_ring(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TESTS_PEPPER_SRV_RING_H */
+/** @} */
+
@@ -1,6 +1,8 @@
+#include <errno.h>
 #include <string.h>
 
 #include "embUnit.h"
+#include "kernel_defines.h"
 #include "security_ctx.h"
 
 #define ENABLE_DEBUG    0
@@ -39,7 +41,6 @@ static uint8_t expected_encoded_message[] = {
 };
 
 static uint8_t buf[256];
-static uint8_t dbuf[256];
 static char message[] = "a secret message";
 
 static void setUp(void)
@@ -94,19 +95,165 @@ static void test_security_ctx_encode_decode(void)
     TEST_ASSERT_EQUAL_INT(0, memcmp(alice_ctx.common_iv, bob_ctx.common_iv, SECURITY_CTX_COMMON_IV_LEN));
     uint8_t *out;
     size_t olen = security_ctx_encode(&bob_ctx, (uint8_t*) message, strlen(message), buf, sizeof(buf), &out);
+    TEST_ASSERT_EQUAL_INT(sizeof(expected_encoded_message), olen);
     TEST_ASSERT_EQUAL_INT(0, memcmp(out, expected_encoded_message, olen));
-    uint8_t msg[sizeof(message)];
+    uint8_t *msg;
     size_t msg_len = 0;
-    TEST_ASSERT_EQUAL_INT(0, security_ctx_decode(&alice_ctx, out, olen, dbuf, sizeof(dbuf), msg, &msg_len));
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_decode(&alice_ctx, out, olen, &msg, &msg_len));
+    TEST_ASSERT_EQUAL_INT(strlen(message), msg_len);
     TEST_ASSERT_EQUAL_INT(0, memcmp(message, msg, msg_len));
 }
 
+static void test_security_ctx_encode_decode_inplace(void)
+{
+    security_ctx_t alice_ctx;
+    security_ctx_t bob_ctx;
+    security_ctx_init(&alice_ctx, alice_id, sizeof(alice_id), bob_id, sizeof(bob_id));
+    security_ctx_init(&bob_ctx, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    security_ctx_key_gen(&alice_ctx, salt, sizeof(salt), secret, sizeof(secret));
+    security_ctx_key_gen(&bob_ctx, salt, sizeof(salt), secret, sizeof(secret));
+    /* plaintext already in place, no second buffer */
+    uint8_t *data = buf + SECURITY_CTX_HEADROOM;
+    memcpy(data, message, strlen(message));
+    uint8_t *out;
+    int olen = security_ctx_encode(&bob_ctx, data, strlen(message), buf,
+                                   SECURITY_CTX_ENCODE_BUF_LEN(strlen(message)), &out);
+    TEST_ASSERT_EQUAL_INT(sizeof(expected_encoded_message), olen);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(out, expected_encoded_message, olen));
+    uint8_t *msg;
+    size_t msg_len = 0;
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_decode(&alice_ctx, out, olen, &msg, &msg_len));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(message, msg, msg_len));
+    /* tampered messages are rejected */
+    olen = security_ctx_encode(&bob_ctx, (uint8_t*) message, strlen(message), buf,
+                               sizeof(buf), &out);
+    out[olen - 1] ^= 0x01;
+    TEST_ASSERT(security_ctx_decode(&alice_ctx, out, olen, &msg, &msg_len) < 0);
+    /* too small buffers are rejected */
+    TEST_ASSERT(security_ctx_encode(&bob_ctx, (uint8_t*) message, strlen(message), buf,
+                                    SECURITY_CTX_ENCODE_BUF_LEN(strlen(message)) - 1,
+                                    &out) < 0);
+}
+
+static void test_security_ctx_expiry(void)
+{
+    security_ctx_t ctx;
+    uint8_t *out;
+
+    security_ctx_init(&ctx, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    security_ctx_key_gen(&ctx, salt, sizeof(salt), secret, sizeof(secret));
+    ctx.seqnr = SECURITY_CTX_SEQNR_MAX;
+    TEST_ASSERT_EQUAL_INT(-ESTALE, security_ctx_encode(&ctx, (uint8_t*) message,
+                                                       strlen(message), buf,
+                                                       sizeof(buf), &out));
+    TEST_ASSERT(!ctx.valid);
+    /* new keys start over */
+    security_ctx_key_gen(&ctx, salt, sizeof(salt), secret, sizeof(secret));
+    TEST_ASSERT_EQUAL_INT(0, ctx.seqnr);
+    TEST_ASSERT(ctx.valid);
+}
+
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+#include "test_mtd_ram.h"
+
+#define TEST_PAGE_SIZE      (256U)
+#define TEST_SECTORS        (2U)
+
+static uint8_t _flash[TEST_PAGE_SIZE * TEST_SECTORS];
+
+static test_mtd_ram_t _mtd;
+
+static void test_security_ctx_persist(void)
+{
+    security_ctx_t alice_ctx;
+    security_ctx_t bob_ctx;
+    security_ctx_t restored;
+    uint8_t *out;
+    uint8_t *msg;
+    size_t msg_len;
+    int olen;
+
+    test_mtd_ram_init(&_mtd, _flash, TEST_PAGE_SIZE, TEST_SECTORS);
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_persist_init(&_mtd.base, 0, TEST_SECTORS));
+
+    security_ctx_init(&restored, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    TEST_ASSERT_EQUAL_INT(-ENOENT, security_ctx_restore(&restored));
+
+    /* new keys are saved with a first window reserved */
+    security_ctx_init(&alice_ctx, alice_id, sizeof(alice_id), bob_id, sizeof(bob_id));
+    security_ctx_init(&bob_ctx, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    security_ctx_key_gen(&alice_ctx, salt, sizeof(salt), secret, sizeof(secret));
+    security_ctx_key_gen(&bob_ctx, salt, sizeof(salt), secret, sizeof(secret));
+    TEST_ASSERT_EQUAL_INT(CONFIG_SECURITY_CTX_SEQNR_WINDOW, bob_ctx.seqnr_hwm);
+
+    /* using the whole window reserves the next one */
+    for (unsigned i = 0; i <= CONFIG_SECURITY_CTX_SEQNR_WINDOW; i++) {
+        TEST_ASSERT(security_ctx_encode(&bob_ctx, (uint8_t*) message, strlen(message),
+                                        buf, sizeof(buf), &out) > 0);
+    }
+    TEST_ASSERT_EQUAL_INT(2 * CONFIG_SECURITY_CTX_SEQNR_WINDOW, bob_ctx.seqnr_hwm);
+
+    /* after a reboot the seqnr skips ahead past any used one */
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_restore(&restored));
+    TEST_ASSERT(restored.valid);
+    TEST_ASSERT(restored.seqnr >= bob_ctx.seqnr);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(restored.send_ctx_key, bob_ctx.send_ctx_key,
+                                    SECURITY_CTX_KEY_LEN));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(restored.common_iv, bob_ctx.common_iv,
+                                    SECURITY_CTX_COMMON_IV_LEN));
+    olen = security_ctx_encode(&restored, (uint8_t*) message, strlen(message),
+                               buf, sizeof(buf), &out);
+    TEST_ASSERT(olen > 0);
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_decode(&alice_ctx, out, olen, &msg, &msg_len));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(message, msg, msg_len));
+
+    /* expired contexts are not restored */
+    restored.seqnr = SECURITY_CTX_SEQNR_MAX - 1;
+    security_ctx_encode(&restored, (uint8_t*) message, strlen(message),
+                        buf, sizeof(buf), &out);
+    security_ctx_init(&restored, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    TEST_ASSERT_EQUAL_INT(-ESTALE, security_ctx_restore(&restored));
+}
+
+static void test_security_ctx_persist_invalidate(void)
+{
+    security_ctx_t ctx;
+    security_ctx_t restored;
+
+    test_mtd_ram_init(&_mtd, _flash, TEST_PAGE_SIZE, TEST_SECTORS);
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_persist_init(&_mtd.base, 0, TEST_SECTORS));
+
+    security_ctx_init(&ctx, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    security_ctx_init(&restored, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    security_ctx_key_gen(&ctx, salt, sizeof(salt), secret, sizeof(secret));
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_restore(&restored));
+
+    /* e.g. on a decrypt failure, the context is not restored after a reboot */
+    security_ctx_invalidate(&ctx);
+    TEST_ASSERT(!ctx.valid);
+    security_ctx_init(&restored, bob_id, sizeof(bob_id), alice_id, sizeof(alice_id));
+    TEST_ASSERT_EQUAL_INT(-ESTALE, security_ctx_restore(&restored));
+    TEST_ASSERT(!restored.valid);
+
+    /* until new keys are saved */
+    security_ctx_key_gen(&ctx, salt, sizeof(salt), secret, sizeof(secret));
+    TEST_ASSERT_EQUAL_INT(0, security_ctx_restore(&restored));
+    TEST_ASSERT(restored.valid);
+}
+#endif
+
 Test *tests_security_ctx_all(void)
 {
     EMB_UNIT_TESTFIXTURES(fixtures) {
         new_TestFixture(test_security_ctx_key_gen),
         new_TestFixture(test_security_ctx_gen_nonce),
         new_TestFixture(test_security_ctx_encode_decode),
+        new_TestFixture(test_security_ctx_encode_decode_inplace),
+        new_TestFixture(test_security_ctx_expiry),
+#if IS_USED(MODULE_SECURITY_CTX_PERSIST)
+        new_TestFixture(test_security_ctx_persist),
+        new_TestFixture(test_security_ctx_persist_invalidate),
+#endif
     };
 
     EMB_UNIT_TESTCALLER(security_ctx_tests, setUp, tearDown, fixtures);
@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <string.h>
+
+#include "embUnit.h"
+#include "twr.h"
+
+#define ADDR                (0x1234)
+/* 20ppm fast neighbour */
+#define DRIFT_PPB           (20000)
+/* scheduling offset, 1s */
+#define OFFSET_US           (1000000LU)
+
+static void setUp(void)
+{
+    twr_peer_reset();
+}
+
+static void tearDown(void)
+{
+}
+
+static void tests_twr_peer_unknown(void)
+{
+    twr_peer_t peer;
+
+    TEST_ASSERT_EQUAL_INT(-ENOENT, twr_peer_get(ADDR, &peer));
+    TEST_ASSERT_EQUAL_INT(-ENOENT, twr_peer_get_by_idx(0, &peer));
+    TEST_ASSERT_EQUAL_INT(-ENOENT, twr_peer_get_by_idx(CONFIG_TWR_PEER_NUMOF, &peer));
+    TEST_ASSERT_EQUAL_INT(0, twr_peer_predict_us(ADDR, OFFSET_US));
+}
+
+static void tests_twr_peer_samples_min(void)
+{
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_SAMPLES_MIN; i++) {
+        TEST_ASSERT_EQUAL_INT(0, twr_peer_predict_us(ADDR, OFFSET_US));
+        twr_peer_sample_offset(ADDR, 100, OFFSET_US);
+    }
+    TEST_ASSERT_EQUAL_INT(100, twr_peer_predict_us(ADDR, OFFSET_US));
+}
+
+static void tests_twr_peer_drift(void)
+{
+    twr_peer_t peer;
+
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_SAMPLES_MIN; i++) {
+        twr_peer_sample_drift(ADDR, DRIFT_PPB);
+    }
+    /* the fast neighbour requests land 20us early after 1s */
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_SAMPLES_MIN; i++) {
+        twr_peer_sample_offset(ADDR, 100 - 20, OFFSET_US);
+    }
+    TEST_ASSERT_EQUAL_INT(0, twr_peer_get(ADDR, &peer));
+    TEST_ASSERT_EQUAL_INT(ADDR, peer.addr);
+    TEST_ASSERT_EQUAL_INT(DRIFT_PPB, peer.drift_ppb);
+    /* only the scheduling offset independent part is stored */
+    TEST_ASSERT_EQUAL_INT(100, peer.offset_us);
+    TEST_ASSERT_EQUAL_INT(100 - 20, twr_peer_predict_us(ADDR, OFFSET_US));
+    TEST_ASSERT_EQUAL_INT(100 - 40, twr_peer_predict_us(ADDR, 2 * OFFSET_US));
+    TEST_ASSERT_EQUAL_INT(100, twr_peer_predict_us(ADDR, 0));
+}
+
+static void tests_twr_peer_ewma(void)
+{
+    twr_peer_t peer;
+
+    /* the first samples are averaged */
+    for (unsigned i = 0; i < (1 << CONFIG_TWR_PEER_EWMA_SHIFT); i++) {
+        twr_peer_sample_offset(ADDR, i % 2 ? 200 : 0, 0);
+    }
+    TEST_ASSERT_EQUAL_INT(0, twr_peer_get(ADDR, &peer));
+    TEST_ASSERT_EQUAL_INT(100, peer.offset_us);
+    /* then a new sample has a 1 / 2^shift weight */
+    twr_peer_sample_offset(ADDR, 100 + (1 << CONFIG_TWR_PEER_EWMA_SHIFT) * 10, 0);
+    TEST_ASSERT_EQUAL_INT(0, twr_peer_get(ADDR, &peer));
+    TEST_ASSERT_EQUAL_INT(110, peer.offset_us);
+}
+
+static void tests_twr_peer_saturate(void)
+{
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_SAMPLES_MIN; i++) {
+        twr_peer_sample_offset(ADDR, 10 * CONFIG_TWR_PEER_CORRECTION_MAX_US, 0);
+        twr_peer_sample_offset(ADDR + 1, -10 * CONFIG_TWR_PEER_CORRECTION_MAX_US, 0);
+    }
+    TEST_ASSERT_EQUAL_INT(CONFIG_TWR_PEER_CORRECTION_MAX_US,
+                          twr_peer_predict_us(ADDR, 0));
+    TEST_ASSERT_EQUAL_INT(-CONFIG_TWR_PEER_CORRECTION_MAX_US,
+                          twr_peer_predict_us(ADDR + 1, 0));
+}
+
+static void tests_twr_peer_replace(void)
+{
+    twr_peer_t peer;
+
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_NUMOF; i++) {
+        twr_peer_sample_offset(ADDR + i, 100, 0);
+    }
+    /* the first entry is refreshed, the second becomes the oldest */
+    twr_peer_sample_drift(ADDR, DRIFT_PPB);
+    twr_peer_sample_offset(ADDR + CONFIG_TWR_PEER_NUMOF, 100, 0);
+    TEST_ASSERT_EQUAL_INT(-ENOENT, twr_peer_get(ADDR + 1, &peer));
+    TEST_ASSERT_EQUAL_INT(0, twr_peer_get(ADDR, &peer));
+    TEST_ASSERT_EQUAL_INT(1, peer.drift_samples);
+    TEST_ASSERT_EQUAL_INT(0, twr_peer_get(ADDR + CONFIG_TWR_PEER_NUMOF, &peer));
+    TEST_ASSERT_EQUAL_INT(1, peer.offset_samples);
+    twr_peer_reset();
+    for (unsigned i = 0; i < CONFIG_TWR_PEER_NUMOF; i++) {
+        TEST_ASSERT_EQUAL_INT(-ENOENT, twr_peer_get_by_idx(i, &peer));
+    }
+}
+
+Test *tests_twr_peer_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(tests_twr_peer_unknown),
+        new_TestFixture(tests_twr_peer_samples_min),
+        new_TestFixture(tests_twr_peer_drift),
+        new_TestFixture(tests_twr_peer_ewma),
+        new_TestFixture(tests_twr_peer_saturate),
+        new_TestFixture(tests_twr_peer_replace),
+    };
+
+    EMB_UNIT_TESTCALLER(twr_peer_tests, setUp, tearDown, fixtures);
+    return (Test *)&twr_peer_tests;
+}
+
+void tests_twr_peer(void)
+{
+    TESTS_RUN(tests_twr_peer_all());
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2022 Inria
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include <string.h>
+
+#include "embUnit.h"
+#include "ed.h"
+#include "thread.h"
+#include "watermark.h"
+
+static ed_memory_manager_t _manager;
+static ed_t *_eds[CONFIG_ED_BUF_SIZE];
+
+static void setUp(void)
+{
+    ed_memory_manager_init(&_manager);
+}
+
+static void tearDown(void)
+{
+    /* Finalize */
+}
+
+static void test_watermark_pool_init(void)
+{
+    TEST_ASSERT_EQUAL_INT(CONFIG_ED_BUF_SIZE, _manager.watermark.size);
+    TEST_ASSERT_EQUAL_INT(0, _manager.watermark.used);
+    TEST_ASSERT_EQUAL_INT(0, _manager.watermark.high);
+    TEST_ASSERT_EQUAL_INT(0, _manager.watermark.fails);
+}
+
+static void test_watermark_pool_exhaust(void)
+{
+    for (unsigned i = 0; i < CONFIG_ED_BUF_SIZE; i++) {
+        _eds[i] = ed_memory_manager_calloc(&_manager);
+        TEST_ASSERT_NOT_NULL(_eds[i]);
+    }
+    TEST_ASSERT_NULL(ed_memory_manager_calloc(&_manager));
+    TEST_ASSERT_NULL(ed_memory_manager_calloc(&_manager));
+    TEST_ASSERT_EQUAL_INT(CONFIG_ED_BUF_SIZE, _manager.watermark.used);
+    TEST_ASSERT_EQUAL_INT(CONFIG_ED_BUF_SIZE, _manager.watermark.high);
+    TEST_ASSERT_EQUAL_INT(2, _manager.watermark.fails);
+
+    /* the high watermark survives frees */
+    for (unsigned i = 0; i < CONFIG_ED_BUF_SIZE; i++) {
+        ed_memory_manager_free(&_manager, _eds[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(0, _manager.watermark.used);
+    TEST_ASSERT_EQUAL_INT(CONFIG_ED_BUF_SIZE, _manager.watermark.high);
+}
+
+static void test_watermark_pool_reset(void)
+{
+    _eds[0] = ed_memory_manager_calloc(&_manager);
+    _eds[1] = ed_memory_manager_calloc(&_manager);
+    ed_memory_manager_free(&_manager, _eds[1]);
+    _manager.watermark.fails = 1;
+
+    /* restarts from the blocks still in use */
+    watermark_pool_reset(&_manager.watermark);
+    TEST_ASSERT_EQUAL_INT(1, _manager.watermark.used);
+    TEST_ASSERT_EQUAL_INT(1, _manager.watermark.high);
+    TEST_ASSERT_EQUAL_INT(0, _manager.watermark.fails);
+    ed_memory_manager_free(&_manager, _eds[0]);
+}
+
+static void test_watermark_stacks(void)
+{
+    watermark_stack_t stacks[CONFIG_WATERMARK_STACKS_NUMOF];
+    unsigned numof = watermark_stacks(stacks, ARRAY_SIZE(stacks), NULL, 0);
+
+#ifdef DEVELHELP
+    /* at least idle and main */
+    TEST_ASSERT(numof >= 2);
+    for (unsigned i = 0; i < numof; i++) {
+        TEST_ASSERT_NOT_NULL(stacks[i].name);
+        TEST_ASSERT(stacks[i].used > 0);
+        TEST_ASSERT(stacks[i].used <= stacks[i].size);
+    }
+    TEST_ASSERT_EQUAL_INT(1, watermark_stacks(stacks, 1, NULL, 0));
+#else
+    TEST_ASSERT_EQUAL_INT(0, numof);
+#endif
+}
+
+static void test_watermark_stacks_pids(void)
+{
+    watermark_stack_t stacks[2];
+    /* invalid and duplicate PIDs are skipped */
+    const kernel_pid_t pids[] = {
+        KERNEL_PID_UNDEF, thread_getpid(), thread_getpid(),
+    };
+    unsigned numof = watermark_stacks(stacks, ARRAY_SIZE(stacks), pids,
+                                      ARRAY_SIZE(pids));
+
+#ifdef DEVELHELP
+    /* the listed thread first, though idle has a lower PID */
+    TEST_ASSERT_EQUAL_INT(2, numof);
+    TEST_ASSERT_EQUAL_STRING(thread_get_name(thread_get_active()), stacks[0].name);
+    TEST_ASSERT(strcmp(stacks[0].name, stacks[1].name) != 0);
+#else
+    TEST_ASSERT_EQUAL_INT(0, numof);
+#endif
+}
+
+Test *tests_watermark_all(void)
+{
+    EMB_UNIT_TESTFIXTURES(fixtures) {
+        new_TestFixture(test_watermark_pool_init),
+        new_TestFixture(test_watermark_pool_exhaust),
+        new_TestFixture(test_watermark_pool_reset),
+        new_TestFixture(test_watermark_stacks),
+        new_TestFixture(test_watermark_stacks_pids),
+    };
+
+    EMB_UNIT_TESTCALLER(watermark_tests, setUp, tearDown, fixtures);
+    return (Test *)&watermark_tests;
+}
+
+void tests_watermark(void)
+{
+    TESTS_RUN(tests_watermark_all());
+}